@@ -0,0 +1,279 @@
+// BarnesHutクラスの実装部分
+
+#include <algorithm>    // std::max, std::min
+#include <cmath>        // std::sqrt
+
+#include "BarnesHut.h"
+#include "ThreadPool.h"
+
+namespace {
+    const int MAX_DEPTH = 32;       // 同じ位置に天体が重なっていても無限に分割しないための上限
+    const int STACK_SIZE = 8 * (MAX_DEPTH + 2);    // 木をたどるときのスタックの大きさ
+    const size_t WALK_GRAIN = 256;  // 並列に木をたどるとき、1つの塊にする天体の数
+}
+
+BarnesHut::BarnesHut(float thetaInput, size_t leafSizeInput, bool quadrupoleInput)
+:   theta(thetaInput),
+    leafSize(leafSizeInput),
+    quadrupole(quadrupoleInput),
+    rebuildInterval(1),
+    bodyCount_(0),
+    evaluationsSinceBuild_(0)
+{
+}
+
+void BarnesHut::accelerations(const float* x, const float* y, const float* z, const float* gm, size_t n,
+                              float* ax, float* ay, float* az, ThreadPool* pool) {
+    // 天体数が変わったときや、決められた回数が経ったときは作り直す。それ以外はrefitで済ませる
+    if (nodes_.empty() || n != bodyCount_ || evaluationsSinceBuild_ >= rebuildInterval) {
+        build(x, y, z, gm, n);
+    } else {
+        refit(x, y, z, gm);
+    }
+    ++evaluationsSinceBuild_;
+
+    auto walk = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            accelerationAt(x[i], y[i], z[i], i, x, y, z, gm, ax[i], ay[i], az[i]);
+        }
+    };
+    if (pool) {
+        pool->parallelFor(0, n, WALK_GRAIN, walk);
+    } else {
+        walk(0, n);
+    }
+}
+
+void BarnesHut::build(const float* x, const float* y, const float* z, const float* gm, size_t n) {
+    bodyCount_ = n;
+    evaluationsSinceBuild_ = 0;
+    nodes_.clear();
+    order_.resize(n);
+    scratch_.resize(n);
+    for (size_t i = 0; i < n; ++i) order_[i] = i;
+    if (n == 0) return;
+
+    // 全天体を囲む立方体を根にする
+    float lower[3] = {x[0], y[0], z[0]};
+    float upper[3] = {x[0], y[0], z[0]};
+    for (size_t i = 1; i < n; ++i) {
+        lower[0] = std::min(lower[0], x[i]); upper[0] = std::max(upper[0], x[i]);
+        lower[1] = std::min(lower[1], y[i]); upper[1] = std::max(upper[1], y[i]);
+        lower[2] = std::min(lower[2], z[i]); upper[2] = std::max(upper[2], z[i]);
+    }
+    float half = 0.5f * std::max(upper[0] - lower[0], std::max(upper[1] - lower[1], upper[2] - lower[2]));
+    half = half * 1.001f + 1e-30f;  // 境界上の天体がはみ出さないように少し広げる
+
+    Node root = {};
+    root.begin = 0;
+    root.end = n;
+    root.firstChild = -1;
+    nodes_.push_back(root);
+    subdivide(0, 0.5f * (lower[0] + upper[0]), 0.5f * (lower[1] + upper[1]), 0.5f * (lower[2] + upper[2]), half, 0, x, y, z);
+    computeMoments(0, x, y, z, gm);
+}
+
+void BarnesHut::refit(const float* x, const float* y, const float* z, const float* gm) {
+    if (!nodes_.empty()) computeMoments(0, x, y, z, gm);
+}
+
+// nodeIndexのノードを八つの小立方体に分ける。(cx, cy, cz)は立方体の中心、halfは辺の半分
+void BarnesHut::subdivide(int nodeIndex, float cx, float cy, float cz, float half, int depth,
+                          const float* x, const float* y, const float* z) {
+    const size_t begin = nodes_[nodeIndex].begin;
+    const size_t end = nodes_[nodeIndex].end;
+    if (end - begin <= leafSize || depth >= MAX_DEPTH) {
+        nodes_[nodeIndex].firstChild = -1;
+        nodes_[nodeIndex].childCount = 0;
+        return;
+    }
+
+    // どの小立方体に入るかで数え上げソートする(bit0:x, bit1:y, bit2:z が中心以上か)
+    size_t count[8] = {0};
+    for (size_t k = begin; k < end; ++k) {
+        size_t i = order_[k];
+        int octant = (x[i] >= cx ? 1 : 0) | (y[i] >= cy ? 2 : 0) | (z[i] >= cz ? 4 : 0);
+        ++count[octant];
+    }
+    size_t offset[8];
+    size_t start = begin;
+    int childCount = 0;
+    for (int o = 0; o < 8; ++o) {
+        offset[o] = start;
+        start += count[o];
+        if (count[o] > 0) ++childCount;
+    }
+    for (size_t k = begin; k < end; ++k) {
+        size_t i = order_[k];
+        int octant = (x[i] >= cx ? 1 : 0) | (y[i] >= cy ? 2 : 0) | (z[i] >= cz ? 4 : 0);
+        scratch_[offset[octant]++] = i;
+    }
+    std::copy(scratch_.begin() + begin, scratch_.begin() + end, order_.begin() + begin);
+
+    // 空でない小立方体だけを子ノードとして連続して確保する(resizeで参照が無効になるので番号で扱う)
+    const int firstChild = static_cast<int>(nodes_.size());
+    nodes_.resize(nodes_.size() + childCount);
+    nodes_[nodeIndex].firstChild = firstChild;
+    nodes_[nodeIndex].childCount = childCount;
+
+    const float quarter = 0.5f * half;
+    size_t childBegin = begin;
+    int child = firstChild;
+    for (int o = 0; o < 8; ++o) {
+        if (count[o] == 0) continue;
+        Node& node = nodes_[child];
+        node = Node();
+        node.begin = childBegin;
+        node.end = childBegin + count[o];
+        node.firstChild = -1;
+        childBegin += count[o];
+        subdivide(child,
+                  cx + ((o & 1) ? quarter : -quarter),
+                  cy + ((o & 2) ? quarter : -quarter),
+                  cz + ((o & 4) ? quarter : -quarter),
+                  quarter, depth + 1, x, y, z);
+        ++child;
+    }
+}
+
+// 重心、質量、四重極、囲む箱を葉から順に計算する。木の形は変えないので、refitでもそのまま使える
+void BarnesHut::computeMoments(int nodeIndex, const float* x, const float* y, const float* z, const float* gm) {
+    Node& node = nodes_[nodeIndex];
+    float mass = 0.0f;
+    float weighted[3] = {0.0f, 0.0f, 0.0f};
+    float lower[3], upper[3];
+
+    if (node.firstChild < 0) {
+        size_t first = order_[node.begin];
+        lower[0] = upper[0] = x[first];
+        lower[1] = upper[1] = y[first];
+        lower[2] = upper[2] = z[first];
+        for (size_t k = node.begin; k < node.end; ++k) {
+            size_t i = order_[k];
+            mass += gm[i];
+            weighted[0] += gm[i] * x[i]; weighted[1] += gm[i] * y[i]; weighted[2] += gm[i] * z[i];
+            lower[0] = std::min(lower[0], x[i]); upper[0] = std::max(upper[0], x[i]);
+            lower[1] = std::min(lower[1], y[i]); upper[1] = std::max(upper[1], y[i]);
+            lower[2] = std::min(lower[2], z[i]); upper[2] = std::max(upper[2], z[i]);
+        }
+    } else {
+        for (int c = 0; c < node.childCount; ++c) {
+            computeMoments(node.firstChild + c, x, y, z, gm);
+        }
+        const Node& first = nodes_[node.firstChild];
+        for (int k = 0; k < 3; ++k) { lower[k] = first.lower[k]; upper[k] = first.upper[k]; }
+        for (int c = 0; c < node.childCount; ++c) {
+            const Node& child = nodes_[node.firstChild + c];
+            mass += child.gm;
+            for (int k = 0; k < 3; ++k) {
+                weighted[k] += child.gm * child.com[k];
+                lower[k] = std::min(lower[k], child.lower[k]);
+                upper[k] = std::max(upper[k], child.upper[k]);
+            }
+        }
+    }
+
+    node.gm = mass;
+    for (int k = 0; k < 3; ++k) {
+        // 質量がない(テスト粒子だけの)ノードは箱の中心を重心とする
+        node.com[k] = (mass > 0.0f) ? weighted[k] / mass : 0.5f * (lower[k] + upper[k]);
+        node.lower[k] = lower[k];
+        node.upper[k] = upper[k];
+    }
+    node.size = std::max(upper[0] - lower[0], std::max(upper[1] - lower[1], upper[2] - lower[2]));
+
+    for (int k = 0; k < 6; ++k) node.quad[k] = 0.0f;
+    if (!quadrupole) return;
+
+    // Q = Σ m (3 s s^T - |s|^2 I)  (sは重心からの位置)。子ノードの分は平行軸の定理で移す
+    auto addPoint = [&node](float m, float sx, float sy, float sz) {
+        float s2 = sx*sx + sy*sy + sz*sz;
+        node.quad[0] += m * (3.0f*sx*sx - s2);
+        node.quad[1] += m * (3.0f*sy*sy - s2);
+        node.quad[2] += m * (3.0f*sz*sz - s2);
+        node.quad[3] += m * 3.0f*sx*sy;
+        node.quad[4] += m * 3.0f*sx*sz;
+        node.quad[5] += m * 3.0f*sy*sz;
+    };
+    if (node.firstChild < 0) {
+        for (size_t k = node.begin; k < node.end; ++k) {
+            size_t i = order_[k];
+            addPoint(gm[i], x[i] - node.com[0], y[i] - node.com[1], z[i] - node.com[2]);
+        }
+    } else {
+        for (int c = 0; c < node.childCount; ++c) {
+            const Node& child = nodes_[node.firstChild + c];
+            for (int k = 0; k < 6; ++k) node.quad[k] += child.quad[k];
+            addPoint(child.gm, child.com[0] - node.com[0], child.com[1] - node.com[1], child.com[2] - node.com[2]);
+        }
+    }
+}
+
+void BarnesHut::accelerationAt(float px, float py, float pz, size_t skip,
+                               const float* x, const float* y, const float* z, const float* gm,
+                               float& axOut, float& ayOut, float& azOut) const {
+    float ax = 0.0f, ay = 0.0f, az = 0.0f;
+    if (nodes_.empty()) { axOut = ayOut = azOut = 0.0f; return; }
+
+    const float theta2 = theta * theta;
+    int stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes_[stack[--top]];
+
+        // 点が箱の中にあるノードは近似しない(自分自身の質量を含んでしまうため)
+        bool inside = px >= node.lower[0] && px <= node.upper[0]
+                   && py >= node.lower[1] && py <= node.upper[1]
+                   && pz >= node.lower[2] && pz <= node.upper[2];
+        float dx = px - node.com[0];
+        float dy = py - node.com[1];
+        float dz = pz - node.com[2];
+        float r2 = dx*dx + dy*dy + dz*dz;
+
+        if (!inside && node.size * node.size < theta2 * r2) {
+            // 十分遠いので重心で近似: a = -gm d/r^3
+            float invR = 1.0f / std::sqrt(r2);
+            float invR2 = invR * invR;
+            float invR3 = invR * invR2;
+            ax -= node.gm * dx * invR3;
+            ay -= node.gm * dy * invR3;
+            az -= node.gm * dz * invR3;
+            if (quadrupole) {
+                // a_q = Q d / r^5 - (5/2) (d・Q d) d / r^7
+                const float* q = node.quad;
+                float qx = q[0]*dx + q[3]*dy + q[4]*dz;
+                float qy = q[3]*dx + q[1]*dy + q[5]*dz;
+                float qz = q[4]*dx + q[5]*dy + q[2]*dz;
+                float invR5 = invR3 * invR2;
+                float dqd = (dx*qx + dy*qy + dz*qz) * invR5 * invR2;
+                ax += qx * invR5 - 2.5f * dqd * dx;
+                ay += qy * invR5 - 2.5f * dqd * dy;
+                az += qz * invR5 - 2.5f * dqd * dz;
+            }
+        } else if (node.firstChild < 0) {
+            // 葉は中の天体と直接計算する
+            for (size_t k = node.begin; k < node.end; ++k) {
+                size_t j = order_[k];
+                if (j == skip) continue;
+                float ddx = x[j] - px;
+                float ddy = y[j] - py;
+                float ddz = z[j] - pz;
+                float d2 = ddx*ddx + ddy*ddy + ddz*ddz;
+                if (d2 <= 0.0f) continue;   // 完全に重なった天体は無視
+                float invD = 1.0f / std::sqrt(d2);
+                float s = gm[j] * invD * invD * invD;
+                ax += s * ddx;
+                ay += s * ddy;
+                az += s * ddz;
+            }
+        } else {
+            for (int c = 0; c < node.childCount; ++c) {
+                stack[top++] = node.firstChild + c;
+            }
+        }
+    }
+    axOut = ax;
+    ayOut = ay;
+    azOut = az;
+}
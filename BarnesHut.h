@@ -0,0 +1,55 @@
+#ifndef BARNESHUT_H
+#define BARNESHUT_H
+
+#include <cstddef>  // size_t
+#include <vector>   // std::vector
+
+class ThreadPool;
+
+// Barnes–Hut法による重力計算。全天体を八分木(octree)にまとめ、十分遠いノードは重心(と四重極)で近似する。O(N log N)
+// 質量はG*m(シミュレーション単位)で受け取るので、結果はそのまま加速度になる。
+class BarnesHut {
+public:
+    float theta;            // 開き角。ノードの大きさ/距離 < theta なら近似する。小さいほど正確で遅い
+    size_t leafSize;        // 葉に入れる天体の最大数
+    bool quadrupole;        // 四重極モーメントまで使うかどうか
+    int rebuildInterval;    // 木を作り直す間隔(加速度の計算回数)。間の回は木の形を保ったまま重心や大きさだけ更新(refit)する
+
+    BarnesHut(float thetaInput = 0.5f, size_t leafSizeInput = 8, bool quadrupoleInput = false);
+
+    // 位置(x, y, z)とG*m(gm)からn個の天体の加速度を計算してax, ay, azに書き込む
+    // poolがあれば、木をたどる部分を天体ごとに分担する(木の構築は1スレッド)
+    void accelerations(const float* x, const float* y, const float* z, const float* gm, size_t n,
+                       float* ax, float* ay, float* az, ThreadPool* pool = nullptr);
+
+    void build(const float* x, const float* y, const float* z, const float* gm, size_t n);    // 木を作り直す
+    void refit(const float* x, const float* y, const float* z, const float* gm);              // 木の形はそのままでノードの量を更新する
+    // 点(px, py, pz)での加速度。skipは自分自身の番号(木の外の点ならnを渡す)
+    void accelerationAt(float px, float py, float pz, size_t skip,
+                        const float* x, const float* y, const float* z, const float* gm,
+                        float& ax, float& ay, float& az) const;
+
+private:
+    struct Node {
+        float com[3];       // 重心
+        float gm;           // 含まれる天体のG*mの和
+        float quad[6];      // 重心まわりの四重極(トレースレス)。xx, yy, zz, xy, xz, yz
+        float lower[3];     // 含まれる天体を囲む箱
+        float upper[3];
+        float size;         // 箱の一番長い辺
+        size_t begin, end;  // order_の中で、このノードに含まれる天体の範囲
+        int firstChild;     // 子ノードの先頭(子は連続して並ぶ)。葉なら-1
+        int childCount;
+    };
+    std::vector<Node> nodes_;       // nodes_[0]が根
+    std::vector<size_t> order_;     // 天体の番号を、木の葉の順に並べたもの
+    std::vector<size_t> scratch_;   // 分割時の作業領域
+    size_t bodyCount_;
+    int evaluationsSinceBuild_;
+
+    void subdivide(int nodeIndex, float cx, float cy, float cz, float half, int depth,
+                   const float* x, const float* y, const float* z);
+    void computeMoments(int nodeIndex, const float* x, const float* y, const float* z, const float* gm);
+};
+
+#endif
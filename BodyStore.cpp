@@ -0,0 +1,160 @@
+// BodyStoreクラスの実装部分
+
+#include <algorithm>    // std::max
+#include <cstring>      // std::memcpy
+#include <new>          // operator new(size_t, std::align_val_t)
+#include <utility>      // std::swap
+
+#include "BodyStore.h"
+
+namespace {
+    const size_t ALIGNMENT = BodyStore::ALIGNMENT;
+
+    template <typename Real>
+    Real* allocateArena(size_t capacity) {
+        if (capacity == 0) return nullptr;
+        size_t bytes = capacity * BasicBodyStore<Real>::ARRAY_COUNT * sizeof(Real);
+        return static_cast<Real*>(::operator new(bytes, std::align_val_t(ALIGNMENT)));
+    }
+
+    template <typename Real>
+    void freeArena(Real* arena) {
+        if (arena) ::operator delete(arena, std::align_val_t(ALIGNMENT));
+    }
+}
+
+template <typename Real>
+BasicBodyStore<Real>::BasicBodyStore()
+:   arena_(nullptr),
+    size_(0),
+    capacity_(0)
+{
+    setPointers();
+}
+
+template <typename Real>
+BasicBodyStore<Real>::~BasicBodyStore() {
+    freeArena(arena_);
+}
+
+template <typename Real>
+BasicBodyStore<Real>::BasicBodyStore(const BasicBodyStore& other)
+:   arena_(allocateArena<Real>(other.capacity_)),
+    size_(other.size_),
+    capacity_(other.capacity_)
+{
+    if (arena_) std::memcpy(arena_, other.arena_, capacity_ * ARRAY_COUNT * sizeof(Real));
+    setPointers();
+}
+
+template <typename Real>
+BasicBodyStore<Real>& BasicBodyStore<Real>::operator=(const BasicBodyStore& other) {
+    if (this == &other) return *this;
+    if (capacity_ != other.capacity_) {
+        freeArena(arena_);
+        arena_ = allocateArena<Real>(other.capacity_);
+        capacity_ = other.capacity_;
+    }
+    size_ = other.size_;
+    if (arena_) std::memcpy(arena_, other.arena_, capacity_ * ARRAY_COUNT * sizeof(Real));
+    setPointers();
+    return *this;
+}
+
+template <typename Real>
+size_t BasicBodyStore<Real>::size() const {
+    return size_;
+}
+
+template <typename Real>
+size_t BasicBodyStore<Real>::capacity() const {
+    return capacity_;
+}
+
+template <typename Real>
+void BasicBodyStore<Real>::reserve(size_t n) {
+    if (n <= capacity_) return;
+    // 各配列の長さをALIGNMENTバイトの倍数にすると、次の配列の先頭も境界に揃う
+    const size_t perLine = ALIGNMENT / sizeof(Real);
+    size_t capacity = (n + perLine - 1) / perLine * perLine;
+    Real* arena = allocateArena<Real>(capacity);
+    std::memset(arena, 0, capacity * ARRAY_COUNT * sizeof(Real));
+    for (int a = 0; a < ARRAY_COUNT; ++a) {
+        if (size_ > 0) std::memcpy(arena + a * capacity, arena_ + a * capacity_, size_ * sizeof(Real));
+    }
+    freeArena(arena_);
+    arena_ = arena;
+    capacity_ = capacity;
+    setPointers();
+}
+
+template <typename Real>
+void BasicBodyStore<Real>::resize(size_t n) {
+    reserve(n);
+    for (size_t i = size_; i < n; ++i) {
+        x[i] = y[i] = z[i] = Real(0);
+        vx[i] = vy[i] = vz[i] = Real(0);
+        ax[i] = ay[i] = az[i] = Real(0);
+        mu[i] = Real(0);
+    }
+    size_ = n;
+}
+
+template <typename Real>
+size_t BasicBodyStore<Real>::add(Real posX, Real posY, Real posZ, Real velX, Real velY, Real velZ, Real gm) {
+    if (size_ == capacity_) reserve(std::max<size_t>(ALIGNMENT / sizeof(Real), capacity_ * 2));
+    size_t i = size_++;
+    x[i] = posX;  y[i] = posY;  z[i] = posZ;
+    vx[i] = velX; vy[i] = velY; vz[i] = velZ;
+    ax[i] = Real(0); ay[i] = Real(0); az[i] = Real(0);
+    mu[i] = gm;
+    return i;
+}
+
+template <typename Real>
+void BasicBodyStore<Real>::clear() {
+    size_ = 0;
+}
+
+template <typename Real>
+const Real* BasicBodyStore<Real>::arena() const {
+    return arena_;
+}
+
+template <typename Real>
+bool BasicBodyStore<Real>::assign(const Real* arena, size_t n, size_t capacity) {
+    const size_t perLine = ALIGNMENT / sizeof(Real);
+    if (capacity < n || capacity % perLine != 0) return false;
+    if (capacity != capacity_) {
+        Real* fresh = allocateArena<Real>(capacity);
+        freeArena(arena_);
+        arena_ = fresh;
+        capacity_ = capacity;
+        setPointers();
+    }
+    if (capacity > 0) std::memcpy(arena_, arena, capacity * ARRAY_COUNT * sizeof(Real));
+    size_ = n;
+    return true;
+}
+
+template <typename Real>
+void BasicBodyStore<Real>::swap(BasicBodyStore& other) {
+    std::swap(arena_, other.arena_);
+    std::swap(size_, other.size_);
+    std::swap(capacity_, other.capacity_);
+    setPointers();
+    other.setPointers();
+}
+
+// 各配列のポインタをメモリブロックの中に向ける(並びはARRAY_COUNTの説明の順)
+template <typename Real>
+void BasicBodyStore<Real>::setPointers() {
+    Real** arrays[ARRAY_COUNT] = {&x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mu};
+    for (int a = 0; a < ARRAY_COUNT; ++a) {
+        *arrays[a] = arena_ ? arena_ + a * capacity_ : nullptr;
+    }
+}
+
+// 使う型についてだけ実体化する
+template class BasicBodyStore<float>;
+template class BasicBodyStore<double>;
@@ -0,0 +1,50 @@
+#ifndef BODYSTORE_H
+#define BODYSTORE_H
+
+#include <cstddef>  // size_t
+
+// 力の計算と積分で毎ステップ触る量だけを、量ごとの配列(Structure of Arrays)として持つ。
+// 全部の配列を1つのメモリブロックに並べ、各配列の先頭はALIGNMENTバイト境界に揃えてある(SIMDで読めるように)。
+// 名前や色、軌跡などの普段触らない情報はUniverse::bodyInfo(BodyInfo)に分けて持つ。
+// 数値の型(Real)はfloatとdoubleを使える(実装はBodyStore.cppでこの2つについて実体化している)。
+template <typename Real>
+class BasicBodyStore {
+public:
+    static const size_t ALIGNMENT = 64;     // 各配列の先頭の境界(バイト)
+    static const int ARRAY_COUNT = 10;      // 配列の数(x, y, z, vx, vy, vz, ax, ay, az, mu)
+
+    Real* x;  Real* y;  Real* z;        // 位置
+    Real* vx; Real* vy; Real* vz;       // 速度
+    Real* ax; Real* ay; Real* az;       // 加速度
+    Real* mu;                           // G*m(シミュレーション単位)。加速度の計算には質量ではなくこれを使う
+
+    BasicBodyStore();
+    ~BasicBodyStore();
+    BasicBodyStore(const BasicBodyStore& other);
+    BasicBodyStore& operator=(const BasicBodyStore& other);
+
+    size_t size() const;
+    size_t capacity() const;
+    void reserve(size_t n);     // 容量を増やす。ポインタ(x, y, ...)は変わるので取り直すこと
+    void resize(size_t n);      // 天体数を変える。増えた分は0で埋める(積分の作業領域として使うとき用)
+    size_t add(Real posX, Real posY, Real posZ, Real velX, Real velY, Real velZ, Real gm);   // 追加した天体の番号を返す
+    void clear();
+
+    // メモリブロックをそのまま読み書きする(スナップショット用)。ブロックは ARRAY_COUNT * capacity() 個のRealで、配列の並びはx, y, z, ..., mu
+    const Real* arena() const;
+    // 同じ並びのブロック(1配列あたりcapacity個)を一度にコピーして、天体数をnにする。capacityがALIGNMENTバイトの倍数でないか、nより小さければfalse
+    bool assign(const Real* arena, size_t n, size_t capacity);
+    void swap(BasicBodyStore& other);   // 中身を入れ替える(メモリブロックごと入れ替えるのでコピーしない)
+
+private:
+    Real* arena_;       // 全配列の入ったメモリブロック
+    size_t size_;
+    size_t capacity_;   // 1配列あたりの要素数。ALIGNMENTバイトの倍数になるように切り上げてある
+
+    void setPointers();
+};
+
+typedef BasicBodyStore<float> BodyStore;            // 描画や通常の計算で使う単精度の状態
+typedef BasicBodyStore<double> PreciseBodyStore;    // Precision::Doubleで積分するときの倍精度の状態
+
+#endif
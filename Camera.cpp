@@ -1,9 +1,11 @@
 #include "Camera.h"
+#include "Frame.h"
 #include "Constants.h"
 #include "Sphere.h"
 #include "Universe.h"
 #include "Geometry.h"
 #include <GL/gl.h>   // OpenGLの基本機能を使うためのヘッダー
+#include <GL/glu.h>  // gluProject, gluUnProject
 
 
 // カメラや描画に関する定数
@@ -16,20 +18,20 @@ namespace cameraSetting{
 }
 
 // クラスCameraの実装部分
-Camera::Camera(Universe& universe, std::vector<Sphere*> targetSpheres = {})    // コンストラクタ
+Camera::Camera(Universe& universe, std::vector<Sphere> targetSpheres = {})    // コンストラクタ
     :universe_(universe), targetSpheres_(targetSpheres), omegaLatitude_(cameraSetting::omega_z), omegaLongitude_(cameraSetting::omega)  // 適当な初期値
 {
     if (targetSpheres.empty()){
-        for (Sphere& sphere : universe.spheres){
-            targetSpheres_.push_back(&sphere);
+        for (size_t i = 0; i < universe.sphereCount(); ++i){
+            targetSpheres_.push_back(universe.sphere(i));
         }
     }
     
 }
-void Camera::changeSpheres(std::vector<Sphere*> targetSpheres){
+void Camera::changeSpheres(std::vector<Sphere> targetSpheres){
     targetSpheres_=targetSpheres;
 }
-void Camera::addSphere(Sphere* sphere){
+void Camera::addSphere(Sphere sphere){
     targetSpheres_.push_back(sphere);
 }
 float Camera::getPosition(int i) const  {
@@ -50,17 +52,22 @@ float Camera::getUp(int i) const  {
     }
     return up_[i];
 }
-void Camera::update(){
+void Camera::update(const Frame& frame, double alpha){
 //カメラは、球面上を動きながら全天体を画角に収めたい。
     // 見る対象を計算
     float massPos[3] = {0.0f, 0.0f, 0.0f};
     float totalMass = 0.0f;
     // 見る対象を計算してtarget_に格納
-    for (Sphere* sphere : targetSpheres_){
-        massPos[0]+=sphere->mass*sphere->x;
-        massPos[1]+=sphere->mass*sphere->y;
-        massPos[2]+=sphere->mass*sphere->z;
-        totalMass+=sphere->mass;
+    // 天体の状態は計算スレッドが写したframeから読む(Universeは計算スレッドが進めている)
+    for (const Sphere& sphere : targetSpheres_){
+        if (sphere.index() >= frame.bodies.size()) continue;
+        const Frame::Body& body = frame.bodies[sphere.index()];
+        float position[3];
+        frame.position(sphere.index(), alpha, position);
+        massPos[0]+=body.mass*position[0];
+        massPos[1]+=body.mass*position[1];
+        massPos[2]+=body.mass*position[2];
+        totalMass+=body.mass;
         // massPos[0]+=1.0*sphere->x;
         // massPos[1]+=1.0*sphere->y;
         // massPos[2]+=1.0*sphere->z;
@@ -85,9 +92,12 @@ void Camera::update(){
 
     // カメラに収める点をコンテナに入れる。(Sphre*だけでなく、各Sphereの軌跡を構成する点も格納する)
     std::vector<std::tuple<float,float,float>> targetPoints;
-    for (Sphere* sphere : targetSpheres_){
-        targetPoints.push_back(std::make_tuple(sphere->x, sphere->y, sphere->z));
-        for (std::tuple<float, float, float> point : sphere->trajectory){
+    for (const Sphere& sphere : targetSpheres_){
+        if (sphere.index() >= frame.bodies.size()) continue;
+        float position[3];
+        frame.position(sphere.index(), alpha, position);
+        targetPoints.push_back(std::make_tuple(position[0], position[1], position[2]));
+        for (std::tuple<float, float, float> point : frame.trajectoryView(sphere.index())){
             targetPoints.push_back(point);
         }
     }
@@ -140,8 +150,8 @@ void Camera::update(){
     const float theta_center=(theta_max+theta_min)/2; //thetaの中心
     // float theta = theta_center + theta_amplitude*sin(omegaLatitude_*universe_.getSimulationTime() / scaling::time); //thetaの値（緯度）
     // float phi = omegaLongitude_*universe_.getSimulationTime() / scaling::time; //phiの値（経度）
-    float theta = theta_center + theta_amplitude*sin(omegaLatitude_*universe_.getSimulationTime() / scaling::time); //thetaの値（緯度）
-    float phi = omegaLongitude_*universe_.getSimulationTime() / scaling::time; //phiの値（経度）
+    float theta = theta_center + theta_amplitude*sin(omegaLatitude_*frame.simulationTime / scaling::time); //thetaの値（緯度）
+    float phi = omegaLongitude_*frame.simulationTime / scaling::time; //phiの値（経度）
     float camera_r[3]={                      //方向ベクトル   
         static_cast<float>(cos(theta)*cos(phi)),       //カメラ位置のx座標(z軸からの距離がゼロにならないようにしている)
         static_cast<float>(cos(theta)*sin(phi)),       //カメラ位置のy座標(z軸からの距離がゼロにならないようにしている)
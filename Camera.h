@@ -4,6 +4,8 @@
 #include "Universe.h"
 #include "Sphere.h"
 
+struct Frame;
+
 // カメラや描画に関する定数
 namespace cameraSetting{
     extern const float fovy;
@@ -16,13 +18,13 @@ namespace cameraSetting{
 class Camera{
 public:
 
-    Camera(Universe& universe, std::vector<Sphere*> targetSpheres);
-    void changeSpheres(std::vector<Sphere*> targetSpheres);
-    void addSphere(Sphere* sphere);
+    Camera(Universe& universe, std::vector<Sphere> targetSpheres);
+    void changeSpheres(std::vector<Sphere> targetSpheres);
+    void addSphere(Sphere sphere);
     float getPosition(int i) const;
     float getTarget(int i) const;
     float getUp(int i) const;
-    void update();
+    void update(const Frame& frame, double alpha);  // 計算スレッドが渡した状態(Simulation::latest())を補間した位置(alpha: Frame::interpolation())で、位置と向きを決める
 private:
     // float fovy_, aspect_, zNear_, zFar;     // 一応作っておいた。
     float position_[3];  // カメラの位置（x, y, z）
@@ -31,7 +33,7 @@ private:
     // float rot_[3];  // カメラの回転軸
     float omegaLatitude_;   // カメラの回転角速度(緯度方向)
     float omegaLongitude_;  // カメラの回転角速度(経度方向)
-    std::vector<Sphere*> targetSpheres_;   // 注目の対象とする天体のアドレスを格納する。
+    std::vector<Sphere> targetSpheres_;   // 注目の対象とする天体(のハンドル)を格納する。
     Universe& universe_; // カメラが対象とする宇宙
     
 };
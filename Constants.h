@@ -27,7 +27,7 @@ namespace celestialConstants {
 // スケール係数
 namespace scaling{
    // 時間関係
-    extern const float time_simu2real; // 現実時間1sで経過するシミュレーション時間[s]
+    extern const float time_simu2real; // 現実時間1sで経過するシミュレーション時間[s]。Simulationの時間の圧縮率の初期値(実行中に変えられる)
     extern const float DT; // 数値積分の時間ステップ。単位はシミュレーション内のsecond
     // 物理量関係
     extern const float distance; // 長さをkmからシミュレーション単位へ変換。10を1e+8kmくらいとする。(参考：地球から太陽までの距離は1.496e+8km)
@@ -48,6 +48,30 @@ namespace scaling{
 enum class IntegrationMethod {
     Euler,  // Euler法
     Heun,   // Heun法
-    RK4     // 4次のRunge-Kutta
+    RK4,    // 4次のRunge-Kutta
+    // 以下はシンプレクティック積分法。エネルギーの誤差がずっと増え続けず、一定の幅に収まる
+    Leapfrog,   // 蛙飛び法(Kick-Drift-Kick)。2次。1ステップで力の計算1回
+    Yoshida4,   // 蛙飛び法を3回組み合わせた吉田の4次。力の計算3回
+    Yoshida6,   // 蛙飛び法を7回組み合わせた吉田の6次(解A)。力の計算7回
+    PEFRL,      // Omelyanらの位置拡張Forest–Ruth型(PEFRL)。Forest–Ruthの4次と同じ形で、誤差が小さくなるように係数を選んだもの。力の計算4回
+    // 刻み幅を自動で変える方法
+    DOPRI5,     // Dormand–Prince 5(4)次。誤差を見積もって刻み幅を伸び縮みさせる。update(dt)のdtとは関係なく進み、途中は補間する
+    Hermite,    // 4次のHermite予測子・修正子法。天体ごとに2の累乗の刻み(ブロック刻み)を持ち、その時刻になった天体だけ力を計算し直す
+    IAS15,      // Gauss–Radau分点による15次(IAS15)。近接遭遇のときだけ刻みを縮める。状態はdoubleで、丸め誤差の程度の精度を保つ
+    // 中心天体が重い系向け
+    WisdomHolman    // Wisdom–Holman法。中心天体のまわりのKepler運動を解析的に解き、残りの引力だけを蛙飛び法で足す。2次。力の計算1回(double)
+};
+
+// 状態を持つ数値の精度の列挙(Euler〜PEFRLとDOPRI5で使う。Hermite法、IAS15、Wisdom–Holman法は常にdouble)
+enum class Precision {
+    Single,     // float。SIMDで速いが、太陽から1.5e8 km離れた所では地球と月の距離が数桁しか残らない
+    Double      // double。力の計算はスカラー版になるので遅い
+};
+
+// 重力(加速度)の計算方法の列挙
+enum class ForceMethod {
+    Direct,     // 全ペアを直接計算する。O(N^2)
+    Tiled,      // 全ペアを直接計算するが、作用・反作用を使って1ペアを1回だけ計算する。O(N^2/2)
+    BarnesHut   // 八分木で遠くの天体をまとめて近似する。O(N log N)
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+// 描画スレッドに渡す状態の写し
+
+#include <algorithm>    // std::copy, std::min, std::max
+
+#include "Frame.h"
+#include "Universe.h"
+
+Frame::Frame()
+:   trajectoryCapacity(0),
+    trajectoryVersion(TrajectoryStore::NO_SERIAL),     // 最初のcapture()で必ず全部を写す
+    simulationTime(0.0),
+    previousTime(0.0),
+    step(0),
+    playback(false),
+    playbackTime(0.0),
+    replayEndTime(0.0),
+    presentTime(0.0),
+    timeCompression(0.0),
+    behind(false)
+{
+}
+
+void Frame::capture(Universe& universe) {
+    const size_t n = universe.bodies.size();
+    bodies.resize(n);
+
+    // 容量が変わったり読み込み直したりしたときは、軌跡を全部写し直す
+    const TrajectoryStore& trajectories = universe.trajectories;
+    const size_t ringFloats = (trajectories.capacity() + 1) * 3;
+    const bool rewrite = trajectoryCapacity != trajectories.capacity() || trajectoryVersion != trajectories.version()
+        || trajectory.size() != n * ringFloats;
+    trajectory.resize(n * ringFloats);
+    trajectoryCapacity = trajectories.capacity();
+    trajectoryVersion = trajectories.version();
+
+    for (size_t i = 0; i < n; ++i) {
+        const BodyInfo& info = universe.bodyInfo[i];
+        Body& body = bodies[i];
+        body.name = info.name;
+        body.position[0] = universe.bodies.x[i];  body.position[1] = universe.bodies.y[i];  body.position[2] = universe.bodies.z[i];
+        std::copy(body.position, body.position + 3, body.previousPosition);
+        body.velocity[0] = universe.bodies.vx[i]; body.velocity[1] = universe.bodies.vy[i]; body.velocity[2] = universe.bodies.vz[i];
+        body.mass = info.mass;
+        body.radius = info.radius;
+        std::copy(info.color, info.color + 3, body.color);
+        body.lightEmission = info.lightEmission;
+        body.angleTheta = info.angle_theta;
+
+        // 前に写した一番新しい点から後に書き換わった場所だけを写す
+        const TrajectoryStore::View view = trajectories.view(i);
+        const float* source = view.ring();
+        float* destination = trajectory.data() + i * ringFloats;
+        view.changedSince(rewrite ? TrajectoryStore::NO_SERIAL : body.trajectorySerial, [&](size_t first, size_t count) {
+            std::copy(source + first * 3, source + (first + count) * 3, destination + first * 3);
+        });
+        body.trajectoryHead = view.head();
+        body.trajectoryCount = view.size();
+        body.trajectorySerial = view.serial();
+    }
+
+    // 描画用の値はBodyStoreの配列からそのまま並べる
+    instances.resize(n * INSTANCE_FLOATS);
+    for (size_t i = 0; i < n; ++i) {
+        const BodyInfo& info = universe.bodyInfo[i];
+        float* instance = instances.data() + i * INSTANCE_FLOATS;
+        instance[0] = instance[4] = universe.bodies.x[i];
+        instance[1] = instance[5] = universe.bodies.y[i];
+        instance[2] = instance[6] = universe.bodies.z[i];
+        instance[3] = info.radius;
+        instance[7] = info.lightEmission ? 1.0f : 0.0f;
+        std::copy(info.color, info.color + 3, instance + 8);
+        instance[11] = 0.0f;
+    }
+
+    simulationTime = universe.getSimulationTime();
+    previousTime = simulationTime;
+    presentTime = simulationTime;
+    simulationTime_tp = universe.getSimulationTime_tp();
+}
+
+void Frame::setPreviousPosition(size_t index, const float previous[3]) {
+    std::copy(previous, previous + 3, bodies[index].previousPosition);
+    std::copy(previous, previous + 3, instances.begin() + index * INSTANCE_FLOATS + 4);
+}
+
+TrajectoryStore::View Frame::trajectoryView(size_t index) const {
+    const Body& body = bodies[index];
+    return TrajectoryStore::View(trajectory.data() + index * (trajectoryCapacity + 1) * 3, trajectoryCapacity,
+        body.trajectoryHead, body.trajectoryCount, body.trajectorySerial);
+}
+
+double Frame::interpolation(std::chrono::steady_clock::time_point now) const {
+    const double span = simulationTime - previousTime;
+    if (span <= 0.0) return 1.0;
+    const double elapsed = std::chrono::duration<double>(now - publishedAt).count();
+    const double shown = presentTime + std::max(elapsed, 0.0) * timeCompression - span;
+    return std::min(std::max((shown - previousTime) / span, 0.0), 1.0);
+}
+
+void Frame::position(size_t index, double alpha, float out[3]) const {
+    const Body& body = bodies[index];
+    const float a = static_cast<float>(alpha);
+    for (int c = 0; c < 3; ++c) out[c] = body.previousPosition[c] + (body.position[c] - body.previousPosition[c]) * a;
+}
@@ -0,0 +1,73 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <chrono>   // std::chrono::system_clock
+#include <cstddef>  // size_t
+#include <string>   // std::string
+#include <vector>   // std::vector
+
+#include "TrajectoryStore.h"
+
+class Universe;
+
+// ある時刻の全天体の状態(位置・速度・軌跡・シミュレーション時刻)の写し。描画と画面表示はこれだけを読む。
+// 計算スレッド(Simulation)がcapture()で作ってTripleBufferで描画スレッドに渡すので、描画中にUniverseが進んでも中身は変わらない。
+struct Frame {
+    struct Body {
+        std::string name;
+        float position[3];
+        float previousPosition[3];  // 直前のステップの位置(interpolation()で補間するのに使う)
+        float velocity[3];
+        float mass;             // 質量(kg)
+        float radius;
+        float color[3];         // 球の色（RGB）
+        bool lightEmission;     // 球が光を放つかどうか
+        float angleTheta;       // 球の回転角度（z軸回りの角度）
+        size_t trajectoryHead;  // この天体の軌跡の一番新しい点の場所
+        size_t trajectoryCount; // この天体の軌跡の点の数
+        unsigned long long trajectorySerial;    // 一番新しい点の通し番号(TrajectoryStore::View::serial())
+    };
+
+    std::vector<Body> bodies;       // Universeと同じ番号
+    // 全天体の軌跡の点。Universe::trajectoriesと同じ並び(天体ごとに trajectoryCapacity + 1 点の環状バッファ)のまま写す。
+    // 前に写したときから書き換わった場所だけを写すので、軌跡が長くても1ステップに天体あたり1〜2点で済む
+    std::vector<float> trajectory;
+    size_t trajectoryCapacity;
+    unsigned long long trajectoryVersion;   // 写したときのTrajectoryStore::version()
+    // 球の描画に使う値を天体ごとにINSTANCE_FLOATS個ずつ並べたもの。SphereRendererはこれをそのままGPUのバッファに渡す
+    //   [0..2] 位置, [3] 半径, [4..6] 直前のステップの位置, [7] 光を放つなら1, [8..10] 色, [11] 使わない(16byteにそろえる)
+    static const size_t INSTANCE_FLOATS = 12;
+    std::vector<float> instances;
+    double simulationTime;          // Universe::getSimulationTime()
+    double previousTime;            // 直前のステップの時刻。状態が飛んだとき(巻き戻しなど)はsimulationTimeと同じ
+    std::chrono::system_clock::time_point simulationTime_tp;
+    unsigned long long step;        // 計算を始めてから進めたステップ数
+    bool playback;                  // 計算せずに記録したフレームを見せているか(Simulation::scrub())
+    double playbackTime;            // 再生中のシミュレーション時刻[s]
+    double replayEndTime;           // 巻き戻しできる範囲の終わり[s]
+    // 補間に使う時刻の関係。Simulationが渡した時点(publishedAt)で、シミュレーションはpresentTimeまで進んでいるはずだった
+    // (simulationTimeとの差は、まだ1ステップに満たないので進めていない分)
+    double presentTime;
+    std::chrono::steady_clock::time_point publishedAt;
+    double timeCompression;         // 目標の時間の圧縮率[s/s]
+    bool behind;                    // 計算が追いつかず、時間を捨てたか(実際の圧縮率は目標より小さい)
+
+    Frame();
+    // universeの今の状態を写す。名前や軌跡の領域は使い回すので、天体の数が変わらなければメモリを確保し直さない。
+    // 軌跡は、このFrameに前に写したときから書き換わった点だけを写す(TripleBufferの3つのFrameはそれぞれが自分の写した所を覚えている)
+    // 直前の位置は今の位置と同じにする(補間しない)。Simulationが後から書き換える
+    void capture(Universe& universe);
+    void setPreviousPosition(size_t index, const float previous[3]);   // bodiesとinstancesの両方の直前の位置を書き換える
+    TrajectoryStore::View trajectoryView(size_t index) const;          // 写した軌跡を古い順に見る
+
+    // 現実の時刻nowに見せる状態の、直前のステップ(0)から最後のステップ(1)までの位置。
+    // 1ステップ遅れの時刻を見せることにして、presentTimeからの経過時間で進める(1を超えたら1)
+    double interpolation(std::chrono::steady_clock::time_point now) const;
+    void position(size_t index, double alpha, float out[3]) const;  // 補間した位置
+
+    // OpenGLでの描画(実装はSphereDraw.cpp。ヘッドレスビルドではリンクしない)
+    void drawBody(size_t index, double alpha) const;    // alpha: interpolation()
+    void drawTrajectory(size_t index) const;    // 全天体をまとめて描くのはTrailRenderer
+};
+
+#endif
@@ -0,0 +1,170 @@
+// OpenGL 1.2以降の関数のアドレスをドライバから受け取る。シェーダーの組み立て
+
+#include <stdexcept>    // std::runtime_error
+
+#include "GLFunctions.h"
+
+namespace gl {
+    PFNGLGENBUFFERSPROC genBuffers = nullptr;
+    PFNGLDELETEBUFFERSPROC deleteBuffers = nullptr;
+    PFNGLBINDBUFFERPROC bindBuffer = nullptr;
+    PFNGLBUFFERDATAPROC bufferData = nullptr;
+    PFNGLBUFFERSUBDATAPROC bufferSubData = nullptr;
+    PFNGLMAPBUFFERRANGEPROC mapBufferRange = nullptr;
+    PFNGLUNMAPBUFFERPROC unmapBuffer = nullptr;
+    PFNGLBUFFERSTORAGEPROC bufferStorage = nullptr;
+    PFNGLTEXBUFFERPROC texBuffer = nullptr;
+    PFNGLACTIVETEXTUREPROC activeTexture = nullptr;
+
+    PFNGLGENVERTEXARRAYSPROC genVertexArrays = nullptr;
+    PFNGLDELETEVERTEXARRAYSPROC deleteVertexArrays = nullptr;
+    PFNGLBINDVERTEXARRAYPROC bindVertexArray = nullptr;
+    PFNGLVERTEXATTRIBPOINTERPROC vertexAttribPointer = nullptr;
+    PFNGLENABLEVERTEXATTRIBARRAYPROC enableVertexAttribArray = nullptr;
+    PFNGLVERTEXATTRIBDIVISORPROC vertexAttribDivisor = nullptr;
+    PFNGLDRAWELEMENTSINSTANCEDPROC drawElementsInstanced = nullptr;
+    PFNGLMULTIDRAWARRAYSPROC multiDrawArrays = nullptr;
+
+    PFNGLCREATESHADERPROC createShader = nullptr;
+    PFNGLDELETESHADERPROC deleteShader = nullptr;
+    PFNGLSHADERSOURCEPROC shaderSource = nullptr;
+    PFNGLCOMPILESHADERPROC compileShader = nullptr;
+    PFNGLGETSHADERIVPROC getShaderiv = nullptr;
+    PFNGLGETSHADERINFOLOGPROC getShaderInfoLog = nullptr;
+    PFNGLCREATEPROGRAMPROC createProgram = nullptr;
+    PFNGLDELETEPROGRAMPROC deleteProgram = nullptr;
+    PFNGLATTACHSHADERPROC attachShader = nullptr;
+    PFNGLLINKPROGRAMPROC linkProgram = nullptr;
+    PFNGLGETPROGRAMIVPROC getProgramiv = nullptr;
+    PFNGLGETPROGRAMINFOLOGPROC getProgramInfoLog = nullptr;
+    PFNGLUSEPROGRAMPROC useProgram = nullptr;
+    PFNGLGETUNIFORMLOCATIONPROC getUniformLocation = nullptr;
+    PFNGLUNIFORM1FPROC uniform1f = nullptr;
+    PFNGLUNIFORM1IPROC uniform1i = nullptr;
+
+    PFNGLFENCESYNCPROC fenceSync = nullptr;
+    PFNGLCLIENTWAITSYNCPROC clientWaitSync = nullptr;
+    PFNGLDELETESYNCPROC deleteSync = nullptr;
+
+    PFNGLGENFRAMEBUFFERSPROC genFramebuffers = nullptr;
+    PFNGLDELETEFRAMEBUFFERSPROC deleteFramebuffers = nullptr;
+    PFNGLBINDFRAMEBUFFERPROC bindFramebuffer = nullptr;
+    PFNGLCHECKFRAMEBUFFERSTATUSPROC checkFramebufferStatus = nullptr;
+    PFNGLGENRENDERBUFFERSPROC genRenderbuffers = nullptr;
+    PFNGLDELETERENDERBUFFERSPROC deleteRenderbuffers = nullptr;
+    PFNGLBINDRENDERBUFFERPROC bindRenderbuffer = nullptr;
+    PFNGLRENDERBUFFERSTORAGEPROC renderbufferStorage = nullptr;
+    PFNGLFRAMEBUFFERRENDERBUFFERPROC framebufferRenderbuffer = nullptr;
+
+    namespace {
+        bool loaded = false;
+
+        template <typename Function>
+        bool find(ProcAddress procAddress, const char* name, Function& function) {
+            function = reinterpret_cast<Function>(procAddress(name));
+            return function != nullptr;
+        }
+
+        GLuint compile(GLenum type, const std::string& source) {
+            const GLuint shader = gl::createShader(type);
+            const char* text = source.c_str();
+            gl::shaderSource(shader, 1, &text, nullptr);
+            gl::compileShader(shader);
+            GLint status = GL_FALSE;
+            gl::getShaderiv(shader, GL_COMPILE_STATUS, &status);
+            if (status != GL_TRUE) {
+                char log[1024] = {};
+                gl::getShaderInfoLog(shader, sizeof(log), nullptr, log);
+                gl::deleteShader(shader);
+                throw std::runtime_error(std::string("shader compile failed: ") + log);
+            }
+            return shader;
+        }
+    }
+
+    bool load(ProcAddress procAddress) {
+        bool found = true;  // 見つからないものがあっても、どれが無いか分かるように全部探す
+        found &= find(procAddress, "glGenBuffers", genBuffers);
+        found &= find(procAddress, "glDeleteBuffers", deleteBuffers);
+        found &= find(procAddress, "glBindBuffer", bindBuffer);
+        found &= find(procAddress, "glBufferData", bufferData);
+        found &= find(procAddress, "glBufferSubData", bufferSubData);
+        found &= find(procAddress, "glMapBufferRange", mapBufferRange);
+        found &= find(procAddress, "glUnmapBuffer", unmapBuffer);
+        find(procAddress, "glBufferStorage", bufferStorage);
+        found &= find(procAddress, "glTexBuffer", texBuffer);
+        found &= find(procAddress, "glActiveTexture", activeTexture);
+
+        found &= find(procAddress, "glGenVertexArrays", genVertexArrays);
+        found &= find(procAddress, "glDeleteVertexArrays", deleteVertexArrays);
+        found &= find(procAddress, "glBindVertexArray", bindVertexArray);
+        found &= find(procAddress, "glVertexAttribPointer", vertexAttribPointer);
+        found &= find(procAddress, "glEnableVertexAttribArray", enableVertexAttribArray);
+        found &= find(procAddress, "glVertexAttribDivisor", vertexAttribDivisor);
+        found &= find(procAddress, "glDrawElementsInstanced", drawElementsInstanced);
+        found &= find(procAddress, "glMultiDrawArrays", multiDrawArrays);
+
+        found &= find(procAddress, "glCreateShader", createShader);
+        found &= find(procAddress, "glDeleteShader", deleteShader);
+        found &= find(procAddress, "glShaderSource", shaderSource);
+        found &= find(procAddress, "glCompileShader", compileShader);
+        found &= find(procAddress, "glGetShaderiv", getShaderiv);
+        found &= find(procAddress, "glGetShaderInfoLog", getShaderInfoLog);
+        found &= find(procAddress, "glCreateProgram", createProgram);
+        found &= find(procAddress, "glDeleteProgram", deleteProgram);
+        found &= find(procAddress, "glAttachShader", attachShader);
+        found &= find(procAddress, "glLinkProgram", linkProgram);
+        found &= find(procAddress, "glGetProgramiv", getProgramiv);
+        found &= find(procAddress, "glGetProgramInfoLog", getProgramInfoLog);
+        found &= find(procAddress, "glUseProgram", useProgram);
+        found &= find(procAddress, "glGetUniformLocation", getUniformLocation);
+        found &= find(procAddress, "glUniform1f", uniform1f);
+        found &= find(procAddress, "glUniform1i", uniform1i);
+
+        found &= find(procAddress, "glFenceSync", fenceSync);
+        found &= find(procAddress, "glClientWaitSync", clientWaitSync);
+        found &= find(procAddress, "glDeleteSync", deleteSync);
+
+        found &= find(procAddress, "glGenFramebuffers", genFramebuffers);
+        found &= find(procAddress, "glDeleteFramebuffers", deleteFramebuffers);
+        found &= find(procAddress, "glBindFramebuffer", bindFramebuffer);
+        found &= find(procAddress, "glCheckFramebufferStatus", checkFramebufferStatus);
+        found &= find(procAddress, "glGenRenderbuffers", genRenderbuffers);
+        found &= find(procAddress, "glDeleteRenderbuffers", deleteRenderbuffers);
+        found &= find(procAddress, "glBindRenderbuffer", bindRenderbuffer);
+        found &= find(procAddress, "glRenderbufferStorage", renderbufferStorage);
+        found &= find(procAddress, "glFramebufferRenderbuffer", framebufferRenderbuffer);
+        loaded = found;
+        return found;
+    }
+
+    bool isLoaded() {
+        return loaded;
+    }
+
+    GLuint buildProgram(const std::string& vertexSource, const std::string& fragmentSource) {
+        const GLuint vertexShader = compile(GL_VERTEX_SHADER, vertexSource);
+        GLuint fragmentShader = 0;
+        try {
+            fragmentShader = compile(GL_FRAGMENT_SHADER, fragmentSource);
+        } catch (...) {
+            gl::deleteShader(vertexShader);
+            throw;
+        }
+        const GLuint program = gl::createProgram();
+        gl::attachShader(program, vertexShader);
+        gl::attachShader(program, fragmentShader);
+        gl::linkProgram(program);
+        gl::deleteShader(vertexShader);     // programが使っている間は残る
+        gl::deleteShader(fragmentShader);
+        GLint status = GL_FALSE;
+        gl::getProgramiv(program, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE) {
+            char log[1024] = {};
+            gl::getProgramInfoLog(program, sizeof(log), nullptr, log);
+            gl::deleteProgram(program);
+            throw std::runtime_error(std::string("shader link failed: ") + log);
+        }
+        return program;
+    }
+}
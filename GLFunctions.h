@@ -0,0 +1,83 @@
+#ifndef GLFUNCTIONS_H
+#define GLFUNCTIONS_H
+
+#ifdef _WIN32
+#include <windows.h>    // GL/gl.hがAPIENTRYなどを使う
+#endif
+#include <GL/gl.h>
+#include <GL/glext.h>   // OpenGL 1.2以降の関数の型(PFNGL...PROC)と定数
+
+#include <string>       // std::string
+
+// OpenGL 1.2以降の関数(バッファ、シェーダー、インスタンス描画など)。
+// WindowsのOpenGL32.dllは1.1までの関数しか持たないので、コンテキストを作ってからドライバに関数のアドレスを聞いて使う
+// (WindowsならwglGetProcAddress、Mesaのオフスクリーン描画ならeglGetProcAddress)。load()するまではどれもnullptr。
+// 名前がOpenGLの関数と重ならないように、gl::genBuffersのように名前空間に入れて先頭のglを取っている。
+namespace gl {
+    typedef void* (*ProcAddress)(const char* name);     // 関数の名前からアドレスを返す関数(見つからなければnullptr)
+
+    // 今のコンテキストで下の関数を全部探す。1つでも見つからなければfalse(OpenGL 3.3より前のドライバ)。bufferStorageだけは無くてもよい
+    bool load(ProcAddress procAddress);
+    bool isLoaded();
+
+    // 頂点シェーダーとフラグメントシェーダーのソースからプログラムを作る。コンパイルかリンクに失敗したらログを付けてstd::runtime_error
+    GLuint buildProgram(const std::string& vertexSource, const std::string& fragmentSource);
+
+    // バッファ
+    extern PFNGLGENBUFFERSPROC genBuffers;
+    extern PFNGLDELETEBUFFERSPROC deleteBuffers;
+    extern PFNGLBINDBUFFERPROC bindBuffer;
+    extern PFNGLBUFFERDATAPROC bufferData;
+    extern PFNGLBUFFERSUBDATAPROC bufferSubData;
+    extern PFNGLMAPBUFFERRANGEPROC mapBufferRange;
+    extern PFNGLUNMAPBUFFERPROC unmapBuffer;
+    extern PFNGLBUFFERSTORAGEPROC bufferStorage;   // OpenGL 4.4。無くてもload()は失敗しない(使う側でnullptrか確かめる)
+    extern PFNGLTEXBUFFERPROC texBuffer;
+    extern PFNGLACTIVETEXTUREPROC activeTexture;
+
+    // 頂点配列
+    extern PFNGLGENVERTEXARRAYSPROC genVertexArrays;
+    extern PFNGLDELETEVERTEXARRAYSPROC deleteVertexArrays;
+    extern PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+    extern PFNGLVERTEXATTRIBPOINTERPROC vertexAttribPointer;
+    extern PFNGLENABLEVERTEXATTRIBARRAYPROC enableVertexAttribArray;
+    extern PFNGLVERTEXATTRIBDIVISORPROC vertexAttribDivisor;
+    extern PFNGLDRAWELEMENTSINSTANCEDPROC drawElementsInstanced;
+    extern PFNGLMULTIDRAWARRAYSPROC multiDrawArrays;
+
+    // シェーダー
+    extern PFNGLCREATESHADERPROC createShader;
+    extern PFNGLDELETESHADERPROC deleteShader;
+    extern PFNGLSHADERSOURCEPROC shaderSource;
+    extern PFNGLCOMPILESHADERPROC compileShader;
+    extern PFNGLGETSHADERIVPROC getShaderiv;
+    extern PFNGLGETSHADERINFOLOGPROC getShaderInfoLog;
+    extern PFNGLCREATEPROGRAMPROC createProgram;
+    extern PFNGLDELETEPROGRAMPROC deleteProgram;
+    extern PFNGLATTACHSHADERPROC attachShader;
+    extern PFNGLLINKPROGRAMPROC linkProgram;
+    extern PFNGLGETPROGRAMIVPROC getProgramiv;
+    extern PFNGLGETPROGRAMINFOLOGPROC getProgramInfoLog;
+    extern PFNGLUSEPROGRAMPROC useProgram;
+    extern PFNGLGETUNIFORMLOCATIONPROC getUniformLocation;
+    extern PFNGLUNIFORM1FPROC uniform1f;
+    extern PFNGLUNIFORM1IPROC uniform1i;
+
+    // 同期
+    extern PFNGLFENCESYNCPROC fenceSync;
+    extern PFNGLCLIENTWAITSYNCPROC clientWaitSync;
+    extern PFNGLDELETESYNCPROC deleteSync;
+
+    // フレームバッファ(ウィンドウなしで描くとき)
+    extern PFNGLGENFRAMEBUFFERSPROC genFramebuffers;
+    extern PFNGLDELETEFRAMEBUFFERSPROC deleteFramebuffers;
+    extern PFNGLBINDFRAMEBUFFERPROC bindFramebuffer;
+    extern PFNGLCHECKFRAMEBUFFERSTATUSPROC checkFramebufferStatus;
+    extern PFNGLGENRENDERBUFFERSPROC genRenderbuffers;
+    extern PFNGLDELETERENDERBUFFERSPROC deleteRenderbuffers;
+    extern PFNGLBINDRENDERBUFFERPROC bindRenderbuffer;
+    extern PFNGLRENDERBUFFERSTORAGEPROC renderbufferStorage;
+    extern PFNGLFRAMEBUFFERRENDERBUFFERPROC framebufferRenderbuffer;
+}
+
+#endif
@@ -0,0 +1,326 @@
+// Gauss–Radau分点による15次の積分法(IAS15)
+
+#include <algorithm>    // std::max, std::min, std::copy
+#include <cmath>        // std::sqrt, std::pow, std::fabs, std::isfinite, HUGE_VAL
+#include <functional>   // std::function
+
+#include "GaussRadau.h"
+#include "Summation.h"
+#include "ThreadPool.h"
+
+namespace {
+    const size_t FORCE_GRAIN = 64;      // 加速度の計算で1つの塊にする天体の数
+    const size_t BODY_GRAIN = 4096;     // 位置の予測で1つの塊にする天体の数
+    const int MAX_ITERATIONS = 12;      // 予測子・修正子の反復の上限
+    const double CONVERGENCE = 1e-16;   // 係数の変化が加速度に対してこれより小さくなったら反復を終える
+    const double SAFETY = 0.25;         // 刻みが1/4より小さくなる場合はステップをやり直す。伸ばすのは1回に4倍まで
+    const double ACCELERATION_FLOOR = 1e-8;     // 刻みの見積もりで、加速度の2乗をすべての天体の最大値のこの倍より小さくは見ない
+
+    // Gauss–Radau分点(区間[0, 1]、始点を含む8点)
+    const double NODE[8] = {
+        0.0,
+        0.0562625605369221464656521910318, 0.180240691736892364987579942780, 0.352624717113169637373907769648,
+        0.547153626330555383001448554766,  0.734210177215410531523210605558, 0.885320946839095768090359771030,
+        0.977520613561287501891174488626
+    };
+
+    // Newtonの形 a(t) = a0 + Σ_j g_j t(t - h_1)...(t - h_j) を単項式の形 a0 + Σ_k b_k t^(k+1) に直す係数
+    //   C[j][k] = t(t - h_1)...(t - h_j) の t^(k+1) の係数 (k <= j)
+    struct NewtonToMonomial {
+        double c[7][7];
+        NewtonToMonomial() {
+            double poly[8] = {0.0, 1.0};    // poly[p]: t^pの係数。最初は t
+            for (int j = 0; j < 7; ++j) {
+                if (j > 0) {
+                    // (t - h_j) を掛ける
+                    for (int p = 7; p >= 1; --p) poly[p] = poly[p - 1] - NODE[j] * poly[p];
+                    poly[0] = 0.0;
+                }
+                for (int k = 0; k < 7; ++k) c[j][k] = (k <= j) ? poly[k + 1] : 0.0;
+            }
+        }
+    };
+    const NewtonToMonomial NEWTON;
+
+    // 二項係数 C(l+1, k+1) (次のステップの予測に使う)
+    struct ShiftCoefficients {
+        double c[7][7];
+        ShiftCoefficients() {
+            for (int l = 0; l < 7; ++l) {
+                for (int k = 0; k < 7; ++k) {
+                    double value = 1.0;
+                    for (int i = 1; i <= k + 1; ++i) value = value * (l - k + i) / i;
+                    c[l][k] = (k <= l) ? value : 0.0;
+                }
+            }
+        }
+    };
+    const ShiftCoefficients SHIFT;
+
+    void parallel(ThreadPool* pool, size_t n, size_t grain, const std::function<void(size_t, size_t)>& body) {
+        if (pool) {
+            pool->parallelFor(0, n, grain, body);
+        } else {
+            body(0, n);
+        }
+    }
+
+    // 始点の位置・速度・加速度と係数から、ステップの中の位置 s (0〜1) での位置の増分と速度の増分を求める
+    //   x(s) = x0 + v0 Δt s + Δt^2 s^2 (a0/2 + Σ_k b_k s^(k+1) / ((k+2)(k+3)))
+    //   v(s) = v0 + Δt s (a0 + Σ_k b_k s^(k+1) / (k+2))
+    double positionIncrement(double v0, double a0, const double* b, double s, double dt) {
+        double sum = 0.0, power = s;
+        for (int k = 0; k < 7; ++k) {
+            sum += b[k] * power / ((k + 2) * (k + 3));
+            power *= s;
+        }
+        return v0 * dt * s + dt * dt * s * s * (a0 / 2 + sum);
+    }
+    double velocityIncrement(double a0, const double* b, double s, double dt) {
+        double sum = 0.0, power = s;
+        for (int k = 0; k < 7; ++k) {
+            sum += b[k] * power / (k + 2);
+            power *= s;
+        }
+        return dt * s * (a0 + sum);
+    }
+}
+
+GaussRadau::GaussRadau(double epsilonInput)
+:   epsilon(epsilonInput),
+    minStep(0.0),
+    n_(0),
+    time_(0.0),
+    denseBegin_(0.0),
+    denseStep_(0.0),
+    displayTime_(0.0),
+    step_(0.0),
+    evaluations_(0)
+{
+}
+
+size_t GaussRadau::size() const {
+    return n_;
+}
+
+double GaussRadau::getStep() const {
+    return step_;
+}
+
+unsigned long long GaussRadau::getForceEvaluationCount() const {
+    return evaluations_;
+}
+
+void GaussRadau::start(const BodyStore& bodies, double firstStep, ThreadPool* pool) {
+    n_ = bodies.size();
+    const size_t m = 3 * n_;
+    mu_.assign(bodies.mu, bodies.mu + n_);
+    massive_.clear();
+    for (size_t i = 0; i < n_; ++i) {
+        if (mu_[i] > 0.0) massive_.push_back(i);
+    }
+    for (std::vector<double>* v : {&x_, &v_, &a_, &xError_, &vError_, &predicted_, &substep_, &denseX_, &denseV_, &denseA_}) v->assign(m, 0.0);
+    for (int k = 0; k < ORDER; ++k) {
+        b_[k].assign(m, 0.0);
+        g_[k].assign(m, 0.0);
+        denseB_[k].assign(m, 0.0);
+    }
+    for (size_t i = 0; i < n_; ++i) {
+        x_[3*i + 0] = bodies.x[i];  x_[3*i + 1] = bodies.y[i];  x_[3*i + 2] = bodies.z[i];
+        v_[3*i + 0] = bodies.vx[i]; v_[3*i + 1] = bodies.vy[i]; v_[3*i + 2] = bodies.vz[i];
+    }
+    accelerations(x_.data(), a_.data(), pool);
+    // 補間用のステップは長さ0の区間にしておく(始点そのもの)
+    denseX_ = x_; denseV_ = v_; denseA_ = a_;
+    time_ = denseBegin_ = displayTime_ = 0.0;
+    denseStep_ = 0.0;
+    step_ = firstStep;
+}
+
+void GaussRadau::advance(double dt, ThreadPool* pool) {
+    displayTime_ += dt;
+    if (n_ == 0) return;
+    while (time_ < displayTime_) {
+        while (!tryStep(pool)) {}
+    }
+}
+
+void GaussRadau::store(BodyStore& bodies) const {
+    const double s = (denseStep_ > 0.0) ? (displayTime_ - denseBegin_) / denseStep_ : 0.0;
+    float* const position[3] = {bodies.x, bodies.y, bodies.z};
+    float* const velocity[3] = {bodies.vx, bodies.vy, bodies.vz};
+    for (size_t i = 0; i < n_; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            const size_t k = 3 * i + c;
+            double b[ORDER];
+            for (int j = 0; j < ORDER; ++j) b[j] = denseB_[j][k];
+            position[c][i] = static_cast<float>(denseX_[k] + positionIncrement(denseV_[k], denseA_[k], b, s, denseStep_));
+            velocity[c][i] = static_cast<float>(denseV_[k] + velocityIncrement(denseA_[k], b, s, denseStep_));
+        }
+    }
+}
+
+// 位置(成分ごとに3つずつ並べたもの)での全天体の加速度
+void GaussRadau::accelerations(const double* position, double* acceleration, ThreadPool* pool) {
+    ++evaluations_;
+    const size_t sources = massive_.size();
+    parallel(pool, n_, FORCE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const double xi = position[3*i], yi = position[3*i + 1], zi = position[3*i + 2];
+            double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+            for (size_t k = 0; k < sources; ++k) {
+                const size_t j = massive_[k];
+                if (j == i) continue;
+                double dx = position[3*j] - xi;
+                double dy = position[3*j + 1] - yi;
+                double dz = position[3*j + 2] - zi;
+                double r2 = dx*dx + dy*dy + dz*dz;
+                if (!(r2 > 0.0)) continue;  // 同じ位置にある天体は足さない
+                double s = mu_[j] / (r2 * std::sqrt(r2));
+                sumX += s * dx; sumY += s * dy; sumZ += s * dz;
+            }
+            acceleration[3*i] = sumX; acceleration[3*i + 1] = sumY; acceleration[3*i + 2] = sumZ;
+        }
+    });
+}
+
+bool GaussRadau::tryStep(ThreadPool* pool) {
+    const size_t m = 3 * n_;
+    const double dt = step_;
+    // 予測子・修正子の反復。分点ごとに、今の係数で位置を予測して加速度を計算し、その分点のgと、gの変化に応じてbを直す
+    double lastError = 2.0;
+    for (int iteration = 0; iteration < MAX_ITERATIONS; ++iteration) {
+        double maxChange = 0.0, maxAcceleration = 0.0;
+        for (int node = 1; node < NODES; ++node) {
+            const double s = NODE[node];
+            parallel(pool, n_, BODY_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t k = 3 * begin; k < 3 * end; ++k) {
+                    double b[ORDER];
+                    for (int j = 0; j < ORDER; ++j) b[j] = b_[j][k];
+                    predicted_[k] = x_[k] + (xError_[k] + positionIncrement(v_[k], a_[k], b, s, dt));
+                }
+            });
+            accelerations(predicted_.data(), substep_.data(), pool);
+
+            // g_{node-1} = 差分商 [h_0, ..., h_node]
+            const int j = node - 1;
+            for (size_t k = 0; k < m; ++k) {
+                double value = (substep_[k] - a_[k]) / NODE[node];
+                for (int l = 1; l < node; ++l) value = (value - g_[l - 1][k]) / (NODE[node] - NODE[l]);
+                const double change = value - g_[j][k];
+                g_[j][k] = value;
+                for (int l = 0; l <= j; ++l) b_[l][k] += NEWTON.c[j][l] * change;
+                if (node == NODES - 1) {
+                    maxChange = std::max(maxChange, std::fabs(change));
+                    maxAcceleration = std::max(maxAcceleration, std::fabs(substep_[k]));
+                }
+            }
+        }
+        // 最高次の係数の変化が丸め誤差の程度になるか、それ以上小さくならなくなったら終わる
+        const double error = (maxAcceleration > 0.0) ? maxChange / maxAcceleration : 0.0;
+        if (error < CONVERGENCE || (iteration > 1 && error >= lastError)) break;
+        lastError = error;
+    }
+
+    // 刻みの見積もり(Pham, Rein & Spiegel 2024): 天体ごとに、終点での加速度 a とその1階・2階微分から時間の尺度
+    //   τ^2 = 2|a|^2 / (|a'|^2 + |a||a''|)
+    // を求め、一番短いものの (7! epsilon)^(1/7) 倍を次の刻みにする。
+    // 最高次の係数 b6 を使う元の判定は、天体が原点から離れた所で接近すると丸め誤差で b6 が大きく見え、刻みが際限なく縮む
+    // 加速度がちょうど0になる点を通る天体(8の字解の原点など)は、|a|が刻みに比例して小さく見えるので τ も刻みに比例し、
+    // 刻みが際限なく縮む。そのため|a|^2は全天体の最大値のACCELERATION_FLOOR倍より小さくは見ない(刻みを緩める向きにだけ効く)
+    auto endpoint = [&](size_t i, double& y2, double& y3, double& y4) {
+        y2 = y3 = y4 = 0.0;
+        for (int c = 0; c < 3; ++c) {
+            const size_t k = 3 * i + c;
+            double value = a_[k], first = 0.0, second = 0.0;
+            for (int j = 0; j < ORDER; ++j) {
+                value += b_[j][k];
+                first += (j + 1) * b_[j][k];
+                second += (j + 1) * j * b_[j][k];
+            }
+            y2 += value * value;
+            y3 += first * first;
+            y4 += second * second;
+        }
+    };
+    double maxY2 = 0.0;
+    for (size_t i = 0; i < n_; ++i) {
+        double y2, y3, y4;
+        endpoint(i, y2, y3, y4);
+        maxY2 = std::max(maxY2, y2);
+    }
+    double minTimescale2 = HUGE_VAL;
+    for (size_t i = 0; i < n_; ++i) {
+        double y2, y3, y4;
+        endpoint(i, y2, y3, y4);
+        y2 = std::max(y2, ACCELERATION_FLOOR * maxY2);
+        const double denominator = y3 + std::sqrt(y4 * y2);
+        if (denominator > 0.0) minTimescale2 = std::min(minTimescale2, 2.0 * y2 / denominator);
+    }
+    double nextStep;
+    if (std::isfinite(minTimescale2)) {
+        nextStep = std::sqrt(minTimescale2) * dt * std::pow(5040.0 * epsilon, 1.0 / 7);
+    } else {
+        nextStep = dt / SAFETY;     // 加速度が変化していない(またはほぼ0)
+    }
+    if (std::fabs(nextStep) < minStep) nextStep = (nextStep < 0.0) ? -minStep : minStep;
+
+    if (std::fabs(nextStep / dt) < SAFETY && std::fabs(dt) > minStep) {
+        // 刻みが大きすぎたので縮めてやり直す。係数は今の多項式の時間の尺度を変えたものから始める
+        double scale[ORDER];
+        for (int k = 0; k < ORDER; ++k) scale[k] = std::pow(nextStep / dt, k + 1);
+        for (size_t c = 0; c < m; ++c) {
+            for (int k = 0; k < ORDER; ++k) b_[k][c] *= scale[k];
+            updateG(c);
+        }
+        step_ = nextStep;
+        return false;
+    }
+    if (nextStep / dt > 1.0 / SAFETY) nextStep = dt / SAFETY;
+
+    // 受け入れる。補間用に始点と係数を取っておき、位置と速度を補正付きの和で終点まで進める
+    denseX_ = x_; denseV_ = v_; denseA_ = a_;
+    for (int k = 0; k < ORDER; ++k) std::copy(b_[k].begin(), b_[k].end(), denseB_[k].begin());
+    for (size_t k = 0; k < m; ++k) denseX_[k] += xError_[k];
+    for (size_t k = 0; k < m; ++k) denseV_[k] += vError_[k];
+    denseBegin_ = time_;
+    denseStep_ = dt;
+    for (size_t k = 0; k < m; ++k) {
+        double b[ORDER];
+        for (int j = 0; j < ORDER; ++j) b[j] = b_[j][k];
+        summation::add(x_[k], xError_[k], positionIncrement(v_[k], a_[k], b, 1.0, dt));
+        summation::add(v_[k], vError_[k], velocityIncrement(a_[k], b, 1.0, dt));
+    }
+    time_ += dt;
+    accelerations(x_.data(), a_.data(), pool);
+    predictNext(nextStep / dt);
+    step_ = nextStep;
+    return true;
+}
+
+// 今のステップの多項式を終点のまわりで展開し直し、次の刻みの尺度に合わせたものを次のステップの係数の初期値にする
+//   b'_k = q^(k+1) Σ_{l>=k} C(l+1, k+1) b_l   (q = 次の刻み / 今の刻み)
+void GaussRadau::predictNext(double ratio) {
+    const size_t m = 3 * n_;
+    double scale[ORDER];
+    for (int k = 0; k < ORDER; ++k) scale[k] = std::pow(ratio, k + 1);
+    for (size_t c = 0; c < m; ++c) {
+        double b[ORDER];
+        for (int k = 0; k < ORDER; ++k) {
+            double sum = 0.0;
+            for (int l = k; l < ORDER; ++l) sum += SHIFT.c[l][k] * b_[l][c];
+            b[k] = scale[k] * sum;
+        }
+        for (int k = 0; k < ORDER; ++k) b_[k][c] = b[k];
+        updateG(c);
+    }
+}
+
+// 成分cのgをbから作り直す(g_6 = b_6 、g_k = b_k - Σ_{l>k} C[l][k] g_l)
+void GaussRadau::updateG(size_t c) {
+    for (int k = ORDER - 1; k >= 0; --k) {
+        double value = b_[k][c];
+        for (int l = k + 1; l < ORDER; ++l) value -= NEWTON.c[l][k] * g_[l][c];
+        g_[k][c] = value;
+    }
+}
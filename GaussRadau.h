@@ -0,0 +1,65 @@
+#ifndef GAUSSRADAU_H
+#define GAUSSRADAU_H
+
+#include <cstddef>  // size_t
+#include <vector>   // std::vector
+
+#include "BodyStore.h"
+
+class ThreadPool;
+
+// Gauss–Radau分点による15次の積分法(IAS15, Rein & Spiegel 2015)
+// 1ステップの中の加速度を時刻の7次多項式 a(t) = a0 + b0 t + b1 t^2 + ... + b6 t^7 (tはステップの中での位置0〜1)で表し、
+// 7つの分点で加速度を計算しては係数を直す(予測子・修正子の反復)。係数が動かなくなったら、多項式を積分して位置と速度を進める。
+// 刻みは加速度とその微分から決まる時間の尺度に比例させ、毎ステップ決め直す(1/4より縮める必要があればやり直す)。
+// 近接遭遇のときだけ刻みが縮み、離れればすぐに戻る。
+//
+// 状態はdoubleで自分で持ち、位置と速度は補正付きの和(compensated summation)で足していくので、
+// 長く進めてもエネルギーの誤差は丸め誤差の程度にとどまる。
+// 表示する時刻は、その時刻を含むステップの多項式から求める(ステップを表示の刻みに合わせない)。
+class GaussRadau {
+public:
+    double epsilon;     // 刻みを決める精度パラメータ。1e-9程度で丸め誤差の程度の精度になる。小さくするほど刻みが細かくなる(刻みは epsilon^(1/7) に比例)
+    double minStep;     // 刻みの下限[s]。0なら下限なし(天体が衝突するような場合に止まらないようにする)
+
+    GaussRadau(double epsilonInput = 1e-9);
+
+    // bodiesの位置・速度・G*mから始める(最初の加速度もここで計算する)。最初の刻みはfirstStep[s]で試す
+    void start(const BodyStore& bodies, double firstStep, ThreadPool* pool = nullptr);
+    // 表示する時刻をdt[s]だけ進め、その時刻を含むステップまで進める
+    void advance(double dt, ThreadPool* pool = nullptr);
+    // 表示する時刻での位置と速度をbodiesに書き込む。加速度は書き込まない
+    void store(BodyStore& bodies) const;
+    size_t size() const;
+    double getStep() const;     // 次に試す刻み[s]
+    unsigned long long getForceEvaluationCount() const;     // start/advanceで加速度を計算した回数の合計
+
+private:
+    static const int NODES = 8;     // 分点の数(始点を含む)
+    static const int ORDER = 7;     // 係数 b, g の数
+
+    size_t n_;
+    std::vector<double> mu_;        // 天体のG*m
+    std::vector<size_t> massive_;   // G*mが0でない天体
+    // 以下は成分ごとに 3 * 天体番号 + (0, 1, 2) の位置に入れる
+    std::vector<double> x_, v_, a_;         // ステップの始点の位置・速度・加速度
+    std::vector<double> xError_, vError_;   // 位置と速度の補正付きの和の誤差(本当の値は x_ + xError_)
+    std::vector<double> b_[ORDER];          // 加速度の多項式の係数(単項式の形)
+    std::vector<double> g_[ORDER];          // 同じ多項式をNewtonの差分商の形で表した係数
+    std::vector<double> predicted_;         // 分点での位置
+    std::vector<double> substep_;           // 分点での加速度
+    // 直前に終わったステップ(表示する時刻の補間用)
+    std::vector<double> denseX_, denseV_, denseA_, denseB_[ORDER];
+    double time_;               // 始点の時刻(始めてからの経過時間[s])
+    double denseBegin_, denseStep_;     // 直前のステップの始点と刻み
+    double displayTime_;        // 表示する時刻
+    double step_;               // 次に試す刻み
+    unsigned long long evaluations_;
+
+    void accelerations(const double* position, double* acceleration, ThreadPool* pool);
+    bool tryStep(ThreadPool* pool);     // 刻みstep_で1ステップ試す。許容を超えたら刻みを縮めてfalseを返す
+    void predictNext(double ratio);     // 次のステップの係数を、今のステップの多項式を延長して予測する
+    void updateG(size_t c);             // 成分cの係数gを、bに合わせて作り直す
+};
+
+#endif
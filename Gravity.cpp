@@ -0,0 +1,240 @@
+// 直接計算による重力(スカラー版と命令セットの選択)
+
+#include <algorithm>    // std::min, std::fill
+#include <cmath>        // std::sqrt
+
+#include "Gravity.h"
+#include "ThreadPool.h"
+
+namespace {
+    // タイルの大きさ(天体の数)。1タイルで位置・μ・加速度の7配列 x 256 x 4バイト = 7KB
+    // 2つのタイルを合わせてもL1キャッシュ(32KB〜)に収まる
+    const size_t TILE_SIZE = 256;
+    const size_t REDUCE_GRAIN = 4096;   // 部分和を合計するときに1つの塊にする天体の数
+}
+
+namespace gravity {
+
+Isa detectIsa() {
+    if (isSupported(Isa::AVX512)) return Isa::AVX512;
+    if (isSupported(Isa::AVX2)) return Isa::AVX2;
+    return Isa::Scalar;
+}
+
+bool isSupported(Isa isa) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    switch (isa) {
+        case Isa::Scalar: return true;
+        case Isa::AVX2:   return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case Isa::AVX512: return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+#else
+    return isa == Isa::Scalar;
+#endif
+}
+
+const char* isaName(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar: return "scalar";
+        case Isa::AVX2:   return "avx2";
+        case Isa::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+void directAccelerations(const float* x, const float* y, const float* z, const float* mu, size_t n,
+                         size_t begin, size_t end, float* ax, float* ay, float* az, Isa isa) {
+    if (!isSupported(isa)) isa = Isa::Scalar;
+    switch (isa) {
+        case Isa::AVX512: directAccelerationsAVX512(x, y, z, mu, n, begin, end, ax, ay, az); return;
+        case Isa::AVX2:   directAccelerationsAVX2(x, y, z, mu, n, begin, end, ax, ay, az);   return;
+        case Isa::Scalar: break;
+    }
+    directAccelerationsScalar(x, y, z, mu, n, begin, end, ax, ay, az);
+}
+
+void directAccelerations(const double* x, const double* y, const double* z, const double* mu, size_t n,
+                         size_t begin, size_t end, double* ax, double* ay, double* az, Isa) {
+    directAccelerationsScalar(x, y, z, mu, n, begin, end, ax, ay, az);
+}
+
+template <typename Real>
+void directAccelerationsScalar(const Real* x, const Real* y, const Real* z, const Real* mu, size_t n,
+                               size_t begin, size_t end, Real* ax, Real* ay, Real* az) {
+    for (size_t i = begin; i < end; ++i) {
+        Real sumX = 0, sumY = 0, sumZ = 0;
+        for (size_t j = 0; j < n; ++j) {
+            if (i == j) continue;  // 同じ天体は無視
+
+            // 2つの天体間の距離を計算
+            Real dx = x[j] - x[i];
+            Real dy = y[j] - y[i];
+            Real dz = z[j] - z[i];
+            Real r2 = dx*dx + dy*dy + dz*dz;
+            if (!(r2 > Real(0))) continue;  // 同じ位置にある天体は足さない(SIMD版でr2 > 0のマスクを掛けるのと同じ)
+            Real invR = Real(1) / std::sqrt(r2);
+
+            // a = μ_j / r^2 を方向(d/r)に分ける。相手の質量だけで加速度が決まる
+            Real s = mu[j] * invR * invR * invR;
+            sumX += s * dx;
+            sumY += s * dy;
+            sumZ += s * dz;
+        }
+        ax[i] = sumX;
+        ay[i] = sumY;
+        az[i] = sumZ;
+    }
+}
+
+void pairTileAccelerations(const float* x, const float* y, const float* z, const float* mu,
+                           size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd,
+                           float* ax, float* ay, float* az, Isa isa) {
+    if (!isSupported(isa)) isa = Isa::Scalar;
+    switch (isa) {
+        case Isa::AVX512: pairTileAVX512(x, y, z, mu, iBegin, iEnd, jBegin, jEnd, ax, ay, az); return;
+        case Isa::AVX2:   pairTileAVX2(x, y, z, mu, iBegin, iEnd, jBegin, jEnd, ax, ay, az);   return;
+        case Isa::Scalar: break;
+    }
+    pairTileScalar(x, y, z, mu, iBegin, iEnd, jBegin, jEnd, ax, ay, az);
+}
+
+void pairTileAccelerations(const double* x, const double* y, const double* z, const double* mu,
+                           size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd,
+                           double* ax, double* ay, double* az, Isa) {
+    pairTileScalar(x, y, z, mu, iBegin, iEnd, jBegin, jEnd, ax, ay, az);
+}
+
+template <typename Real>
+void pairTileScalar(const Real* x, const Real* y, const Real* z, const Real* mu,
+                    size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd, Real* ax, Real* ay, Real* az) {
+    const bool diagonal = (iBegin == jBegin);
+    for (size_t i = iBegin; i < iEnd; ++i) {
+        const Real xi = x[i], yi = y[i], zi = z[i], mui = mu[i];
+        Real sumX = 0, sumY = 0, sumZ = 0;
+        for (size_t j = diagonal ? i + 1 : jBegin; j < jEnd; ++j) {
+            Real dx = x[j] - xi;
+            Real dy = y[j] - yi;
+            Real dz = z[j] - zi;
+            Real r2 = dx*dx + dy*dy + dz*dz;
+            if (!(r2 > Real(0))) continue;  // 同じ位置にある天体は足さない(SIMD版と同じ)
+            Real invR = Real(1) / std::sqrt(r2);
+            Real s = invR * invR * invR;
+            // iはjの方向へ μ_j s d 、jはiの方向へ μ_i s d だけ引かれる
+            Real si = mu[j] * s;
+            Real sj = mui * s;
+            sumX += si * dx; sumY += si * dy; sumZ += si * dz;
+            ax[j] -= sj * dx; ay[j] -= sj * dy; az[j] -= sj * dz;
+        }
+        ax[i] += sumX;
+        ay[i] += sumY;
+        az[i] += sumZ;
+    }
+}
+
+template <typename Real>
+void tiledAccelerations(const Real* x, const Real* y, const Real* z, const Real* mu, size_t n,
+                        Real* ax, Real* ay, Real* az, Isa isa, ThreadPool* pool, std::vector<Real>& partial) {
+    const size_t tiles = (n + TILE_SIZE - 1) / TILE_SIZE;
+    const size_t pairs = tiles * (tiles + 1) / 2;   // I <= J のタイルの組の数
+    size_t groups = pool ? pool->size() : 1;
+    if (groups > pairs) groups = pairs;
+    if (groups <= 1) {
+        // 1グループなら部分和は要らない
+        std::fill(ax, ax + n, Real(0));
+        std::fill(ay, ay + n, Real(0));
+        std::fill(az, az + n, Real(0));
+        for (size_t I = 0; I < tiles; ++I) {
+            for (size_t J = I; J < tiles; ++J) {
+                pairTileAccelerations(x, y, z, mu, I * TILE_SIZE, std::min(n, (I + 1) * TILE_SIZE),
+                                      J * TILE_SIZE, std::min(n, (J + 1) * TILE_SIZE), ax, ay, az, isa);
+            }
+        }
+        return;
+    }
+
+    // グループgは、行の順(I, J)に並べたタイルの組のうち [g*pairs/groups, (g+1)*pairs/groups) 番目を受け持ち、
+    // 結果を自分の部分和 partial[(3g + 成分) * n ...] に足す。どのスレッドが実行しても書く場所は同じ
+    partial.assign(groups * 3 * n, Real(0));
+    pool->parallelFor(0, groups, 1, [&](size_t groupBegin, size_t groupEnd) {
+        for (size_t g = groupBegin; g < groupEnd; ++g) {
+            Real* px = partial.data() + (3 * g + 0) * n;
+            Real* py = partial.data() + (3 * g + 1) * n;
+            Real* pz = partial.data() + (3 * g + 2) * n;
+            const size_t first = g * pairs / groups;
+            const size_t last = (g + 1) * pairs / groups;
+            // first番目の組が何行目(I)の何列目(J)かを求める
+            size_t I = 0, rowStart = 0;
+            while (rowStart + (tiles - I) <= first) { rowStart += tiles - I; ++I; }
+            size_t J = I + (first - rowStart);
+            for (size_t p = first; p < last; ++p) {
+                pairTileAccelerations(x, y, z, mu, I * TILE_SIZE, std::min(n, (I + 1) * TILE_SIZE),
+                                      J * TILE_SIZE, std::min(n, (J + 1) * TILE_SIZE), px, py, pz, isa);
+                if (++J == tiles) { ++I; J = I; }
+            }
+        }
+    });
+    // グループの順番どおりに足すので、結果はスケジューリングによらない
+    pool->parallelFor(0, n, REDUCE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Real sumX = 0, sumY = 0, sumZ = 0;
+            for (size_t g = 0; g < groups; ++g) {
+                sumX += partial[(3 * g + 0) * n + i];
+                sumY += partial[(3 * g + 1) * n + i];
+                sumZ += partial[(3 * g + 2) * n + i];
+            }
+            ax[i] = sumX;
+            ay[i] = sumY;
+            az[i] = sumZ;
+        }
+    });
+}
+
+// 使う型についてだけ実体化する
+template void directAccelerationsScalar<float>(const float*, const float*, const float*, const float*, size_t,
+                                               size_t, size_t, float*, float*, float*);
+template void directAccelerationsScalar<double>(const double*, const double*, const double*, const double*, size_t,
+                                                size_t, size_t, double*, double*, double*);
+template void pairTileScalar<float>(const float*, const float*, const float*, const float*,
+                                    size_t, size_t, size_t, size_t, float*, float*, float*);
+template void pairTileScalar<double>(const double*, const double*, const double*, const double*,
+                                     size_t, size_t, size_t, size_t, double*, double*, double*);
+template void tiledAccelerations<float>(const float*, const float*, const float*, const float*, size_t,
+                                        float*, float*, float*, Isa, ThreadPool*, std::vector<float>&);
+template void tiledAccelerations<double>(const double*, const double*, const double*, const double*, size_t,
+                                         double*, double*, double*, Isa, ThreadPool*, std::vector<double>&);
+
+void accelerationJerk(const double* x, const double* y, const double* z,
+                      const double* vx, const double* vy, const double* vz, const double* mu, size_t n,
+                      const size_t* targets, size_t begin, size_t end,
+                      double* ax, double* ay, double* az, double* jx, double* jy, double* jz) {
+    for (size_t k = begin; k < end; ++k) {
+        const size_t i = targets[k];
+        double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+        double jerkX = 0.0, jerkY = 0.0, jerkZ = 0.0;
+        for (size_t j = 0; j < n; ++j) {
+            if (i == j) continue;  // 同じ天体は無視
+            double dx = x[j] - x[i];
+            double dy = y[j] - y[i];
+            double dz = z[j] - z[i];
+            double dvx = vx[j] - vx[i];
+            double dvy = vy[j] - vy[i];
+            double dvz = vz[j] - vz[i];
+            double r2 = dx*dx + dy*dy + dz*dz;
+            if (!(r2 > 0.0)) continue;  // 同じ位置にある天体は足さない
+            double invR2 = 1.0 / r2;
+            double s = mu[j] * invR2 * std::sqrt(invR2);     // μ_j / r^3
+            double rv = 3.0 * (dx*dvx + dy*dvy + dz*dvz) * invR2;  // 3 (r・v) / r^2
+            sumX += s * dx;
+            sumY += s * dy;
+            sumZ += s * dz;
+            jerkX += s * (dvx - rv * dx);
+            jerkY += s * (dvy - rv * dy);
+            jerkZ += s * (dvz - rv * dz);
+        }
+        ax[i] = sumX; ay[i] = sumY; az[i] = sumZ;
+        jx[i] = jerkX; jy[i] = jerkY; jz[i] = jerkZ;
+    }
+}
+
+}
@@ -0,0 +1,82 @@
+#ifndef GRAVITY_H
+#define GRAVITY_H
+
+#include <cstddef>  // size_t
+#include <vector>   // std::vector
+
+class ThreadPool;
+
+// 全ペアを直接足し合わせる重力計算(direct summation)
+// 加速度は a_i = Σ_j μ_j (r_j - r_i) / |r_j - r_i|^3  (μ = G*m)。自分自身(距離0)は足さない。
+//
+// SIMD版は8個(AVX2)または16個(AVX-512)の天体の加速度をまとめて計算する。
+// 1/r は近似逆数平方根(rsqrt)にNewton反復を1回かけて求めるので、スカラー版(1/sqrt)とは完全には一致しない。
+// 1つのペアあたりの相対誤差は AVX2 で 6e-7、AVX-512 で 4e-7 程度(floatの丸め誤差の数倍)。
+// 足し算の順番はスカラー版と同じなので、合計した加速度もスカラー版と相対1e-6以内で一致する(許容差はこの値とする)。
+// 倍精度(double)の配列を渡した場合は、命令セットの指定によらずスカラー版で計算する。
+namespace gravity {
+    // 使う命令セット
+    enum class Isa {
+        Scalar,     // SIMDを使わない
+        AVX2,       // AVX2 + FMA (8個ずつ)
+        AVX512      // AVX-512F (16個ずつ)
+    };
+
+    Isa detectIsa();                    // 実行中のCPUで使える一番速い命令セット
+    bool isSupported(Isa isa);          // 実行中のCPUでその命令セットが使えるか
+    const char* isaName(Isa isa);
+
+    // 位置(x, y, z)とμを持つn個の天体のうち、[begin, end) 番目の天体の加速度を計算して ax, ay, az に書き込む
+    // 使えない命令セットを指定した場合はスカラー版で計算する
+    void directAccelerations(const float* x, const float* y, const float* z, const float* mu, size_t n,
+                             size_t begin, size_t end, float* ax, float* ay, float* az, Isa isa);
+    void directAccelerations(const double* x, const double* y, const double* z, const double* mu, size_t n,
+                             size_t begin, size_t end, double* ax, double* ay, double* az, Isa isa);
+
+    // 作用・反作用の法則を使う、キャッシュに収まる大きさ(タイル)ごとの直接計算。[0, n) の全天体の加速度を書き込む
+    // 1つのペアの力を両方の天体に同時に足すので、計算量は全ペア版の半分になる。
+    // 足し算の順番がdirectAccelerationsと違うので結果は完全には一致しない(天体5000個で相対6e-6程度。天体数とともに増える)。
+    // タイルの組をスレッド数と同じ数のグループに分け、グループごとの部分和(partial)に足してから、決まった順番で合計する。
+    // そのため、スレッド数が同じなら何度計算しても結果は完全に一致する。partialは作業領域(中身は気にしなくてよい)
+    // Realはfloatかdouble
+    template <typename Real>
+    void tiledAccelerations(const Real* x, const Real* y, const Real* z, const Real* mu, size_t n,
+                            Real* ax, Real* ay, Real* az, Isa isa, ThreadPool* pool, std::vector<Real>& partial);
+
+    // タイル[iBegin, iEnd)とタイル[jBegin, jEnd)の間の全ペアの加速度を、両方の天体の ax, ay, az に足す
+    // iBegin == jBegin のときは同じタイルの中のペア(i < j)だけを計算する
+    void pairTileAccelerations(const float* x, const float* y, const float* z, const float* mu,
+                               size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd,
+                               float* ax, float* ay, float* az, Isa isa);
+    void pairTileAccelerations(const double* x, const double* y, const double* z, const double* mu,
+                               size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd,
+                               double* ax, double* ay, double* az, Isa isa);
+
+    // targets[begin, end) の天体について、全天体からの加速度 a と、その時間微分(躍度, jerk)を計算して番号の位置に書き込む
+    //   a_i = Σ_j μ_j r_ij / r^3 、 j_i = Σ_j μ_j (v_ij / r^3 - 3 (r_ij・v_ij) r_ij / r^5)   (r_ij = r_j - r_i, v_ij = v_j - v_i)
+    // 4次のHermite法で使う。力を計算し直す天体だけを指定できるように、番号の一覧を受け取る
+    // 修正子は始点と終点の加速度の差から高階の微分を求めるので、floatの丸め誤差が刻みを決めてしまわないようにdoubleで計算する
+    void accelerationJerk(const double* x, const double* y, const double* z,
+                          const double* vx, const double* vy, const double* vz, const double* mu, size_t n,
+                          const size_t* targets, size_t begin, size_t end,
+                          double* ax, double* ay, double* az, double* jx, double* jy, double* jz);
+
+    // 以下は命令セットごとの本体(SIMD版はGravitySIMD.cppで定義)。呼ぶ側でCPUが対応しているか確かめること
+    // スカラー版はfloatとdoubleの両方で使える
+    void directAccelerationsAVX2(const float* x, const float* y, const float* z, const float* mu, size_t n,
+                                 size_t begin, size_t end, float* ax, float* ay, float* az);
+    void directAccelerationsAVX512(const float* x, const float* y, const float* z, const float* mu, size_t n,
+                                   size_t begin, size_t end, float* ax, float* ay, float* az);
+    template <typename Real>
+    void directAccelerationsScalar(const Real* x, const Real* y, const Real* z, const Real* mu, size_t n,
+                                   size_t begin, size_t end, Real* ax, Real* ay, Real* az);
+    void pairTileAVX2(const float* x, const float* y, const float* z, const float* mu,
+                      size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd, float* ax, float* ay, float* az);
+    void pairTileAVX512(const float* x, const float* y, const float* z, const float* mu,
+                        size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd, float* ax, float* ay, float* az);
+    template <typename Real>
+    void pairTileScalar(const Real* x, const Real* y, const Real* z, const Real* mu,
+                        size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd, Real* ax, Real* ay, Real* az);
+}
+
+#endif
@@ -0,0 +1,219 @@
+// 直接計算による重力のSIMD版(AVX2 / AVX-512)
+// 関数ごとにtarget属性を付けているので、このファイルを -mavx2 などでコンパイルする必要はない。
+// どの命令セットを使うかはGravity.cppのdirectAccelerationsが実行時に選ぶ。
+
+#include "Gravity.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <cmath>    // std::sqrt
+#include <immintrin.h>
+
+namespace gravity {
+
+__attribute__((target("avx2,fma")))
+void directAccelerationsAVX2(const float* x, const float* y, const float* z, const float* mu, size_t n,
+                             size_t begin, size_t end, float* ax, float* ay, float* az) {
+    const size_t lanes = 8;
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+
+    size_t i = begin;
+    for (; i + lanes <= end; i += lanes) {
+        // 8個の天体の位置をまとめて読み、全天体からの加速度を足していく
+        const __m256 xi = _mm256_loadu_ps(x + i);
+        const __m256 yi = _mm256_loadu_ps(y + i);
+        const __m256 zi = _mm256_loadu_ps(z + i);
+        __m256 sumX = zero, sumY = zero, sumZ = zero;
+        for (size_t j = 0; j < n; ++j) {
+            const __m256 dx = _mm256_sub_ps(_mm256_set1_ps(x[j]), xi);
+            const __m256 dy = _mm256_sub_ps(_mm256_set1_ps(y[j]), yi);
+            const __m256 dz = _mm256_sub_ps(_mm256_set1_ps(z[j]), zi);
+            const __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+            // 1/r: rsqrt(12ビット精度)にNewton反復を1回 y = y(1.5 - 0.5 r2 y^2)
+            __m256 invR = _mm256_rsqrt_ps(r2);
+            invR = _mm256_mul_ps(invR, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(invR, invR), threeHalves));
+            // 距離0(自分自身)は足さない
+            invR = _mm256_and_ps(invR, _mm256_cmp_ps(r2, zero, _CMP_GT_OQ));
+            const __m256 s = _mm256_mul_ps(_mm256_set1_ps(mu[j]), _mm256_mul_ps(invR, _mm256_mul_ps(invR, invR)));
+            sumX = _mm256_fmadd_ps(s, dx, sumX);
+            sumY = _mm256_fmadd_ps(s, dy, sumY);
+            sumZ = _mm256_fmadd_ps(s, dz, sumZ);
+        }
+        _mm256_storeu_ps(ax + i, sumX);
+        _mm256_storeu_ps(ay + i, sumY);
+        _mm256_storeu_ps(az + i, sumZ);
+    }
+    // 8個に満たない残りはスカラー版で
+    if (i < end) directAccelerationsScalar(x, y, z, mu, n, i, end, ax, ay, az);
+}
+
+__attribute__((target("avx512f")))
+void directAccelerationsAVX512(const float* x, const float* y, const float* z, const float* mu, size_t n,
+                               size_t begin, size_t end, float* ax, float* ay, float* az) {
+    const size_t lanes = 16;
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 threeHalves = _mm512_set1_ps(1.5f);
+
+    size_t i = begin;
+    for (; i < end; i += lanes) {
+        // 16個に満たない残りはマスクで読み書きする
+        const __mmask16 active = (end - i >= lanes) ? static_cast<__mmask16>(0xFFFF)
+                                                    : static_cast<__mmask16>((1u << (end - i)) - 1u);
+        const __m512 xi = _mm512_maskz_loadu_ps(active, x + i);
+        const __m512 yi = _mm512_maskz_loadu_ps(active, y + i);
+        const __m512 zi = _mm512_maskz_loadu_ps(active, z + i);
+        __m512 sumX = zero, sumY = zero, sumZ = zero;
+        for (size_t j = 0; j < n; ++j) {
+            const __m512 dx = _mm512_sub_ps(_mm512_set1_ps(x[j]), xi);
+            const __m512 dy = _mm512_sub_ps(_mm512_set1_ps(y[j]), yi);
+            const __m512 dz = _mm512_sub_ps(_mm512_set1_ps(z[j]), zi);
+            const __m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+            // 1/r: rsqrt14(14ビット精度)にNewton反復を1回
+            __m512 invR = _mm512_rsqrt14_ps(r2);
+            invR = _mm512_mul_ps(invR, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(invR, invR), threeHalves));
+            // 距離0(自分自身)は足さない
+            const __mmask16 apart = _mm512_cmp_ps_mask(r2, zero, _CMP_GT_OQ);
+            const __m512 s = _mm512_maskz_mul_ps(apart, _mm512_set1_ps(mu[j]), _mm512_mul_ps(invR, _mm512_mul_ps(invR, invR)));
+            sumX = _mm512_fmadd_ps(s, dx, sumX);
+            sumY = _mm512_fmadd_ps(s, dy, sumY);
+            sumZ = _mm512_fmadd_ps(s, dz, sumZ);
+        }
+        _mm512_mask_storeu_ps(ax + i, active, sumX);
+        _mm512_mask_storeu_ps(ay + i, active, sumY);
+        _mm512_mask_storeu_ps(az + i, active, sumZ);
+    }
+}
+
+// タイルの組の対称な計算。jを8個ずつまとめ、iの分はベクトルで貯めて最後に足し合わせ、jの分はその場で引く
+__attribute__((target("avx2,fma")))
+void pairTileAVX2(const float* x, const float* y, const float* z, const float* mu,
+                  size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd, float* ax, float* ay, float* az) {
+    const size_t lanes = 8;
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const bool diagonal = (iBegin == jBegin);
+
+    for (size_t i = iBegin; i < iEnd; ++i) {
+        const __m256 xi = _mm256_set1_ps(x[i]);
+        const __m256 yi = _mm256_set1_ps(y[i]);
+        const __m256 zi = _mm256_set1_ps(z[i]);
+        const __m256 mui = _mm256_set1_ps(mu[i]);
+        __m256 sumX = zero, sumY = zero, sumZ = zero;
+        size_t j = diagonal ? i + 1 : jBegin;
+        for (; j + lanes <= jEnd; j += lanes) {
+            const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), xi);
+            const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), yi);
+            const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), zi);
+            const __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+            __m256 invR = _mm256_rsqrt_ps(r2);
+            invR = _mm256_mul_ps(invR, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(invR, invR), threeHalves));
+            invR = _mm256_and_ps(invR, _mm256_cmp_ps(r2, zero, _CMP_GT_OQ));
+            const __m256 s = _mm256_mul_ps(invR, _mm256_mul_ps(invR, invR));
+            const __m256 si = _mm256_mul_ps(_mm256_loadu_ps(mu + j), s);
+            const __m256 sj = _mm256_mul_ps(mui, s);
+            sumX = _mm256_fmadd_ps(si, dx, sumX);
+            sumY = _mm256_fmadd_ps(si, dy, sumY);
+            sumZ = _mm256_fmadd_ps(si, dz, sumZ);
+            _mm256_storeu_ps(ax + j, _mm256_fnmadd_ps(sj, dx, _mm256_loadu_ps(ax + j)));
+            _mm256_storeu_ps(ay + j, _mm256_fnmadd_ps(sj, dy, _mm256_loadu_ps(ay + j)));
+            _mm256_storeu_ps(az + j, _mm256_fnmadd_ps(sj, dz, _mm256_loadu_ps(az + j)));
+        }
+        // 8個ずつ貯めた分を1つにまとめる
+        float lanesX[8], lanesY[8], lanesZ[8];
+        _mm256_storeu_ps(lanesX, sumX);
+        _mm256_storeu_ps(lanesY, sumY);
+        _mm256_storeu_ps(lanesZ, sumZ);
+        float totalX = 0.0f, totalY = 0.0f, totalZ = 0.0f;
+        for (size_t k = 0; k < lanes; ++k) { totalX += lanesX[k]; totalY += lanesY[k]; totalZ += lanesZ[k]; }
+        // 8個に満たない残り
+        for (; j < jEnd; ++j) {
+            float dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+            float r2 = dx*dx + dy*dy + dz*dz;
+            if (!(r2 > 0.0f)) continue;     // 同じ位置にある天体は足さない(ベクトルの部分と同じ)
+            float invR = 1.0f / std::sqrt(r2);
+            float s = invR * invR * invR;
+            totalX += mu[j] * s * dx; totalY += mu[j] * s * dy; totalZ += mu[j] * s * dz;
+            ax[j] -= mu[i] * s * dx;  ay[j] -= mu[i] * s * dy;  az[j] -= mu[i] * s * dz;
+        }
+        ax[i] += totalX;
+        ay[i] += totalY;
+        az[i] += totalZ;
+    }
+}
+
+__attribute__((target("avx512f")))
+void pairTileAVX512(const float* x, const float* y, const float* z, const float* mu,
+                    size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd, float* ax, float* ay, float* az) {
+    const size_t lanes = 16;
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 threeHalves = _mm512_set1_ps(1.5f);
+    const bool diagonal = (iBegin == jBegin);
+
+    for (size_t i = iBegin; i < iEnd; ++i) {
+        const __m512 xi = _mm512_set1_ps(x[i]);
+        const __m512 yi = _mm512_set1_ps(y[i]);
+        const __m512 zi = _mm512_set1_ps(z[i]);
+        const __m512 mui = _mm512_set1_ps(mu[i]);
+        __m512 sumX = zero, sumY = zero, sumZ = zero;
+        for (size_t j = diagonal ? i + 1 : jBegin; j < jEnd; j += lanes) {
+            // 16個に満たない残りはマスクで読み書きする(読まなかった所は0なので、r2 = 0として除かれる)
+            const __mmask16 active = (jEnd - j >= lanes) ? static_cast<__mmask16>(0xFFFF)
+                                                         : static_cast<__mmask16>((1u << (jEnd - j)) - 1u);
+            const __m512 dx = _mm512_maskz_sub_ps(active, _mm512_maskz_loadu_ps(active, x + j), xi);
+            const __m512 dy = _mm512_maskz_sub_ps(active, _mm512_maskz_loadu_ps(active, y + j), yi);
+            const __m512 dz = _mm512_maskz_sub_ps(active, _mm512_maskz_loadu_ps(active, z + j), zi);
+            const __m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+            __m512 invR = _mm512_rsqrt14_ps(r2);
+            invR = _mm512_mul_ps(invR, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(invR, invR), threeHalves));
+            const __mmask16 apart = _mm512_cmp_ps_mask(r2, zero, _CMP_GT_OQ) & active;
+            const __m512 s = _mm512_maskz_mul_ps(apart, invR, _mm512_mul_ps(invR, invR));
+            const __m512 si = _mm512_mul_ps(_mm512_maskz_loadu_ps(active, mu + j), s);
+            const __m512 sj = _mm512_mul_ps(mui, s);
+            sumX = _mm512_fmadd_ps(si, dx, sumX);
+            sumY = _mm512_fmadd_ps(si, dy, sumY);
+            sumZ = _mm512_fmadd_ps(si, dz, sumZ);
+            _mm512_mask_storeu_ps(ax + j, active, _mm512_fnmadd_ps(sj, dx, _mm512_maskz_loadu_ps(active, ax + j)));
+            _mm512_mask_storeu_ps(ay + j, active, _mm512_fnmadd_ps(sj, dy, _mm512_maskz_loadu_ps(active, ay + j)));
+            _mm512_mask_storeu_ps(az + j, active, _mm512_fnmadd_ps(sj, dz, _mm512_maskz_loadu_ps(active, az + j)));
+        }
+        ax[i] += _mm512_reduce_add_ps(sumX);
+        ay[i] += _mm512_reduce_add_ps(sumY);
+        az[i] += _mm512_reduce_add_ps(sumZ);
+    }
+}
+
+}
+
+#else
+
+// x86以外ではSIMD版を使わない(isSupportedがfalseを返すので呼ばれないが、リンクのために置いておく)
+namespace gravity {
+
+void directAccelerationsAVX2(const float* x, const float* y, const float* z, const float* mu, size_t n,
+                             size_t begin, size_t end, float* ax, float* ay, float* az) {
+    directAccelerationsScalar(x, y, z, mu, n, begin, end, ax, ay, az);
+}
+
+void directAccelerationsAVX512(const float* x, const float* y, const float* z, const float* mu, size_t n,
+                               size_t begin, size_t end, float* ax, float* ay, float* az) {
+    directAccelerationsScalar(x, y, z, mu, n, begin, end, ax, ay, az);
+}
+
+void pairTileAVX2(const float* x, const float* y, const float* z, const float* mu,
+                  size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd, float* ax, float* ay, float* az) {
+    pairTileScalar(x, y, z, mu, iBegin, iEnd, jBegin, jEnd, ax, ay, az);
+}
+
+void pairTileAVX512(const float* x, const float* y, const float* z, const float* mu,
+                    size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd, float* ax, float* ay, float* az) {
+    pairTileScalar(x, y, z, mu, iBegin, iEnd, jBegin, jEnd, ax, ay, az);
+}
+
+}
+
+#endif
@@ -0,0 +1,97 @@
+#include <cmath>        // std::sqrt
+#include <stdexcept>    // std::out_of_range
+
+#include "Hierarchy.h"
+
+Hierarchy::Hierarchy()
+:   satellites_(0)
+{
+}
+
+void Hierarchy::add(size_t primary) {
+    if (primary != NONE && primary >= primary_.size()) {
+        throw std::out_of_range("Primary must be added before its satellite");
+    }
+    primary_.push_back(primary);
+    if (primary != NONE) ++satellites_;
+}
+
+void Hierarchy::clear() {
+    primary_.clear();
+    satellites_ = 0;
+}
+
+size_t Hierarchy::size() const { return primary_.size(); }
+size_t Hierarchy::primary(size_t index) const { return primary_[index]; }
+size_t Hierarchy::satelliteCount() const { return satellites_; }
+
+void Hierarchy::toGlobal(const BodyStore& local, BodyStore& global, bool positionsOnly) const {
+    const size_t n = primary_.size();
+    const int arrays = positionsOnly ? 3 : 9;
+    float* const* from[9] = {&local.x, &local.y, &local.z, &local.vx, &local.vy, &local.vz, &local.ax, &local.ay, &local.az};
+    float* const* to[9] = {&global.x, &global.y, &global.z, &global.vx, &global.vy, &global.vz, &global.ax, &global.ay, &global.az};
+    for (int q = 0; q < arrays; ++q) {
+        const float* l = *from[q];
+        float* g = *to[q];
+        // 主星は前にあるので、g[p]はもう全体の値になっている
+        for (size_t i = 0; i < n; ++i) {
+            const size_t p = primary_[i];
+            g[i] = (p == NONE) ? l[i] : g[p] + l[i];
+        }
+    }
+}
+
+void Hierarchy::toLocal(const BodyStore& global, BodyStore& local) const {
+    const size_t n = primary_.size();
+    float* const* from[6] = {&global.x, &global.y, &global.z, &global.vx, &global.vy, &global.vz};
+    float* const* to[6] = {&local.x, &local.y, &local.z, &local.vx, &local.vy, &local.vz};
+    for (int q = 0; q < 6; ++q) {
+        const float* g = *from[q];
+        float* l = *to[q];
+        for (size_t i = 0; i < n; ++i) {
+            const size_t p = primary_[i];
+            l[i] = (p == NONE) ? g[i] : g[i] - g[p];
+        }
+    }
+}
+
+void Hierarchy::localAccelerations(BodyStore& local, BodyStore& global, const float* mu) const {
+    const size_t n = primary_.size();
+    // 衛星と主星の間の引力を差し替える。差し替える量は小さいのでdoubleで求めてから足す
+    for (size_t i = 0; i < n; ++i) {
+        const size_t p = primary_[i];
+        if (p == NONE) continue;
+        // 力の計算で使われた相対位置(floatの全体の座標の差)
+        const double gx = global.x[i] - global.x[p];
+        const double gy = global.y[i] - global.y[p];
+        const double gz = global.z[i] - global.z[p];
+        const double lx = local.x[i], ly = local.y[i], lz = local.z[i];
+        const double gr = std::sqrt(gx*gx + gy*gy + gz*gz);
+        const double lr = std::sqrt(lx*lx + ly*ly + lz*lz);
+        const double gs = 1.0 / (gr * gr * gr);
+        const double ls = 1.0 / (lr * lr * lr);
+        // d/r^3 の差。衛星には -μ_p倍、主星には +μ_i倍で効く
+        const double dx = lx * ls - gx * gs;
+        const double dy = ly * ls - gy * gs;
+        const double dz = lz * ls - gz * gs;
+        global.ax[i] -= static_cast<float>(mu[p] * dx);
+        global.ay[i] -= static_cast<float>(mu[p] * dy);
+        global.az[i] -= static_cast<float>(mu[p] * dz);
+        global.ax[p] += static_cast<float>(mu[i] * dx);
+        global.ay[p] += static_cast<float>(mu[i] * dy);
+        global.az[p] += static_cast<float>(mu[i] * dz);
+    }
+    // 主星に対する相対加速度
+    for (size_t i = 0; i < n; ++i) {
+        const size_t p = primary_[i];
+        if (p == NONE) {
+            local.ax[i] = global.ax[i];
+            local.ay[i] = global.ay[i];
+            local.az[i] = global.az[i];
+        } else {
+            local.ax[i] = global.ax[i] - global.ax[p];
+            local.ay[i] = global.ay[i] - global.ay[p];
+            local.az[i] = global.az[i] - global.az[p];
+        }
+    }
+}
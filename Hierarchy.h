@@ -0,0 +1,38 @@
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include <cstddef>  // size_t
+#include <vector>   // std::vector
+
+#include "BodyStore.h"
+
+// 天体の主星(衛星が回っている天体)の関係。月の主星は地球、地球の主星は太陽、太陽には主星がない。
+// 衛星の位置と速度を主星からの相対(local)で持つと、太陽から1.5e8 km離れた所でもfloatで地球と月の距離を細かく表せる。
+// 天体は必ず主星より後ろの番号にある(Universe::addSphereで主星を先に追加する)ので、前から順に足せば全体(global)の座標になる。
+class Hierarchy {
+public:
+    static const size_t NONE = static_cast<size_t>(-1);    // 主星がないことを表す番号
+
+    Hierarchy();
+
+    void add(size_t primary);       // 天体を1つ追加する。primaryはこれより前に追加した天体の番号かNONE
+    void clear();
+    size_t size() const;
+    size_t primary(size_t index) const;
+    size_t satelliteCount() const;  // 主星を持つ天体の数
+
+    // localの位置(positionsOnlyでなければ速度と加速度も)を主星の分だけ足してglobalに書き込む
+    void toGlobal(const BodyStore& local, BodyStore& global, bool positionsOnly) const;
+    // globalの位置と速度(x..vz)を主星からの相対にしてlocalに書き込む
+    void toLocal(const BodyStore& global, BodyStore& local) const;
+    // globalの加速度(toGlobalした位置で計算したもの)から、localの加速度(主星に対する相対加速度)を求める。
+    // 衛星と主星の間の引力は、全体の座標の差(桁が落ちている)ではなくlocalの相対位置で計算し直して差し替える。
+    // それ以外の天体からの引力は、衛星と主星にかかる分の差(潮汐力)になる。globalの加速度も差し替えた後の値になる
+    void localAccelerations(BodyStore& local, BodyStore& global, const float* mu) const;
+
+private:
+    std::vector<size_t> primary_;   // 天体ごとの主星の番号
+    size_t satellites_;
+};
+
+#endif
@@ -0,0 +1,105 @@
+// Kepler運動の解析解(普遍変数による)
+
+#include <cmath>    // std::sqrt, std::cos, std::cosh, std::sin, std::sinh, std::fabs, std::fmod
+
+#include "Kepler.h"
+
+namespace {
+    const int MAX_ITERATIONS = 50;
+    const double CONVERGENCE = 1e-15;   // χ の相対的な変化がこれより小さくなったら終わる
+    const double SERIES_LIMIT = 0.1;    // |z| がこれより小さいときはStumpff関数を級数で計算する
+    const double PI = 3.14159265358979323846;
+}
+
+namespace kepler {
+
+void stumpff(double z, double& c2, double& c3) {
+    if (std::fabs(z) < SERIES_LIMIT) {
+        // c2 = 1/2! - z/4! + z^2/6! - ... 、 c3 = 1/3! - z/5! + z^2/7! - ...
+        c2 = 0.0; c3 = 0.0;
+        double term2 = 1.0 / 2, term3 = 1.0 / 6;
+        for (int k = 0; k < 8; ++k) {
+            c2 += term2;
+            c3 += term3;
+            term2 *= -z / ((2 * k + 3) * (2 * k + 4));
+            term3 *= -z / ((2 * k + 4) * (2 * k + 5));
+        }
+    } else if (z > 0.0) {
+        double s = std::sqrt(z);
+        c2 = (1.0 - std::cos(s)) / z;
+        c3 = (s - std::sin(s)) / (z * s);
+    } else {
+        double s = std::sqrt(-z);
+        c2 = (std::cosh(s) - 1.0) / (-z);
+        c3 = (std::sinh(s) - s) / (-z * s);
+    }
+}
+
+bool drift(double mu, double dt, double& x, double& y, double& z, double& vx, double& vy, double& vz) {
+    if (mu <= 0.0) {
+        // 中心天体に質量がなければ等速直線運動
+        x += vx * dt; y += vy * dt; z += vz * dt;
+        return true;
+    }
+    const double r0 = std::sqrt(x*x + y*y + z*z);
+    if (r0 == 0.0) return false;
+    const double v2 = vx*vx + vy*vy + vz*vz;
+    const double rv = x*vx + y*vy + z*vz;
+    const double sqrtMu = std::sqrt(mu);
+    const double alpha = 2.0 / r0 - v2 / mu;    // 長半径の逆数(負なら双曲線)
+
+    // 楕円軌道なら、1周期より長い分は進めなくてよい
+    double t = dt;
+    if (alpha > 0.0) {
+        const double period = 2.0 * PI / (sqrtMu * alpha * std::sqrt(alpha));
+        t = std::fmod(dt, period);
+    }
+
+    // F(χ) = (r・v/√μ) χ^2 c2 + (1 - α r0) χ^3 c3 + r0 χ - √μ t = 0 をLaguerre法で解く(Newton法より初期値に鈍感)
+    double chi = (alpha > 0.0) ? sqrtMu * t * alpha : sqrtMu * t / r0;
+    const double sigma0 = rv / sqrtMu;
+    const double laguerreN = 5.0;
+    double c2 = 0.5, c3 = 1.0 / 6;
+    double r = r0;
+    bool converged = false;
+    for (int iteration = 0; iteration < MAX_ITERATIONS; ++iteration) {
+        const double chi2 = chi * chi;
+        const double psi = alpha * chi2;
+        stumpff(psi, c2, c3);
+        const double f = sigma0 * chi2 * c2 + (1.0 - alpha * r0) * chi2 * chi * c3 + r0 * chi - sqrtMu * t;
+        r = sigma0 * chi * (1.0 - psi * c3) + (1.0 - alpha * r0) * chi2 * c2 + r0;     // F'(χ)は距離になる
+        const double fpp = sigma0 * (1.0 - psi * c2) + (1.0 - alpha * r0) * chi * (1.0 - psi * c3);
+        const double root = std::sqrt(std::fabs((laguerreN - 1) * (laguerreN - 1) * r * r - laguerreN * (laguerreN - 1) * f * fpp));
+        const double denominator = (r >= 0.0) ? r + root : r - root;
+        const double delta = laguerreN * f / denominator;
+        chi -= delta;
+        if (std::fabs(delta) <= CONVERGENCE * std::fabs(chi) || delta == 0.0) {
+            converged = true;
+            break;
+        }
+    }
+    if (!converged) return false;
+
+    // 最後のχで距離と係数を計算し直す
+    const double chi2 = chi * chi;
+    const double psi = alpha * chi2;
+    stumpff(psi, c2, c3);
+    r = sigma0 * chi * (1.0 - psi * c3) + (1.0 - alpha * r0) * chi2 * c2 + r0;
+
+    // Lagrangeの係数 f, g とその時間微分
+    const double f = 1.0 - chi2 * c2 / r0;
+    const double g = t - chi2 * chi * c3 / sqrtMu;
+    const double fdot = sqrtMu / (r * r0) * chi * (psi * c3 - 1.0);
+    const double gdot = 1.0 - chi2 * c2 / r;
+
+    const double px = x, py = y, pz = z;
+    x = f * px + g * vx;
+    y = f * py + g * vy;
+    z = f * pz + g * vz;
+    vx = fdot * px + gdot * vx;
+    vy = fdot * py + gdot * vy;
+    vz = fdot * pz + gdot * vz;
+    return true;
+}
+
+}
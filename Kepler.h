@@ -0,0 +1,16 @@
+#ifndef KEPLER_H
+#define KEPLER_H
+
+// 2体問題(Kepler運動)を解析的に解く。Wisdom–Holman法のKepler drift(中心天体のまわりを時間dtだけ進める)に使う
+// 普遍変数(universal variable)χ とStumpff関数を使うので、楕円・放物線・双曲線軌道を同じ式で扱える。
+// 桁落ちを避けるため、すべてdoubleで計算する。
+namespace kepler {
+    // 重力定数μ(= G*(中心天体と自分の質量の和)など)のまわりで、相対位置(x, y, z)・相対速度(vx, vy, vz)を時間dtだけ進める
+    // μが0以下なら等速直線運動。中心天体と同じ位置にある場合や収束しなかった場合(ほぼ起きない)はfalseを返し、位置と速度は書き換えない
+    bool drift(double mu, double dt, double& x, double& y, double& z, double& vx, double& vy, double& vz);
+
+    // Stumpff関数 c2(z) = (1 - cos√z)/z 、 c3(z) = (√z - sin√z)/√z^3  (zが負なら双曲線関数。0の近くは級数)
+    void stumpff(double z, double& c2, double& c3);
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include <stdexcept>    // std::runtime_error
+
+#ifdef _WIN32
+#define NOMINMAX        // std::min/std::maxと衝突させない
+#include <windows.h>    // CreateFileMapping, MapViewOfFile
+#else
+#include <fcntl.h>      // open
+#include <sys/mman.h>   // mmap
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // close
+#endif
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile(const std::string& path)
+:   data_(nullptr),
+    size_(0),
+    file_(nullptr),
+    mapping_(nullptr),
+    descriptor_(-1)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("cannot open " + path);
+    file_ = file;
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ > 0) {
+        mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_) data_ = static_cast<const char*>(MapViewOfFile(static_cast<HANDLE>(mapping_), FILE_MAP_READ, 0, 0, 0));
+        if (!data_) {
+            release();
+            throw std::runtime_error("cannot map " + path);
+        }
+    }
+#else
+    descriptor_ = open(path.c_str(), O_RDONLY);
+    if (descriptor_ < 0) throw std::runtime_error("cannot open " + path);
+    struct stat status;
+    if (fstat(descriptor_, &status) != 0) {
+        release();
+        throw std::runtime_error("cannot stat " + path);
+    }
+    size_ = static_cast<size_t>(status.st_size);
+    if (size_ > 0) {
+        void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor_, 0);
+        if (mapped == MAP_FAILED) {
+            release();
+            throw std::runtime_error("cannot map " + path);
+        }
+        data_ = static_cast<const char*>(mapped);
+        madvise(mapped, size_, MADV_SEQUENTIAL);    // 前から順に読むことが多い
+    }
+#endif
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+const char* MappedFile::data() const { return data_; }
+size_t MappedFile::size() const { return size_; }
+
+void MappedFile::release() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(static_cast<HANDLE>(mapping_));
+    if (file_) CloseHandle(static_cast<HANDLE>(file_));
+#else
+    if (data_) munmap(const_cast<char*>(data_), size_);
+    if (descriptor_ >= 0) close(descriptor_);
+#endif
+    data_ = nullptr;
+    mapping_ = nullptr;
+    file_ = nullptr;
+    descriptor_ = -1;
+}
@@ -0,0 +1,29 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>  // size_t
+#include <string>   // std::string
+
+// 読み込むファイルをメモリに写像したもの(読み取り専用)。Linuxではmmap、WindowsではMapViewOfFileを使う。
+// 開けないときはstd::runtime_errorを投げる。空のファイルならdata()はnullptr
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const;
+    size_t size() const;
+
+private:
+    const char* data_;
+    size_t size_;
+    void* file_;        // Windowsのファイルのハンドル(Linuxでは使わない)
+    void* mapping_;     // Windowsの写像のハンドル(Linuxでは使わない)
+    int descriptor_;    // Linuxのファイル記述子(Windowsでは使わない)
+
+    void release();
+};
+
+#endif
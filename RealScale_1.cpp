@@ -2,6 +2,7 @@
 #include <windows.h> // Windows APIを使用するためのヘッダー
 #include <GL/gl.h>   // OpenGLの基本機能を使うためのヘッダー
 #include <GL/glu.h>  // OpenGLのユーティリティ関数（例: gluSphere）を使うためのヘッダー
+#include <string>    // std::string
 #include <vector>    // std::vector
 #include <cmath>
 #include <iostream>
@@ -15,6 +16,14 @@
 #include "Sphere.h" // 球体を表すクラスSphereの宣言
 #include "Universe.h" // SphereをまとめたクラスSpheresをメンバとして持つ。相互作用を計算し、各Sphereの位置や速度を決める。
 #include "Camera.h" // 名前の通り。カメラの動きを決める。
+#include "Scenario.h" // 天体の初期条件(ヘッドレス版と共通)
+#include "Snapshot.h" // 状態の保存と再開
+#include "Recorder.h" // 位置と速度の時系列の書き出し
+#include "Replay.h" // 巻き戻し・早送り
+#include "Simulation.h" // 計算を描画とは別のスレッドで進める
+#include "GLFunctions.h" // OpenGL 1.2以降の関数
+#include "SphereRenderer.h" // 全天体の球を1回の命令で描く
+#include "TrailRenderer.h" // 全天体の軌跡を1回の命令で描く
 
 std::chrono::system_clock::time_point maketimepiont(int year, int month, int day, int hour, int minute, int second)
 {
@@ -39,6 +48,28 @@ std::tm* maketm_from_timepoint(std::chrono::system_clock::time_point tp)
 
 Universe universe(IntegrationMethod::RK4, maketimepiont(2024, 12, 22, 0, 0, 0)); // 宇宙の生成
 Camera camera(universe, {});
+Checkpointer checkpointer("checkpoint.snap", 30.0 * 24.0 * 60.0 * 60.0); // シミュレーション時間30日ごとに状態を保存する(落ちてもそこから再開できる)
+const std::string recordingPath = "trajectory.rec";   // 再生で見せるフレーム(recorderが書き、replayが読む)
+Recorder recorder(recordingPath);
+Replay replay(30.0 * 24.0 * 60.0 * 60.0);   // シミュレーション時間30日ごとにキーフレームを置く
+const double scrubStep = 10.0 * 24.0 * 60.0 * 60.0;    // 左右キーで動かす時間[s]
+// 計算の速さと描画の速さは別々に決める。計算は現実の1秒でシミュレーション時間が圧縮率[s/s]だけ進むように、刻みDTで何ステップでも進める
+// 圧縮率の初期値はtime_simu2real。上下キーで10倍ずつ変える
+Simulation simulation(universe, scaling::time_simu2real, scaling::DT);
+const double compressionFactor = 10.0;  // 上下キーで圧縮率を変える倍率
+const UINT frameInterval = 16;      // 描き直す間隔[ms]
+const Frame* frame = nullptr;       // 描画している状態(simulation.latest())。次のWM_TIMERまで中身は変わらない
+double alpha = 1.0;                 // frameの直前のステップと最後のステップの間のどこを描くか(Frame::interpolation())
+SphereRenderer sphereRenderer;      // 使えなければ(OpenGL 3.3より前のドライバ)Frame::drawBody()で1つずつ描く
+TrailRenderer trailRenderer;        // 使えなければFrame::drawTrajectory()で1本ずつ描く
+
+// OpenGL 1.2以降の関数のアドレス(gl::load()に渡す)。wglGetProcAddressは見つからないときにnullptrではなく1, 2, 3, -1を返すドライバがある
+void* getGLProcAddress(const char* name) {
+    void* address = reinterpret_cast<void*>(wglGetProcAddress(name));
+    const intptr_t value = reinterpret_cast<intptr_t>(address);
+    if (value == 1 || value == 2 || value == 3 || value == -1) return nullptr;
+    return address;
+}
 
 
 
@@ -148,7 +179,6 @@ void drawText(const char* text, float x, float y, float r=1.0f, float g=1.0f, fl
 // ウィンドウプロシージャ: ウィンドウが受け取るメッセージ（描画要求など）を処理する関数
 float windowWidth = 0.0f;
 float windowHeight = 0.0f;
-float counter = 0.0f;
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     float aspect = 0.0; //アスペクト比
     
@@ -176,25 +206,34 @@ std::cout << "WM_SIZE" << std::endl;
             glMatrixMode(GL_MODELVIEW); // モデルビュー行列に戻す
             return 0;
         }
-        case WM_TIMER:      // メインループが16msごとにWM_TIMERを送っている
+        case WM_TIMER:      // メインループがframeIntervalごとにWM_TIMERを送っている。計算はsimulationのスレッドが進めている
 std::cout << "WM_TIMER" << std::endl;
-            counter++;
-
-            if (counter >= 0.0f) {
-                universe.update(scaling::DT);
-                InvalidateRect(hwnd, NULL, FALSE); // 間接的に再描画をリクエスト : 間接的にウィンドウに「WM_PAINT」が送られるらしい。
-                counter = 0.0f;
-            }
+            frame = &simulation.latest();   // 計算スレッドが渡した一番新しい状態(待たない)
+            alpha = frame->interpolation(std::chrono::steady_clock::now()); // 今の時刻に合わせて、ステップの間を補間して描く
 
             // カメラの位置と向きの設定
-            camera.update(); // カメラの位置・向きを更新
+            camera.update(*frame, alpha); // カメラの位置・向きを更新
+            InvalidateRect(hwnd, NULL, FALSE); // 間接的に再描画をリクエスト : 間接的にウィンドウに「WM_PAINT」が送られるらしい。
+
+            return 0;
 
+        case WM_KEYDOWN:    // 左右キーで巻き戻し・早送り、スペースキーで再生中の時刻から計算を続ける(計算スレッドが次のステップの前に行う)。上下キーで時間の圧縮率を変える
+            if (wParam == VK_LEFT || wParam == VK_RIGHT) {
+                simulation.scrub(wParam == VK_LEFT ? -scrubStep : scrubStep);
+            } else if (wParam == VK_SPACE) {
+                simulation.resume();    // 次のupdate()で、ここから先の履歴は捨てられる
+            } else if (wParam == VK_UP) {
+                simulation.setTimeCompression(simulation.getTimeCompression() * compressionFactor);
+            } else if (wParam == VK_DOWN) {
+                simulation.setTimeCompression(simulation.getTimeCompression() / compressionFactor);
+            }
             return 0;
 
         case WM_PAINT: {
 std::cout << "WM_PAINT" << std::endl;
             PAINTSTRUCT ps;
             HDC hdc = BeginPaint(hwnd, &ps);
+            if (!frame) frame = &simulation.latest();   // 最初のWM_TIMERより前(alphaは初期値の1)
 
                 // 描画内容をクリア（画面を黒に塗りつぶし、深度バッファをリセット）
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -221,9 +260,15 @@ std::cout << "WM_PAINT" << std::endl;
                 // drawRadialLines(500,10000,-10);
 
                 // 全ての球を描画
-                for (Sphere& sphere : universe.spheres) {
-                    sphere.draw();
-                    sphere.drawTrajectory();
+                if (sphereRenderer.isReady()) {
+                    sphereRenderer.draw(*frame, alpha);     // 全天体をまとめて描く(視錐台の外は描かず、小さい球は点で描く)
+                } else {
+                    for (size_t i = 0; i < frame->bodies.size(); ++i) frame->drawBody(i, alpha);
+                }
+                if (trailRenderer.isReady()) {
+                    trailRenderer.draw(*frame);     // 全天体の軌跡を1回で描く(GPUに置いた点に、書き換わった所だけを書き込む)
+                } else {
+                    for (size_t i = 0; i < frame->bodies.size(); ++i) frame->drawTrajectory(i);
                 }
                 // SwapBuffers(hdc); // 描画内容を画面に反映
 
@@ -243,7 +288,7 @@ std::cout << "WM_PAINT" << std::endl;
                 glLoadIdentity(); // 単位行列をロードしてモデルビュー行列を初期化
 
                     // シミュレーション時間をフォーマットしたものをstring型のテキストとして作成
-                    std::chrono::system_clock::time_point tp = universe.getSimulationTime_tp();
+                    std::chrono::system_clock::time_point tp = frame->simulationTime_tp;
                     std::tm *tm = maketm_from_timepoint(tp);
                     std::string currentTime = std::to_string(tm->tm_year+1900) + "/" + std::to_string(tm->tm_mon+1) + "/" + std::to_string(tm->tm_mday) + " " + std::to_string(tm->tm_hour) + ":" + std::to_string(tm->tm_min) + ":" + std::to_string(tm->tm_sec);
                     
@@ -254,27 +299,36 @@ std::cout << "WM_PAINT" << std::endl;
                     float linePosition = 0.0;
                     char text[256];
                     snprintf(text, sizeof(text), 
-                        "Scale of distance (/km) : %.2E,  Scale of time (s/s) : %.2E,  Time lapse (s) : %.2E, Current time : %s",
-                        scaling::distance, scaling::time_simu2real, universe.getSimulationTime(), currentTime.c_str()
+                        "Scale of distance (/km) : %.2E,  Scale of time (s/s) : %.2E%s,  Time lapse (s) : %.2E, Current time : %s",
+                        scaling::distance, frame->timeCompression, frame->behind ? " (behind)" : "", frame->simulationTime, currentTime.c_str()
                     );
                     drawText(text, xBuffer, yBuffer + windowHeight-static_cast<int>(linePosition));  // 距離や時間のスケールを画面に表示
                     linePosition += lineHeight;
-                    for (size_t i = 0; i < universe.spheres.size(); ++i) {
+                    if (frame->playback) {
+                        snprintf(text, sizeof(text),
+                            "Replay : %.2E (s) / %.2E (s)  [Left/Right : -/+10 days, Space : resume from here]",
+                            frame->playbackTime, frame->replayEndTime
+                        );
+                        drawText(text, xBuffer, yBuffer + windowHeight-static_cast<int>(linePosition), 1.0f, 1.0f, 0.0f);  // 再生中の時刻を画面に表示
+                        linePosition += lineHeight;
+                    }
+                    for (size_t i = 0; i < frame->bodies.size(); ++i) {
+                        const Frame::Body& body = frame->bodies[i];
                         snprintf(text, sizeof(text), 
                             "%s (Sphere%zu) : ",
-                            universe.spheres[i].name.c_str(),
+                            body.name.c_str(),
                             i + 1
                         );
-                        drawText(text, xBuffer, yBuffer + windowHeight-static_cast<int>(linePosition), universe.spheres[i].color[0], universe.spheres[i].color[1], universe.spheres[i].color[2]);  // 天体の名前を画面に表示
+                        drawText(text, xBuffer, yBuffer + windowHeight-static_cast<int>(linePosition), body.color[0], body.color[1], body.color[2]);  // 天体の名前を画面に表示
                         linePosition += lineHeight;
 
                         snprintf(text, sizeof(text), 
                             "Position(%.2E, %.2E, %.2E)[km], Velocity(%.2E, %.2E, %.2E)[km/s], Mass:%.2E[kg], Radius:%.2E[km]", 
-                            universe.spheres[i].x / scaling::distance, universe.spheres[i].y / scaling::distance, universe.spheres[i].z / scaling::distance, 
-                            universe.spheres[i].vx / scaling::velocity, universe.spheres[i].vy / scaling::velocity, universe.spheres[i].vz / scaling::velocity, 
-                            universe.spheres[i].mass,
-                            universe.spheres[i].radius / scaling::distance
-                            // universe.spheres[i].color[0], universe.spheres[i].color[1], universe.spheres[i].color[2]
+                            body.position[0] / scaling::distance, body.position[1] / scaling::distance, body.position[2] / scaling::distance, 
+                            body.velocity[0] / scaling::velocity, body.velocity[1] / scaling::velocity, body.velocity[2] / scaling::velocity, 
+                            body.mass,
+                            body.radius / scaling::distance
+                            // sphere.color()[0], sphere.color()[1], sphere.color()[2]
                         );
                         drawText(text, xBuffer, yBuffer + windowHeight-static_cast<int>(linePosition));  // 位置・速度・色を画面に表示
                         linePosition += lineHeight;
@@ -343,45 +397,50 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     glEnable(GL_DEPTH_TEST);                   // 深度テストを有効化
     glClearColor(0.01f, 0.01f, 0.01f, 1.0f);      // 背景色を黒に設定
     // glClearColor(1.0f, 1.0f, 1.0f, 1.0f);           // 背景色を白に設定
+    if (gl::load(getGLProcAddress)) {
+        try {
+            sphereRenderer.init();
+        } catch (const std::exception& e) {
+            std::cout << "SphereRenderer: " << e.what() << std::endl;     // 1つずつ描く
+        }
+        try {
+            trailRenderer.init();
+        } catch (const std::exception& e) {
+            std::cout << "TrailRenderer: " << e.what() << std::endl;
+        }
+    } else {
+        std::cout << "OpenGL 3.3 is not available. Spheres and trails are drawn one by one." << std::endl;
+    }
 
 
 
 // Sphereクラスのインスタンス化、天体の初期条件入力-------------------------------------------------------------------------
     const float radiusScaler= 1.0;  // 実際の比にすると星が小さすぎて見えないので、便宜的に半径のみ実際より大きくしたい場合がある。
-    universe.addSphere(Sphere(
-        "Sun", //名前(ワイド文字)
-        0.0f, 0.0f, 0.0f,   //位置(km)
-        0.0f, 0.0f, 0.0f,   //速度(km/s)
-        celestialConstants::solar_mass, // 質量(kg)
-        celestialConstants::solar_radius*radiusScaler,               //半径(km)
-        255.0f, 100.0f, 0.0f,    //rgb(0-255)
-        true    // 光源として扱う
-    ));  // 赤い球
-    universe.addSphere(Sphere(
-        "Earth",   //名前(ワイド文字)
-        celestialConstants::distance_sun_earth, 0.0f, 0.0f,   //位置(km)
-        0.0f, celestialConstants::earth_orbital_speed, 0.0f,  //速度(km/s)
-        celestialConstants::earth_mass,               //質量(kg)
-        celestialConstants::earth_radius*radiusScaler,               //半径(km)
-        69.0f, 130.0f, 181.0f,    //rgb(0-255)
-        false
-    ));
-    universe.addSphere(Sphere(
-        "Moon",   //名前(ワイド文字)
-        celestialConstants::distance_sun_earth+celestialConstants::distance_earth_moon, 0.0f, 0.0f,   //位置(km)
-        0.0f, celestialConstants::earth_orbital_speed+celestialConstants::moon_orbital_speed, 0.0f,  //速度(km/s)
-        celestialConstants::moon_mass,               //質量(kg)
-        celestialConstants::moon_radius*radiusScaler,               //半径(km)
-        190.0f, 190.0f, 190.0f,    //rgb(0-255)
-        false
-    ));
-    // camera.addSphere(&universe.spheres[0]);
-    camera.addSphere(&universe.spheres[1]);
-    camera.addSphere(&universe.spheres[2]);
+    bool resumed = false;
+    if (lpCmdLine && *lpCmdLine) {
+        // 引数にスナップショット(checkpoint.snapなど)を渡すと、その続きから始める
+        try {
+            Snapshot::load(universe, lpCmdLine);
+            resumed = true;
+        } catch (const std::exception& e) {
+            MessageBoxA(hwnd, e.what(), "Snapshot", MB_OK);
+        }
+    }
+    if (!resumed) scenario::addSunEarthMoon(universe, radiusScaler);   // 太陽・地球・月(Scenario.cpp)
+    // camera.addSphere(universe.sphere(0));
+    camera.addSphere(universe.sphere(1));
+    camera.addSphere(universe.sphere(2));
 // Sphereクラスのインスタンス化、天体の初期条件入力-------------------------------------------------------------------------
 
-    // タイマーを設定（16msごとにWM_TIMERメッセージを送信）
-    SetTimer(hwnd, 1, 16, NULL);
+    // ここから先、universeは計算スレッドだけが進める
+    simulation.checkpointer = &checkpointer;
+    simulation.recorder = &recorder;
+    replay.setRecording(recordingPath);    // 記録した時刻の再生は計算し直さず、ファイルのフレームを見せる
+    simulation.replay = &replay;
+    simulation.start();
+
+    // タイマーを設定（frameIntervalごとにWM_TIMERメッセージを送信）
+    SetTimer(hwnd, 1, frameInterval, NULL);
           
     // メッセージループ
     MSG msg = {};
@@ -391,6 +450,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     }
 
     // 後処理
+    simulation.stop();          // 計算スレッドを止める
+    sphereRenderer.destroy();   // コンテキストを消す前に、GPUに作ったものを消す
+    trailRenderer.destroy();
     wglMakeCurrent(NULL, NULL); // レンダリングコンテキストを解除
     wglDeleteContext(glrc);     // レンダリングコンテキストを削除
     ReleaseDC(hwnd, hdc);       // デバイスコンテキストを解放
@@ -405,10 +467,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 // フォーカスする天体を設定できるようにしたい。
 // 地球に月を作る。
 // 公転面の傾きの情報を設定する。
-// Sphereクラスに主星を設定できるメンバを作る。そして、衛星の位置(速度)は主星に対する相対位置(相対速度)でも入力できるようにする。
+// (済)Sphereクラスに主星を設定できるメンバを作る。そして、衛星の位置(速度)は主星に対する相対位置(相対速度)でも入力できるようにする。
 // 星の自転に関する情報も加えたい。自転軸の傾き、自転周期
 // 恒星か惑星かの情報を加えて、恒星は自ら光るようにする
-// ルンゲクッタより精度のよい方法
+// (済)ルンゲクッタより精度のよい方法
 // 時間のすぎる速さについての現実との対応
 // 球面に星の模様をつける
 // (済)クラスの宣言部分と実装を分ける。
\ No newline at end of file
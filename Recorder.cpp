@@ -0,0 +1,386 @@
+// 位置と速度の時系列の書き出し(Recorder)と読み込み(Recording)
+// ファイルの並び: FileHeader、塊(ChunkHeader、時刻の配列、圧縮した値)の繰り返し、索引(IndexEntryの配列)、Footer
+
+#include <algorithm>    // std::upper_bound
+#include <cstring>      // std::memcpy, std::memcmp
+#include <stdexcept>    // std::runtime_error
+
+#include "MappedFile.h"
+#include "Recorder.h"
+#include "Universe.h"
+
+namespace {
+    const char FILE_MAGIC[8] = {'C', 'E', 'L', 'E', 'S', 'T', 'R', 'C'};
+    const char CHUNK_MAGIC[4] = {'C', 'H', 'N', 'K'};
+    const char INDEX_MAGIC[8] = {'C', 'E', 'L', 'E', 'S', 'T', 'I', 'X'};
+    const std::uint32_t ENDIAN_TAG = 0x01020304;
+    const std::uint32_t VERSION = 1;
+    const size_t MAX_QUEUED_CHUNKS = 8;     // 書き込みを待つ塊がこれだけあれば、新しい塊を作らずに書き終わるのを待つ
+
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t endian;
+        std::uint32_t version;
+        std::uint32_t headerBytes;
+        std::uint32_t quantities;
+    };
+    static_assert(sizeof(FileHeader) == 24, "FileHeader must not contain padding");
+
+    struct ChunkHeader {
+        char magic[4];
+        std::uint32_t frames;
+        std::uint64_t bodies;
+        std::uint64_t firstFrame;
+        std::uint64_t payloadBytes;     // 圧縮した値の大きさ(時刻の配列は含まない)
+    };
+    static_assert(sizeof(ChunkHeader) == 32, "ChunkHeader must not contain padding");
+
+    struct Footer {
+        std::uint64_t indexOffset;
+        std::uint64_t chunkCount;
+        std::uint64_t frameCount;
+        char magic[8];
+    };
+    static_assert(sizeof(Footer) == 32, "Footer must not contain padding");
+
+    std::uint32_t floatBits(float value) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float bitsFloat(std::uint32_t bits) {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // 直前の2つのビット列(previous, older)から次を予測する。1つ目は0、2つ目は直前と同じと予測する
+    std::uint32_t predict(size_t f, std::uint32_t previous, std::uint32_t older) {
+        if (f == 0) return 0;
+        if (f == 1) return previous;
+        return 2u * previous - older;   // 符号なしなので桁あふれしても決まった値になる(読むときも同じ計算をする)
+    }
+
+    // 予測との差をジグザグ符号化(0, -1, 1, -2, ... を 0, 1, 2, 3, ... に)して、7ビットずつ書く
+    void putResidual(std::vector<std::uint8_t>& out, std::uint32_t actual, std::uint32_t predicted) {
+        const std::int32_t difference = static_cast<std::int32_t>(actual - predicted);
+        std::uint32_t zigzag = (static_cast<std::uint32_t>(difference) << 1) ^ static_cast<std::uint32_t>(difference >> 31);
+        while (zigzag >= 0x80) {
+            out.push_back(static_cast<std::uint8_t>(zigzag | 0x80));
+            zigzag >>= 7;
+        }
+        out.push_back(static_cast<std::uint8_t>(zigzag));
+    }
+
+    std::uint32_t getResidual(const std::uint8_t*& in, const std::uint8_t* end, std::uint32_t predicted) {
+        std::uint32_t zigzag = 0;
+        for (int shift = 0; ; shift += 7) {
+            if (in == end || shift > 28) throw std::runtime_error("recording: corrupted chunk");
+            const std::uint8_t byte = *in++;
+            zigzag |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        const std::uint32_t difference = (zigzag >> 1) ^ (0u - (zigzag & 1));
+        return predicted + difference;
+    }
+}
+
+Recorder::Recorder(const std::string& path, size_t strideInput, size_t framesPerChunkInput)
+:   stride_(strideInput < 1 ? 1 : strideInput),
+    framesPerChunk_(framesPerChunkInput < 1 ? 1 : framesPerChunkInput),
+    steps_(0),
+    frameCount_(0),
+    file_(path, std::ios::binary | std::ios::trunc),
+    fileOffset_(0),
+    rawBytes_(0),
+    compressedBytes_(0),
+    closed_(false),
+    stop_(false)
+{
+    if (!file_) throw std::runtime_error("cannot create recording: " + path);
+    FileHeader header;
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.endian = ENDIAN_TAG;
+    header.version = VERSION;
+    header.headerBytes = sizeof(FileHeader);
+    header.quantities = QUANTITIES;
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fileOffset_ = sizeof(header);
+    thread_ = std::thread(&Recorder::run, this);
+}
+
+Recorder::~Recorder() {
+    close();
+}
+
+void Recorder::update(const Universe& universe) {
+    if (++steps_ % stride_ == 0) record(universe);
+}
+
+void Recorder::record(const Universe& universe) {
+    if (closed_) return;
+    const BodyStore& bodies = universe.bodies;
+    const size_t n = bodies.size();
+    // 天体数が変わったら塊を区切る
+    if (filling_ && filling_->bodies != n) submit();
+    if (!filling_) {
+        {
+            // 書き込みが追いつかないときは、待っている塊がMAX_QUEUED_CHUNKSになるまでは増やし、それより多くは書き終わるのを待つ
+            std::unique_lock<std::mutex> lock(mutex_);
+            drained_.wait(lock, [this] { return !free_.empty() || queue_.size() < MAX_QUEUED_CHUNKS; });
+            if (!free_.empty()) {
+                filling_ = std::move(free_.back());
+                free_.pop_back();
+            }
+        }
+        if (!filling_) filling_.reset(new Chunk());
+        filling_->bodies = n;
+        filling_->frames = 0;
+        filling_->firstFrame = frameCount_;
+        filling_->values.resize(framesPerChunk_ * QUANTITIES * n);     // 使い回すときは確保し直さない
+        filling_->times.resize(framesPerChunk_);
+    }
+    Chunk& chunk = *filling_;
+    const float* arrays[QUANTITIES] = {bodies.x, bodies.y, bodies.z, bodies.vx, bodies.vy, bodies.vz};
+    float* frame = chunk.values.data() + chunk.frames * QUANTITIES * n;
+    for (int q = 0; q < QUANTITIES; ++q) {
+        std::memcpy(frame + q * n, arrays[q], n * sizeof(float));
+    }
+    chunk.times[chunk.frames] = universe.getSimulationTime();
+    ++chunk.frames;
+    ++frameCount_;
+    if (chunk.frames == framesPerChunk_) submit();
+}
+
+void Recorder::submit() {
+    if (!filling_) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(filling_));
+    }
+    wake_.notify_one();
+}
+
+void Recorder::close() {
+    if (closed_) return;
+    closed_ = true;
+    if (filling_ && filling_->frames > 0) submit();
+    filling_.reset();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+    // 索引と、索引の位置を書いた末尾
+    Footer footer;
+    footer.indexOffset = fileOffset_;
+    footer.chunkCount = index_.size();
+    footer.frameCount = frameCount_;
+    std::memcpy(footer.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    if (!index_.empty()) file_.write(reinterpret_cast<const char*>(index_.data()), index_.size() * sizeof(IndexEntry));
+    file_.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+    file_.close();
+    if (!file_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lastError_ = "cannot write recording index";
+    }
+}
+
+size_t Recorder::getFrameCount() const {
+    return frameCount_;
+}
+
+unsigned long long Recorder::getRawBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rawBytes_;
+}
+
+unsigned long long Recorder::getCompressedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return compressedBytes_;
+}
+
+std::string Recorder::getLastError() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lastError_;
+}
+
+void Recorder::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return;     // stop_で、書くものがない
+        std::unique_ptr<Chunk> chunk = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        writeChunk(*chunk);     // 圧縮と書き込みはロックの外で
+        lock.lock();
+        free_.push_back(std::move(chunk));
+        drained_.notify_one();
+    }
+}
+
+void Recorder::writeChunk(Chunk& chunk) {
+    const size_t n = chunk.bodies;
+    const size_t frames = chunk.frames;
+    // 天体ごと・量ごとに、時間の順に予測との差を書く
+    chunk.encoded.clear();
+    for (int q = 0; q < QUANTITIES; ++q) {
+        for (size_t i = 0; i < n; ++i) {
+            std::uint32_t previous = 0, older = 0;
+            for (size_t f = 0; f < frames; ++f) {
+                const std::uint32_t bits = floatBits(chunk.values[(f * QUANTITIES + q) * n + i]);
+                putResidual(chunk.encoded, bits, predict(f, previous, older));
+                older = previous;
+                previous = bits;
+            }
+        }
+    }
+
+    ChunkHeader header;
+    std::memcpy(header.magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+    header.frames = static_cast<std::uint32_t>(frames);
+    header.bodies = n;
+    header.firstFrame = chunk.firstFrame;
+    header.payloadBytes = chunk.encoded.size();
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file_.write(reinterpret_cast<const char*>(chunk.times.data()), frames * sizeof(double));
+    file_.write(reinterpret_cast<const char*>(chunk.encoded.data()), chunk.encoded.size());
+    file_.flush();  // 書いている途中のファイルを読む再生(Replay, Recording)から、書き終えた塊がすぐ見えるように
+
+    IndexEntry entry;
+    entry.offset = fileOffset_;
+    entry.bytes = sizeof(header) + frames * sizeof(double) + chunk.encoded.size();
+    entry.bodies = n;
+    entry.firstFrame = chunk.firstFrame;
+    entry.frames = static_cast<std::uint32_t>(frames);
+    entry.reserved = 0;
+    entry.firstTime = chunk.times[0];
+    entry.lastTime = chunk.times[frames - 1];
+    index_.push_back(entry);
+    fileOffset_ += entry.bytes;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    rawBytes_ += frames * QUANTITIES * n * sizeof(float);
+    compressedBytes_ += chunk.encoded.size();
+    if (!file_) lastError_ = "cannot write recording";
+}
+
+Recording::Recording(const std::string& path)
+:   file_(new MappedFile(path)),
+    decodedChunk_(0)
+{
+    const char* data = file_->data();
+    const size_t size = file_->size();
+    FileHeader header;
+    if (size < sizeof(FileHeader)) throw std::runtime_error("recording: file is too small");
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) throw std::runtime_error("recording: not a recording file");
+    if (header.endian != ENDIAN_TAG) throw std::runtime_error("recording: written on a machine with a different byte order");
+    if (header.version > VERSION || header.quantities != Recorder::QUANTITIES) throw std::runtime_error("recording: unsupported version");
+
+    // 塊の位置。索引があれば索引から、なければ(索引を書く前に落ちたファイル)塊を前から順にたどって集める
+    std::vector<size_t> offsets;
+    Footer footer;
+    if (size >= header.headerBytes + sizeof(Footer)) std::memcpy(&footer, data + size - sizeof(Footer), sizeof(footer));
+    if (size >= header.headerBytes + sizeof(Footer) && std::memcmp(footer.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0
+        && footer.indexOffset <= size - sizeof(Footer)
+        && footer.chunkCount == (size - sizeof(Footer) - footer.indexOffset) / sizeof(Recorder::IndexEntry)) {
+        for (size_t c = 0; c < footer.chunkCount; ++c) {
+            Recorder::IndexEntry entry;
+            std::memcpy(&entry, data + footer.indexOffset + c * sizeof(entry), sizeof(entry));
+            offsets.push_back(static_cast<size_t>(entry.offset));
+        }
+    } else {
+        size_t offset = header.headerBytes;
+        while (offset + sizeof(ChunkHeader) <= size) {
+            ChunkHeader chunk;
+            std::memcpy(&chunk, data + offset, sizeof(chunk));
+            if (std::memcmp(chunk.magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0) break;
+            const size_t bytes = sizeof(chunk) + chunk.frames * sizeof(double) + chunk.payloadBytes;
+            if (chunk.frames == 0 || bytes > size - offset) break;     // 書きかけの塊
+            offsets.push_back(offset);
+            offset += bytes;
+        }
+    }
+
+    for (size_t offset : offsets) {
+        ChunkHeader chunk;
+        if (offset + sizeof(ChunkHeader) > size) throw std::runtime_error("recording: corrupted index");
+        std::memcpy(&chunk, data + offset, sizeof(chunk));
+        const size_t bytes = sizeof(chunk) + chunk.frames * sizeof(double) + chunk.payloadBytes;
+        if (std::memcmp(chunk.magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0 || bytes > size - offset) throw std::runtime_error("recording: corrupted index");
+        ChunkInfo info;
+        info.offset = offset + sizeof(chunk);
+        info.bytes = bytes - sizeof(chunk);
+        info.bodies = static_cast<size_t>(chunk.bodies);
+        info.frames = chunk.frames;
+        info.firstFrame = times_.size();
+        for (size_t f = 0; f < info.frames; ++f) {
+            double time;
+            std::memcpy(&time, data + info.offset + f * sizeof(double), sizeof(time));
+            times_.push_back(time);
+            frameChunk_.push_back(chunks_.size());
+        }
+        chunks_.push_back(info);
+    }
+    decodedChunk_ = chunks_.size();
+}
+
+Recording::~Recording() {
+}
+
+size_t Recording::getFrameCount() const {
+    return times_.size();
+}
+
+double Recording::getTime(size_t frame) const {
+    return times_[frame];
+}
+
+size_t Recording::getBodyCount(size_t frame) const {
+    return chunks_[frameChunk_[frame]].bodies;
+}
+
+size_t Recording::findFrame(double time) const {
+    // 時刻は増える順に並んでいる
+    auto it = std::upper_bound(times_.begin(), times_.end(), time);
+    return (it == times_.begin()) ? 0 : static_cast<size_t>(it - times_.begin()) - 1;
+}
+
+void Recording::readFrame(size_t frame, BodyStore& bodies) {
+    if (frame >= times_.size()) throw std::out_of_range("Frame out of range");
+    const size_t c = frameChunk_[frame];
+    if (decodedChunk_ != c) decode(c);
+    const ChunkInfo& chunk = chunks_[c];
+    const size_t n = chunk.bodies;
+    if (bodies.size() != n) bodies.resize(n);
+    float* arrays[Recorder::QUANTITIES] = {bodies.x, bodies.y, bodies.z, bodies.vx, bodies.vy, bodies.vz};
+    const float* values = values_.data() + (frame - chunk.firstFrame) * Recorder::QUANTITIES * n;
+    for (int q = 0; q < Recorder::QUANTITIES; ++q) {
+        std::memcpy(arrays[q], values + q * n, n * sizeof(float));
+    }
+}
+
+void Recording::decode(size_t c) {
+    const ChunkInfo& chunk = chunks_[c];
+    const size_t n = chunk.bodies;
+    const size_t frames = chunk.frames;
+    values_.resize(frames * Recorder::QUANTITIES * n);
+    const std::uint8_t* in = reinterpret_cast<const std::uint8_t*>(file_->data() + chunk.offset + frames * sizeof(double));
+    const std::uint8_t* end = reinterpret_cast<const std::uint8_t*>(file_->data() + chunk.offset + chunk.bytes);
+    for (int q = 0; q < Recorder::QUANTITIES; ++q) {
+        for (size_t i = 0; i < n; ++i) {
+            std::uint32_t previous = 0, older = 0;
+            for (size_t f = 0; f < frames; ++f) {
+                const std::uint32_t bits = getResidual(in, end, predict(f, previous, older));
+                values_[(f * Recorder::QUANTITIES + q) * n + i] = bitsFloat(bits);
+                older = previous;
+                previous = bits;
+            }
+        }
+    }
+    decodedChunk_ = c;
+}
@@ -0,0 +1,131 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <condition_variable>   // std::condition_variable
+#include <cstddef>  // size_t
+#include <cstdint>  // std::uint8_t
+#include <deque>    // std::deque
+#include <fstream>  // std::ofstream
+#include <memory>   // std::unique_ptr
+#include <mutex>    // std::mutex
+#include <string>   // std::string
+#include <thread>   // std::thread
+#include <vector>   // std::vector
+
+#include "BodyStore.h"
+
+class Universe;
+class MappedFile;
+
+// 全天体の位置と速度の時系列をファイルに書き出す(あとで解析したり再生したりするため)。
+//
+// strideステップごとに1フレーム(全天体の x, y, z, vx, vy, vz とシミュレーション時刻)を記録し、framesPerChunkフレームを1つの塊(chunk)にまとめる。
+// update()はフレームをメモリにコピーするだけで、圧縮とファイルへの書き込みは別のスレッドが行う。
+// 塊の領域は使い回す(ふだんは2つの領域を交互に使う二重バッファになる)。書き込みが追いつかないときは領域を増やすが、
+// 書き込みを待つ塊が一定の数(Recorder.cppのMAX_QUEUED_CHUNKS)を超えるときは、update()が書き終わるのを待つ。
+// 塊は書くたびにフラッシュするので、書いている途中のファイルも書き終えた塊までは読める。
+//
+// 圧縮: 天体ごと・量ごとの時系列について、floatのビット列を整数とみなして、直前の2つから直線で予測した値との差を
+// ジグザグ符号化して可変長(7ビットずつ)で書く。なめらかな軌道なら差は小さく、1つの値が1〜3バイトになる。損失はない。
+//
+// ファイルの最後に塊の索引(時刻と位置)を書くので、Recordingで時刻から任意のフレームを読める。
+// 索引を書く前に落ちたファイルも、塊を前から順にたどって読める。
+class Recorder {
+    friend class Recording;     // 索引の形式(IndexEntry)を共有する
+public:
+    static const int QUANTITIES = 6;    // 1天体あたりの量(x, y, z, vx, vy, vz)
+
+    Recorder(const std::string& path, size_t strideInput = 1, size_t framesPerChunkInput = 64);    // 開けないときはstd::runtime_errorを投げる
+    ~Recorder();    // close()する
+
+    void update(const Universe& universe);  // Universe::update()の後に毎回呼ぶ。strideステップ目ごとに記録する
+    void record(const Universe& universe);  // 今の状態を1フレーム記録する
+    void close();   // 残りの塊と索引を書いてファイルを閉じる
+
+    size_t getFrameCount() const;           // 記録したフレームの数
+    unsigned long long getRawBytes() const;         // 圧縮前の大きさ(書き終えた塊の分)
+    unsigned long long getCompressedBytes() const;  // 圧縮後の大きさ(同上)
+    std::string getLastError() const;
+
+private:
+    // 1つの塊。フレームごとに量ごとの配列を並べる(values[(f * QUANTITIES + q) * bodies + i])
+    struct Chunk {
+        size_t bodies;
+        size_t frames;
+        size_t firstFrame;
+        std::vector<float> values;
+        std::vector<double> times;
+        std::vector<std::uint8_t> encoded;
+    };
+    // 索引の1項目
+    struct IndexEntry {
+        std::uint64_t offset;
+        std::uint64_t bytes;
+        std::uint64_t bodies;
+        std::uint64_t firstFrame;
+        std::uint32_t frames;
+        std::uint32_t reserved;
+        double firstTime;
+        double lastTime;
+    };
+
+    size_t stride_;
+    size_t framesPerChunk_;
+    size_t steps_;          // update()の回数
+    size_t frameCount_;
+    std::unique_ptr<Chunk> filling_;    // update()が書き込んでいる塊
+
+    std::ofstream file_;
+    std::vector<IndexEntry> index_;
+    unsigned long long fileOffset_;
+    unsigned long long rawBytes_;
+    unsigned long long compressedBytes_;
+    std::string lastError_;
+    bool closed_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable drained_;   // 書き込みスレッドが塊を書き終えてfree_に戻した
+    std::deque<std::unique_ptr<Chunk>> queue_;      // 書き込みを待っている塊
+    std::vector<std::unique_ptr<Chunk>> free_;      // 書き終えて使い回せる塊
+    bool stop_;
+    std::thread thread_;
+
+    void submit();      // filling_を書き込みスレッドに渡す
+    void run();
+    void writeChunk(Chunk& chunk);
+};
+
+// Recorderが書いたファイルを読む。ファイルはメモリに写像し、フレームは塊ごとに展開する(直前に展開した塊は覚えておく)
+class Recording {
+public:
+    explicit Recording(const std::string& path);     // 形式が違うときはstd::runtime_errorを投げる
+    ~Recording();
+
+    size_t getFrameCount() const;
+    double getTime(size_t frame) const;     // フレームのシミュレーション時刻
+    size_t getBodyCount(size_t frame) const;
+    size_t findFrame(double time) const;    // 時刻がtime以下で一番新しいフレーム(timeが最初より前なら0)
+    // フレームの位置と速度をbodiesのx..vzに書き込む(天体数もそろえる。加速度とG*mは変えない)
+    void readFrame(size_t frame, BodyStore& bodies);
+
+private:
+    struct ChunkInfo {
+        size_t offset;      // 塊の中身(時刻の配列)の位置
+        size_t bytes;
+        size_t bodies;
+        size_t frames;
+        size_t firstFrame;
+    };
+
+    std::unique_ptr<MappedFile> file_;
+    std::vector<ChunkInfo> chunks_;
+    std::vector<double> times_;         // 全フレームの時刻
+    std::vector<size_t> frameChunk_;    // フレームが入っている塊
+    size_t decodedChunk_;               // values_に展開してある塊(なければchunks_.size())
+    std::vector<float> values_;
+
+    void decode(size_t chunk);
+};
+
+#endif
@@ -0,0 +1,169 @@
+// 巻き戻し・早送りのための履歴
+
+#include <algorithm>    // std::upper_bound
+#include <cstdio>       // std::remove
+#include <stdexcept>    // std::exception
+#include <string>       // std::to_string
+
+#include "Recorder.h"
+#include "Replay.h"
+#include "Snapshot.h"
+#include "Universe.h"
+
+Replay::Replay(double keyframeIntervalInput, const std::string& directoryInput)
+:   keyframeInterval_(keyframeIntervalInput),
+    directory_(directoryInput),
+    nextKeyframeTime_(0.0),
+    furthestTime_(0.0),
+    position_(0),
+    onHistory_(false),
+    replayedSteps_(0),
+    shownTime_(0.0)
+{
+}
+
+Replay::~Replay() {
+    clear();
+}
+
+bool Replay::update(const Universe& universe, float dt) {
+    const double time = universe.getSimulationTime();
+    if (keyframes_.empty() || !onHistory_) {
+        // 履歴の始まり(show()の後にseek()せずに進めたときも、どこから来たか分からないので始め直す)
+        clear();
+        addKeyframe(universe);
+        position_ = 0;
+        onHistory_ = true;
+        const bool extended = time > furthestTime_;
+        if (extended) furthestTime_ = time;
+        return extended;
+    }
+    if (position_ < steps_.size()) truncate(position_);     // 過去から進め直した
+
+    steps_.push_back(dt);
+    times_.push_back(time);
+    position_ = steps_.size();
+    if (time >= nextKeyframeTime_) addKeyframe(universe);
+
+    const bool extended = time > furthestTime_;
+    if (extended) furthestTime_ = time;
+    return extended;
+}
+
+void Replay::clear() {
+    for (const Keyframe& keyframe : keyframes_) {
+        if (!keyframe.path.empty()) std::remove(keyframe.path.c_str());
+    }
+    keyframes_.clear();
+    steps_.clear();
+    times_.clear();
+    position_ = 0;
+    onHistory_ = false;
+}
+
+double Replay::getStartTime() const {
+    return keyframes_.empty() ? 0.0 : keyframes_.front().time;
+}
+
+double Replay::getEndTime() const {
+    if (keyframes_.empty()) return 0.0;
+    return times_.empty() ? keyframes_.front().time : times_.back();
+}
+
+size_t Replay::getKeyframeCount() const {
+    return keyframes_.size();
+}
+
+size_t Replay::getStepCount() const {
+    return steps_.size();
+}
+
+size_t Replay::getReplayedStepCount() const {
+    return replayedSteps_;
+}
+
+bool Replay::seek(Universe& universe, double time) {
+    if (keyframes_.empty()) return false;
+    // 目的のステップ: 後の時刻がtime以下のステップの数
+    const size_t target = static_cast<size_t>(std::upper_bound(times_.begin(), times_.end(), time) - times_.begin());
+    // それより前で一番新しいキーフレーム(キーフレームはstepの順に並んでいる)
+    size_t k = keyframes_.size() - 1;
+    while (k > 0 && keyframes_[k].step > target) --k;
+
+    // 今の状態がキーフレームと目的の間にあれば、戻さずにそのまま進める(早送り)。
+    // ただし内部の状態をキーフレームに持たない方法は、今の状態から進めた値とキーフレームからやり直した値が違うので、いつも戻す
+    const bool keyframeHoldsState = universe.integrationMethod != IntegrationMethod::DOPRI5
+        && universe.integrationMethod != IntegrationMethod::Hermite && universe.integrationMethod != IntegrationMethod::IAS15;
+    if (!keyframeHoldsState || !onHistory_ || position_ > target || position_ < keyframes_[k].step) {
+        restore(universe, keyframes_[k]);
+        position_ = keyframes_[k].step;
+    }
+    replayedSteps_ = target - position_;
+    for (; position_ < target; ++position_) {
+        universe.update(steps_[position_]);
+    }
+    onHistory_ = true;
+    return true;
+}
+
+void Replay::setRecording(const std::string& path) {
+    recordingPath_ = path;
+    recording_.reset();
+}
+
+bool Replay::show(Universe& universe, double time) {
+    if (recordingPath_.empty()) return false;
+    // 書き込み中のファイルなので、欲しいフレームがまだなければ開き直す
+    if (!recording_ || recording_->getFrameCount() == 0
+        || time > recording_->getTime(recording_->getFrameCount() - 1)) {
+        try {
+            recording_.reset(new Recording(recordingPath_));
+        } catch (const std::exception&) {
+            recording_.reset();
+            return false;
+        }
+    }
+    if (recording_->getFrameCount() == 0 || time < recording_->getTime(0)) return false;
+    const size_t frame = recording_->findFrame(time);
+    if (recording_->getBodyCount(frame) != universe.bodies.size()) return false;
+    recording_->readFrame(frame, universe.bodies);
+    shownTime_ = recording_->getTime(frame);
+    onHistory_ = false;
+    return true;
+}
+
+double Replay::getShownTime() const {
+    return shownTime_;
+}
+
+void Replay::addKeyframe(const Universe& universe) {
+    Keyframe keyframe;
+    keyframe.time = universe.getSimulationTime();
+    keyframe.step = steps_.size();
+    Snapshot::capture(universe, keyframe.image);
+    if (!directory_.empty()) {
+        keyframe.path = directory_ + "/keyframe_" + std::to_string(keyframes_.size()) + ".snap";
+        Snapshot::write(keyframe.image, keyframe.path);
+        std::vector<char>().swap(keyframe.image);
+    }
+    keyframes_.push_back(std::move(keyframe));
+    nextKeyframeTime_ = keyframes_.back().time + keyframeInterval_;
+}
+
+void Replay::truncate(size_t step) {
+    steps_.resize(step);
+    times_.resize(step);
+    while (keyframes_.size() > 1 && keyframes_.back().step > step) {
+        if (!keyframes_.back().path.empty()) std::remove(keyframes_.back().path.c_str());
+        keyframes_.pop_back();
+    }
+    nextKeyframeTime_ = keyframes_.back().time + keyframeInterval_;
+}
+
+void Replay::restore(Universe& universe, const Keyframe& keyframe) const {
+    if (keyframe.path.empty()) {
+        Snapshot::restore(universe, keyframe.image.data(), keyframe.image.size());
+    } else {
+        Snapshot::load(universe, keyframe.path);
+    }
+}
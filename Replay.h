@@ -0,0 +1,77 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstddef>  // size_t
+#include <memory>   // std::unique_ptr
+#include <string>   // std::string
+#include <vector>   // std::vector
+
+class Universe;
+class Recording;
+
+// 過去のシミュレーション時刻に戻って見直すための履歴(巻き戻し・早送り)。
+//
+// update()で毎ステップのdtを記録し、keyframeInterval秒(シミュレーション時間)ごとにスナップショット(キーフレーム)をとる。
+// seek()は目的の時刻より前で一番近いキーフレームから状態を戻し、記録したdtで同じようにupdate()し直して目的の時刻まで進める。
+// Euler〜PEFRLとWisdom–Holman法なら、戻した状態は最初に計算したときとビット単位で同じになる(キーフレームに状態をすべて持つ)。
+// DOPRI5, Hermite法, IAS15は内部の状態をキーフレームに持たないので、キーフレームからやり直した近い値になる。
+// この3つは今の状態から早送りせず、いつもキーフレームからやり直すので、何度seek()しても同じ値になる。
+//
+// 再生(show())は計算し直さず、Recorderが書いたファイルのフレームをbodiesに写すだけ。
+// show()の後はbodiesと積分の状態が合わないので、計算を続ける前にseek()すること。
+//
+// キーフレームはふだんはメモリに置く。directoryを指定するとそこにファイルとして書き、メモリには持たない。
+class Replay {
+public:
+    explicit Replay(double keyframeIntervalInput, const std::string& directoryInput = "");
+    ~Replay();      // directoryに書いたキーフレームは消す
+
+    // Universe::update(dt)の後に毎回呼ぶ。最初の呼び出しで履歴を始める。
+    // 過去にseek()した後に呼ぶと、そこから先の履歴を捨てて新しく記録し直す。
+    // これまでに記録した一番先の時刻より進んだときにtrueを返す(Recorderに渡すフレームを重ねないため)
+    bool update(const Universe& universe, float dt);
+    void clear();   // 履歴を捨てる(天体を足したり読み込んだりしたとき)
+
+    double getStartTime() const;    // seek()できる範囲(履歴がなければ0)
+    double getEndTime() const;
+    size_t getKeyframeCount() const;
+    size_t getStepCount() const;
+    size_t getReplayedStepCount() const;    // 最後のseek()で計算し直したステップ数
+
+    // 時刻time以下で一番新しい記録済みのステップまで戻す(範囲の外なら端に合わせる)。履歴がなければfalse
+    bool seek(Universe& universe, double time);
+
+    void setRecording(const std::string& path);     // show()で使うRecorderのファイル
+    // 時刻time以下で一番新しい記録済みのフレームの位置と速度をuniverse.bodiesに写す。フレームがなければfalse
+    bool show(Universe& universe, double time);
+    double getShownTime() const;    // 最後にshow()したフレームの時刻
+
+private:
+    struct Keyframe {
+        double time;
+        size_t step;        // このキーフレームの次に行うステップ(steps_の添字)
+        std::vector<char> image;
+        std::string path;   // directoryに書いたときのファイル名
+    };
+
+    double keyframeInterval_;
+    std::string directory_;
+    std::vector<Keyframe> keyframes_;
+    std::vector<float> steps_;      // 各ステップのdt
+    std::vector<double> times_;     // 各ステップの後の時刻
+    double nextKeyframeTime_;
+    double furthestTime_;           // これまでに記録した一番先の時刻
+    size_t position_;               // universeが今いるステップ(onHistory_のとき)
+    bool onHistory_;                // universeが履歴の上にいるか(show()の後はfalse)
+    size_t replayedSteps_;
+
+    std::string recordingPath_;
+    std::unique_ptr<Recording> recording_;
+    double shownTime_;
+
+    void addKeyframe(const Universe& universe);
+    void truncate(size_t step);     // stepより後の履歴を捨てる
+    void restore(Universe& universe, const Keyframe& keyframe) const;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include <cmath>    // std::sqrt, std::cos, std::sin, std::pow
+#include <vector>   // std::vector
+#include <random>   // std::mt19937
+#include <string>   // std::to_string
+
+#include "Scenario.h"
+#include "Constants.h"
+
+namespace scenario {
+
+void addSunEarthMoon(Universe& universe, float radiusScaler) {
+    universe.addSphere(
+        "Sun", //名前(ワイド文字)
+        0.0f, 0.0f, 0.0f,   //位置(km)
+        0.0f, 0.0f, 0.0f,   //速度(km/s)
+        celestialConstants::solar_mass, // 質量(kg)
+        celestialConstants::solar_radius*radiusScaler,               //半径(km)
+        255.0f, 100.0f, 0.0f,    //rgb(0-255)
+        true    // 光源として扱う
+    );  // 赤い球
+    Sphere earth = universe.addSphere(
+        "Earth",   //名前(ワイド文字)
+        celestialConstants::distance_sun_earth, 0.0f, 0.0f,   //位置(km)
+        0.0f, celestialConstants::earth_orbital_speed, 0.0f,  //速度(km/s)
+        celestialConstants::earth_mass,               //質量(kg)
+        celestialConstants::earth_radius*radiusScaler,               //半径(km)
+        69.0f, 130.0f, 181.0f,    //rgb(0-255)
+        false
+    );
+    universe.addSphere(
+        "Moon",   //名前(ワイド文字)
+        celestialConstants::distance_earth_moon, 0.0f, 0.0f,   //地球からの相対位置(km)
+        0.0f, celestialConstants::moon_orbital_speed, 0.0f,  //地球に対する相対速度(km/s)
+        celestialConstants::moon_mass,               //質量(kg)
+        celestialConstants::moon_radius*radiusScaler,               //半径(km)
+        190.0f, 190.0f, 190.0f,    //rgb(0-255)
+        false,
+        earth.index()   // 主星は地球
+    );
+}
+
+void addAsteroidBelt(Universe& universe, size_t count, unsigned int seed) {
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float> radiusAU(2.1f, 3.3f);     // 軌道半径(天文単位)
+    std::uniform_real_distribution<float> angle(0.0f, 2.0f * static_cast<float>(M_PI));
+    std::normal_distribution<float> inclination(0.0f, 0.05f);       // 軌道傾斜角(rad)
+    std::uniform_real_distribution<float> logMass(15.0f, 20.0f);    // 質量(kg)の常用対数
+
+    // 円軌道の速さ v = sqrt(G*M/r) 。Gの単位は m^3なので km^3 にするため1e-9を掛ける
+    const double gmSun = 1e-9 * static_cast<double>(celestialConstants::G) * celestialConstants::solar_mass;   // km^3/s^2
+    for (size_t k = 0; k < count; ++k) {
+        float r = radiusAU(engine) * celestialConstants::distance_sun_earth;   // km
+        float phi = angle(engine);
+        float inc = inclination(engine);
+        float node = angle(engine);
+        float v = static_cast<float>(std::sqrt(gmSun / r));
+        // 軌道面内の位置と速度を、昇交点(node)のまわりにincだけ傾ける
+        float px = r * std::cos(phi), py = r * std::sin(phi);
+        float vxp = -v * std::sin(phi), vyp = v * std::cos(phi);
+        float cn = std::cos(node), sn = std::sin(node), ci = std::cos(inc), si = std::sin(inc);
+        auto rotate = [&](float a, float b, float& outX, float& outY, float& outZ) {
+            float u = a * cn + b * sn;      // 昇交点方向の成分
+            float w = -a * sn + b * cn;     // それに垂直な成分(これを傾ける)
+            outX = u * cn - w * ci * sn;
+            outY = u * sn + w * ci * cn;
+            outZ = w * si;
+        };
+        float x, y, z, vx, vy, vz;
+        rotate(px, py, x, y, z);
+        rotate(vxp, vyp, vx, vy, vz);
+        universe.addSphere(
+            "Asteroid" + std::to_string(k + 1),
+            x, y, z,
+            vx, vy, vz,
+            std::pow(10.0f, logMass(engine)),
+            100.0f,
+            150.0f, 140.0f, 130.0f,
+            false
+        );
+    }
+}
+
+double addKeplerPair(Universe& universe, double eccentricity) {
+    const double m1 = celestialConstants::solar_mass, m2 = celestialConstants::earth_mass;
+    const double gm = 1e-9 * static_cast<double>(celestialConstants::G) * (m1 + m2);  // km^3/s^2
+    const double a = celestialConstants::distance_sun_earth;                         // km
+    // 近日点での相対位置と相対速度(vis-viva)
+    const double r = a * (1.0 - eccentricity);
+    const double v = std::sqrt(gm * (1.0 + eccentricity) / r);
+    const double f1 = m2 / (m1 + m2), f2 = m1 / (m1 + m2);     // 重心からの距離の割合
+    universe.addSphere("Star", static_cast<float>(-f1 * r), 0.0f, 0.0f, 0.0f, static_cast<float>(-f1 * v), 0.0f,
+                       static_cast<float>(m1), celestialConstants::solar_radius, 255.0f, 100.0f, 0.0f, true);
+    universe.addSphere("Planet", static_cast<float>(f2 * r), 0.0f, 0.0f, 0.0f, static_cast<float>(f2 * v), 0.0f,
+                       static_cast<float>(m2), celestialConstants::earth_radius, 69.0f, 130.0f, 181.0f, false);
+    return 2.0 * M_PI * std::sqrt(a * a * a / gm);
+}
+
+double addFigureEight(Universe& universe) {
+    // G = m = 1 の単位での初期条件と周期
+    const double x1 = 0.97000436, y1 = -0.24308753;
+    const double vx3 = -0.93240737, vy3 = -0.86473146;
+    const double period = 6.32591398;
+    // 長さの単位L = 1天文単位、質量の単位M = 太陽の質量のとき、時間の単位は sqrt(L^3 / (G M))
+    const double length = celestialConstants::distance_sun_earth;
+    const double gm = 1e-9 * static_cast<double>(celestialConstants::G) * celestialConstants::solar_mass;
+    const double time = std::sqrt(length * length * length / gm);
+    const double velocity = length / time;
+    const double state[3][4] = {
+        {x1, y1, -0.5 * vx3, -0.5 * vy3},
+        {-x1, -y1, -0.5 * vx3, -0.5 * vy3},
+        {0.0, 0.0, vx3, vy3}
+    };
+    const float colors[3][3] = {{255.0f, 100.0f, 100.0f}, {100.0f, 255.0f, 100.0f}, {100.0f, 100.0f, 255.0f}};
+    for (int k = 0; k < 3; ++k) {
+        universe.addSphere("Body" + std::to_string(k + 1),
+                           static_cast<float>(state[k][0] * length), static_cast<float>(state[k][1] * length), 0.0f,
+                           static_cast<float>(state[k][2] * velocity), static_cast<float>(state[k][3] * velocity), 0.0f,
+                           celestialConstants::solar_mass, celestialConstants::solar_radius,
+                           colors[k][0], colors[k][1], colors[k][2], true);
+    }
+    return period * time;
+}
+
+double addPlummer(Universe& universe, size_t count, unsigned int seed) {
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<double> state(count * 6);
+    double center[6] = {};
+    for (size_t k = 0; k < count; ++k) {
+        // 半径: 累積質量 X = r^3 / (1 + r^2)^(3/2) を逆に解く(外側の極端に遠い星は引き直す)
+        double r;
+        do {
+            r = 1.0 / std::sqrt(std::pow(uniform(engine), -2.0 / 3.0) - 1.0);
+        } while (r > 10.0);
+        // 速さ: 脱出速度との比qの分布 q^2 (1 - q^2)^(7/2) から棄却法で選ぶ
+        double q, g;
+        do {
+            q = uniform(engine);
+            g = 0.1 * uniform(engine);
+        } while (g > q * q * std::pow(1.0 - q * q, 3.5));
+        const double v = q * std::sqrt(2.0) * std::pow(1.0 + r * r, -0.25);
+        // 向きはどちらも等方的に選ぶ
+        for (int part = 0; part < 2; ++part) {
+            const double length = part == 0 ? r : v;
+            const double cosTheta = 2.0 * uniform(engine) - 1.0;
+            const double sinTheta = std::sqrt(1.0 - cosTheta * cosTheta);
+            const double phi = 2.0 * M_PI * uniform(engine);
+            double* out = &state[k * 6 + part * 3];
+            out[0] = length * sinTheta * std::cos(phi);
+            out[1] = length * sinTheta * std::sin(phi);
+            out[2] = length * cosTheta;
+        }
+        // Plummerの単位(スケール長1)からN体単位へ
+        const double scale = 3.0 * M_PI / 16.0;
+        for (int q3 = 0; q3 < 3; ++q3) {
+            state[k * 6 + q3] *= scale;
+            state[k * 6 + 3 + q3] /= std::sqrt(scale);
+        }
+        for (int q6 = 0; q6 < 6; ++q6) center[q6] += state[k * 6 + q6] / count;
+    }
+
+    const double length = 1000.0 * celestialConstants::distance_sun_earth;
+    const double gm = 1e-9 * static_cast<double>(celestialConstants::G) * celestialConstants::solar_mass * count;
+    const double time = std::sqrt(length * length * length / gm);
+    const double velocity = length / time;
+    for (size_t k = 0; k < count; ++k) {
+        const double* s = &state[k * 6];
+        universe.addSphere("Star" + std::to_string(k + 1),
+                           static_cast<float>((s[0] - center[0]) * length), static_cast<float>((s[1] - center[1]) * length),
+                           static_cast<float>((s[2] - center[2]) * length),
+                           static_cast<float>((s[3] - center[3]) * velocity), static_cast<float>((s[4] - center[4]) * velocity),
+                           static_cast<float>((s[5] - center[5]) * velocity),
+                           celestialConstants::solar_mass, celestialConstants::solar_radius,
+                           255.0f, 240.0f, 200.0f, true);
+    }
+    return 2.0 * std::sqrt(2.0) * time;
+}
+
+}
@@ -0,0 +1,23 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include "Universe.h"
+
+// 天体の初期条件をまとめたもの。WinMain(描画あり)とtools/Headless.cpp(描画なし)の両方から使う。
+namespace scenario {
+    // 太陽・地球・月。radiusScalerは見た目のためだけに半径を拡大する倍率
+    void addSunEarthMoon(Universe& universe, float radiusScaler = 1.0f);
+    // 太陽のまわりを円軌道で回る小惑星帯(2.1〜3.3天文単位)。同じseedなら同じ配置になる
+    void addAsteroidBelt(Universe& universe, size_t count, unsigned int seed = 1);
+
+    // 以下は積分方法の精度を比べるための典型的な問題。戻り値はその問題の特徴的な時間[s]
+    // 太陽と地球の質量の2体問題。長半径1天文単位、離心率eccentricityで近日点から始め、重心は原点に止まっている。戻り値は公転周期
+    double addKeplerPair(Universe& universe, double eccentricity);
+    // 太陽の質量の3体が8の字を描く周期解(Chenciner & Montgomery 2000)。長さの単位を1天文単位とする。戻り値は周期
+    double addFigureEight(Universe& universe);
+    // 太陽の質量のcount個の星によるPlummer球(Aarseth, Hénon & Wielen 1974の方法)。
+    // N体単位(G = 全質量 = 1, エネルギー -1/4)で作り、長さの単位を1000天文単位とする。重心は原点に止まっている。戻り値は横断時間(N体単位で2√2)
+    double addPlummer(Universe& universe, size_t count, unsigned int seed = 1);
+}
+
+#endif
@@ -0,0 +1,230 @@
+// 描画とは別のスレッドでの計算
+
+#include <algorithm>    // std::min, std::max
+#include <chrono>       // std::chrono::steady_clock
+#include <cmath>        // std::fmod
+#include <utility>      // std::swap
+
+#include "Recorder.h"
+#include "Replay.h"
+#include "Simulation.h"
+#include "Snapshot.h"
+#include "Universe.h"
+
+namespace {
+    // 計算スレッドが起きる間隔の下限と上限[s]。次のステップまでの時間が短くても下限までは待ち(1回に何ステップか進める)、
+    // 長くても上限ごとには起きて時間を貯める
+    const double MIN_TICK = 0.001;
+    const double MAX_TICK = 0.05;
+}
+
+Simulation::Simulation(Universe& universe, double timeCompressionInput, float dtInput, unsigned maxSubstepsInput)
+:   checkpointer(nullptr),
+    recorder(nullptr),
+    replay(nullptr),
+    universe_(universe),
+    dt_(dtInput),
+    timeCompression_(timeCompressionInput),
+    maxSubsteps_(std::max(maxSubstepsInput, 1u)),
+    steps_(0),
+    playback_(false),
+    playbackTime_(0.0),
+    accumulator_(0.0),
+    behind_(false),
+    previousTime_(0.0),
+    stop_(false),
+    scrubRequest_(0.0),
+    scrubRequested_(false),
+    resumeRequested_(false),
+    compressionChanged_(false)
+{
+}
+
+Simulation::~Simulation() {
+    stop();
+}
+
+void Simulation::start() {
+    if (thread_.joinable()) return;
+    stop_ = false;
+    accumulator_ = 0.0;
+    forgetPrevious();
+    publish(std::chrono::steady_clock::now());      // 最初のステップの前から描画できるように
+    thread_ = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+bool Simulation::isRunning() const {
+    return thread_.joinable();
+}
+
+void Simulation::setTimeCompression(double timeCompressionInput) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timeCompression_ = timeCompressionInput;
+    compressionChanged_ = true;     // 遅くしていたときに、長く待ったままにならないように
+    wake_.notify_all();
+}
+
+double Simulation::getTimeCompression() const {
+    return timeCompression_;
+}
+
+void Simulation::setMaxSubsteps(unsigned maxSubstepsInput) {
+    maxSubsteps_ = std::max(maxSubstepsInput, 1u);
+}
+
+unsigned Simulation::getMaxSubsteps() const {
+    return maxSubsteps_;
+}
+
+unsigned long long Simulation::getStepCount() const {
+    return steps_;
+}
+
+const Frame& Simulation::latest() {
+    return frames_.latest();
+}
+
+void Simulation::scrub(double seconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    scrubRequest_ += seconds;
+    scrubRequested_ = true;
+    wake_.notify_all();
+}
+
+void Simulation::resume() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    resumeRequested_ = true;
+    wake_.notify_all();
+}
+
+void Simulation::run() {
+    std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point wakeAt = last;
+    while (true) {
+        double scrub = 0.0;
+        bool scrubRequested = false, resumeRequested = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait_until(lock, wakeAt, [this] { return stop_ || scrubRequested_ || resumeRequested_ || compressionChanged_; });
+            if (stop_) break;
+            compressionChanged_ = false;
+            std::swap(scrub, scrubRequest_);
+            std::swap(scrubRequested, scrubRequested_);
+            std::swap(resumeRequested, resumeRequested_);
+        }
+
+        // 経過した現実の時間をシミュレーション時間にして貯める
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        const double timeCompression = timeCompression_;
+        if (timeCompression > 0.0) accumulator_ += std::chrono::duration<double>(now - last).count() * timeCompression;
+        last = now;
+
+        // 操作を頼まれたときは進めない(キーを押した時刻から再生や計算を始める)
+        bool commanded = false;
+        if (replay && scrubRequested) {
+            if (!playback_) {
+                playback_ = true;
+                playbackTime_ = universe_.getSimulationTime();
+            }
+            showPlayback(playbackTime_ + scrub);
+            commanded = true;
+        }
+        if (replay && resumeRequested && playback_) {
+            replay->seek(universe_, playbackTime_);     // 次のupdate()で、ここから先の履歴は捨てられる
+            playback_ = false;
+            commanded = true;
+        }
+        if (commanded) {
+            accumulator_ = 0.0;
+            forgetPrevious();
+        }
+
+        // 貯まった分だけ決まった刻みで進める。maxSubstepsで追いつかない分は捨てる
+        const unsigned maxSubsteps = maxSubsteps_;
+        unsigned substeps = 0;
+        while (!commanded && accumulator_ >= dt_ && substeps < maxSubsteps) {
+            step();
+            accumulator_ -= dt_;
+            ++substeps;
+        }
+        behind_ = accumulator_ >= dt_;
+        if (behind_) accumulator_ = std::fmod(accumulator_, static_cast<double>(dt_));
+        if (commanded || substeps > 0) publish(now);
+
+        // 次のステップの分が貯まるころに起きる
+        double wait = MAX_TICK;
+        if (timeCompression > 0.0) wait = std::min(std::max((dt_ - accumulator_) / timeCompression, MIN_TICK), MAX_TICK);
+        wakeAt = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(wait));
+    }
+}
+
+void Simulation::step() {
+    // 補間のために進める前の位置を覚えておく
+    const size_t n = universe_.bodies.size();
+    previous_.resize(n * 3);
+    for (size_t i = 0; i < n; ++i) {
+        previous_[i * 3] = universe_.bodies.x[i];
+        previous_[i * 3 + 1] = universe_.bodies.y[i];
+        previous_[i * 3 + 2] = universe_.bodies.z[i];
+    }
+    previousTime_ = playback_ ? playbackTime_ : universe_.getSimulationTime();
+
+    if (playback_) {
+        if (playbackTime_ + dt_ >= replay->getEndTime()) {
+            // 記録の先まで来たら、計算に戻る
+            replay->seek(universe_, replay->getEndTime());
+            playback_ = false;
+            forgetPrevious();
+        } else {
+            showPlayback(playbackTime_ + dt_);
+        }
+        return;
+    }
+    universe_.update(dt_);
+    ++steps_;
+    if (checkpointer) checkpointer->update(universe_);  // 書き込みはCheckpointerのスレッドで行うので、ここでは状態をコピーするだけ
+    // 巻き戻してから進め直した分は記録済み
+    const bool extended = replay ? replay->update(universe_, dt_) : true;
+    if (recorder && extended) recorder->update(universe_);
+}
+
+void Simulation::forgetPrevious() {
+    previous_.clear();
+}
+
+void Simulation::showPlayback(double time) {
+    playbackTime_ = std::min(std::max(time, replay->getStartTime()), replay->getEndTime());
+    if (!replay->show(universe_, playbackTime_)) replay->seek(universe_, playbackTime_);
+}
+
+void Simulation::publish(std::chrono::steady_clock::time_point now) {
+    Frame& frame = frames_.back();
+    frame.capture(universe_);
+    frame.step = steps_;
+    frame.playback = playback_;
+    frame.playbackTime = playbackTime_;
+    frame.replayEndTime = replay ? replay->getEndTime() : frame.simulationTime;
+
+    // 時刻は再生中なら再生している時刻で数える
+    const double time = playback_ ? playbackTime_ : frame.simulationTime;
+    if (previous_.size() == frame.bodies.size() * 3 && time > previousTime_) {
+        for (size_t i = 0; i < frame.bodies.size(); ++i) {
+            frame.setPreviousPosition(i, previous_.data() + i * 3);
+        }
+        frame.previousTime = frame.simulationTime - (time - previousTime_);
+    }
+    frame.presentTime = frame.simulationTime + accumulator_;
+    frame.publishedAt = now;
+    frame.timeCompression = timeCompression_;
+    frame.behind = behind_;
+    frames_.publish();
+}
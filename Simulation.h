@@ -0,0 +1,92 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <atomic>               // std::atomic
+#include <chrono>               // std::chrono::steady_clock
+#include <condition_variable>   // std::condition_variable
+#include <mutex>                // std::mutex
+#include <thread>               // std::thread
+#include <vector>               // std::vector
+
+#include "Frame.h"
+#include "TripleBuffer.h"
+
+class Universe;
+class Checkpointer;
+class Recorder;
+class Replay;
+
+// Universeを描画とは別のスレッドで進める。
+//
+// 計算スレッドは経過した現実の時間に時間の圧縮率(現実の1秒あたりのシミュレーション時間)を掛けて貯め(accumulator)、
+// 貯まった分だけ決まった刻みdtでupdate(dt)する。刻みは変えないので、圧縮率を変えても積分の精度は変わらない。
+// 1回に進めるステップ数はmaxSubstepsまでで、それでも追いつかない分は捨てる(計算が重いときに遅れが際限なく貯まらないように)。
+// そのときはFrame::behindが立ち、実際の圧縮率は目標より小さくなる。
+//
+// 進めるたびに状態をFrameに写してTripleBufferで渡す。Frameには直前のステップの位置も入れるので、
+// 描画スレッドはFrame::interpolation()で自分の時刻に合わせて2つのステップの間を補間して描ける(1ステップ分遅れて見える)。
+// 描画スレッドはlatest()で一番新しいFrameを待たずに受け取るので、描画が遅くても計算は止まらず、計算が重くても描画は止まらない。
+//
+// start()してからstop()するまで、universeと、checkpointer, recorder, replayは計算スレッドだけが触る。
+// ほかのスレッドからはlatest()のFrameを読み、巻き戻しなどの操作はscrub(), resume()で頼む(次のステップの前に行われる)。
+class Simulation {
+public:
+    Checkpointer* checkpointer;     // ステップごとにupdate()するもの。使わなければnullptr。start()の前に設定する
+    Recorder* recorder;
+    Replay* replay;                 // scrub()とresume()に使う
+
+    Simulation(Universe& universe, double timeCompressionInput, float dtInput, unsigned maxSubstepsInput = 256);
+    ~Simulation();      // 計算スレッドを止める
+
+    void start();       // 今の状態をFrameに写してから計算スレッドを始める
+    void stop();        // 今のステップが終わるのを待って止める
+    bool isRunning() const;
+
+    void setTimeCompression(double timeCompressionInput);   // 現実の1秒あたりのシミュレーション時間[s/s]。0以下なら止める
+    double getTimeCompression() const;
+    void setMaxSubsteps(unsigned maxSubstepsInput);         // 1回に進める最大のステップ数(1以上)
+    unsigned getMaxSubsteps() const;
+    unsigned long long getStepCount() const;    // 計算スレッドが進めたステップ数
+
+    // 計算スレッドが最後に渡したFrame。待たない。次にlatest()を呼ぶまで中身は変わらない(描画スレッド1つだけから呼ぶ)
+    const Frame& latest();
+
+    // 再生中の時刻を seconds だけずらす(再生中でなければ今の時刻から再生を始める)。記録したフレームがなければキーフレームから計算し直して見せる
+    void scrub(double seconds);
+    // 再生中の時刻から計算を続ける(そこから先の履歴は捨てる)
+    void resume();
+
+private:
+    Universe& universe_;
+    float dt_;
+    std::atomic<double> timeCompression_;
+    std::atomic<unsigned> maxSubsteps_;
+    std::atomic<unsigned long long> steps_;
+    TripleBuffer<Frame> frames_;
+
+    // 計算スレッドだけが触る
+    bool playback_;
+    double playbackTime_;
+    double accumulator_;            // まだ進めていないシミュレーション時間[s]
+    bool behind_;                   // 直前にmaxSubstepsを超えて時間を捨てたか
+    std::vector<float> previous_;   // 直前のステップの前の位置(xyzの並び)
+    double previousTime_;           // そのときのシミュレーション時刻
+
+    // 描画スレッドからの頼みごと(mutex_で守る)
+    std::mutex mutex_;
+    std::condition_variable wake_;      // 待っている計算スレッドを起こす(止めるとき、操作を頼んだとき、圧縮率を変えたとき)
+    bool stop_;
+    double scrubRequest_;   // まだ行っていないscrub()の合計
+    bool scrubRequested_;
+    bool resumeRequested_;
+    bool compressionChanged_;   // setTimeCompression()の後、計算スレッドが待ち時間を決め直していない
+    std::thread thread_;
+
+    void run();
+    void step();                    // 直前の位置を覚えてから1ステップ進める(再生中なら再生を進める)
+    void forgetPrevious();          // 状態が飛んだ(巻き戻しなど)ので、補間しないように直前の位置を今の位置にする
+    void showPlayback(double time); // 再生する時刻をtimeにする
+    void publish(std::chrono::steady_clock::time_point now);    // 今の状態をFrameに写して渡す。nowはaccumulator_を数えた時刻
+};
+
+#endif
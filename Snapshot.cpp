@@ -0,0 +1,630 @@
+// スナップショットの読み書き
+// 形式はSnapshot.hの説明を参照。ファイルの中の並びはここで定義する構造体(Header, Section, ...)のとおり。
+
+#include <chrono>       // std::chrono
+#include <cstdio>       // std::rename
+#include <cstring>      // std::memcpy, std::memcmp
+#include <fstream>      // std::ofstream
+#include <stdexcept>    // std::runtime_error
+#include <utility>      // std::move
+
+#ifdef _WIN32
+#define NOMINMAX        // std::min/std::maxと衝突させない
+#include <windows.h>    // MoveFileEx
+#endif
+
+#include "MappedFile.h"
+#include "Snapshot.h"
+#include "Universe.h"
+
+namespace {
+    const char MAGIC[8] = {'C', 'E', 'L', 'E', 'S', 'T', 'S', 'N'};
+    const std::uint32_t ENDIAN_TAG = 0x01020304;   // 違うバイト順で読むと 0x04030201 になる
+
+    // ヘッダのflagsのビット
+    enum Flag : std::uint32_t {
+        COMPENSATED_SUMMATION = 1u << 0,
+        LOCAL_FRAMES = 1u << 1,
+        ACCELERATIONS_VALID = 1u << 2,
+        ERROR_VALID = 1u << 3,
+        LOCAL_READY = 1u << 4,
+        LOCAL_ACCELERATIONS_VALID = 1u << 5,
+        PRECISE_READY = 1u << 6,
+        PRECISE_ACCELERATIONS_VALID = 1u << 7,
+        BARNES_HUT_QUADRUPOLE = 1u << 8,
+        WISDOM_HOLMAN_READY = 1u << 9,
+        WISDOM_HOLMAN_JACOBI = 1u << 10     // Wisdom–Holman法の状態がJacobi座標の値
+    };
+
+    // 節の番号。番号は変えないこと(知らない番号は読み飛ばされる)
+    enum SectionId : std::uint32_t {
+        BODIES = 1,             // bodies(floatのarena)
+        BODY_INFO = 2,          // InfoRecordの配列
+        NAMES = 3,              // 名前をつなげたもの
+        PRIMARIES = 4,          // 主星の番号(uint64、なしはUINT64_MAX)
+        TRAJECTORY_POINTS = 5,  // 軌跡の点(TrajectoryStoreの中身そのまま)
+        TRAJECTORY_RINGS = 6,   // RingRecordの配列
+        BODY_ERROR = 7,         // error_(floatのarena)
+        LOCAL = 8,              // local_(floatのarena)
+        LOCAL_ERROR = 9,        // localError_(floatのarena)
+        PRECISE = 10,           // precise_(doubleのarena)
+        PRECISE_ERROR = 11,     // preciseError_(doubleのarena)
+        WISDOM_HOLMAN_ORDER = 12,   // Wisdom–Holman法の内部での天体の並び(uint64)
+        WISDOM_HOLMAN = 13          // Wisdom–Holman法の状態(double)。x, y, z, vx, vy, vz, ax, ay, az の順に天体数ずつ
+    };
+
+    // 大きい型から順に並べて、間に詰め物が入らないようにしてある
+    struct Header {
+        char magic[8];
+        std::uint32_t endian;
+        std::uint32_t version;
+        std::uint32_t headerBytes;      // sizeof(Header)。後ろに項目を足したときに古い読み手が読み飛ばせるように
+        std::uint32_t sectionCount;
+        double simulationTime;          // 補正付きの和の本体と誤差
+        double simulationTimeError;
+        std::int64_t startTimeNanoseconds;  // シミュレーション開始時刻(1970年からのナノ秒)
+        std::uint64_t forceEvaluations;
+        std::uint64_t bodyForceEvaluations;
+        std::uint64_t bodyCount;
+        double gaussRadauEpsilon;
+        std::uint64_t barnesHutLeafSize;
+        std::uint64_t trajectoryCapacity;
+        std::uint64_t trajectoryStride;
+        std::int32_t integrationMethod;
+        std::int32_t precision;
+        std::int32_t forceMethod;
+        std::int32_t wisdomHolmanCoordinates;
+        std::int32_t barnesHutRebuildInterval;
+        std::int32_t trajectorySampling;
+        std::uint32_t flags;
+        float hermiteEta;
+        float adaptiveTolerance;
+        float barnesHutTheta;
+        float trajectoryMinDistance;
+        std::uint32_t reserved;
+    };
+    static_assert(sizeof(Header) == 152, "Header must not contain padding");
+
+    struct Section {
+        std::uint32_t id;
+        std::uint32_t elementBytes;     // BodyStoreの節なら数値1つの大きさ(4か8)、それ以外は要素1つの大きさ
+        std::uint64_t count;            // 要素の数(BodyStoreの節なら天体数)
+        std::uint64_t capacity;         // BodyStoreの節の1配列あたりの要素数
+        std::uint64_t offset;           // ファイルの先頭からの位置
+        std::uint64_t bytes;
+    };
+    static_assert(sizeof(Section) == 40, "Section must not contain padding");
+
+    struct InfoRecord {
+        std::uint64_t nameOffset;       // NAMESの節の中の位置
+        std::uint32_t nameLength;
+        std::uint32_t lightEmission;
+        float mass;
+        float radius;
+        float color[3];
+        float angleTheta;
+        float anglePhi;
+        std::uint32_t reserved;
+    };
+    static_assert(sizeof(InfoRecord) == 48, "InfoRecord must not contain padding");
+
+    struct RingRecord {
+        std::uint64_t head;
+        std::uint64_t count;
+        std::uint64_t steps;
+        float last[3];
+        std::uint32_t committed;
+    };
+    static_assert(sizeof(RingRecord) == 40, "RingRecord must not contain padding");
+
+    const std::uint64_t NO_PRIMARY = ~std::uint64_t(0);
+    const int WISDOM_HOLMAN_ARRAYS = 9;
+
+    size_t alignUp(size_t offset) {
+        return (offset + Snapshot::ALIGNMENT - 1) / Snapshot::ALIGNMENT * Snapshot::ALIGNMENT;
+    }
+
+    // 書き出す節の中身(どこから何バイト)。並びを決めてから一度にimageへコピーする
+    struct Piece {
+        Section section;
+        const void* data;
+    };
+
+    template <typename Real>
+    Piece storePiece(std::uint32_t id, const BasicBodyStore<Real>& store) {
+        Piece piece;
+        piece.section.id = id;
+        piece.section.elementBytes = sizeof(Real);
+        piece.section.count = store.size();
+        piece.section.capacity = store.capacity();
+        piece.section.offset = 0;
+        piece.section.bytes = store.capacity() * BasicBodyStore<Real>::ARRAY_COUNT * sizeof(Real);
+        piece.data = store.arena();
+        return piece;
+    }
+
+    Piece arrayPiece(std::uint32_t id, size_t elementBytes, size_t count, const void* data) {
+        Piece piece;
+        piece.section.id = id;
+        piece.section.elementBytes = static_cast<std::uint32_t>(elementBytes);
+        piece.section.count = count;
+        piece.section.capacity = count;
+        piece.section.offset = 0;
+        piece.section.bytes = elementBytes * count;
+        piece.data = data;
+        return piece;
+    }
+
+    // 節の表を引く。なければnullptr
+    const Section* findSection(const Section* sections, std::uint32_t count, std::uint32_t id) {
+        for (std::uint32_t s = 0; s < count; ++s) {
+            if (sections[s].id == id) return &sections[s];
+        }
+        return nullptr;
+    }
+
+    template <typename Real>
+    bool restoreStore(const char* data, const Section* section, BasicBodyStore<Real>& store, size_t bodyCount) {
+        if (!section) return false;
+        if (section->elementBytes != sizeof(Real) || section->count != bodyCount
+            || section->bytes != section->capacity * BasicBodyStore<Real>::ARRAY_COUNT * sizeof(Real)) {
+            throw std::runtime_error("snapshot: body store section has an unexpected layout");
+        }
+        // arenaと同じ並びなので、まるごと1回コピーするだけ
+        if (!store.assign(reinterpret_cast<const Real*>(data + section->offset), bodyCount, section->capacity)) {
+            throw std::runtime_error("snapshot: body store capacity is not aligned");
+        }
+        return true;
+    }
+}
+
+void Snapshot::capture(const Universe& universe, std::vector<char>& image) {
+    const size_t n = universe.bodies.size();
+
+    // 名前と描画用の情報
+    std::vector<InfoRecord> info(n);
+    std::string names;
+    for (size_t i = 0; i < n; ++i) {
+        const BodyInfo& source = universe.bodyInfo[i];
+        InfoRecord& record = info[i];
+        record.nameOffset = names.size();
+        record.nameLength = static_cast<std::uint32_t>(source.name.size());
+        record.lightEmission = source.lightEmission ? 1 : 0;
+        record.mass = source.mass;
+        record.radius = source.radius;
+        record.color[0] = source.color[0]; record.color[1] = source.color[1]; record.color[2] = source.color[2];
+        record.angleTheta = source.angle_theta;
+        record.anglePhi = source.angle_phi;
+        record.reserved = 0;
+        names += source.name;
+    }
+    std::vector<std::uint64_t> primaries(n);
+    for (size_t i = 0; i < n; ++i) {
+        const size_t p = universe.hierarchy_.primary(i);
+        primaries[i] = (p == Hierarchy::NONE) ? NO_PRIMARY : p;
+    }
+    const TrajectoryStore& trajectories = universe.trajectories;
+    std::vector<RingRecord> rings(trajectories.rings_.size());
+    for (size_t i = 0; i < rings.size(); ++i) {
+        const TrajectoryStore::Ring& ring = trajectories.rings_[i];
+        rings[i].head = ring.head;
+        rings[i].count = ring.count;
+        rings[i].steps = ring.steps;
+        rings[i].last[0] = ring.last[0]; rings[i].last[1] = ring.last[1]; rings[i].last[2] = ring.last[2];
+        rings[i].committed = ring.committed ? 1 : 0;
+    }
+
+    // Wisdom–Holman法の状態(続きをビット単位で同じに計算できるように)
+    const WisdomHolman& wisdomHolman = universe.wisdomHolman;
+    const bool wisdomHolmanReady = universe.wisdomHolmanReady_ && wisdomHolman.size() == n;
+    std::vector<std::uint64_t> wisdomHolmanOrder;
+    std::vector<double> wisdomHolmanState;
+    if (wisdomHolmanReady) {
+        wisdomHolmanOrder.assign(wisdomHolman.order_.begin(), wisdomHolman.order_.end());
+        const std::vector<double>* const arrays[WISDOM_HOLMAN_ARRAYS] = {
+            &wisdomHolman.x_, &wisdomHolman.y_, &wisdomHolman.z_, &wisdomHolman.vx_, &wisdomHolman.vy_, &wisdomHolman.vz_,
+            &wisdomHolman.ax_, &wisdomHolman.ay_, &wisdomHolman.az_};
+        wisdomHolmanState.reserve(WISDOM_HOLMAN_ARRAYS * n);
+        for (const std::vector<double>* array : arrays) wisdomHolmanState.insert(wisdomHolmanState.end(), array->begin(), array->end());
+    }
+
+    std::vector<Piece> pieces;
+    pieces.push_back(storePiece(BODIES, universe.bodies));
+    pieces.push_back(arrayPiece(BODY_INFO, sizeof(InfoRecord), n, info.data()));
+    pieces.push_back(arrayPiece(NAMES, 1, names.size(), names.data()));
+    pieces.push_back(arrayPiece(PRIMARIES, sizeof(std::uint64_t), n, primaries.data()));
+    pieces.push_back(arrayPiece(TRAJECTORY_POINTS, sizeof(float), trajectories.points_.size(), trajectories.points_.data()));
+    pieces.push_back(arrayPiece(TRAJECTORY_RINGS, sizeof(RingRecord), rings.size(), rings.data()));
+    if (universe.errorValid_) pieces.push_back(storePiece(BODY_ERROR, universe.error_));
+    if (universe.localReady_) {
+        pieces.push_back(storePiece(LOCAL, universe.local_));
+        if (universe.localError_.size() == n) pieces.push_back(storePiece(LOCAL_ERROR, universe.localError_));
+    }
+    if (universe.preciseReady_) {
+        pieces.push_back(storePiece(PRECISE, universe.precise_));
+        pieces.push_back(storePiece(PRECISE_ERROR, universe.preciseError_));
+    }
+    if (wisdomHolmanReady) {
+        pieces.push_back(arrayPiece(WISDOM_HOLMAN_ORDER, sizeof(std::uint64_t), n, wisdomHolmanOrder.data()));
+        pieces.push_back(arrayPiece(WISDOM_HOLMAN, sizeof(double), wisdomHolmanState.size(), wisdomHolmanState.data()));
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.endian = ENDIAN_TAG;
+    header.version = VERSION;
+    header.headerBytes = sizeof(Header);
+    header.sectionCount = static_cast<std::uint32_t>(pieces.size());
+    header.simulationTime = universe.simulationTime_.sum;
+    header.simulationTimeError = universe.simulationTime_.error;
+    header.startTimeNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(universe.startTime_.time_since_epoch()).count();
+    header.forceEvaluations = universe.forceEvaluations_;
+    header.bodyForceEvaluations = universe.bodyForceEvaluations_;
+    header.bodyCount = n;
+    header.gaussRadauEpsilon = universe.gaussRadau.epsilon;
+    header.barnesHutLeafSize = universe.barnesHut.leafSize;
+    header.trajectoryCapacity = trajectories.capacity();
+    header.trajectoryStride = trajectories.stride;
+    header.integrationMethod = static_cast<std::int32_t>(universe.integrationMethod);
+    header.precision = static_cast<std::int32_t>(universe.precision);
+    header.forceMethod = static_cast<std::int32_t>(universe.forceMethod);
+    header.wisdomHolmanCoordinates = static_cast<std::int32_t>(universe.wisdomHolman.coordinates);
+    header.barnesHutRebuildInterval = universe.barnesHut.rebuildInterval;
+    header.trajectorySampling = static_cast<std::int32_t>(trajectories.sampling);
+    std::uint32_t flags = 0;
+    if (universe.compensatedSummation) flags |= COMPENSATED_SUMMATION;
+    if (universe.localFrames) flags |= LOCAL_FRAMES;
+    if (universe.accelerationsValid_) flags |= ACCELERATIONS_VALID;
+    if (universe.errorValid_) flags |= ERROR_VALID;
+    if (universe.localReady_) flags |= LOCAL_READY;
+    if (universe.localAccelerationsValid_) flags |= LOCAL_ACCELERATIONS_VALID;
+    if (universe.preciseReady_) flags |= PRECISE_READY;
+    if (universe.preciseAccelerationsValid_) flags |= PRECISE_ACCELERATIONS_VALID;
+    if (universe.barnesHut.quadrupole) flags |= BARNES_HUT_QUADRUPOLE;
+    if (wisdomHolmanReady) flags |= WISDOM_HOLMAN_READY;
+    if (wisdomHolmanReady && wisdomHolman.current_ == WisdomHolman::Coordinates::Jacobi) flags |= WISDOM_HOLMAN_JACOBI;
+    header.flags = flags;
+    header.hermiteEta = universe.hermiteEta;
+    header.adaptiveTolerance = universe.adaptiveTolerance;
+    header.barnesHutTheta = universe.barnesHut.theta;
+    header.trajectoryMinDistance = trajectories.minDistance;
+
+    // 中身の位置を決める
+    size_t offset = alignUp(sizeof(Header) + pieces.size() * sizeof(Section));
+    for (Piece& piece : pieces) {
+        piece.section.offset = offset;
+        offset = alignUp(offset + piece.section.bytes);
+    }
+    // 中身はすぐ上書きするので0で埋めず、境界合わせの隙間だけ0にする(同じファイルの中身がいつも同じになるように)
+    image.resize(offset);
+    char* out = image.data();
+    size_t written = sizeof(Header) + pieces.size() * sizeof(Section);
+    std::memcpy(out, &header, sizeof(Header));
+    for (size_t s = 0; s < pieces.size(); ++s) {
+        std::memcpy(out + sizeof(Header) + s * sizeof(Section), &pieces[s].section, sizeof(Section));
+    }
+    for (const Piece& piece : pieces) {
+        std::memset(out + written, 0, piece.section.offset - written);
+        if (piece.section.bytes > 0) std::memcpy(out + piece.section.offset, piece.data, piece.section.bytes);
+        written = piece.section.offset + piece.section.bytes;
+    }
+    std::memset(out + written, 0, offset - written);
+}
+
+void Snapshot::write(const std::vector<char>& image, const std::string& path) {
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) throw std::runtime_error("cannot create snapshot: " + temporary);
+        file.write(image.data(), static_cast<std::streamsize>(image.size()));
+        file.flush();
+        if (!file) throw std::runtime_error("cannot write snapshot: " + temporary);
+    }
+#ifdef _WIN32
+    const bool renamed = MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    const bool renamed = std::rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+    if (!renamed) throw std::runtime_error("cannot replace snapshot: " + path);
+}
+
+void Snapshot::save(const Universe& universe, const std::string& path) {
+    std::vector<char> image;
+    capture(universe, image);
+    write(image, path);
+}
+
+void Snapshot::load(Universe& universe, const std::string& path) {
+    MappedFile file(path);
+    restore(universe, file.data(), file.size());
+}
+
+void Snapshot::restore(Universe& universe, const char* data, size_t bytes) {
+    // ヘッダと節の表を確かめる
+    Header header;
+    if (bytes < sizeof(Header)) throw std::runtime_error("snapshot: file is too small");
+    std::memcpy(&header, data, sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) throw std::runtime_error("snapshot: not a snapshot file");
+    if (header.endian != ENDIAN_TAG) throw std::runtime_error("snapshot: written on a machine with a different byte order");
+    if (header.version > VERSION) throw std::runtime_error("snapshot: written by a newer version");
+    if (header.headerBytes < sizeof(Header)) throw std::runtime_error("snapshot: header is too small");
+    const size_t tableEnd = header.headerBytes + static_cast<size_t>(header.sectionCount) * sizeof(Section);
+    if (tableEnd > bytes) throw std::runtime_error("snapshot: section table is truncated");
+    std::vector<Section> sections(header.sectionCount);
+    if (header.sectionCount > 0) std::memcpy(sections.data(), data + header.headerBytes, sections.size() * sizeof(Section));
+    for (const Section& section : sections) {
+        if (section.offset > bytes || section.bytes > bytes - section.offset) throw std::runtime_error("snapshot: section is truncated");
+    }
+    const std::uint32_t count = header.sectionCount;
+    const size_t n = static_cast<size_t>(header.bodyCount);
+    auto require = [&](std::uint32_t id, size_t elementBytes, size_t elements) {
+        const Section* section = findSection(sections.data(), count, id);
+        if (!section || section->elementBytes != elementBytes || section->count != elements || section->bytes != elementBytes * elements) {
+            throw std::runtime_error("snapshot: missing or malformed section " + std::to_string(id));
+        }
+        return data + section->offset;
+    };
+
+    // 設定の列挙値(知らない値は読まない)
+    if (header.integrationMethod < static_cast<std::int32_t>(IntegrationMethod::Euler)
+        || header.integrationMethod > static_cast<std::int32_t>(IntegrationMethod::WisdomHolman)
+        || header.precision < static_cast<std::int32_t>(Precision::Single)
+        || header.precision > static_cast<std::int32_t>(Precision::Double)
+        || header.forceMethod < static_cast<std::int32_t>(ForceMethod::Direct)
+        || header.forceMethod > static_cast<std::int32_t>(ForceMethod::BarnesHut)
+        || header.wisdomHolmanCoordinates < static_cast<std::int32_t>(WisdomHolman::Coordinates::DemocraticHeliocentric)
+        || header.wisdomHolmanCoordinates > static_cast<std::int32_t>(WisdomHolman::Coordinates::Jacobi)
+        || header.trajectorySampling < static_cast<std::int32_t>(TrajectoryStore::Sampling::Stride)
+        || header.trajectorySampling > static_cast<std::int32_t>(TrajectoryStore::Sampling::Distance)) {
+        throw std::runtime_error("snapshot: unknown setting");
+    }
+
+    // 全部の節を読んで確かめるまではuniverseに触らず、ここに置く(途中で投げてもuniverseは元のまま)
+    // 天体の物理量
+    BodyStore bodies;
+    if (!restoreStore(data, findSection(sections.data(), count, BODIES), bodies, n)) {
+        throw std::runtime_error("snapshot: missing body section");
+    }
+
+    // 名前や色(小さな記録なのでここだけは1つずつ読む)
+    const InfoRecord* info = reinterpret_cast<const InfoRecord*>(require(BODY_INFO, sizeof(InfoRecord), n));
+    const Section* namesSection = findSection(sections.data(), count, NAMES);
+    if (!namesSection) throw std::runtime_error("snapshot: missing name section");
+    const char* names = data + namesSection->offset;
+    std::vector<BodyInfo> bodyInfo(n);
+    for (size_t i = 0; i < n; ++i) {
+        InfoRecord record;
+        std::memcpy(&record, info + i, sizeof(InfoRecord));
+        if (record.nameOffset > namesSection->bytes || record.nameLength > namesSection->bytes - record.nameOffset) {
+            throw std::runtime_error("snapshot: name is out of range");
+        }
+        BodyInfo& target = bodyInfo[i];
+        target.name.assign(names + record.nameOffset, record.nameLength);
+        target.mass = record.mass;
+        target.radius = record.radius;
+        target.color[0] = record.color[0]; target.color[1] = record.color[1]; target.color[2] = record.color[2];
+        target.lightEmission = record.lightEmission != 0;
+        target.angle_theta = record.angleTheta;
+        target.angle_phi = record.anglePhi;
+    }
+
+    // 主星の関係(主星は前にあるはず)
+    const char* primaryData = require(PRIMARIES, sizeof(std::uint64_t), n);
+    Hierarchy hierarchy;
+    for (size_t i = 0; i < n; ++i) {
+        std::uint64_t p;
+        std::memcpy(&p, primaryData + i * sizeof(std::uint64_t), sizeof(p));
+        if (p != NO_PRIMARY && p >= i) throw std::runtime_error("snapshot: primary is not before its satellite");
+        hierarchy.add(p == NO_PRIMARY ? Hierarchy::NONE : static_cast<size_t>(p));
+    }
+
+    // 軌跡
+    if (header.trajectoryCapacity > bytes) throw std::runtime_error("snapshot: trajectory capacity is out of range");
+    const size_t capacity = header.trajectoryCapacity < 1 ? 1 : static_cast<size_t>(header.trajectoryCapacity);
+    const size_t pointCount = n * (capacity + 1) * 3;
+    const float* pointBegin = reinterpret_cast<const float*>(require(TRAJECTORY_POINTS, sizeof(float), pointCount));
+    const char* ringData = require(TRAJECTORY_RINGS, sizeof(RingRecord), n);
+    std::vector<TrajectoryStore::Ring> rings(n);
+    for (size_t i = 0; i < n; ++i) {
+        RingRecord record;
+        std::memcpy(&record, ringData + i * sizeof(RingRecord), sizeof(RingRecord));
+        if (record.head >= capacity || record.count > capacity) throw std::runtime_error("snapshot: trajectory ring is out of range");
+        TrajectoryStore::Ring& ring = rings[i];
+        ring.head = static_cast<size_t>(record.head);
+        ring.count = static_cast<size_t>(record.count);
+        ring.steps = static_cast<size_t>(record.steps);
+        ring.last[0] = record.last[0]; ring.last[1] = record.last[1]; ring.last[2] = record.last[2];
+        ring.committed = record.committed != 0;
+        ring.serial = ring.head;
+    }
+    std::vector<float> points(pointBegin, pointBegin + pointCount);
+
+    // Euler〜PEFRLの状態(フラグが立っていても節がなければ、その状態は作り直す)
+    BodyStore error, local, localError;
+    PreciseBodyStore precise, preciseError;
+    const bool errorValid = (header.flags & ERROR_VALID) != 0
+        && restoreStore(data, findSection(sections.data(), count, BODY_ERROR), error, n);
+    const bool localReady = (header.flags & LOCAL_READY) != 0
+        && restoreStore(data, findSection(sections.data(), count, LOCAL), local, n);
+    const bool localErrorValid = localReady
+        && restoreStore(data, findSection(sections.data(), count, LOCAL_ERROR), localError, n);
+    const bool preciseReady = (header.flags & PRECISE_READY) != 0
+        && restoreStore(data, findSection(sections.data(), count, PRECISE), precise, n)
+        && restoreStore(data, findSection(sections.data(), count, PRECISE_ERROR), preciseError, n);
+
+    // Wisdom–Holman法の状態(節がなければbodiesから始め直す)
+    WisdomHolman wisdomHolman(static_cast<WisdomHolman::Coordinates>(header.wisdomHolmanCoordinates));
+    bool wisdomHolmanReady = false;
+    if ((header.flags & WISDOM_HOLMAN_READY) != 0 && findSection(sections.data(), count, WISDOM_HOLMAN_ORDER)
+        && findSection(sections.data(), count, WISDOM_HOLMAN)) {
+        const char* orderData = require(WISDOM_HOLMAN_ORDER, sizeof(std::uint64_t), n);
+        const char* stateData = require(WISDOM_HOLMAN, sizeof(double), WISDOM_HOLMAN_ARRAYS * n);
+        std::vector<bool> seen(n, false);
+        wisdomHolman.order_.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            std::uint64_t index;
+            std::memcpy(&index, orderData + i * sizeof(std::uint64_t), sizeof(index));
+            if (index >= n || seen[index]) throw std::runtime_error("snapshot: Wisdom-Holman order is not a permutation");
+            seen[index] = true;
+            wisdomHolman.order_[i] = static_cast<size_t>(index);
+        }
+        std::vector<double>* const arrays[WISDOM_HOLMAN_ARRAYS] = {
+            &wisdomHolman.x_, &wisdomHolman.y_, &wisdomHolman.z_, &wisdomHolman.vx_, &wisdomHolman.vy_, &wisdomHolman.vz_,
+            &wisdomHolman.ax_, &wisdomHolman.ay_, &wisdomHolman.az_};
+        for (int a = 0; a < WISDOM_HOLMAN_ARRAYS; ++a) {
+            arrays[a]->resize(n);
+            if (n > 0) std::memcpy(arrays[a]->data(), stateData + a * n * sizeof(double), n * sizeof(double));
+        }
+        wisdomHolman.current_ = (header.flags & WISDOM_HOLMAN_JACOBI) != 0
+            ? WisdomHolman::Coordinates::Jacobi : WisdomHolman::Coordinates::DemocraticHeliocentric;
+        wisdomHolman.setMasses(bodies);
+        wisdomHolmanReady = true;
+    }
+
+    // ここから先は投げない。確かめたものをuniverseへ移す
+    universe.bodies.swap(bodies);
+    universe.bodyInfo.swap(bodyInfo);
+    universe.hierarchy_ = std::move(hierarchy);
+
+    TrajectoryStore& trajectories = universe.trajectories;
+    trajectories.sampling = static_cast<TrajectoryStore::Sampling>(header.trajectorySampling);
+    trajectories.stride = static_cast<size_t>(header.trajectoryStride);
+    trajectories.minDistance = header.trajectoryMinDistance;
+    trajectories.capacity_ = capacity;
+    trajectories.points_.swap(points);
+    trajectories.rings_.swap(rings);
+    ++trajectories.version_;    // 写して持っている側は全部を写し直す
+
+    // 設定
+    universe.integrationMethod = static_cast<IntegrationMethod>(header.integrationMethod);
+    universe.precision = static_cast<Precision>(header.precision);
+    universe.forceMethod = static_cast<ForceMethod>(header.forceMethod);
+    universe.compensatedSummation = (header.flags & COMPENSATED_SUMMATION) != 0;
+    universe.localFrames = (header.flags & LOCAL_FRAMES) != 0;
+    universe.hermiteEta = header.hermiteEta;
+    universe.adaptiveTolerance = header.adaptiveTolerance;
+    universe.gaussRadau = GaussRadau(header.gaussRadauEpsilon);
+    universe.wisdomHolman = std::move(wisdomHolman);
+    universe.barnesHut = BarnesHut();   // 木は作り直す
+    universe.barnesHut.theta = header.barnesHutTheta;
+    universe.barnesHut.leafSize = static_cast<size_t>(header.barnesHutLeafSize);
+    universe.barnesHut.quadrupole = (header.flags & BARNES_HUT_QUADRUPOLE) != 0;
+    universe.barnesHut.rebuildInterval = header.barnesHutRebuildInterval;
+
+    universe.accelerationsValid_ = (header.flags & ACCELERATIONS_VALID) != 0;
+    universe.errorValid_ = errorValid;
+    if (errorValid) universe.error_.swap(error);
+    universe.localReady_ = localReady;
+    if (localReady) universe.local_.swap(local);
+    if (localErrorValid) {
+        universe.localError_.swap(localError);
+    } else {
+        universe.localError_.clear();
+    }
+    universe.localAccelerationsValid_ = localReady && (header.flags & LOCAL_ACCELERATIONS_VALID) != 0;
+    universe.preciseReady_ = preciseReady;
+    if (preciseReady) {
+        universe.precise_.swap(precise);
+        universe.preciseError_.swap(preciseError);
+    }
+    universe.preciseAccelerationsValid_ = preciseReady && (header.flags & PRECISE_ACCELERATIONS_VALID) != 0;
+    universe.wisdomHolmanReady_ = wisdomHolmanReady;
+    // 自分の刻みで進む方法はbodiesから始め直す。最初に試す刻みも戻し、始め直した後が読み込む前の履歴によらないようにする
+    universe.adaptiveReady_ = false;
+    universe.adaptiveStep_ = 0.0;
+    universe.hermiteReady_ = false;
+    universe.gaussRadauReady_ = false;
+    universe.gaussRadauEvaluations_ = 0;
+
+    // 時刻と数
+    universe.simulationTime_.sum = header.simulationTime;
+    universe.simulationTime_.error = header.simulationTimeError;
+    universe.startTime_ = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(header.startTimeNanoseconds)));
+    universe.forceEvaluations_ = header.forceEvaluations;
+    universe.bodyForceEvaluations_ = header.bodyForceEvaluations;
+    universe.updateCenterOfMass();
+}
+
+Checkpointer::Checkpointer(const std::string& path, double interval)
+:   path_(path),
+    interval_(interval),
+    nextTime_(0.0),
+    started_(false),
+    hasPending_(false),
+    stop_(false),
+    written_(0)
+{
+    thread_ = std::thread(&Checkpointer::run, this);
+}
+
+Checkpointer::~Checkpointer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void Checkpointer::update(const Universe& universe) {
+    if (!started_) {
+        // 最初のupdate()からintervalごと(スナップショットから再開したときも、そこから数える)
+        nextTime_ = universe.getSimulationTime() + interval_;
+        started_ = true;
+    }
+    if (universe.getSimulationTime() < nextTime_) return;
+    {
+        // 前の書き込みが終わっていなければ、待たずに次の機会にする
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (hasPending_) return;
+    }
+    Snapshot::capture(universe, image_);    // コピーの間だけ積分が止まる
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.swap(image_);
+        hasPending_ = true;
+    }
+    wake_.notify_one();
+    while (nextTime_ <= universe.getSimulationTime()) nextTime_ += interval_;
+}
+
+void Checkpointer::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return !hasPending_; });
+}
+
+unsigned long long Checkpointer::getWrittenCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_;
+}
+
+std::string Checkpointer::getLastError() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lastError_;
+}
+
+void Checkpointer::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stop_ || hasPending_; });
+        if (!hasPending_) return;   // stop_で、書くものがない
+        // 書いている間はロックを外す(pending_はhasPending_がtrueの間update()が触らない)
+        lock.unlock();
+        std::string error;
+        try {
+            Snapshot::write(pending_, path_);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        lock.lock();
+        if (error.empty()) {
+            ++written_;
+        } else {
+            lastError_ = error;
+        }
+        hasPending_ = false;
+        done_.notify_all();
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <condition_variable>   // std::condition_variable
+#include <cstddef>  // size_t
+#include <cstdint>  // std::uint32_t
+#include <mutex>    // std::mutex
+#include <string>   // std::string
+#include <thread>   // std::thread
+#include <vector>   // std::vector
+
+class Universe;
+
+// Universeの状態をまるごと保存するバイナリ形式(スナップショット)。途中から計算を再開するのに使う。
+//
+// ファイルは ヘッダ、節(section)の表、各節の中身 の順に並ぶ。節の中身はALIGNMENTバイト境界から始まり、
+// BodyStoreの節はメモリブロック(arena)と同じ並びなので、読み込みはファイルをメモリに写像(mmap)して一度コピーするだけで済む。
+// 数値はすべて書いた計算機のバイト順のまま。ヘッダのendianで確かめ、違うバイト順のファイルは読まない。
+// 知らない番号の節は読み飛ばすので、節を増やしてもVERSIONを上げなくてよい(中身の意味を変えるときだけ上げる)。
+//
+// 保存するもの: 全天体の位置・速度・加速度・G*m、名前や色、主星の関係、軌跡、シミュレーション時刻、積分と力の計算の設定、
+// Euler〜PEFRLの状態(補正付きの和の誤差、主星からの相対の状態、Precision::Doubleの状態)、Wisdom–Holman法の状態(double)。
+// これらの方法は、読み込んだ後の計算が保存しなかった場合とビット単位で同じになる。
+// DOPRI5, Hermite法, IAS15の内部の状態は保存せず、読み込んだ後はbodiesから始め直す(方法を切り替えたときと同じ)。
+class Snapshot {
+public:
+    static const std::uint32_t VERSION = 1;
+    static const size_t ALIGNMENT = 64;     // 節の中身の境界(バイト)
+
+    // 状態をファイルと同じ並びのバイト列にしてimageに入れる(imageの領域は使い回す)
+    static void capture(const Universe& universe, std::vector<char>& image);
+    // imageをpathに書く。一時ファイルに書いてから名前を変えるので、途中で落ちても前のファイルは壊れない
+    static void write(const std::vector<char>& image, const std::string& path);
+    static void save(const Universe& universe, const std::string& path);
+    // pathをメモリに写像してuniverseに読み込む。universeにあった天体は消える
+    static void load(Universe& universe, const std::string& path);
+    // バイト列から読み込む。形式が違うときはstd::runtime_errorを投げ、そのときuniverseは元のまま
+    static void restore(Universe& universe, const char* data, size_t bytes);
+};
+
+// 一定のシミュレーション時間ごとにスナップショットを書く。
+// update()は状態をメモリにコピーするだけで、ファイルへの書き込みは別のスレッドが行う(積分を止めない)。
+// 前の書き込みが終わっていなければ、そのときは保存せず次のupdate()でもう一度試す。
+class Checkpointer {
+public:
+    Checkpointer(const std::string& path, double interval);    // interval: 保存する間隔(シミュレーション時間[s])。最初のupdate()から数える
+    ~Checkpointer();    // 書きかけのものは書き終えてから終わる
+
+    void update(const Universe& universe);  // Universe::update()の後に毎回呼ぶ
+    void flush();                           // 書きかけのものが書き終わるまで待つ
+    unsigned long long getWrittenCount() const;
+    std::string getLastError() const;       // 最後に失敗した書き込みの理由(なければ空)
+
+private:
+    std::string path_;
+    double interval_;
+    double nextTime_;       // 次に保存するシミュレーション時刻
+    bool started_;          // nextTime_を決めたか
+    std::vector<char> image_;       // update()がコピーする先
+    std::vector<char> pending_;     // 書き込みスレッドに渡したもの
+    bool hasPending_;
+    bool stop_;
+    unsigned long long written_;
+    std::string lastError_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;      // 書き込みスレッドを起こす
+    std::condition_variable done_;      // 書き込みが終わったことを知らせる
+    std::thread thread_;
+
+    void run();
+};
+
+#endif
@@ -1,41 +1,52 @@
 #ifndef SPHERE_H
 #define SPHERE_H
 
-#include <vector>   // std::vector, std::tuple
-#include <GL/gl.h>   // OpenGLの基本機能を使うためのヘッダー
-#include <GL/glu.h>  // OpenGLのユーティリティ関数（例: gluSphere）を使うためのヘッダー
+#include <string>   // std::string
+#include <vector>   // std::vector
+#include <tuple>    // std::tuple
 
 #include "Constants.h"
+#include "TrajectoryStore.h"
 
-class Sphere {
-public:
+class Universe;
+
+// 天体ごとの、描画や画面表示にしか使わない情報(毎ステップの力の計算では触らない)
+// 位置・速度などの物理量はUniverse::bodies(BodyStore)に配列としてまとめて持つ。
+struct BodyInfo {
     std::string name;      // 名前
-    float x, y, z;         // 球の位置
-    float vx, vy, vz;      // 球の速度（x, y, z成分）
-    float ax, ay, az;      // 球の加速度（x, y, z成分）
+    float mass;            // 質量(kg)。計算にはBodyStore::mu(G*m)を使う
+    float radius;          // 半径
+    float color[3];        // 球の色（RGB）
+    bool lightEmission;    // 球が光を放つかどうか
     float angle_theta;     // 球の回転角度（z軸回りの角度）
     float angle_phi;       // 球の回転軸のz軸に対する角度（-90度から90度）
-    float mass;            // 質量
-    float radius;          // 半径
-    float color[3];        // 球の色（RGB） 
-    // 軌跡用のベクター
-    std::vector<std::tuple<float, float, float>> trajectory; // 位置の軌跡（最大1000点）
-    size_t trajectoryLength;  // 各天体の軌跡の長さ
+    // 軌跡はUniverse::trajectories(TrajectoryStore)に全天体分をまとめて持つ
+};
+
+// Universeの中の1つの天体を指すハンドル。描画や画面表示(HUD)から天体を扱うときに使う。
+// 中身はUniverseの番号で引くので、天体を追加してBodyStoreの配列が移動しても使い続けられる。
+class Sphere {
+public:
+    Sphere(Universe& universe, size_t index);
+
+    size_t index() const;
+    size_t primary() const;        // 主星の番号(Hierarchy::NONEなら主星なし)
+    const std::string& name() const;
+    float x() const; float y() const; float z() const;         // 球の位置
+    float vx() const; float vy() const; float vz() const;      // 球の速度（x, y, z成分）
+    float ax() const; float ay() const; float az() const;      // 球の加速度（x, y, z成分）
+    float mass() const;            // 質量(kg)
+    float radius() const;          // 半径
+    const float* color() const;    // 球の色（RGB）
+    bool lightEmission() const;    // 球が光を放つかどうか
+    float angleTheta() const;      // 球の回転角度（z軸回りの角度）
+    TrajectoryStore::View trajectory() const;   // 位置の軌跡(古い順)
 
-    
-    Sphere(     // コンストラクタ: 初期値を設定
-        std::string nameInput,
-        float posX, float posY, float posZ,
-        float velX, float velY, float velZ, 
-        float m, float rad,
-        float r, float g, float b,
-        bool lightEmission
-    );
     void updateRotation(float delta);   // 回転角度を更新
-    void draw(); // 球を描画
-    void drawTrajectory();  //軌跡を描画
+    void draw() const; // 球を描画(実装はSphereDraw.cpp。ヘッドレスビルドではリンクしない)
+    void drawTrajectory() const;  //軌跡を描画(同上)
 private:
-    bool lightEmission_;    // 球が光を放つかどうか
-
+    Universe* universe_;    // この天体の入っている宇宙
+    size_t index_;          // Universeの中での番号
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,90 @@
+// SphereクラスとFrameの描画部分(OpenGLに依存する部分だけをここに分けている)
+// ヘッドレスビルド(tools/Headless.cpp)はこのファイルをリンクしないので、windows.hやOpenGLが無い環境でもSphere/Universeを使える。
+
+#include <GL/gl.h>   // OpenGLの基本機能を使うためのヘッダー
+#include <GL/glu.h>  // OpenGLのユーティリティ関数（例: gluSphere）を使うためのヘッダー
+
+#include "Frame.h"
+#include "Sphere.h"
+
+
+namespace {
+    // 球を描画
+    void drawSphere(float x, float y, float z, float angleTheta, float radius, const float* color, bool lightEmission) {
+        glPushMatrix();                     // 現在の座標系を保存
+        glTranslatef(x, y, z);              // 球の位置に移動
+        glRotatef(angleTheta, 0.0f, 0.0f, 1.0f); // Y軸を中心にangle_theta度回転
+
+        
+        // マテリアルプロパティの設定
+        if (lightEmission) {
+            GLfloat emission[] = {color[0], color[1], color[2], 1.0f}; // 球体が放つ光の色 (黄色)
+            glMaterialfv(GL_FRONT, GL_EMISSION, emission);
+        }else{
+            // 球の材質の色を設定（AmbientとDiffuseを設定）
+            GLfloat matColor[] = {color[0], color[1], color[2], 1.0f}; // RGB + α（アルファ値）
+            glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, matColor);
+        }
+
+        static GLUquadric* quadric = gluNewQuadric();   // 球を生成するためのオブジェクト(作り直さずに使い回す)
+
+        gluSphere(quadric, radius, 10, 10);        // 半径radius、分割数10x10の球を描画
+
+        // マテリアルプロパティをリセット
+        if (lightEmission) {
+            GLfloat noEmission[] = {0.0f, 0.0f, 0.0f, 1.0f};
+            glMaterialfv(GL_FRONT, GL_EMISSION, noEmission);
+        }
+
+        glPopMatrix();                          // 座標系を元に戻す
+    }
+
+    // 連続した点(xyzの並び)の配列を、球体と同じ色の線で描く
+    void drawLineStrips(const float* color, const float* const* first, const size_t* count, int strips) {
+        glPushMatrix(); // 座標系を保存
+
+        glDisable(GL_LIGHTING);     //ライティングを一度無効にしないと色が反映されない。
+        glColor3f(color[0], color[1], color[2]);  // 球体と同じ色
+        glEnableClientState(GL_VERTEX_ARRAY);
+        for (int s = 0; s < strips; ++s) {
+            glVertexPointer(3, GL_FLOAT, 0, first[s]);
+            glDrawArrays(GL_LINE_STRIP, 0, static_cast<GLsizei>(count[s]));
+        }
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glEnable(GL_LIGHTING);
+
+        glPopMatrix();  // 座標系を復元
+    }
+}
+
+
+// 球を描画
+void Sphere::draw() const {
+    drawSphere(x(), y(), z(), angleTheta(), radius(), color(), lightEmission());
+}
+
+// 軌跡を描画する
+void Sphere::drawTrajectory() const {
+    // 環状バッファの中の点を頂点配列として渡し、連続した線として描く(継ぎ目をまたぐときは2本に分かれる)
+    const float* first[2];
+    size_t count[2];
+    const int segments = trajectory().segments(first, count);
+    drawLineStrips(color(), first, count, segments);
+}
+
+// Frameに写した天体を描画する(描画スレッドはUniverseに触らずにこちらを使う)
+// 全天体をまとめて描くのはSphereRenderer。これはOpenGL 3.3が使えないときのためのもの
+void Frame::drawBody(size_t index, double alpha) const {
+    const Body& body = bodies[index];
+    float p[3];
+    position(index, alpha, p);
+    drawSphere(p[0], p[1], p[2], body.angleTheta, body.radius, body.color, body.lightEmission);
+}
+
+void Frame::drawTrajectory(size_t index) const {
+    // Universeと同じ環状バッファの並びで写してあるので、Sphere::drawTrajectory()と同じように描く
+    const float* first[2];
+    size_t count[2];
+    const int segments = trajectoryView(index).segments(first, count);
+    drawLineStrips(bodies[index].color, first, count, segments);
+}
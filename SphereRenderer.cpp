@@ -0,0 +1,388 @@
+// 全天体の球のインスタンス描画(視錐台の外は描かず、画面上の大きさで形の細かさを選ぶ)
+
+#include <algorithm>    // std::copy
+#include <cmath>        // std::sin, std::cos, std::sqrt
+#include <stdexcept>    // std::runtime_error
+#include <string>       // std::string
+#include <vector>       // std::vector
+
+#include "Frame.h"
+#include "GLFunctions.h"
+#include "SphereRenderer.h"
+
+namespace {
+    // 球の形の細かさの段階。画面上の半径[pixel]がmaxPixelsより小さければその段階で描く
+    struct MeshLevel {
+        int slices;         // 経度方向の分割数
+        int stacks;         // 緯度方向の分割数
+        float maxPixels;
+    };
+    const MeshLevel MESH_LEVEL[SphereRenderer::MESH_LEVELS] = {
+        {8, 6, 8.0f},
+        {16, 12, 48.0f},
+        {32, 24, 1e30f},
+    };
+    const int REFERENCE_LEVEL = 1;          // levelOfDetailがfalseのときに使う段階
+    const float IMPOSTOR_PIXELS = 2.0f;     // 画面上の半径がこれより小さい球は点で描く
+    const unsigned char CULLED = 255;       // SphereRenderer::levels_で、描かない天体
+
+    // 頂点属性の番号(シェーダーのlayout(location)と同じ)
+    const GLuint VERTEX = 0;
+    const GLuint CURRENT = 1;
+    const GLuint PREVIOUS = 2;
+    const GLuint COLOR = 3;
+
+    const char* VERSION = "#version 330 compatibility\n";
+
+    const char* MESH_VERTEX_SHADER = R"(
+layout(location = 0) in vec3 vertex;    // 単位球の頂点(法線と同じ)
+layout(location = 1) in vec4 current;   // 最後のステップの位置と半径
+layout(location = 2) in vec4 previous;  // 直前のステップの位置と、光を放つか(1なら放つ)
+layout(location = 3) in vec3 color;
+uniform float alpha;                    // 直前のステップ(0)から最後のステップ(1)までのどこを描くか
+
+out vec3 eyePosition;
+out vec3 eyeNormal;
+flat out vec3 baseColor;
+flat out float emission;
+
+void main() {
+    vec3 center = mix(previous.xyz, current.xyz, alpha);
+    vec4 eye = gl_ModelViewMatrix * vec4(center + vertex * current.w, 1.0);
+    eyePosition = eye.xyz;
+    eyeNormal = gl_NormalMatrix * vertex;
+    baseColor = color;
+    emission = previous.w;
+    gl_Position = gl_ProjectionMatrix * eye;
+}
+)";
+
+    // 点で描くときは、球を囲む正方形の点(point sprite)を1つ描く
+    const char* IMPOSTOR_VERTEX_SHADER = R"(
+layout(location = 1) in vec4 current;
+layout(location = 2) in vec4 previous;
+layout(location = 3) in vec3 color;
+uniform float alpha;
+uniform float pixelScale;               // 視点から距離1のところの長さ1が画面上で何pixelか
+
+flat out vec3 eyeCenter;
+flat out float radius;
+flat out vec3 baseColor;
+flat out float emission;
+
+void main() {
+    vec4 eye = gl_ModelViewMatrix * vec4(mix(previous.xyz, current.xyz, alpha), 1.0);
+    eyeCenter = eye.xyz;
+    radius = current.w;
+    baseColor = color;
+    emission = previous.w;
+    gl_PointSize = max(2.0 * current.w * pixelScale / max(-eye.z, 1e-30), 1.0);   // 1pixelより小さい球も1pixelで描く
+    gl_Position = gl_ProjectionMatrix * eye;
+}
+)";
+
+    // 固定機能のライティング(材質の環境光・拡散光の色が球の色、光を放つ球は放射光も球の色)と同じ計算を画素ごとに行う
+    const char* LIGHTING = R"(
+vec4 shade(vec3 eyePosition, vec3 normal, vec3 baseColor, float emission) {
+    vec4 light = gl_LightSource[0].position;
+    vec3 toLight = normalize(light.xyz - eyePosition * light.w);
+    vec3 ambient = (gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb) * baseColor;
+    vec3 diffuse = gl_LightSource[0].diffuse.rgb * baseColor * max(dot(normal, toLight), 0.0);
+    return vec4(min(emission * baseColor + ambient + diffuse, vec3(1.0)), 1.0);
+}
+)";
+
+    const char* MESH_FRAGMENT_SHADER = R"(
+in vec3 eyePosition;
+in vec3 eyeNormal;
+flat in vec3 baseColor;
+flat in float emission;
+
+out vec4 fragColor;
+
+void main() {
+    fragColor = shade(eyePosition, normalize(eyeNormal), baseColor, emission);
+}
+)";
+
+    // 点の中の円の部分だけを、視点の方を向いた半球として塗る
+    const char* IMPOSTOR_FRAGMENT_SHADER = R"(
+flat in vec3 eyeCenter;
+flat in float radius;
+flat in vec3 baseColor;
+flat in float emission;
+
+out vec4 fragColor;
+
+void main() {
+    vec2 p = gl_PointCoord * 2.0 - 1.0;
+    p.y = -p.y;                         // gl_PointCoordは上が0
+    float r2 = dot(p, p);
+    if (r2 > 1.0) discard;
+    // 画面の中心から外れた球は、視点の方を向いた半球が見えるので、視点への向きを軸にして法線を作る
+    vec3 view = -normalize(eyeCenter);
+    vec3 right = normalize(cross(abs(view.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0), view));
+    vec3 up = cross(view, right);
+    vec3 normal = p.x * right + p.y * up + sqrt(1.0 - r2) * view;
+    fragColor = shade(eyeCenter + normal * radius, normal, baseColor, emission);
+}
+)";
+
+    // 単位球の頂点(緯度・経度の格子)と、それを1本の三角形の帯(GL_TRIANGLE_STRIP)で描く頂点の番号をverticesとindicesの後ろに足す。
+    // 緯度の帯ごとに北と南の頂点を交互に並べ、帯の間は同じ頂点を2回置いて(面積0の三角形で)つなぐ。
+    // 三角形ごとに頂点を並べるより頂点シェーダーを呼ぶ回数が少ない(gluSphereと同じくらい)
+    void buildSphere(int slices, int stacks, std::vector<GLfloat>& vertices, std::vector<GLushort>& indices) {
+        const float pi = 3.14159265358979f;
+        const GLushort base = static_cast<GLushort>(vertices.size() / 3);
+        for (int stack = 0; stack <= stacks; ++stack) {
+            const float phi = pi * stack / stacks;      // 北極(+z)からの角度
+            for (int slice = 0; slice <= slices; ++slice) {
+                const float theta = 2.0f * pi * slice / slices;
+                vertices.push_back(std::sin(phi) * std::cos(theta));
+                vertices.push_back(std::sin(phi) * std::sin(theta));
+                vertices.push_back(std::cos(phi));
+            }
+        }
+        for (int stack = 0; stack < stacks; ++stack) {
+            const GLushort north = static_cast<GLushort>(base + stack * (slices + 1));
+            const GLushort south = static_cast<GLushort>(north + slices + 1);
+            if (stack > 0) indices.push_back(north);        // 前の帯の最後の頂点と合わせて、面積0の三角形でつなぐ
+            for (int slice = 0; slice <= slices; ++slice) {
+                indices.push_back(static_cast<GLushort>(north + slice));
+                indices.push_back(static_cast<GLushort>(south + slice));
+            }
+            if (stack < stacks - 1) indices.push_back(static_cast<GLushort>(south + slices));
+        }
+    }
+
+    // インスタンスごとの値(Frame::instancesの並び)の、firstByte番目のbyteからの読み方を決める
+    void instanceAttributes(size_t firstByte, GLuint divisor) {
+        const GLsizei stride = Frame::INSTANCE_FLOATS * sizeof(GLfloat);
+        gl::enableVertexAttribArray(CURRENT);
+        gl::vertexAttribPointer(CURRENT, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(firstByte));
+        gl::vertexAttribDivisor(CURRENT, divisor);
+        gl::enableVertexAttribArray(PREVIOUS);
+        gl::vertexAttribPointer(PREVIOUS, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(firstByte + 4 * sizeof(GLfloat)));
+        gl::vertexAttribDivisor(PREVIOUS, divisor);
+        gl::enableVertexAttribArray(COLOR);
+        gl::vertexAttribPointer(COLOR, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(firstByte + 8 * sizeof(GLfloat)));
+        gl::vertexAttribDivisor(COLOR, divisor);
+    }
+}
+
+SphereRenderer::SphereRenderer()
+:   culling(true),
+    levelOfDetail(true),
+    meshArray_(0),
+    impostorArray_(0),
+    meshBuffer_(0),
+    indexBuffer_(0),
+    instanceBuffer_(0),
+    meshProgram_(0),
+    impostorProgram_(0),
+    meshAlphaLocation_(-1),
+    impostorAlphaLocation_(-1),
+    impostorPixelScaleLocation_(-1),
+    indexFirst_(),
+    indexCount_(),
+    statistics_()
+{
+}
+
+void SphereRenderer::init() {
+    if (isReady()) return;
+    if (!gl::isLoaded()) throw std::runtime_error("OpenGL 3.3 functions are not loaded");
+
+    // シェーダー
+    const GLuint meshProgram = gl::buildProgram(std::string(VERSION) + MESH_VERTEX_SHADER, std::string(VERSION) + LIGHTING + MESH_FRAGMENT_SHADER);
+    GLuint impostorProgram = 0;
+    try {
+        impostorProgram = gl::buildProgram(std::string(VERSION) + IMPOSTOR_VERTEX_SHADER, std::string(VERSION) + LIGHTING + IMPOSTOR_FRAGMENT_SHADER);
+    } catch (...) {
+        gl::deleteProgram(meshProgram);
+        throw;
+    }
+    meshProgram_ = meshProgram;
+    impostorProgram_ = impostorProgram;
+    meshAlphaLocation_ = gl::getUniformLocation(meshProgram_, "alpha");
+    impostorAlphaLocation_ = gl::getUniformLocation(impostorProgram_, "alpha");
+    impostorPixelScaleLocation_ = gl::getUniformLocation(impostorProgram_, "pixelScale");
+
+    // 球の形は1回だけ作る(細かさの段階ごとに続けて入れる)
+    std::vector<GLfloat> vertices;
+    std::vector<GLushort> indices;
+    for (int level = 0; level < MESH_LEVELS; ++level) {
+        indexFirst_[level] = static_cast<int>(indices.size());
+        buildSphere(MESH_LEVEL[level].slices, MESH_LEVEL[level].stacks, vertices, indices);
+        indexCount_[level] = static_cast<int>(indices.size()) - indexFirst_[level];
+    }
+
+    gl::genBuffers(1, &meshBuffer_);
+    gl::genBuffers(1, &indexBuffer_);
+    gl::genBuffers(1, &instanceBuffer_);
+
+    // 球の形で描くとき: 頂点は単位球、天体ごとの値はインスタンスごとに1つ進む
+    gl::genVertexArrays(1, &meshArray_);
+    gl::bindVertexArray(meshArray_);
+    gl::bindBuffer(GL_ARRAY_BUFFER, meshBuffer_);
+    gl::bufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+    gl::enableVertexAttribArray(VERTEX);
+    gl::vertexAttribPointer(VERTEX, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);     // 頂点配列に覚えられる
+    gl::bufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+    gl::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer_);
+    instanceAttributes(0, 1);
+
+    // 点で描くとき: 天体1つが頂点1つ
+    gl::genVertexArrays(1, &impostorArray_);
+    gl::bindVertexArray(impostorArray_);
+    instanceAttributes(0, 0);
+
+    gl::bindVertexArray(0);
+    gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SphereRenderer::destroy() {
+    if (!isReady()) return;
+    gl::deleteVertexArrays(1, &meshArray_);
+    gl::deleteVertexArrays(1, &impostorArray_);
+    gl::deleteBuffers(1, &meshBuffer_);
+    gl::deleteBuffers(1, &indexBuffer_);
+    gl::deleteBuffers(1, &instanceBuffer_);
+    gl::deleteProgram(meshProgram_);
+    gl::deleteProgram(impostorProgram_);
+    meshArray_ = impostorArray_ = meshBuffer_ = indexBuffer_ = instanceBuffer_ = meshProgram_ = impostorProgram_ = 0;
+}
+
+bool SphereRenderer::isReady() const {
+    return meshProgram_ != 0;
+}
+
+const SphereRenderer::Statistics& SphereRenderer::getStatistics() const {
+    return statistics_;
+}
+
+void SphereRenderer::classify(const Frame& frame, double alpha, size_t counts[MESH_LEVELS + 1], float& pixelScale) {
+    GLfloat modelview[16], projection[16];
+    GLint viewport[4];
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    pixelScale = projection[5] * viewport[3] * 0.5f;    // projection[5]はgluPerspectiveの1/tan(fovy/2)
+
+    // 視錐台の6つの面(クリップ座標への行列 projection * modelview の行の和と差)。内側が正になるように向け、法線の長さを1にする
+    GLfloat clip[16];   // OpenGLと同じ列優先
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 4; ++row) {
+            clip[column * 4 + row] = 0.0f;
+            for (int k = 0; k < 4; ++k) clip[column * 4 + row] += projection[k * 4 + row] * modelview[column * 4 + k];
+        }
+    }
+    float planes[6][4];
+    for (int p = 0; p < 6; ++p) {
+        const int row = p / 2;
+        const float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        for (int column = 0; column < 4; ++column) planes[p][column] = clip[column * 4 + 3] + sign * clip[column * 4 + row];
+        const float length = std::sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        if (length > 0.0f) for (int column = 0; column < 4; ++column) planes[p][column] /= length;
+    }
+
+    // 描き方を決めて数える
+    const size_t n = frame.bodies.size();
+    const float a = static_cast<float>(alpha);
+    levels_.resize(n);
+    for (int level = 0; level <= MESH_LEVELS; ++level) counts[level] = 0;
+    size_t culled = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const float* instance = frame.instances.data() + i * Frame::INSTANCE_FLOATS;
+        float center[3];
+        for (int c = 0; c < 3; ++c) center[c] = instance[4 + c] + (instance[c] - instance[4 + c]) * a;
+        const float radius = instance[3];
+
+        bool inside = true;
+        for (int p = 0; culling && inside && p < 6; ++p) {
+            inside = planes[p][0] * center[0] + planes[p][1] * center[1] + planes[p][2] * center[2] + planes[p][3] >= -radius;
+        }
+        if (!inside) {
+            levels_[i] = CULLED;
+            ++culled;
+            continue;
+        }
+
+        unsigned char level = 1 + REFERENCE_LEVEL;  // 0が点、1からが球の形の段階
+        if (levelOfDetail) {
+            const float depth = -(modelview[2] * center[0] + modelview[6] * center[1] + modelview[10] * center[2] + modelview[14]);
+            const float pixels = (depth > radius) ? radius * pixelScale / depth : MESH_LEVEL[MESH_LEVELS - 1].maxPixels;    // 視点が球の中にあれば一番細かく
+            if (pixels < IMPOSTOR_PIXELS) {
+                level = 0;
+            } else {
+                level = MESH_LEVELS;
+                for (int k = MESH_LEVELS - 1; k >= 0 && pixels < MESH_LEVEL[k].maxPixels; --k) level = static_cast<unsigned char>(1 + k);
+            }
+        }
+        levels_[i] = level;
+        ++counts[level];
+    }
+
+    // 描き方ごとにまとめて並べる
+    size_t next[MESH_LEVELS + 1];
+    next[0] = 0;
+    for (int level = 1; level <= MESH_LEVELS; ++level) next[level] = next[level - 1] + counts[level - 1];
+    visible_.resize((n - culled) * Frame::INSTANCE_FLOATS);
+    for (size_t i = 0; i < n; ++i) {
+        if (levels_[i] == CULLED) continue;
+        const float* instance = frame.instances.data() + i * Frame::INSTANCE_FLOATS;
+        std::copy(instance, instance + Frame::INSTANCE_FLOATS, visible_.begin() + next[levels_[i]]++ * Frame::INSTANCE_FLOATS);
+    }
+
+    statistics_.culled = culled;
+    statistics_.impostors = counts[0];
+    for (int level = 0; level < MESH_LEVELS; ++level) statistics_.meshes[level] = counts[1 + level];
+}
+
+void SphereRenderer::pointInstances(size_t first) const {
+    instanceAttributes(first * Frame::INSTANCE_FLOATS * sizeof(GLfloat), 1);
+}
+
+void SphereRenderer::draw(const Frame& frame, double alpha) {
+    if (!isReady()) return;
+    size_t counts[MESH_LEVELS + 1];
+    float pixelScale = 0.0f;
+    classify(frame, alpha, counts, pixelScale);
+    if (visible_.empty()) return;
+
+    // 見える天体の値を1回で渡す(バッファを丸ごと置き換えるので、前のフレームを描き終わるのを待たない)
+    gl::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer_);
+    gl::bufferData(GL_ARRAY_BUFFER, visible_.size() * sizeof(GLfloat), visible_.data(), GL_STREAM_DRAW);
+
+    // 小さい天体は点で描く
+    if (counts[0] > 0) {
+        gl::useProgram(impostorProgram_);
+        gl::uniform1f(impostorAlphaLocation_, static_cast<GLfloat>(alpha));
+        gl::uniform1f(impostorPixelScaleLocation_, pixelScale);
+        glEnable(GL_PROGRAM_POINT_SIZE);    // 点の大きさをシェーダーで決める
+        glEnable(GL_POINT_SPRITE);          // 互換プロファイルでは、これを有効にしないとgl_PointCoordが決まらない
+        gl::bindVertexArray(impostorArray_);
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(counts[0]));
+        glDisable(GL_POINT_SPRITE);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+
+    // 残りは細かさの段階ごとに1回ずつ、インスタンス描画で描く
+    gl::useProgram(meshProgram_);
+    gl::uniform1f(meshAlphaLocation_, static_cast<GLfloat>(alpha));
+    gl::bindVertexArray(meshArray_);
+    size_t first = counts[0];
+    for (int level = 0; level < MESH_LEVELS; ++level) {
+        const size_t count = counts[1 + level];
+        if (count == 0) continue;
+        pointInstances(first);
+        gl::drawElementsInstanced(GL_TRIANGLE_STRIP, indexCount_[level], GL_UNSIGNED_SHORT,
+                                  reinterpret_cast<const void*>(indexFirst_[level] * sizeof(GLushort)), static_cast<GLsizei>(count));
+        first += count;
+    }
+
+    gl::bindVertexArray(0);     // 軌跡などの固定機能の描画に戻す
+    gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+    gl::useProgram(0);
+}
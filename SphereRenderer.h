@@ -0,0 +1,72 @@
+#ifndef SPHERERENDERER_H
+#define SPHERERENDERER_H
+
+#include <cstddef>  // size_t
+#include <vector>   // std::vector
+
+struct Frame;
+
+// 全天体の球をインスタンス描画でまとめて描く。
+//
+// 球の形(単位球の頂点)は細かさの違うものをinit()で1回だけGPUのバッファに作っておき、天体ごとに違う値(位置・直前の位置・半径・色・光を放つか)は
+// Frame::instancesから見える天体の分だけを並べ直して、毎フレーム1つのバッファで渡す。ステップの間の補間(Frame::interpolation())も
+// シェーダーで行う。ドライバを呼ぶ回数は細かさの段階の数で決まり、天体の数によらない(gluSphereで1つずつ描くと、天体ごとに数百回呼ぶことになる)。
+//
+// 描く前に、天体ごとに
+//   - 視錐台(gluPerspectiveとgluLookAtで決めた、見えている範囲)の外にある球は描かない
+//   - 画面上の半径[pixel]から球の形の細かさを選ぶ(小さく見える球ほど粗い形で描く)
+//   - 画面上で小さすぎる球は、形を描かずに点(point sprite)を1つ描き、その中で球に見えるように色を付ける(impostor)
+// を決める。小惑星のように数が多い天体はほとんどが点になるので、頂点の計算がほぼ要らなくなる。
+// 光の当たり方は固定機能の光源0(setLighting)と同じ値を読んで計算する。
+//
+// OpenGL 3.3以降の関数を使うので、gl::load()が成功してからinit()する。使えないときはFrame::drawBody()で1つずつ描く。
+// OpenGLに依存するので、ヘッドレスビルドではリンクしない。
+class SphereRenderer {
+public:
+    static const int MESH_LEVELS = 3;   // 球の形の細かさの段階の数(0が一番粗い)
+
+    // 直前のdraw()で描いたものの数
+    struct Statistics {
+        size_t culled;                  // 視錐台の外にあって描かなかった天体
+        size_t impostors;               // 点で描いた天体
+        size_t meshes[MESH_LEVELS];     // 細かさの段階ごとの、球の形で描いた天体
+    };
+
+    bool culling;           // 視錐台の外の天体を描かない(初期値true)
+    bool levelOfDetail;     // 画面上の大きさで細かさを選び、小さい天体を点で描く(初期値true)。falseなら全部を真ん中の細かさで描く
+
+    SphereRenderer();
+
+    void init();            // 今のコンテキストで球の形とシェーダーを作る。シェーダーが作れなければstd::runtime_error
+    void destroy();         // 作ったものを消す(コンテキストを消す前に呼ぶ)
+    bool isReady() const;   // init()が成功したか
+
+    // frameの全天体を、直前のステップと最後のステップの間のalpha(Frame::interpolation())の位置に描く。
+    // 今の投影行列・モデルビュー行列・ビューポート・光源0を使う
+    void draw(const Frame& frame, double alpha);
+    const Statistics& getStatistics() const;
+
+private:
+    unsigned meshArray_;        // 球の形で描くときの頂点配列
+    unsigned impostorArray_;    // 点で描くときの頂点配列
+    unsigned meshBuffer_;       // 単位球の頂点(法線と同じ)。全段階分を続けて入れる
+    unsigned indexBuffer_;      // 単位球を三角形の帯で描く頂点の番号。全段階分を続けて入れる
+    unsigned instanceBuffer_;   // 見える天体のFrame::instancesを、点・段階0・段階1・…の順に並べ直したもの
+    unsigned meshProgram_;
+    unsigned impostorProgram_;
+    int meshAlphaLocation_;
+    int impostorAlphaLocation_;
+    int impostorPixelScaleLocation_;
+    int indexFirst_[MESH_LEVELS];   // indexBufferの中での、段階ごとの最初の番号の位置
+    int indexCount_[MESH_LEVELS];
+
+    Statistics statistics_;
+    std::vector<unsigned char> levels_; // 天体ごとの描き方(classify()の結果)
+    std::vector<float> visible_;        // instanceBufferに渡す値
+
+    // 天体ごとに描き方を決め、見える天体の値を描き方ごとにvisible_に並べる。描き方ごとの天体の数をcountsに返す
+    void classify(const Frame& frame, double alpha, size_t counts[MESH_LEVELS + 1], float& pixelScale);
+    void pointInstances(size_t first) const;    // 球の形で描くときのインスタンスごとの値を、instanceBufferのfirst番目の天体からにする
+};
+
+#endif
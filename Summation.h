@@ -0,0 +1,39 @@
+#ifndef SUMMATION_H
+#define SUMMATION_H
+
+#include <cmath>    // std::fabs
+
+// 補正付きの和(compensated summation)。小さな値を大きな値に何度も足すとき(位置に速度×刻みを足す、時刻に刻みを足すなど)、
+// 足すたびに切り捨てられる下位の桁を別の変数(error)に取っておき、次に足す値に戻す。
+// 本当の値は sum + error で、誤差は足した回数によらず丸め誤差1〜2回分にとどまる。
+namespace summation {
+    // sum + error に value を足す(Kahan–Babuška–Neumaier)。value の方が大きくても下位の桁を落とさない
+    template <typename T>
+    void add(T& sum, T& error, T value) {
+        const T y = value + error;
+        const T t = sum + y;
+        if (std::fabs(sum) >= std::fabs(y)) {
+            error = (sum - t) + y;
+        } else {
+            error = (y - t) + sum;
+        }
+        sum = t;
+    }
+
+    // 1つの値を補正付きの和で積み上げていくもの(シミュレーション時刻など)
+    template <typename T>
+    class Compensated {
+    public:
+        T sum;
+        T error;
+
+        Compensated(T value = T(0)) : sum(value), error(T(0)) {}
+        Compensated& operator+=(T value) {
+            add(sum, error, value);
+            return *this;
+        }
+        T value() const { return sum + error; }
+    };
+}
+
+#endif
@@ -0,0 +1,125 @@
+// ThreadPoolクラスの実装部分
+
+#include <algorithm>    // std::min
+
+#include "ThreadPool.h"
+
+namespace {
+    thread_local bool insideParallelFor = false;   // このスレッドがparallelForの塊を実行中かどうか(入れ子の判定)
+}
+
+ThreadPool::ThreadPool(unsigned threadCount)
+:   job_(nullptr),
+    remaining_(0),
+    generation_(0),
+    stop_(false)
+{
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0) threadCount = 1;
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    // 0番は呼び出し元が使うので、ワーカーは1番から
+    for (unsigned i = 1; i < threadCount; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::size() const {
+    return static_cast<unsigned>(queues_.size());
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    if (begin >= end) return;
+    if (grain == 0) grain = 1;
+    // スレッドが1つしかない、塊が1つしかない、入れ子で呼ばれた、のどれかならそのまま実行する
+    if (workers_.empty() || end - begin <= grain || insideParallelFor) {
+        body(begin, end);
+        return;
+    }
+
+    // 塊を順番に各スレッドのキューへ配る。隣り合う塊は同じスレッドに行くようにまとめて配る
+    const size_t chunkCount = (end - begin + grain - 1) / grain;
+    const size_t threads = queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &body;
+        remaining_ = chunkCount;
+        for (size_t c = 0; c < chunkCount; ++c) {
+            size_t owner = c * threads / chunkCount;
+            Range range = {begin + c * grain, std::min(end, begin + (c + 1) * grain)};
+            std::lock_guard<std::mutex> queueLock(queues_[owner]->mutex);
+            queues_[owner]->ranges.push_back(range);
+        }
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    // 呼び出し元も0番のスレッドとして働く
+    runTasks(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return remaining_.load() == 0; });
+    job_ = nullptr;
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    unsigned long long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this, seen] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+        }
+        runTasks(index);
+    }
+}
+
+void ThreadPool::runTasks(unsigned index) {
+    Range range;
+    while (pop(index, range) || steal(index, range)) {
+        insideParallelFor = true;
+        (*job_)(range.begin, range.end);    // キューのロックを通して、job_の設定は塊を取る前に見えている
+        insideParallelFor = false;
+        if (remaining_.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::pop(unsigned index, Range& range) {
+    Queue& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.ranges.empty()) return false;
+    range = queue.ranges.back();
+    queue.ranges.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(unsigned index, Range& range) {
+    const size_t threads = queues_.size();
+    for (size_t k = 1; k < threads; ++k) {
+        Queue& queue = *queues_[(index + k) % threads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.ranges.empty()) continue;
+        range = queue.ranges.front();
+        queue.ranges.pop_front();
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,53 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>               // std::atomic
+#include <condition_variable>   // std::condition_variable
+#include <cstddef>              // size_t
+#include <deque>                // std::deque
+#include <functional>           // std::function
+#include <memory>               // std::unique_ptr
+#include <mutex>                // std::mutex
+#include <thread>               // std::thread
+#include <vector>               // std::vector
+
+// 作り置きのスレッドで範囲ループを分担するスレッドプール
+// 範囲は小さな塊(grain)に分けて各スレッドの両端キューに配る。自分のキューが空になったスレッドは
+// 他のスレッドのキューの反対側から塊を盗む(work stealing)ので、木の探索のように塊ごとの重さが違っても偏らない。
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount = 0);   // 0ならハードウェアのスレッド数。呼び出し元のスレッドも1つと数える
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const;  // 計算に参加するスレッド数(呼び出し元を含む)
+
+    // [begin, end) をgrain個ずつに分けて body(塊の始め, 塊の終わり) を並列に呼ぶ。全部終わるまで戻らない
+    // bodyの中から呼ばれた場合(入れ子)はその場で順番に実行する
+    void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+private:
+    struct Range { size_t begin, end; };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;   // queues_[0]は呼び出し元スレッド用
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;      // 新しい仕事が来たことをワーカーに知らせる
+    std::condition_variable done_;      // 全部の塊が終わったことを呼び出し元に知らせる
+    const std::function<void(size_t, size_t)>* job_;
+    std::atomic<size_t> remaining_;     // まだ終わっていない塊の数
+    unsigned long long generation_;     // parallelForを呼んだ回数。ワーカーはこれが変わったら起きる
+    bool stop_;
+
+    void workerLoop(unsigned index);
+    void runTasks(unsigned index);
+    bool pop(unsigned index, Range& range);     // 自分のキューの後ろから取る
+    bool steal(unsigned index, Range& range);   // 他のキューの前から盗む
+};
+
+#endif
@@ -0,0 +1,235 @@
+// 全天体の軌跡をまとめて描く(点はGPUのバッファに置いたまま、書き換わった場所だけを書き込む)
+
+#include <algorithm>    // std::copy
+#include <cstring>      // std::memcpy
+#include <stdexcept>    // std::runtime_error
+#include <string>       // std::string
+
+#include "Frame.h"
+#include "GLFunctions.h"
+#include "TrailRenderer.h"
+
+namespace {
+    const GLuint POINT = 0;     // 頂点属性の番号(シェーダーのlayout(location)と同じ)
+
+    const char* VERSION = "#version 330 compatibility\n";
+
+    // gl_VertexIDはglMultiDrawArraysに渡した最初の頂点の番号から数えるので、Frame::trajectoryの中の点の番号になる
+    const char* VERTEX_SHADER = R"(
+layout(location = 0) in vec3 point;
+uniform samplerBuffer bodies;   // 天体ごとの(色, 一番新しい点の場所)
+uniform int capacity;           // 1天体あたりの点の数(場所はcapacity + 1個。最後は先頭の点の写し)
+uniform float fade;
+
+out vec3 color;
+
+void main() {
+    int body = gl_VertexID / (capacity + 1);
+    int slot = gl_VertexID - body * (capacity + 1);
+    vec4 info = texelFetch(bodies, body);
+    int age = (int(info.a) - slot + capacity) % capacity;  // 一番新しい点が0(最後の写しの場所はcapacityなので、先頭と同じ年齢になる)
+    color = info.rgb * (1.0 - fade * float(age) / float(max(capacity - 1, 1)));
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(point, 1.0);
+}
+)";
+
+    const char* FRAGMENT_SHADER = R"(
+in vec3 color;
+out vec4 fragColor;
+
+void main() {
+    fragColor = vec4(color, 1.0);
+}
+)";
+
+    const GLbitfield PERSISTENT = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+}
+
+TrailRenderer::TrailRenderer()
+:   fade(0.7f),
+    vertexArray_(0),
+    pointBuffer_(0),
+    bodyBuffer_(0),
+    bodyTexture_(0),
+    program_(0),
+    capacityLocation_(-1),
+    fadeLocation_(-1),
+    mapped_(nullptr),
+    fence_(nullptr),
+    bodies_(0),
+    capacity_(0),
+    version_(0),
+    statistics_()
+{
+}
+
+void TrailRenderer::init() {
+    if (isReady()) return;
+    if (!gl::isLoaded()) throw std::runtime_error("OpenGL 3.3 functions are not loaded");
+
+    program_ = gl::buildProgram(std::string(VERSION) + VERTEX_SHADER, std::string(VERSION) + FRAGMENT_SHADER);
+    capacityLocation_ = gl::getUniformLocation(program_, "capacity");
+    fadeLocation_ = gl::getUniformLocation(program_, "fade");
+
+    // 天体ごとの値はテクスチャバッファにして、シェーダーから天体の番号で読む(samplerはテクスチャユニット0のまま)
+    gl::genBuffers(1, &bodyBuffer_);
+    glGenTextures(1, &bodyTexture_);
+    gl::genVertexArrays(1, &vertexArray_);
+    // 点のバッファは最初のdraw()で、Frameの大きさに合わせて作る
+}
+
+void TrailRenderer::destroy() {
+    if (!isReady()) return;
+    waitFence();
+    if (mapped_) {
+        gl::bindBuffer(GL_ARRAY_BUFFER, pointBuffer_);
+        gl::unmapBuffer(GL_ARRAY_BUFFER);
+        gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+        mapped_ = nullptr;
+    }
+    if (pointBuffer_) gl::deleteBuffers(1, &pointBuffer_);
+    gl::deleteBuffers(1, &bodyBuffer_);
+    glDeleteTextures(1, &bodyTexture_);
+    gl::deleteVertexArrays(1, &vertexArray_);
+    gl::deleteProgram(program_);
+    vertexArray_ = pointBuffer_ = bodyBuffer_ = bodyTexture_ = program_ = 0;
+    bodies_ = capacity_ = 0;
+    serials_.clear();
+}
+
+bool TrailRenderer::isReady() const {
+    return program_ != 0;
+}
+
+bool TrailRenderer::isPersistent() const {
+    return gl::bufferStorage != nullptr;
+}
+
+void TrailRenderer::rebuild(const Frame& frame) {
+    waitFence();
+    if (mapped_) {
+        gl::bindBuffer(GL_ARRAY_BUFFER, pointBuffer_);
+        gl::unmapBuffer(GL_ARRAY_BUFFER);
+        mapped_ = nullptr;
+    }
+    if (pointBuffer_) gl::deleteBuffers(1, &pointBuffer_);     // glBufferStorageで作ったバッファは大きさを変えられないので作り直す
+
+    const size_t n = frame.bodies.size();
+    const GLsizeiptr bytes = static_cast<GLsizeiptr>(frame.trajectory.size() * sizeof(GLfloat));
+    gl::genBuffers(1, &pointBuffer_);
+    gl::bindBuffer(GL_ARRAY_BUFFER, pointBuffer_);
+    if (isPersistent()) {
+        gl::bufferStorage(GL_ARRAY_BUFFER, bytes, frame.trajectory.data(), PERSISTENT);
+        mapped_ = static_cast<float*>(gl::mapBufferRange(GL_ARRAY_BUFFER, 0, bytes, PERSISTENT));
+    } else {
+        gl::bufferData(GL_ARRAY_BUFFER, bytes, frame.trajectory.data(), GL_DYNAMIC_DRAW);
+    }
+    gl::bindVertexArray(vertexArray_);
+    gl::enableVertexAttribArray(POINT);
+    gl::vertexAttribPointer(POINT, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    gl::bindVertexArray(0);
+    gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    bodies_ = n;
+    capacity_ = frame.trajectoryCapacity;
+    version_ = frame.trajectoryVersion;
+    serials_.resize(n);
+    for (size_t i = 0; i < n; ++i) serials_[i] = frame.bodies[i].trajectorySerial;
+    statistics_.uploadedPoints = n * (capacity_ + 1);
+    statistics_.rebuilt = true;
+}
+
+void TrailRenderer::update(const Frame& frame) {
+    const size_t slots = capacity_ + 1;
+    size_t uploaded = 0;
+    if (mapped_) {
+        // 前のフレームの描画がまだ点を読んでいるかもしれないので、終わるのを待ってから書く
+        waitFence();
+        for (size_t i = 0; i < bodies_; ++i) {
+            const float* source = frame.trajectory.data() + i * slots * 3;
+            float* destination = mapped_ + i * slots * 3;
+            frame.trajectoryView(i).changedSince(serials_[i], [&](size_t first, size_t count) {
+                std::memcpy(destination + first * 3, source + first * 3, count * 3 * sizeof(GLfloat));
+                uploaded += count;
+            });
+            serials_[i] = frame.bodies[i].trajectorySerial;
+        }
+    } else {
+        gl::bindBuffer(GL_ARRAY_BUFFER, pointBuffer_);
+        for (size_t i = 0; i < bodies_; ++i) {
+            const size_t base = i * slots * 3;
+            frame.trajectoryView(i).changedSince(serials_[i], [&](size_t first, size_t count) {
+                gl::bufferSubData(GL_ARRAY_BUFFER, (base + first * 3) * sizeof(GLfloat), count * 3 * sizeof(GLfloat),
+                                  frame.trajectory.data() + base + first * 3);
+                uploaded += count;
+            });
+            serials_[i] = frame.bodies[i].trajectorySerial;
+        }
+        gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    statistics_.uploadedPoints = uploaded;
+    statistics_.rebuilt = false;
+}
+
+void TrailRenderer::waitFence() {
+    if (!fence_) return;
+    const GLsync fence = static_cast<GLsync>(fence_);
+    GLenum result = gl::clientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    while (result == GL_TIMEOUT_EXPIRED) result = gl::clientWaitSync(fence, 0, 1000000000);
+    gl::deleteSync(fence);
+    fence_ = nullptr;
+}
+
+void TrailRenderer::draw(const Frame& frame) {
+    if (!isReady()) return;
+    statistics_ = Statistics();
+    const size_t n = frame.bodies.size();
+    if (n == 0 || frame.trajectoryCapacity == 0) return;
+
+    if (!pointBuffer_ || n != bodies_ || frame.trajectoryCapacity != capacity_ || frame.trajectoryVersion != version_) {
+        rebuild(frame);
+    } else {
+        update(frame);
+    }
+
+    // 天体ごとの色と一番新しい点の場所、線ごとの最初の頂点の番号と数
+    bodyValues_.resize(n * 4);
+    firsts_.clear();
+    counts_.clear();
+    for (size_t i = 0; i < n; ++i) {
+        const Frame::Body& body = frame.bodies[i];
+        std::copy(body.color, body.color + 3, bodyValues_.begin() + i * 4);
+        bodyValues_[i * 4 + 3] = static_cast<float>(body.trajectoryHead);
+        const float* first[2];
+        size_t count[2];
+        const int segments = frame.trajectoryView(i).segments(first, count);
+        for (int s = 0; s < segments; ++s) {
+            if (count[s] < 2) continue;     // 1点だけの線は描くものがない
+            firsts_.push_back(static_cast<int>((first[s] - frame.trajectory.data()) / 3));
+            counts_.push_back(static_cast<int>(count[s]));
+        }
+    }
+    gl::bindBuffer(GL_TEXTURE_BUFFER, bodyBuffer_);
+    gl::bufferData(GL_TEXTURE_BUFFER, bodyValues_.size() * sizeof(GLfloat), bodyValues_.data(), GL_STREAM_DRAW);
+    gl::bindBuffer(GL_TEXTURE_BUFFER, 0);
+    statistics_.strips = firsts_.size();
+    if (firsts_.empty()) return;
+
+    gl::useProgram(program_);
+    gl::uniform1i(capacityLocation_, static_cast<GLint>(capacity_));
+    gl::uniform1f(fadeLocation_, fade);
+    glBindTexture(GL_TEXTURE_BUFFER, bodyTexture_);
+    gl::texBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bodyBuffer_);
+
+    gl::bindVertexArray(vertexArray_);
+    gl::multiDrawArrays(GL_LINE_STRIP, firsts_.data(), counts_.data(), static_cast<GLsizei>(firsts_.size()));
+    if (mapped_) fence_ = gl::fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    gl::bindVertexArray(0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    gl::useProgram(0);
+}
+
+const TrailRenderer::Statistics& TrailRenderer::getStatistics() const {
+    return statistics_;
+}
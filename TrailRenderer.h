@@ -0,0 +1,70 @@
+#ifndef TRAILRENDERER_H
+#define TRAILRENDERER_H
+
+#include <cstddef>  // size_t
+#include <vector>   // std::vector
+
+struct Frame;
+
+// 全天体の軌跡を1回の描画命令(glMultiDrawArrays)でまとめて描く。
+//
+// 軌跡の点はFrame::trajectory(Universe::trajectoriesと同じ、天体ごとに capacity + 1 点の環状バッファの並び)のままGPUのバッファに置いておき、
+// 毎フレーム、前のフレームから書き換わった場所(ふつうは天体ごとに一番新しい点の1〜2点)だけを書き込む。軌跡が長くても、渡す量は天体の数で決まる。
+// OpenGL 4.4のglBufferStorageが使えるときは、バッファをずっとメモリに対応付けたまま(persistent mapping)にして直接書き、
+// 使えなければglBufferSubDataで場所ごとに渡す。
+//
+// 環の継ぎ目をまたぐ軌跡は、TrajectoryStore::View::segments()と同じく2本の線(バッファの中の最初の頂点の番号と数)に分けて描く。
+// 頂点シェーダーは頂点の番号(gl_VertexID)から天体と環の中の場所を求め、天体ごとの色と、古い点ほど暗くする割合(fade)を決める。
+//
+// OpenGL 3.3以降の関数を使うので、gl::load()が成功してからinit()する。使えないときはFrame::drawTrajectory()で1本ずつ描く。
+// OpenGLに依存するので、ヘッドレスビルドではリンクしない。
+class TrailRenderer {
+public:
+    // 直前のdraw()で行ったこと
+    struct Statistics {
+        size_t strips;          // 描いた線の数(継ぎ目をまたぐ軌跡は2本)
+        size_t uploadedPoints;  // GPUに書き込んだ点の数
+        bool rebuilt;           // バッファを作り直して全部を書き込んだか
+    };
+
+    float fade;     // 容量いっぱいの一番古い点を何割暗くするか(0なら全部同じ明るさ。初期値0.7)
+
+    TrailRenderer();
+
+    void init();            // 今のコンテキストでシェーダーを作る。作れなければstd::runtime_error
+    void destroy();         // 作ったものを消す(コンテキストを消す前に呼ぶ)
+    bool isReady() const;   // init()が成功したか
+    bool isPersistent() const;  // 点のバッファをずっと対応付けたまま書いているか(glBufferStorageが使えるか)
+
+    // frameの全天体の軌跡を描く。今の投影行列・モデルビュー行列を使う
+    void draw(const Frame& frame);
+    const Statistics& getStatistics() const;
+
+private:
+    unsigned vertexArray_;
+    unsigned pointBuffer_;      // Frame::trajectoryと同じ並びの点
+    unsigned bodyBuffer_;       // 天体ごとの(r, g, b, 一番新しい点の場所)
+    unsigned bodyTexture_;      // bodyBuffer_をシェーダーから読むためのテクスチャ
+    unsigned program_;
+    int capacityLocation_;
+    int fadeLocation_;
+    float* mapped_;             // 対応付けたpointBuffer_(persistent mappingを使わないときはnullptr)
+    void* fence_;               // mapped_に書く前に、前のフレームの描画が点を読み終わるのを待つための同期オブジェクト(GLsync)
+
+    // pointBuffer_の中身がどのFrameの状態と同じか
+    size_t bodies_;
+    size_t capacity_;
+    unsigned long long version_;
+    std::vector<unsigned long long> serials_;   // 天体ごとの、書き込んだ一番新しい点の通し番号
+
+    Statistics statistics_;
+    std::vector<float> bodyValues_; // bodyBuffer_に渡す値
+    std::vector<int> firsts_;   // glMultiDrawArraysに渡す、線ごとの最初の頂点の番号と数
+    std::vector<int> counts_;
+
+    void rebuild(const Frame& frame);   // pointBuffer_をframeの大きさで作り直し、全部を書き込む
+    void update(const Frame& frame);    // 書き換わった場所だけを書き込む
+    void waitFence();
+};
+
+#endif
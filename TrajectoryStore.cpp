@@ -0,0 +1,137 @@
+#include "TrajectoryStore.h"
+
+TrajectoryStore::View::View(const float* ring, size_t capacity, size_t head, size_t count, unsigned long long serial)
+:   ring_(ring),
+    capacity_(capacity),
+    head_(head),
+    count_(count),
+    serial_(serial)
+{
+}
+
+size_t TrajectoryStore::View::size() const { return count_; }
+size_t TrajectoryStore::View::head() const { return head_; }
+const float* TrajectoryStore::View::ring() const { return ring_; }
+unsigned long long TrajectoryStore::View::serial() const { return serial_; }
+
+std::tuple<float, float, float> TrajectoryStore::View::operator[](size_t k) const {
+    // 一番古い点は head - (count - 1)
+    size_t slot = (head_ + capacity_ + 1 - count_ + k) % capacity_;
+    const float* p = ring_ + 3 * slot;
+    return std::make_tuple(p[0], p[1], p[2]);
+}
+
+int TrajectoryStore::View::segments(const float* first[2], size_t count[2]) const {
+    if (count_ == 0) return 0;
+    const size_t oldest = (head_ + capacity_ + 1 - count_) % capacity_;
+    if (oldest <= head_) {
+        first[0] = ring_ + 3 * oldest;
+        count[0] = count_;
+        return 1;
+    }
+    // 継ぎ目をまたぐ。1つ目は最後の写しの点(先頭の点と同じ)まで含める
+    first[0] = ring_ + 3 * oldest;
+    count[0] = capacity_ + 1 - oldest;
+    first[1] = ring_;
+    count[1] = head_ + 1;
+    return 2;
+}
+
+TrajectoryStore::TrajectoryStore(size_t capacityInput)
+:   sampling(Sampling::Stride),
+    stride(1),
+    minDistance(0.0f),
+    capacity_(capacityInput < 1 ? 1 : capacityInput),
+    version_(0)
+{
+}
+
+void TrajectoryStore::setCapacity(size_t capacityInput) {
+    capacity_ = capacityInput < 1 ? 1 : capacityInput;
+    const size_t n = rings_.size();
+    points_.assign(n * (capacity_ + 1) * 3, 0.0f);
+    for (size_t i = 0; i < n; ++i) clear(i);
+    ++version_;
+}
+
+size_t TrajectoryStore::capacity() const {
+    return capacity_;
+}
+
+void TrajectoryStore::resize(size_t bodies) {
+    const size_t old = rings_.size();
+    points_.resize(bodies * (capacity_ + 1) * 3, 0.0f);
+    rings_.resize(bodies);
+    for (size_t i = old; i < bodies; ++i) clear(i);
+}
+
+size_t TrajectoryStore::size() const {
+    return rings_.size();
+}
+
+void TrajectoryStore::clear(size_t index) {
+    Ring& r = rings_[index];
+    r.head = 0;
+    r.count = 0;
+    r.steps = 0;
+    r.last[0] = r.last[1] = r.last[2] = 0.0f;
+    r.committed = false;
+    // 通し番号はheadに合わせてcapacityの倍数にし、写す側が全体を写し直すように容量より大きく進める
+    r.serial = (r.serial / capacity_ + 2) * capacity_;
+}
+
+unsigned long long TrajectoryStore::version() const {
+    return version_;
+}
+
+void TrajectoryStore::record(size_t index, float x, float y, float z) {
+    Ring& r = rings_[index];
+    if (r.count == 0) {
+        // 最初の点は確定した点として記録する
+        write(index, 0, x, y, z);
+        r.head = 0;
+        r.count = 1;
+        r.steps = 0;
+        r.last[0] = x; r.last[1] = y; r.last[2] = z;
+        r.committed = true;
+        return;
+    }
+    ++r.steps;
+    if (r.committed) {
+        // 一番新しい点は確定しているので、次の場所へ進む(いっぱいなら一番古い点に上書きする)
+        r.head = (r.head + 1) % capacity_;
+        ++r.serial;
+        if (r.count < capacity_) ++r.count;
+        r.committed = false;
+    }
+    // 今の位置を一番新しい点に書く
+    write(index, r.head, x, y, z);
+    if (sampling == Sampling::Distance) {
+        const float dx = x - r.last[0], dy = y - r.last[1], dz = z - r.last[2];
+        r.committed = dx*dx + dy*dy + dz*dz >= minDistance * minDistance;
+    } else {
+        r.committed = r.steps >= stride;
+    }
+    if (r.committed) {
+        r.last[0] = x; r.last[1] = y; r.last[2] = z;
+        r.steps = 0;
+    }
+}
+
+TrajectoryStore::View TrajectoryStore::view(size_t index) const {
+    const Ring& r = rings_[index];
+    return View(points_.data() + index * (capacity_ + 1) * 3, capacity_, r.head, r.count, r.serial);
+}
+
+float* TrajectoryStore::ring(size_t index) {
+    return points_.data() + index * (capacity_ + 1) * 3;
+}
+
+void TrajectoryStore::write(size_t index, size_t slot, float x, float y, float z) {
+    float* p = ring(index);
+    p[3 * slot] = x; p[3 * slot + 1] = y; p[3 * slot + 2] = z;
+    // 先頭の点は最後の写しにも書く(継ぎ目をまたいで線をつなぐため)
+    if (slot == 0) {
+        p[3 * capacity_] = x; p[3 * capacity_ + 1] = y; p[3 * capacity_ + 2] = z;
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef TRAJECTORYSTORE_H
+#define TRAJECTORYSTORE_H
+
+#include <cstddef>  // size_t
+#include <tuple>    // std::tuple
+#include <vector>   // std::vector
+
+// 全天体の軌跡を1つのメモリブロックにまとめて持つ。天体ごとに決まった数(capacity)の点を入れる環状バッファ(ring buffer)で、
+// いっぱいになったら一番古い点に上書きする。点を記録するときにメモリの確保や移動は起こらない(確保するのは天体を追加したときと容量を変えたときだけ)。
+//
+// 点は x, y, z の順に並べ、天体ごとに capacity + 1 点分の場所を取る。最後の1点は先頭の点の写しで、
+// 環の継ぎ目(最後の点から先頭の点へ)をまたぐ軌跡も、2つの連続した配列(segments)として線で描ける。
+//
+// 一番新しい点はいつも天体の今の位置(確定するまで毎回上書きする)で、記録する条件を満たしたらそれを確定し、次の記録から次の場所に書く。
+// そのため軌跡は間引いても天体の所まで途切れずにつながる。
+//
+// 点の場所が進むたびに天体ごとの通し番号(serial)を1つ増やす。軌跡を写して持つ側(Frame、TrailRenderer)は、写したときの通し番号を覚えておけば、
+// 次からはView::changedSince()で書き換わった場所だけを写せばよい(ふつうは1ステップに1〜2点)。
+class TrajectoryStore {
+    friend class Snapshot;  // 保存と読み込みのために中身を直接読み書きする
+public:
+    // 点を確定する条件
+    enum class Sampling {
+        Stride,     // strideステップごと
+        Distance    // 直前に確定した点からminDistance以上離れたとき(速く動く所ほど細かくなる)
+    };
+
+    Sampling sampling;
+    size_t stride;          // Strideのときの間隔[ステップ]。1なら毎ステップ
+    float minDistance;      // Distanceのときの間隔(シミュレーション単位の距離)
+
+    static constexpr unsigned long long NO_SERIAL = ~0ULL;   // View::changedSince()に渡すと、全部の場所が書き換わったとみなす
+
+    // 1つの天体の軌跡を古い順に見るもの。天体を追加したり容量を変えたりすると使えなくなる
+    class View {
+    public:
+        class Iterator {
+        public:
+            Iterator(const View* view, size_t k) : view_(view), k_(k) {}
+            std::tuple<float, float, float> operator*() const { return (*view_)[k_]; }
+            Iterator& operator++() { ++k_; return *this; }
+            bool operator!=(const Iterator& other) const { return k_ != other.k_; }
+        private:
+            const View* view_;
+            size_t k_;
+        };
+
+        View(const float* ring, size_t capacity, size_t head, size_t count, unsigned long long serial);
+        size_t size() const;    // 点の数
+        size_t head() const;    // 一番新しい点の場所
+        const float* ring() const;  // capacity + 1 点の並び全体(場所の順)
+        unsigned long long serial() const;  // 一番新しい点の通し番号
+        std::tuple<float, float, float> operator[](size_t k) const;    // k番目に古い点
+        Iterator begin() const { return Iterator(this, 0); }
+        Iterator end() const { return Iterator(this, count_); }
+        // 点を古い順に並んだ連続した配列(xyzの並び)に分ける。分けた数(0〜2)を返す。
+        // 2つに分かれたとき、1つ目の最後の点と2つ目の最初の点は同じ点なので、それぞれを線でつなげば1本の線になる
+        int segments(const float* first[2], size_t count[2]) const;
+        // 通し番号sinceの点を写したあとに書き換わった場所(sinceの点も含む。一番新しい点は確定するまで上書きされるので)を、
+        // 連続した場所の範囲ごとに callback(最初の場所, 場所の数) で知らせる。場所はcapacity + 1個の並びの中の番号で、先頭の点の写しも含める
+        template <typename Callback>
+        void changedSince(unsigned long long since, Callback callback) const {
+            if (since > serial_ || serial_ - since >= capacity_) {
+                callback(size_t(0), capacity_ + 1);
+                return;
+            }
+            const size_t first = static_cast<size_t>(since % capacity_);
+            if (first <= head_) {
+                callback(first, head_ - first + 1);
+                if (first == 0) callback(capacity_, size_t(1));
+            } else {
+                callback(first, capacity_ + 1 - first);
+                callback(size_t(0), head_ + 1);
+            }
+        }
+    private:
+        const float* ring_;
+        size_t capacity_;
+        size_t head_;   // 一番新しい点の場所
+        size_t count_;
+        unsigned long long serial_;
+    };
+
+    TrajectoryStore(size_t capacityInput);
+
+    void setCapacity(size_t capacityInput);     // 1天体あたりの点の数を変える。記録した軌跡は消える
+    size_t capacity() const;
+    void resize(size_t bodies);     // 天体の数を変える。増えた天体の軌跡は空
+    size_t size() const;
+    void clear(size_t index);       // 1つの天体の軌跡を消す
+    // 容量を変えたり読み込んだりして、通し番号では書き換わった所が分からなくなるたびに増える
+    unsigned long long version() const;
+
+    // 天体indexの今の位置を記録する。天体ごとに別の場所に書くので、違う天体なら別々のスレッドから呼んでよい
+    void record(size_t index, float x, float y, float z);
+    View view(size_t index) const;
+
+private:
+    // 天体ごとの環状バッファの状態
+    struct Ring {
+        size_t head;        // 一番新しい点(今の位置)の場所
+        size_t count;       // 点の数(今の位置を含む)
+        size_t steps;       // 直前に確定してからのステップ数
+        float last[3];      // 直前に確定した点
+        bool committed;     // 一番新しい点が確定しているか(次の記録は次の場所に書く)
+        unsigned long long serial;  // 一番新しい点の通し番号(capacityで割った余りがhead)
+    };
+
+    size_t capacity_;
+    unsigned long long version_;
+    std::vector<float> points_;     // 天体ごとに (capacity_ + 1) * 3 個
+    std::vector<Ring> rings_;
+
+    float* ring(size_t index);
+    void write(size_t index, size_t slot, float x, float y, float z);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>   // std::atomic
+
+// 書く側のスレッド1つから読む側のスレッド1つへ、一番新しい値を待たずに渡すための3つの入れ物(triple buffer)。
+//
+// 書く側はback()に書いてpublish()し、読む側はlatest()で最後にpublish()されたものを受け取る。
+// 3つの入れ物を「書く側が使っている」「受け渡し用」「読む側が使っている」に分け、publish()とlatest()は
+// 受け渡し用の番号を自分の番号と1回のexchangeで入れ替えるだけなので、どちらもロックせず、相手を待つこともない。
+// 読む側は次にlatest()を呼ぶまで同じ入れ物を持っているので、その間に書く側が何回publish()しても中身は変わらない。
+// 読む側が受け取る前に次がpublish()されたものは読まれずに捨てられる(書く側の速さは読む側に縛られない)。
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : back_(0), middle_(1), front_(2) {}
+
+    T& back() { return slots_[back_]; }     // 書く側: 次に渡すものを書く入れ物(前に書いた内容が残っているとは限らない)
+    void publish() {                        // 書く側: back()に書いたものを渡す
+        back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    const T& latest() {                     // 読む側: 最後にpublish()されたもの(まだ何も渡されていなければTの初期値)
+        if (middle_.load(std::memory_order_acquire) & FRESH) {
+            front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+        }
+        return slots_[front_];
+    }
+
+private:
+    static const unsigned INDEX = 3;    // 受け渡し用の番号
+    static const unsigned FRESH = 4;    // 受け渡し用の入れ物に読む側がまだ受け取っていないものが入っている
+
+    T slots_[3];
+    unsigned back_;                             // 書く側だけが触る
+    alignas(64) std::atomic<unsigned> middle_;  // 両方が触る(ほかの番号と同じキャッシュラインに置かない)
+    alignas(64) unsigned front_;                // 読む側だけが触る
+};
+
+#endif
@@ -1,6 +1,11 @@
 // #include <cmath>
 // #include <vector>
 #include <chrono>
+#include <algorithm>    // std::copy, std::max, std::min
+#include <cfloat>       // DBL_EPSILON
+#include <cmath>        // std::cbrt, std::isfinite, std::pow, std::sqrt
+#include <limits>       // std::numeric_limits
+#include <stdexcept>    // std::runtime_error
 
 #include "Universe.h"
 #include "Sphere.h"
@@ -8,10 +13,205 @@
 #include "Geometry.h"
 
 
+namespace {
+    const size_t FORCE_GRAIN = 64;      // 直接計算で1つの塊にする天体の数(1天体あたりO(N)の仕事)。SIMDの幅(16)の倍数にしておく
+    const size_t BODY_GRAIN = 4096;     // 位置・速度の更新で1つの塊にする天体の数(1天体あたりO(1)の仕事)
+
+    // シンプレクティック積分法の係数。Kick-Drift-Kickの並びで、Driftがstages回、Kickがstages+1回
+    const int MAX_SYMPLECTIC_STAGES = 7;
+    struct SymplecticScheme {
+        int stages;
+        double drift[MAX_SYMPLECTIC_STAGES];
+        double kick[MAX_SYMPLECTIC_STAGES + 1];
+    };
+
+    // 蛙飛び法(KDK)を重み w[0], ..., w[m-1] で続けて行うときの係数。隣り合うKickはまとめる
+    SymplecticScheme composeLeapfrog(const double* w, int m) {
+        SymplecticScheme scheme = {};
+        scheme.stages = m;
+        for (int k = 0; k < m; ++k) {
+            scheme.drift[k] = w[k];
+            scheme.kick[k] += 0.5 * w[k];
+            scheme.kick[k + 1] += 0.5 * w[k];
+        }
+        return scheme;
+    }
+
+    SymplecticScheme makeYoshida4() {
+        // Yoshida (1990) / Forest & Ruth (1990) の3段の組み合わせ
+        const double w1 = 1.0 / (2.0 - std::cbrt(2.0));
+        const double w0 = -std::cbrt(2.0) * w1;
+        const double w[3] = {w1, w0, w1};
+        return composeLeapfrog(w, 3);
+    }
+
+    SymplecticScheme makeYoshida6() {
+        // Yoshida (1990) の6次、解A
+        const double w1 = -1.17767998417887;
+        const double w2 = 0.235573213359357;
+        const double w3 = 0.784513610477560;
+        const double w0 = 1.0 - 2.0 * (w1 + w2 + w3);
+        const double w[7] = {w3, w2, w1, w0, w1, w2, w3};
+        return composeLeapfrog(w, 7);
+    }
+
+    SymplecticScheme makePEFRL() {
+        // Omelyan, Mryglod & Folk (2002) のPEFRL(速度版)。Forest–Ruthの4次と同じ形で、誤差の係数が数十分の1になる
+        const double xi = 0.1786178958448091;
+        const double lambda = -0.2123418310626054;
+        const double chi = -0.06626458266981849;
+        SymplecticScheme scheme = {};
+        scheme.stages = 4;
+        const double drift[4] = {0.5 * (1.0 - 2.0 * lambda), lambda, lambda, 0.5 * (1.0 - 2.0 * lambda)};
+        const double kick[5] = {xi, chi, 1.0 - 2.0 * (chi + xi), chi, xi};
+        for (int k = 0; k < 4; ++k) scheme.drift[k] = drift[k];
+        for (int k = 0; k < 5; ++k) scheme.kick[k] = kick[k];
+        return scheme;
+    }
+
+    // Dormand–Prince 5(4)次の係数(Hairer, Nørsett & Wanner の DOPRI5)
+    // 7段目の点が5次の解で、その点の傾きは次のステップの1段目になる(FSAL)。力の計算は1ステップ6回
+    const int DOPRI_STAGES = 7;
+    const double DOPRI_A[DOPRI_STAGES][DOPRI_STAGES - 1] = {
+        {},
+        {1.0/5},
+        {3.0/40, 9.0/40},
+        {44.0/45, -56.0/15, 32.0/9},
+        {19372.0/6561, -25360.0/2187, 64448.0/6561, -212.0/729},
+        {9017.0/3168, -355.0/33, 46732.0/5247, 49.0/176, -5103.0/18656},
+        {35.0/384, 0.0, 500.0/1113, 125.0/192, -2187.0/6784, 11.0/84}
+    };
+    // 5次の解と4次の解の差(誤差の見積もり)の係数
+    const double DOPRI_E[DOPRI_STAGES] = {
+        71.0/57600, 0.0, -71.0/16695, 71.0/1920, -17253.0/339200, 22.0/525, -1.0/40
+    };
+    // 位置の誤差を各段の加速度から求める係数 Σ_j e_j a_jm (Σ e_j (v_j - v_1) を h Σ a_jm k_m で書き直したもの)
+    const double DOPRI_POSITION_E[DOPRI_STAGES] = {
+        611.0/230400, 0.0, -514.0/83475, 391.0/38400, -4617.0/1356800, -11.0/3360, 0.0
+    };
+    // 補間(dense output)の係数
+    const double DOPRI_D[DOPRI_STAGES] = {
+        -12715105075.0/11282082432, 0.0, 87487479700.0/32700410799, -10690763975.0/1880347072,
+        701980252875.0/199316789632, -1453857185.0/822651844, 69997945.0/29380423
+    };
+    const double DOPRI_SAFETY = 0.9;        // 次の刻みを少し控えめにする
+    const double DOPRI_MIN_SCALE = 0.2;     // 1回で刻みを縮める限度
+    const double DOPRI_MAX_SCALE = 5.0;     // 1回で刻みを伸ばす限度
+    const float DOPRI_FLOOR = 1e-3f;        // 誤差の基準に使う加速度の下限(系全体での最大値に対する比)。ほとんど引かれていない天体のため
+    const double DOPRI_NOISE = 0.3;         // 位置の表せる細かさから来る加速度の誤差のうち、誤差の見積もりに出てくる割合の目安
+    // 許容誤差の下限。主星と衛星の間の力の丸めは天体ごとに別に見込む(dopriNoise_)ので、これはどの天体にもある分。
+    // floatの位置で何体かの引力を足すと、打ち消し合う所では相対1e-6程度の誤差を含む(8の字解の真ん中の天体など)。
+    // これより小さい許容誤差を指定すると、丸め誤差を誤差と見なして刻みを縮め続けてしまう
+    const float DOPRI_MIN_TOLERANCE = 3e-6f;
+    const float DOPRI_MIN_TOLERANCE_PRECISE = 1e-12f;    // doubleの状態での下限
+    const double DOPRI_MIN_MOTION = 16.0;   // 1刻みで一番速く動く天体が少なくともこのulp数だけ動く刻みを下限にする
+
+    // 状態の6成分(位置と速度)と、その傾きが入っている配列
+    template <typename Real>
+    Real* BasicBodyStore<Real>::* valueArray(int q) {
+        typedef BasicBodyStore<Real> Store;
+        static Real* Store::* const arrays[6] = {&Store::x, &Store::y, &Store::z, &Store::vx, &Store::vy, &Store::vz};
+        return arrays[q];
+    }
+    template <typename Real>
+    Real* BasicBodyStore<Real>::* slopeArray(int q) {
+        typedef BasicBodyStore<Real> Store;
+        static Real* Store::* const arrays[6] = {&Store::vx, &Store::vy, &Store::vz, &Store::ax, &Store::ay, &Store::az};
+        return arrays[q];
+    }
+
+    // Hermite法のブロック刻み。刻みは HERMITE_MAX_STEP / 2^k (k = 0, 1, ..., HERMITE_LEVELS)
+    const int HERMITE_LEVELS = 32;
+    const unsigned long long HERMITE_MAX_TICKS = 1ULL << HERMITE_LEVELS;
+    const double HERMITE_MAX_STEP = 4194304.0;      // 最大の刻み[s] (2^22秒 = 約49日)
+    const double HERMITE_TICK = HERMITE_MAX_STEP / HERMITE_MAX_TICKS;   // 時刻の単位[s] (約1ミリ秒)
+    const float HERMITE_START_ETA = 0.01f;          // 最初の刻み η_s |a| / |j| の係数
+    const double HERMITE_MIN_MOTION = 16.0;         // 1刻みで位置が少なくともこのulp数だけ動く刻みを下限にする
+
+    // 刻みの候補[s]以下で一番大きい、2の累乗の刻み(ticks)
+    unsigned long long quantizeStep(double step) {
+        unsigned long long ticks = HERMITE_MAX_TICKS;
+        while (ticks > 1 && ticks * HERMITE_TICK > step) ticks >>= 1;
+        return ticks;
+    }
+
+    // シミュレーション単位では躍度などの2乗がfloatの範囲(1e-38)を下回るので、doubleで計算する
+    double norm(double x, double y, double z) {
+        return std::sqrt(x*x + y*y + z*z);
+    }
+
+    const SymplecticScheme& symplecticScheme(IntegrationMethod method) {
+        static const double one[1] = {1.0};
+        static const SymplecticScheme leapfrog = composeLeapfrog(one, 1);
+        static const SymplecticScheme yoshida4 = makeYoshida4();
+        static const SymplecticScheme yoshida6 = makeYoshida6();
+        static const SymplecticScheme pefrl = makePEFRL();
+        switch (method) {
+            case IntegrationMethod::Yoshida4:   return yoshida4;
+            case IntegrationMethod::Yoshida6:   return yoshida6;
+            case IntegrationMethod::PEFRL: return pefrl;
+            default:                            return leapfrog;
+        }
+    }
+
+    // stateの位置・速度とμから保存量を計算する
+    template <typename Real>
+    Diagnostics diagnosticsOf(const BasicBodyStore<Real>& state) {
+        Diagnostics d = {};
+        const size_t n = state.size();
+        for (size_t i = 0; i < n; ++i) {
+            const double mu = state.mu[i];
+            const double x = state.x[i], y = state.y[i], z = state.z[i];
+            const double vx = state.vx[i], vy = state.vy[i], vz = state.vz[i];
+            d.kinetic += 0.5 * mu * (vx * vx + vy * vy + vz * vz);
+            d.momentum[0] += mu * vx;
+            d.momentum[1] += mu * vy;
+            d.momentum[2] += mu * vz;
+            d.angularMomentum[0] += mu * (y * vz - z * vy);
+            d.angularMomentum[1] += mu * (z * vx - x * vz);
+            d.angularMomentum[2] += mu * (x * vy - y * vx);
+            if (mu == 0.0) continue;
+            for (size_t j = i + 1; j < n; ++j) {
+                const double dx = state.x[j] - x, dy = state.y[j] - y, dz = state.z[j] - z;
+                const double r = std::sqrt(dx * dx + dy * dy + dz * dz);
+                if (r > 0.0) d.potential -= mu * state.mu[j] / r;
+            }
+        }
+        d.energy = d.kinetic + d.potential;
+        return d;
+    }
+}
+
 // コンストラクタで積分手法を指定できるようにする
-Universe::Universe(IntegrationMethod method, std::chrono::system_clock::time_point startTime)
-:   integrationMethod(method),  // 数値積分の方法
-    simulationTime_(-1*scaling::DT*INITIAL_WAITING_PERIOD),   // simulationTimeの初期値:0を上回らないと開始しないので、マイナスの値を入れることで開始までのカウントダウンをしている。
+Universe::Universe(IntegrationMethod method, std::chrono::system_clock::time_point startTime, float waitingPeriod)
+:   trajectories(TRAJECTORYLENGTH),
+    integrationMethod(method),  // 数値積分の方法
+    precision(Precision::Single),
+    compensatedSummation(true),
+    localFrames(true),
+    forceMethod(ForceMethod::Direct),
+    directIsa(gravity::detectIsa()),
+    hermiteEta(0.02f),
+    adaptiveTolerance(1e-5f),
+    errorValid_(false),
+    preciseReady_(false),
+    preciseAccelerationsValid_(false),
+    localReady_(true),
+    localAccelerationsValid_(false),
+    accelerationsValid_(false),
+    adaptiveReady_(false),
+    adaptivePrecision_(Precision::Single),
+    adaptiveTime_(0.0),
+    stepBegin_(0.0),
+    stepEnd_(0.0),
+    adaptiveStep_(0.0),
+    hermiteReady_(false),
+    gaussRadauReady_(false),
+    gaussRadauEvaluations_(0),
+    wisdomHolmanReady_(false),
+    forceEvaluations_(0),
+    bodyForceEvaluations_(0),
+    simulationTime_(-1*scaling::DT*waitingPeriod),   // simulationTimeの初期値:0を上回らないと開始しないので、マイナスの値を入れることで開始までのカウントダウンをしている。
     startTime_(startTime)  // シミュレーション開始時刻
 {    
     centerOfMass[0] = 0.0f;
@@ -19,188 +219,922 @@ Universe::Universe(IntegrationMethod method, std::chrono::system_clock::time_poi
     centerOfMass[2] = 0.0f;
 }
 
-void Universe::addSphere(const Sphere& sphere) {
-    spheres.push_back(sphere);  // 新しいSphereを追加
+Sphere Universe::addSphere(
+        std::string name,
+        float posX, float posY, float posZ,
+        float velX, float velY, float velZ,
+        float m, float rad,
+        float r, float g, float b,
+        bool lightEmission,
+        size_t primary
+) {
+    // 物理量はシミュレーション単位に変換する。主星があれば位置と速度は主星からの相対
+    const float local[6] = {
+        posX*scaling::distance, posY*scaling::distance, posZ*scaling::distance,    // 位置
+        velX*scaling::velocity, velY*scaling::velocity, velZ*scaling::velocity     // 速度
+    };
+    const float mu = celestialConstants::G * scaling::G * m;  // G*m
+    if (primary != Hierarchy::NONE && !localReady_) {
+        // 他の方法で進めた後なら、今のbodiesから作り直してから衛星を追加する(衛星の相対位置は入力した値のまま持てる)
+        local_.clear();
+        local_.resize(bodies.size());
+        hierarchy_.toLocal(bodies, local_);
+        std::copy(bodies.mu, bodies.mu + bodies.size(), local_.mu);
+        localReady_ = true;
+    }
+    hierarchy_.add(primary);    // 主星がまだないときは例外を投げる
+    float global[6];
+    for (int q = 0; q < 6; ++q) global[q] = local[q];
+    if (primary != Hierarchy::NONE) {
+        const float origin[6] = {bodies.x[primary], bodies.y[primary], bodies.z[primary], bodies.vx[primary], bodies.vy[primary], bodies.vz[primary]};
+        for (int q = 0; q < 6; ++q) global[q] += origin[q];
+    }
+    size_t index = bodies.add(global[0], global[1], global[2], global[3], global[4], global[5], mu);
+    if (localReady_) local_.add(local[0], local[1], local[2], local[3], local[4], local[5], mu);
+    localAccelerationsValid_ = false;
+    accelerationsValid_ = false;
+    errorValid_ = false;
+    preciseReady_ = false;
+    adaptiveReady_ = false;
+    hermiteReady_ = false;
+    gaussRadauReady_ = false;
+    wisdomHolmanReady_ = false;
+    // 描画用の情報はbodyInfoへ
+    BodyInfo info;
+    info.name = name;
+    info.mass = m;
+    info.radius = rad*scaling::distance;
+    info.color[0] = r*scaling::color; info.color[1] = g*scaling::color; info.color[2] = b*scaling::color;
+    info.lightEmission = lightEmission;
+    info.angle_theta = 0.0f;
+    info.angle_phi = 0.0f;
+    bodyInfo.push_back(info);
+    trajectories.resize(bodies.size());
+    return Sphere(*this, index);
+}
+
+size_t Universe::sphereCount() const {
+    return bodies.size();
+}
+
+Sphere Universe::sphere(size_t index) {
+    return Sphere(*this, index);
 }
 
 void Universe::calculateForces() {
-    //重心計算用の変数
-    float totalMass = 0.0f;
-    float weightedX = 0.0f, weightedY = 0.0f, weightedZ = 0.0f;
+    // 全天体の加速度をまとめて計算する
+    if (!accelerationsValid_) {
+        computeAccelerations(bodies.x, bodies.y, bodies.z, bodies.mu, bodies.ax, bodies.ay, bodies.az);
+        accelerationsValid_ = true;
+    }
+    updateCenterOfMass();
+}
+
+void Universe::updateCenterOfMass() {
+    //重心計算用の変数(天体が多いとfloatでは足し込む途中で桁が落ちるのでdoubleで足す)
+    double totalMass = 0.0;
+    double weightedX = 0.0, weightedY = 0.0, weightedZ = 0.0;
+
+    // 質量と位置に基づいて重心を計算
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        totalMass += bodies.mu[i];
+        weightedX += static_cast<double>(bodies.x[i]) * bodies.mu[i];
+        weightedY += static_cast<double>(bodies.y[i]) * bodies.mu[i];
+        weightedZ += static_cast<double>(bodies.z[i]) * bodies.mu[i];
+    }
+    // 重心を更新（質量加重平均）
+    if (totalMass > 0.0) {
+        centerOfMass[0] = static_cast<float>(weightedX / totalMass);
+        centerOfMass[1] = static_cast<float>(weightedY / totalMass);
+        centerOfMass[2] = static_cast<float>(weightedZ / totalMass);
+    }
+}
 
-    // 各天体に対して、他のすべての天体からの引力を計算
-    for (size_t i = 0; i < spheres.size(); ++i) {
-        Sphere& sphere1 = spheres[i];
-        sphere1.ax = sphere1.ay = sphere1.az = 0.0f;  // 初期化（前回の加速度をクリア）
+// 位置(x, y, z)にある全天体について、他のすべての天体からの引力による加速度を ax, ay, az に書き込む
+void Universe::computeAccelerations(const float* x, const float* y, const float* z, const float* mu, float* ax, float* ay, float* az) {
+    const size_t n = bodies.size();
+    ++forceEvaluations_;
+    bodyForceEvaluations_ += n;
+    if (forceMethod == ForceMethod::BarnesHut) {
+        barnesHut.accelerations(x, y, z, mu, n, ax, ay, az, threadPool_.get());
+        return;
+    }
+    if (forceMethod == ForceMethod::Tiled) {
+        gravity::tiledAccelerations(x, y, z, mu, n, ax, ay, az, directIsa, threadPool_.get(), tiledPartial_);
+        return;
+    }
+    // 各天体(i)の加速度は他の天体の位置だけで決まるので、iごとに別のスレッドで計算できる
+    parallelFor(n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+        gravity::directAccelerations(x, y, z, mu, n, begin, end, ax, ay, az, directIsa);
+    });
+}
 
-        // 質量と位置に基づいて重心を計算
-        totalMass += sphere1.mass;
-        weightedX += sphere1.x * sphere1.mass;
-        weightedY += sphere1.y * sphere1.mass;
-        weightedZ += sphere1.z * sphere1.mass;
+// Precision::Doubleの状態(precise_)の加速度。DirectとTiledはdoubleのスカラー版で計算する
+void Universe::computeAccelerations(const double* x, const double* y, const double* z, const double* mu, double* ax, double* ay, double* az) {
+    const size_t n = bodies.size();
+    ++forceEvaluations_;
+    bodyForceEvaluations_ += n;
+    if (forceMethod == ForceMethod::BarnesHut) {
+        // 八分木の近似誤差はfloatの丸め誤差よりずっと大きいので、floatに写して計算する
+        barnesHutView_.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            barnesHutView_.x[i] = static_cast<float>(x[i]);
+            barnesHutView_.y[i] = static_cast<float>(y[i]);
+            barnesHutView_.z[i] = static_cast<float>(z[i]);
+            barnesHutView_.mu[i] = static_cast<float>(mu[i]);
+        }
+        barnesHut.accelerations(barnesHutView_.x, barnesHutView_.y, barnesHutView_.z, barnesHutView_.mu, n,
+                                barnesHutView_.ax, barnesHutView_.ay, barnesHutView_.az, threadPool_.get());
+        for (size_t i = 0; i < n; ++i) {
+            ax[i] = barnesHutView_.ax[i];
+            ay[i] = barnesHutView_.ay[i];
+            az[i] = barnesHutView_.az[i];
+        }
+        return;
+    }
+    if (forceMethod == ForceMethod::Tiled) {
+        gravity::tiledAccelerations(x, y, z, mu, n, ax, ay, az, directIsa, threadPool_.get(), tiledPartialPrecise_);
+        return;
+    }
+    parallelFor(n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+        gravity::directAccelerations(x, y, z, mu, n, begin, end, ax, ay, az, directIsa);
+    });
+}
 
-        for (size_t j = 0; j < spheres.size(); ++j) {
-            if (i == j) continue;  // 同じ天体は無視
+// 位置と速度を更新
+// 各段階(ステージ)の加速度は全天体について一度にまとめて計算する。
+// 天体ごとにcalculateForces()を呼ぶと1ステップがO(N^3)になり、しかも天体ごとに進み具合の違う状態を見てしまうため。
+// 呼び出し前にcalculateForces()で現在の加速度が計算されている必要がある(bodiesとは別に状態を持つ場合を除く。keepsOwnState())。
+void Universe::updatePosition(float dt) {
+    const size_t n = bodies.size();
+    accelerationsValid_ = false;    // 位置が変わるので、シンプレクティック積分法以外は次のステップで計算し直す
+    // DOPRI5やHermite法などに切り替えたときは、その時点のbodiesから始める
+    if (integrationMethod != IntegrationMethod::DOPRI5 || precision != adaptivePrecision_) adaptiveReady_ = false;
+    if (integrationMethod != IntegrationMethod::Hermite) hermiteReady_ = false;
+    if (integrationMethod != IntegrationMethod::IAS15) gaussRadauReady_ = false;
+    if (integrationMethod != IntegrationMethod::WisdomHolman) wisdomHolmanReady_ = false;
+    const bool fixedStep = integrationMethod != IntegrationMethod::DOPRI5 && integrationMethod != IntegrationMethod::Hermite
+        && integrationMethod != IntegrationMethod::IAS15 && integrationMethod != IntegrationMethod::WisdomHolman;
+    const bool local = usesLocalFrames();
+    if (!fixedStep || precision != Precision::Single || local) errorValid_ = false;
+    if (!fixedStep || precision != Precision::Double) preciseReady_ = false;
 
-            Sphere& sphere2 = spheres[j];
+    switch(integrationMethod){
+        case IntegrationMethod::Euler:
+        case IntegrationMethod::Heun:
+        case IntegrationMethod::RK4:
+        case IntegrationMethod::Leapfrog:
+        case IntegrationMethod::Yoshida4:
+        case IntegrationMethod::Yoshida6:
+        case IntegrationMethod::PEFRL:
+            if (precision == Precision::Double) {
+                updatePrecise(dt);
+            } else if (local) {
+                updateLocal(dt);
+            } else {
+                if (!errorValid_) {
+                    error_.resize(n);
+                    for (int q = 0; q < 6; ++q) std::fill(error_.*valueArray<float>(q), error_.*valueArray<float>(q) + n, 0.0f);
+                    errorValid_ = true;
+                }
+                accelerationsValid_ = stepFixed(bodies, stage_, sum_, error_, dt);
+            }
+            break;
+        case IntegrationMethod::DOPRI5:
+            if (precision == Precision::Double) {
+                updateAdaptive(dt, preciseDopriStage_, preciseDopriDense_);
+            } else {
+                updateAdaptive(dt, dopriStage_, dopriDense_);
+            }
+            break;
+        case IntegrationMethod::Hermite:
+            updateHermite(dt);
+            break;
+        case IntegrationMethod::IAS15:
+            updateGaussRadau(dt);
+            break;
+        case IntegrationMethod::WisdomHolman:
+            updateWisdomHolman(dt);
+            break;
+    }
+    if (!local) localReady_ = false;    // bodiesだけが進んだ
+    recordTrajectories();
+}
 
-            // 2つの天体間の距離を計算
-            float dx = sphere2.x - sphere1.x;
-            float dy = sphere2.y - sphere1.y;
-            float dz = sphere2.z - sphere1.z;
-            float distance = std::sqrt(dx*dx + dy*dy + dz*dz);
+template <typename Real>
+bool Universe::stepFixed(BasicBodyStore<Real>& state0, BasicBodyStore<Real>& stage, BasicBodyStore<Real>& sum,
+                         BasicBodyStore<Real>& error, float stepSize) {
+    const size_t n = state0.size();
+    const Real dt = stepSize;
+    stage.resize(n);
+    // 位置や速度(value)に増分を足す。補正付きの和なら、切り捨てた下位の桁をerrorに取っておいて次に足す
+    const bool compensated = compensatedSummation;
+    auto advance = [compensated](Real& value, Real& err, Real increment) {
+        if (compensated) {
+            summation::add(value, err, increment);
+        } else {
+            value += increment;
+        }
+    };
 
-            // 引力を計算
-            float force = (celestialConstants::G * scaling::G * sphere1.mass * sphere2.mass) / (distance * distance);
-            
-            // 力の成分を加速度に変換（F = ma, a = F / m）
-            float ax = force * dx / (sphere1.mass * distance);
-            float ay = force * dy / (sphere1.mass * distance);
-            float az = force * dz / (sphere1.mass * distance);
+    switch(integrationMethod){
+        case IntegrationMethod::Euler:{
+            // 速度を更新してから、その速度で位置を更新する
+            parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    advance(state0.vx[i], error.vx[i], state0.ax[i] * dt);
+                    advance(state0.vy[i], error.vy[i], state0.ay[i] * dt);
+                    advance(state0.vz[i], error.vz[i], state0.az[i] * dt);
+                    advance(state0.x[i], error.x[i], state0.vx[i] * dt);
+                    advance(state0.y[i], error.y[i], state0.vy[i] * dt);
+                    advance(state0.z[i], error.z[i], state0.vz[i] * dt);
+                }
+            });
+            return false;
+        }
+        case IntegrationMethod::Heun :{
+            // 予測子:Euler法で全天体を1ステップ進める
+            parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    stage.x[i] = state0.x[i] + state0.vx[i] * dt;
+                    stage.y[i] = state0.y[i] + state0.vy[i] * dt;
+                    stage.z[i] = state0.z[i] + state0.vz[i] * dt;
+                    stage.vx[i] = state0.vx[i] + state0.ax[i] * dt;
+                    stage.vy[i] = state0.vy[i] + state0.ay[i] * dt;
+                    stage.vz[i] = state0.vz[i] + state0.az[i] * dt;
+                }
+            });
+            stateAccelerations(stage);
+            // 修正子:始点と予測点の傾きの平均で進める
+            const Real half = Real(0.5) * dt;
+            parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    advance(state0.x[i], error.x[i], (state0.vx[i] + stage.vx[i]) * half);
+                    advance(state0.y[i], error.y[i], (state0.vy[i] + stage.vy[i]) * half);
+                    advance(state0.z[i], error.z[i], (state0.vz[i] + stage.vz[i]) * half);
+                    advance(state0.vx[i], error.vx[i], (state0.ax[i] + stage.ax[i]) * half);
+                    advance(state0.vy[i], error.vy[i], (state0.ay[i] + stage.ay[i]) * half);
+                    advance(state0.vz[i], error.vz[i], (state0.az[i] + stage.az[i]) * half);
+                }
+            });
+            return false;
+        }
+        case IntegrationMethod::RK4 :{
+            // 位置の傾きk = 速度、速度の傾きl = 加速度。k1, l1は現在の状態そのもの
+            // sumに (k1 + 2*k2 + 2*k3 + k4) と (l1 + 2*l2 + 2*l3 + l4) を貯めていく
+            sum.resize(n);
+            parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    sum.x[i] = state0.vx[i];  sum.y[i] = state0.vy[i];  sum.z[i] = state0.vz[i];
+                    sum.vx[i] = state0.ax[i]; sum.vy[i] = state0.ay[i]; sum.vz[i] = state0.az[i];
+                    stage.vx[i] = state0.vx[i]; stage.vy[i] = state0.vy[i]; stage.vz[i] = state0.vz[i];
+                    stage.ax[i] = state0.ax[i]; stage.ay[i] = state0.ay[i]; stage.az[i] = state0.az[i];
+                }
+            });
+            // 2段目と3段目は dt/2 、4段目は dt だけ直前の段の傾きで進めた点で評価する
+            const Real stageStep[3] = {Real(0.5) * dt, Real(0.5) * dt, dt};
+            const Real stageWeight[3] = {2, 2, 1};
+            for (int s = 0; s < 3; ++s) {
+                const Real h = stageStep[s];
+                parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        // stageには直前の段の傾き(速度と加速度)が入っている
+                        stage.x[i] = state0.x[i] + stage.vx[i] * h;
+                        stage.y[i] = state0.y[i] + stage.vy[i] * h;
+                        stage.z[i] = state0.z[i] + stage.vz[i] * h;
+                        stage.vx[i] = state0.vx[i] + stage.ax[i] * h;
+                        stage.vy[i] = state0.vy[i] + stage.ay[i] * h;
+                        stage.vz[i] = state0.vz[i] + stage.az[i] * h;
+                    }
+                });
+                stateAccelerations(stage);
+                const Real w = stageWeight[s];
+                parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        sum.x[i] += w * stage.vx[i];  sum.y[i] += w * stage.vy[i];  sum.z[i] += w * stage.vz[i];
+                        sum.vx[i] += w * stage.ax[i]; sum.vy[i] += w * stage.ay[i]; sum.vz[i] += w * stage.az[i];
+                    }
+                });
+            }
+            const Real sixth = dt / 6;
+            parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    advance(state0.x[i], error.x[i], sum.x[i] * sixth);
+                    advance(state0.y[i], error.y[i], sum.y[i] * sixth);
+                    advance(state0.z[i], error.z[i], sum.z[i] * sixth);
+                    advance(state0.vx[i], error.vx[i], sum.vx[i] * sixth);
+                    advance(state0.vy[i], error.vy[i], sum.vy[i] * sixth);
+                    advance(state0.vz[i], error.vz[i], sum.vz[i] * sixth);
+                }
+            });
+            return false;
+        }
+        default:
+            // シンプレクティック積分法は、最後に新しい位置での加速度を計算している
+            updateSymplectic(state0, error, stepSize);
+            return true;
+    }
+}
 
-            // 加速度を加算
-            sphere1.ax += ax;
-            sphere1.ay += ay;
-            sphere1.az += az;
-        
-            //引力と遠心力を出力
-            float v = sqrt(sphere1.vx * sphere1.vx + sphere1.vy * sphere1.vy + sphere1.vz * sphere1.vz);
-            float a = sqrt(sphere1.ax * sphere1.ax + sphere1.ay * sphere1.ay + sphere1.az * sphere1.az);
-            // std::cout << "gravity:" << sphere1.mass * a << "centrifualForce:" << sphere1.mass * v * v /distance << std::endl;
+void Universe::updatePrecise(float dt) {
+    const size_t n = bodies.size();
+    if (!preciseReady_) {
+        // bodiesの現在の状態から始める
+        for (PreciseBodyStore* store : {&precise_, &preciseError_}) {
+            store->clear();
+            store->resize(n);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            precise_.x[i] = bodies.x[i];   precise_.y[i] = bodies.y[i];   precise_.z[i] = bodies.z[i];
+            precise_.vx[i] = bodies.vx[i]; precise_.vy[i] = bodies.vy[i]; precise_.vz[i] = bodies.vz[i];
+            precise_.mu[i] = bodies.mu[i];
+        }
+        // 衛星の主星からの相対位置があれば、floatの全体の座標ではなくそれを主星にdoubleで足す(主星は前にある)
+        if (localReady_ && hierarchy_.satelliteCount() > 0) {
+            for (size_t i = 0; i < n; ++i) {
+                const size_t p = hierarchy_.primary(i);
+                if (p == Hierarchy::NONE) continue;
+                precise_.x[i] = precise_.x[p] + local_.x[i];    precise_.y[i] = precise_.y[p] + local_.y[i];    precise_.z[i] = precise_.z[p] + local_.z[i];
+                precise_.vx[i] = precise_.vx[p] + local_.vx[i]; precise_.vy[i] = precise_.vy[p] + local_.vy[i]; precise_.vz[i] = precise_.vz[p] + local_.vz[i];
+            }
         }
-        // 重心を更新（質量加重平均）
-        if (totalMass > 0.0f) {
-            centerOfMass[0] = weightedX / totalMass;
-            centerOfMass[1] = weightedY / totalMass;
-            centerOfMass[2] = weightedZ / totalMass;
+        preciseAccelerationsValid_ = false;
+        preciseReady_ = true;
+    }
+    if (!preciseAccelerationsValid_) stateAccelerations(precise_);
+    preciseAccelerationsValid_ = stepFixed(precise_, preciseStage_, preciseSum_, preciseError_, dt);
+
+    // 表示用にbodiesへ写す(加速度も写すが、次のステップでは使わない)
+    parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            bodies.x[i] = static_cast<float>(precise_.x[i] + preciseError_.x[i]);
+            bodies.y[i] = static_cast<float>(precise_.y[i] + preciseError_.y[i]);
+            bodies.z[i] = static_cast<float>(precise_.z[i] + preciseError_.z[i]);
+            bodies.vx[i] = static_cast<float>(precise_.vx[i] + preciseError_.vx[i]);
+            bodies.vy[i] = static_cast<float>(precise_.vy[i] + preciseError_.vy[i]);
+            bodies.vz[i] = static_cast<float>(precise_.vz[i] + preciseError_.vz[i]);
+            bodies.ax[i] = static_cast<float>(precise_.ax[i]);
+            bodies.ay[i] = static_cast<float>(precise_.ay[i]);
+            bodies.az[i] = static_cast<float>(precise_.az[i]);
         }
+    });
+}
 
+void Universe::recordTrajectories() {
+    const size_t n = bodies.size();
+    parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            // 環状バッファなので、いっぱいになったら一番古い点に上書きされる(メモリの確保や移動はしない)
+            trajectories.record(i, bodies.x[i], bodies.y[i], bodies.z[i]);
+        }
+    });
+}
+
+bool Universe::usesLocalFrames() const {
+    const bool fixedStep = integrationMethod != IntegrationMethod::DOPRI5 && integrationMethod != IntegrationMethod::Hermite
+        && integrationMethod != IntegrationMethod::IAS15 && integrationMethod != IntegrationMethod::WisdomHolman;
+    return fixedStep && precision == Precision::Single && localFrames && hierarchy_.satelliteCount() > 0;
+}
+
+void Universe::updateLocal(float dt) {
+    const size_t n = bodies.size();
+    if (!localReady_) {
+        // bodiesの現在の状態から始める
+        local_.clear();
+        local_.resize(n);
+        hierarchy_.toLocal(bodies, local_);
+        std::copy(bodies.mu, bodies.mu + n, local_.mu);
+        localAccelerationsValid_ = false;
+        localReady_ = true;
+    }
+    if (localError_.size() != n) {
+        // 天体が増えたら誤差は0から始める(丸め誤差1回分より小さいので捨ててよい)
+        localError_.clear();
+        localError_.resize(n);
     }
+    if (!localAccelerationsValid_) localAccelerations(local_);
+    localAccelerationsValid_ = stepFixed(local_, stage_, sum_, localError_, dt);
+    // 軌跡と重心のために全体の座標をbodiesへ写す
+    hierarchy_.toGlobal(local_, bodies, false);
 }
 
-// 位置と速度を更新
-void Universe::updatePosition(float dt) {
-    for (size_t i = 0; i < spheres.size(); ++i) {
-        
-        switch(integrationMethod){
-            case IntegrationMethod::Euler:{
-                // 速度を更新
-                spheres[i].vx += spheres[i].ax * dt;
-                spheres[i].vy += spheres[i].ay * dt;
-                spheres[i].vz += spheres[i].az * dt;
-                // 位置を更新
-                spheres[i].x += spheres[i].vx * dt;
-                spheres[i].y += spheres[i].vy * dt;
-                spheres[i].z += spheres[i].vz * dt;
-                // 加速度を更新
-                calculateForces();
-                break;
+void Universe::localAccelerations(BodyStore& state) {
+    const size_t n = bodies.size();
+    frameGlobal_.resize(n);
+    hierarchy_.toGlobal(state, frameGlobal_, true);
+    // 遠くの天体からの引力は全体の座標で、いつもの方法(forceMethod)でまとめて計算する
+    computeAccelerations(frameGlobal_.x, frameGlobal_.y, frameGlobal_.z, bodies.mu, frameGlobal_.ax, frameGlobal_.ay, frameGlobal_.az);
+    hierarchy_.localAccelerations(state, frameGlobal_, bodies.mu);
+}
+
+void Universe::stateAccelerations(BodyStore& state) {
+    if (usesLocalFrames()) {
+        localAccelerations(state);
+    } else {
+        computeAccelerations(state.x, state.y, state.z, bodies.mu, state.ax, state.ay, state.az);
+    }
+}
+
+void Universe::stateAccelerations(PreciseBodyStore& state) {
+    computeAccelerations(state.x, state.y, state.z, precise_.mu, state.ax, state.ay, state.az);
+}
+
+// Kick(速度を加速度で進める)とDrift(位置を速度で進める)を交互に行う
+//   K(kick[0]) D(drift[0]) K(kick[1]) D(drift[1]) ... D(drift[m-1]) K(kick[m])   (係数はdtに対する比)
+// 最初のKickは現在の加速度を使い、Driftのたびに新しい位置で加速度を計算する(力の計算はm回)。
+// 最後のKickに使った加速度は終点の位置のものなので、次のステップの最初のKickにそのまま使える。
+template <typename Real>
+void Universe::updateSymplectic(BasicBodyStore<Real>& state, BasicBodyStore<Real>& error, float dt) {
+    const size_t n = state.size();
+    const SymplecticScheme& scheme = symplecticScheme(integrationMethod);
+    const bool compensated = compensatedSummation;
+
+    for (int k = 0; k <= scheme.stages; ++k) {
+        const Real kick = static_cast<Real>(scheme.kick[k] * dt);
+        const bool drift = (k < scheme.stages);
+        const Real h = drift ? static_cast<Real>(scheme.drift[k] * dt) : Real(0);
+        parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+            if (compensated) {
+                for (size_t i = begin; i < end; ++i) {
+                    summation::add(state.vx[i], error.vx[i], state.ax[i] * kick);
+                    summation::add(state.vy[i], error.vy[i], state.ay[i] * kick);
+                    summation::add(state.vz[i], error.vz[i], state.az[i] * kick);
+                    if (!drift) continue;
+                    summation::add(state.x[i], error.x[i], state.vx[i] * h);
+                    summation::add(state.y[i], error.y[i], state.vy[i] * h);
+                    summation::add(state.z[i], error.z[i], state.vz[i] * h);
+                }
+                return;
             }
-            case IntegrationMethod::Heun :{
-                // このHeun法はうまく実装できてない可能性高い
-                // 速度を予測
-                float vx_predict = spheres[i].ax * dt;
-                float vy_predict = spheres[i].ay * dt;
-                float vz_predict = spheres[i].az * dt;
-                // 位置を予測
-                spheres[i].x += vx_predict * dt;
-                spheres[i].y += vy_predict * dt;
-                spheres[i].z += vz_predict * dt;
-                // 加速度を保存後に更新して位置を戻す
-                float ax_current = spheres[i].ax;
-                float ay_current = spheres[i].ay;
-                float az_current = spheres[i].az;
-                calculateForces();
-                spheres[i].x -= vx_predict * dt;
-                spheres[i].y -= vy_predict * dt;
-                spheres[i].z -= vz_predict * dt;
-                // 速度を保存した上で修正
-                float vx_current =spheres[i].vx;
-                float vy_current =spheres[i].vy;
-                float vz_current =spheres[i].vz;
-                spheres[i].vx += 0.5f * (ax_current + spheres[i].ax) * dt;
-                spheres[i].vy += 0.5f * (ay_current + spheres[i].ay) * dt;
-                spheres[i].vz += 0.5f * (az_current + spheres[i].az) * dt;
-                // 修正された速度で位置を修正
-                spheres[i].x += 0.5f * (vx_current+spheres[i].vx)* dt;
-                spheres[i].y += 0.5f * (vy_current+spheres[i].vy)* dt;
-                spheres[i].z += 0.5f * (vz_current+spheres[i].vz)* dt;
-                break;
+            for (size_t i = begin; i < end; ++i) {
+                state.vx[i] += state.ax[i] * kick;
+                state.vy[i] += state.ay[i] * kick;
+                state.vz[i] += state.az[i] * kick;
+                if (!drift) continue;
+                state.x[i] += state.vx[i] * h;
+                state.y[i] += state.vy[i] * h;
+                state.z[i] += state.vz[i] * h;
             }
-            case IntegrationMethod::RK4 :{
-                float k1[3] ={spheres[i].vx, spheres[i].vy, spheres[i].vz};
-                float l1[3] ={spheres[i].ax, spheres[i].ay, spheres[i].az};
-
-                float k2[3]={spheres[i].vx+0.5f*l1[0]*dt, spheres[i].vy+0.5f *l1[1]*dt, spheres[i].vz+0.5f *l1[2]*dt};
-                spheres[i].x += k1[0]*(dt/2);
-                spheres[i].y += k1[1]*(dt/2);
-                spheres[i].z += k1[0]*(dt/2);
-                calculateForces();
-                float l2[3] = {spheres[i].ax,spheres[i].ay, spheres[i].az};
-                spheres[i].x -= k1[0]*(dt/2);
-                spheres[i].y -= k1[1]*(dt/2);
-                spheres[i].z -= k1[0]*(dt/2);
-
-                float k3[3] = {spheres[i].vx + l2[0]*(dt/2), spheres[i].vy + l2[1]*(dt/2),spheres[i].vz + l2[2]*(dt/2)};
-                spheres[i].x += k2[0]*(dt/2);
-                spheres[i].y += k2[1]*(dt/2);
-                spheres[i].z += k2[0]*(dt/2);
-                calculateForces();
-                float l3[3] = {spheres[i].ax,spheres[i].ay, spheres[i].az};
-                spheres[i].x -= k2[0]*(dt/2);
-                spheres[i].y -= k2[1]*(dt/2);
-                spheres[i].z -= k2[0]*(dt/2);                    
-                
-                float k4[3] = {spheres[i].vx + l3[0]*dt,spheres[i].vy + l3[1]*dt,spheres[i].vz + l3[2]*dt};
-                spheres[i].x += k3[0]*dt;
-                spheres[i].y += k3[1]*dt;
-                spheres[i].z += k3[2]*dt;
-                calculateForces();
-                float l4[3] = {spheres[i].ax,spheres[i].ay, spheres[i].az};
-                spheres[i].x -= k3[0]*dt;
-                spheres[i].y -= k3[1]*dt;
-                spheres[i].z -= k3[2]*dt;
-                
-                float k[3] = {(k1[0] + 2*k2[0] + 2*k3[0] + k4[0])/6, (k1[1] + 2*k2[1] + 2*k3[1] + k4[1])/6, (k1[2] + 2*k2[2] + 2*k3[2] + k4[2])/6};
-                float l[3] = {(l1[0] + 2*l2[0] + 2*l3[0] + l4[0])/6, (l1[1] + 2*l2[1] + 2*l3[1] + l4[1])/6, (l1[2] + 2*l2[2] + 2*l3[2] + l4[2])/6};
-
-                spheres[i].x += k[0]*dt;
-                spheres[i].y += k[1]*dt;
-                spheres[i].z += k[2]*dt;
-                spheres[i].vx += l[0]*dt;
-                spheres[i].vy += l[1]*dt;
-                spheres[i].vz += l[2]*dt;
-
-                break;
+        });
+        if (drift) stateAccelerations(state);
+    }
+}
+
+template <typename Real>
+void Universe::updateAdaptive(float dt, BasicBodyStore<Real>* stage, BasicBodyStore<Real>* dense) {
+    const size_t n = bodies.size();
+    if (!adaptiveReady_) {
+        // bodiesの現在の状態から始める
+        for (int s = 0; s < DOPRI_STAGES; ++s) stage[s].resize(n);
+        for (int k = 0; k < 5; ++k) dense[k].resize(n);
+        dopriError_.resize(n);
+        dopriNoise_.resize(n);
+        BasicBodyStore<Real>& y0 = stage[0];
+        std::copy(bodies.x, bodies.x + n, y0.x);   std::copy(bodies.y, bodies.y + n, y0.y);   std::copy(bodies.z, bodies.z + n, y0.z);
+        std::copy(bodies.vx, bodies.vx + n, y0.vx); std::copy(bodies.vy, bodies.vy + n, y0.vy); std::copy(bodies.vz, bodies.vz + n, y0.vz);
+        std::copy(bodies.mu, bodies.mu + n, y0.mu);
+        computeAccelerations(y0.x, y0.y, y0.z, y0.mu, y0.ax, y0.ay, y0.az);
+        adaptiveTime_ = 0.0;
+        stepBegin_ = stepEnd_ = 0.0;
+        if (adaptiveStep_ <= 0.0) adaptiveStep_ = dt;
+        adaptiveReady_ = true;
+        adaptivePrecision_ = precision;
+    }
+
+    // 表示する時刻が直前のステップの区間に入るまで進める。刻みがdtより大きければ、何回かに1回しか進めない
+    adaptiveTime_ += dt;
+    while (stepEnd_ < adaptiveTime_) stepDopri(stage, dense);
+
+    if (stepEnd_ <= stepBegin_) {
+        // まだ1ステップも進めていない(dt = 0)
+        const BasicBodyStore<Real>& y0 = stage[0];
+        for (int q = 0; q < 6; ++q) std::copy(y0.*valueArray<Real>(q), y0.*valueArray<Real>(q) + n, bodies.*valueArray<float>(q));
+    } else {
+        // y(θ) = r1 + θ(r2 + (1-θ)(r3 + θ(r4 + (1-θ) r5)))
+        const Real theta = static_cast<Real>((adaptiveTime_ - stepBegin_) / (stepEnd_ - stepBegin_));
+        const Real rest = 1 - theta;
+        parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+            for (int q = 0; q < 6; ++q) {
+                const Real* r1 = dense[0].*valueArray<Real>(q);
+                const Real* r2 = dense[1].*valueArray<Real>(q);
+                const Real* r3 = dense[2].*valueArray<Real>(q);
+                const Real* r4 = dense[3].*valueArray<Real>(q);
+                const Real* r5 = dense[4].*valueArray<Real>(q);
+                float* out = bodies.*valueArray<float>(q);
+                for (size_t i = begin; i < end; ++i) {
+                    out[i] = static_cast<float>(r1[i] + theta * (r2[i] + rest * (r3[i] + theta * (r4[i] + rest * r5[i]))));
+                }
             }
+        });
+    }
+    accelerationsValid_ = false;    // bodiesの加速度は計算していない
+}
+
+template <typename Real>
+void Universe::stepDopri(BasicBodyStore<Real>* stage, BasicBodyStore<Real>* dense) {
+    const size_t n = bodies.size();
+    BasicBodyStore<Real>& y0 = stage[0];
+    BasicBodyStore<Real>& y1 = stage[DOPRI_STAGES - 1];
+    const Real epsilon = std::numeric_limits<Real>::epsilon();
 
+    // 誤差の基準にする加速度の下限と、刻みの下限(一番速く動く天体でも位置がDOPRI_MIN_MOTION ulpしか動かない刻み)
+    Real maxAcceleration = 0;
+    double minStep = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        maxAcceleration = std::max(maxAcceleration, std::sqrt(y0.ax[i]*y0.ax[i] + y0.ay[i]*y0.ay[i] + y0.az[i]*y0.az[i]));
+        const double r = norm(y0.x[i], y0.y[i], y0.z[i]);
+        const double v = norm(y0.vx[i], y0.vy[i], y0.vz[i]);
+        if (v > 0.0 && r > 0.0) {
+            const double step = DOPRI_MIN_MOTION * epsilon * r / v;
+            minStep = (minStep > 0.0) ? std::min(minStep, step) : step;
         }
+    }
+    // 時刻の和が進まなくなるほど短くもしない
+    minStep = std::max(minStep, DOPRI_MIN_MOTION * DBL_EPSILON * std::fabs(stepEnd_));
+    const Real accelerationFloor = static_cast<Real>(DOPRI_FLOOR) * maxAcceleration;
+
+    // 天体ごとに、位置の表せる細かさから来る加速度の誤差を見込む。主星と衛星の間の距離は全体の座標の差で求めるので、
+    // 太陽から離れた地球と月のように、距離dに比べて座標|r|が大きいと、その引力は相対 ε|r|/d の誤差を含む(衛星にも主星にもかかる)
+    std::fill(dopriNoise_.begin(), dopriNoise_.end(), 0.0);
+    for (size_t i = 0; i < n; ++i) {
+        const size_t p = hierarchy_.primary(i);
+        if (p == Hierarchy::NONE) continue;
+        const double d = norm(y0.x[i] - y0.x[p], y0.y[i] - y0.y[p], y0.z[i] - y0.z[p]);
+        if (d <= 0.0) continue;
+        const double relative = epsilon * std::max(norm(y0.x[i], y0.y[i], y0.z[i]), norm(y0.x[p], y0.y[p], y0.z[p])) / d;
+        dopriNoise_[i] += DOPRI_NOISE * relative * y0.mu[p] / (d * d);
+        dopriNoise_[p] += DOPRI_NOISE * relative * y0.mu[i] / (d * d);
+    }
 
-        // 軌跡を更新
-        spheres[i].trajectory.push_back(std::make_tuple(spheres[i].x, spheres[i].y, spheres[i].z));  // 新しい位置を追加
-        // 軌跡の長さが1000を超えたら古いものを削除
-        if (spheres[i].trajectory.size() > spheres[i].trajectoryLength) {
-            spheres[i].trajectory.erase(spheres[i].trajectory.begin());
+    for (;;) {
+        const double h = std::max(adaptiveStep_, minStep);
+        // s段目の点 y_s = y_0 + h Σ a_sj k_j で加速度を計算する
+        for (int s = 1; s < DOPRI_STAGES; ++s) {
+            BasicBodyStore<Real>& ys = stage[s];
+            Real coefficient[DOPRI_STAGES - 1];
+            for (int j = 0; j < s; ++j) coefficient[j] = static_cast<Real>(h * DOPRI_A[s][j]);
+            parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+                for (int q = 0; q < 6; ++q) {
+                    const Real* start = y0.*valueArray<Real>(q);
+                    Real* out = ys.*valueArray<Real>(q);
+                    for (size_t i = begin; i < end; ++i) {
+                        Real sum = 0;
+                        for (int j = 0; j < s; ++j) sum += coefficient[j] * (stage[j].*slopeArray<Real>(q))[i];
+                        out[i] = start[i] + sum;
+                    }
+                }
+            });
+            computeAccelerations(ys.x, ys.y, ys.z, y0.mu, ys.ax, ys.ay, ys.az);
         }
+
+        // 天体ごとの誤差(5次と4次の解の差)を、そのステップで軌道が曲がる量(速度は |a|h 、位置は |a|h^2)に対する比で見積もる
+        // 位置や速度の大きさを基準にすると、太陽の周りの地球に比べて、地球の周りの月の誤差を大きく見逃してしまうため
+        Real errorCoefficient[DOPRI_STAGES];
+        for (int j = 0; j < DOPRI_STAGES; ++j) errorCoefficient[j] = static_cast<Real>(h * DOPRI_E[j]);
+        Real positionErrorCoefficient[DOPRI_STAGES];
+        for (int m = 0; m < DOPRI_STAGES; ++m) positionErrorCoefficient[m] = static_cast<Real>(h * h * DOPRI_POSITION_E[m]);
+        const Real step = static_cast<Real>(h);
+        const Real tolerance = std::max(static_cast<Real>(adaptiveTolerance), static_cast<Real>(getMinAdaptiveTolerance()));
+        parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                // Σ e_j = 0 なので、Σ e_j (k_j - k_1) として足す。丸めた係数の和が0にならない分の誤差を拾わないため
+                // 位置の誤差は各段の速度の差ではなく加速度から求める。各段の速度は |v| に比例した丸めを含み、
+                // 月では地球の公転速度の分の丸めが、地球に対する軌道の誤差より大きくなるため
+                Real error[6];
+                for (int q = 0; q < 3; ++q) {
+                    const Real k1 = (y0.*slopeArray<Real>(q + 3))[i];
+                    Real sum = 0;
+                    for (int m = 1; m < DOPRI_STAGES; ++m) sum += positionErrorCoefficient[m] * ((stage[m].*slopeArray<Real>(q + 3))[i] - k1);
+                    error[q] = sum;
+                }
+                for (int q = 3; q < 6; ++q) {
+                    const Real k1 = (y0.*slopeArray<Real>(q))[i];
+                    Real sum = 0;
+                    for (int j = 1; j < DOPRI_STAGES; ++j) sum += errorCoefficient[j] * ((stage[j].*slopeArray<Real>(q))[i] - k1);
+                    error[q] = sum;
+                }
+                Real acceleration = std::max(std::sqrt(y0.ax[i]*y0.ax[i] + y0.ay[i]*y0.ay[i] + y0.az[i]*y0.az[i]), accelerationFloor);
+                // 加速度の丸め誤差より小さい誤差は求めない(求めると刻みが際限なく縮む)
+                const Real allowed = std::max(tolerance * acceleration, static_cast<Real>(dopriNoise_[i]));
+                Real velocityAllowed = allowed * step;
+                Real positionAllowed = allowed * step * step;
+                // どの天体も引かれていない(加速度がすべて0)ときは誤差も0なので、0/0にしない
+                Real positionError = std::sqrt(error[0]*error[0] + error[1]*error[1] + error[2]*error[2]);
+                Real velocityError = std::sqrt(error[3]*error[3] + error[4]*error[4] + error[5]*error[5]);
+                if (positionError != 0) positionError /= positionAllowed;
+                if (velocityError != 0) velocityError /= velocityAllowed;
+                dopriError_[i] = std::max(positionError, velocityError);
+            }
+        });
+        // 許容誤差との比。1つの天体の接近でも刻みを縮められるよう、平均ではなく最大値を使う
+        // (NaNはstd::maxで落ちないように、有限でないものがあればそれを残す)
+        double error = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            if (!std::isfinite(dopriError_[i])) { error = dopriError_[i]; break; }
+            error = std::max(error, dopriError_[i]);
+        }
+        if (!std::isfinite(error)) throw std::runtime_error("DOPRI5: the error estimate is not finite");
+
+        double scale = (error > 0.0) ? DOPRI_SAFETY * std::pow(error, -0.2) : DOPRI_MAX_SCALE;
+        scale = std::min(DOPRI_MAX_SCALE, std::max(DOPRI_MIN_SCALE, scale));
+        if (error > 1.0 && h > minStep) {
+            // 許容範囲を超えたので、刻みを縮めてやり直す(下限より縮めるときは下限で試す)
+            adaptiveStep_ = h * std::min(scale, 1.0);
+            continue;
+        }
+        // 下限の刻みでも収まらないときは、それ以上縮めても丸め誤差しか変わらないので、そのまま進める
+
+        // 補間用の係数: r1 = y0, r2 = y1 - y0, r3 = h k1 - r2, r4 = r2 - h k7 - r3, r5 = h Σ d_j k_j
+        Real denseCoefficient[DOPRI_STAGES];
+        for (int j = 0; j < DOPRI_STAGES; ++j) denseCoefficient[j] = static_cast<Real>(h * DOPRI_D[j]);
+        parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+            for (int q = 0; q < 6; ++q) {
+                const Real* start = y0.*valueArray<Real>(q);
+                const Real* finish = y1.*valueArray<Real>(q);
+                const Real* k1 = y0.*slopeArray<Real>(q);
+                const Real* k7 = y1.*slopeArray<Real>(q);
+                Real* r1 = dense[0].*valueArray<Real>(q);
+                Real* r2 = dense[1].*valueArray<Real>(q);
+                Real* r3 = dense[2].*valueArray<Real>(q);
+                Real* r4 = dense[3].*valueArray<Real>(q);
+                Real* r5 = dense[4].*valueArray<Real>(q);
+                for (size_t i = begin; i < end; ++i) {
+                    Real sum = 0;
+                    for (int j = 0; j < DOPRI_STAGES; ++j) sum += denseCoefficient[j] * (stage[j].*slopeArray<Real>(q))[i];
+                    r1[i] = start[i];
+                    r2[i] = finish[i] - start[i];
+                    r3[i] = step * k1[i] - r2[i];
+                    r4[i] = r2[i] - step * k7[i] - r3[i];
+                    r5[i] = sum;
+                }
+            }
+        });
+
+        // 7段目(終点とその傾き)を次のステップの始点にする
+        parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+            for (int q = 0; q < 6; ++q) {
+                std::copy(y1.*valueArray<Real>(q) + begin, y1.*valueArray<Real>(q) + end, y0.*valueArray<Real>(q) + begin);
+                std::copy(y1.*slopeArray<Real>(q) + begin, y1.*slopeArray<Real>(q) + end, y0.*slopeArray<Real>(q) + begin);
+            }
+        });
+        stepBegin_ = stepEnd_;
+        stepEnd_ += h;
+        adaptiveStep_ = h * scale;
+        return;
     }
 }
 
+void Universe::updateHermite(float dt) {
+    const size_t n = bodies.size();
+    if (!hermiteReady_) {
+        // bodiesの現在の状態から始める。最初は全天体の加速度と躍度を計算し、刻みを η_s |a| / |j| から決める
+        hermite_.resize(n);
+        predicted_.resize(n);
+        for (std::vector<double>* v : {&jerkX_, &jerkY_, &jerkZ_, &newJerkX_, &newJerkY_, &newJerkZ_}) v->assign(n, 0.0);
+        hermiteTime_.assign(n, 0);
+        hermiteStep_.assign(n, HERMITE_MAX_TICKS);
+        activeBodies_.resize(n);
+        for (size_t i = 0; i < n; ++i) activeBodies_[i] = i;
+        std::copy(bodies.x, bodies.x + n, hermite_.x);   std::copy(bodies.y, bodies.y + n, hermite_.y);   std::copy(bodies.z, bodies.z + n, hermite_.z);
+        std::copy(bodies.vx, bodies.vx + n, hermite_.vx); std::copy(bodies.vy, bodies.vy + n, hermite_.vy); std::copy(bodies.vz, bodies.vz + n, hermite_.vz);
+        std::copy(bodies.mu, bodies.mu + n, hermite_.mu);
+        parallelFor(n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+            gravity::accelerationJerk(hermite_.x, hermite_.y, hermite_.z, hermite_.vx, hermite_.vy, hermite_.vz, hermite_.mu, n,
+                                      activeBodies_.data(), begin, end,
+                                      hermite_.ax, hermite_.ay, hermite_.az, jerkX_.data(), jerkY_.data(), jerkZ_.data());
+        });
+        ++forceEvaluations_;
+        bodyForceEvaluations_ += n;
+        for (size_t i = 0; i < n; ++i) {
+            double a = norm(hermite_.ax[i], hermite_.ay[i], hermite_.az[i]);
+            double j = norm(jerkX_[i], jerkY_[i], jerkZ_[i]);
+            hermiteStep_[i] = (j > 0.0) ? quantizeStep(HERMITE_START_ETA * a / j) : HERMITE_MAX_TICKS;
+        }
+        adaptiveTime_ = 0.0;
+        hermiteReady_ = true;
+    }
+
+    // 表示する時刻までに時刻が来る天体を、時刻の早いブロックから順に進める
+    adaptiveTime_ += dt;
+    while (n > 0) {
+        unsigned long long blockTime = ~0ULL;
+        for (size_t i = 0; i < n; ++i) blockTime = std::min(blockTime, hermiteTime_[i] + hermiteStep_[i]);
+        if (blockTime * HERMITE_TICK > adaptiveTime_) break;
+        stepHermiteBlock(blockTime);
+    }
+
+    // 各天体を自分の時刻から表示する時刻まで予測子(3次のTaylor展開)で進める
+    parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const double h = adaptiveTime_ - hermiteTime_[i] * HERMITE_TICK;
+            const double h2 = h * h / 2, h3 = h * h * h / 6;
+            bodies.x[i] = static_cast<float>(hermite_.x[i] + hermite_.vx[i] * h + hermite_.ax[i] * h2 + jerkX_[i] * h3);
+            bodies.y[i] = static_cast<float>(hermite_.y[i] + hermite_.vy[i] * h + hermite_.ay[i] * h2 + jerkY_[i] * h3);
+            bodies.z[i] = static_cast<float>(hermite_.z[i] + hermite_.vz[i] * h + hermite_.az[i] * h2 + jerkZ_[i] * h3);
+            bodies.vx[i] = static_cast<float>(hermite_.vx[i] + hermite_.ax[i] * h + jerkX_[i] * h2);
+            bodies.vy[i] = static_cast<float>(hermite_.vy[i] + hermite_.ay[i] * h + jerkY_[i] * h2);
+            bodies.vz[i] = static_cast<float>(hermite_.vz[i] + hermite_.az[i] * h + jerkZ_[i] * h2);
+        }
+    });
+    accelerationsValid_ = false;    // bodiesの加速度は計算していない
+}
+
+void Universe::stepHermiteBlock(unsigned long long blockTime) {
+    const size_t n = bodies.size();
+    activeBodies_.clear();
+    for (size_t i = 0; i < n; ++i) {
+        if (hermiteTime_[i] + hermiteStep_[i] == blockTime) activeBodies_.push_back(i);
+    }
+
+    // 予測子: 全天体の位置と速度をブロックの時刻に揃える(力を計算し直す天体の相手として使う)
+    parallelFor(n, BODY_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const double h = (blockTime - hermiteTime_[i]) * HERMITE_TICK;
+            const double h2 = h * h / 2, h3 = h * h * h / 6;
+            predicted_.x[i] = hermite_.x[i] + hermite_.vx[i] * h + hermite_.ax[i] * h2 + jerkX_[i] * h3;
+            predicted_.y[i] = hermite_.y[i] + hermite_.vy[i] * h + hermite_.ay[i] * h2 + jerkY_[i] * h3;
+            predicted_.z[i] = hermite_.z[i] + hermite_.vz[i] * h + hermite_.az[i] * h2 + jerkZ_[i] * h3;
+            predicted_.vx[i] = hermite_.vx[i] + hermite_.ax[i] * h + jerkX_[i] * h2;
+            predicted_.vy[i] = hermite_.vy[i] + hermite_.ay[i] * h + jerkY_[i] * h2;
+            predicted_.vz[i] = hermite_.vz[i] + hermite_.az[i] * h + jerkZ_[i] * h2;
+        }
+    });
+
+    // 時刻が来た天体だけ、予測した位置と速度で加速度と躍度を計算する
+    const size_t count = activeBodies_.size();
+    parallelFor(count, FORCE_GRAIN, [&](size_t begin, size_t end) {
+        gravity::accelerationJerk(predicted_.x, predicted_.y, predicted_.z, predicted_.vx, predicted_.vy, predicted_.vz, hermite_.mu, n,
+                                  activeBodies_.data(), begin, end,
+                                  predicted_.ax, predicted_.ay, predicted_.az, newJerkX_.data(), newJerkY_.data(), newJerkZ_.data());
+    });
+    ++forceEvaluations_;
+    bodyForceEvaluations_ += count;
+
+    // 修正子: 始点と終点の加速度・躍度から加速度の2階・3階微分を求めて位置と速度を直し、次の刻みを決める
+    parallelFor(count, BODY_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            const size_t i = activeBodies_[k];
+            const double h = hermiteStep_[i] * HERMITE_TICK;
+            const double a0[3] = {hermite_.ax[i], hermite_.ay[i], hermite_.az[i]};
+            const double j0[3] = {jerkX_[i], jerkY_[i], jerkZ_[i]};
+            const double a1[3] = {predicted_.ax[i], predicted_.ay[i], predicted_.az[i]};
+            const double j1[3] = {newJerkX_[i], newJerkY_[i], newJerkZ_[i]};
+            const double predictedPosition[3] = {predicted_.x[i], predicted_.y[i], predicted_.z[i]};
+            const double predictedVelocity[3] = {predicted_.vx[i], predicted_.vy[i], predicted_.vz[i]};
+            double* const position[3] = {&hermite_.x[i], &hermite_.y[i], &hermite_.z[i]};
+            double* const velocity[3] = {&hermite_.vx[i], &hermite_.vy[i], &hermite_.vz[i]};
+            double snap[3], crackle[3], snapEnd[3];    // 加速度の2階微分(始点)、3階微分、2階微分(終点)
+            for (int c = 0; c < 3; ++c) {
+                snap[c] = (-6.0 * (a0[c] - a1[c]) - h * (4.0 * j0[c] + 2.0 * j1[c])) / (h * h);
+                crackle[c] = (12.0 * (a0[c] - a1[c]) + 6.0 * h * (j0[c] + j1[c])) / (h * h * h);
+                *position[c] = predictedPosition[c] + snap[c] * (h*h*h*h / 24) + crackle[c] * (h*h*h*h*h / 120);
+                *velocity[c] = predictedVelocity[c] + snap[c] * (h*h*h / 6) + crackle[c] * (h*h*h*h / 24);
+                snapEnd[c] = snap[c] + h * crackle[c];
+            }
+            hermite_.ax[i] = a1[0]; hermite_.ay[i] = a1[1]; hermite_.az[i] = a1[2];
+            jerkX_[i] = j1[0]; jerkY_[i] = j1[1]; jerkZ_[i] = j1[2];
+            hermiteTime_[i] = blockTime;
+
+            // Aarsethの刻み Δt = sqrt(η (|a||a2| + |a1|^2) / (|a1||a3| + |a2|^2))  (a1, a2, a3 は加速度の1〜3階微分)
+            const double a = norm(a1[0], a1[1], a1[2]);
+            const double j = norm(j1[0], j1[1], j1[2]);
+            const double s = norm(snapEnd[0], snapEnd[1], snapEnd[2]);
+            const double c = norm(crackle[0], crackle[1], crackle[2]);
+            const double denominator = j * c + s * s;
+            double step = (denominator > 0.0) ? std::sqrt(hermiteEta * (a * s + j * j) / denominator) : HERMITE_MAX_STEP;
+            // 原点から遠い天体どうしが近接遭遇すると、刻みの間に動く距離が位置の1ulpを下回り、
+            // 位置が変わらないので加速度も変わらず、上の式が刻みをいくらでも縮めて進まなくなる。
+            // 位置の分解能で意味のある動きになる刻みより縮めない(この下限に掛かるとき、誤差はdoubleの位置の精度で決まる)
+            const double r = norm(hermite_.x[i], hermite_.y[i], hermite_.z[i]);
+            const double v = norm(hermite_.vx[i], hermite_.vy[i], hermite_.vz[i]);
+            if (v > 0.0) step = std::max(step, HERMITE_MIN_MOTION * DBL_EPSILON * r / v);
+            // 縮めるときは何段でも縮め、伸ばすときは今の時刻が2倍の刻みの区切りに合っているときだけ1段伸ばす
+            unsigned long long ticks = hermiteStep_[i];
+            if (step < ticks * HERMITE_TICK) {
+                while (ticks > 1 && ticks * HERMITE_TICK > step) ticks >>= 1;
+            } else if (step >= 2 * ticks * HERMITE_TICK && ticks < HERMITE_MAX_TICKS && blockTime % (2 * ticks) == 0) {
+                ticks <<= 1;
+            }
+            hermiteStep_[i] = ticks;
+        }
+    });
+}
+
+void Universe::updateGaussRadau(float dt) {
+    if (!gaussRadauReady_) {
+        // bodiesの現在の状態から始める。最初の刻みは前回の続き(なければdt)
+        const double step = (gaussRadau.getStep() > 0.0) ? gaussRadau.getStep() : dt;
+        gaussRadau.start(bodies, step, threadPool_.get());
+        gaussRadauReady_ = true;
+    }
+    gaussRadau.advance(dt, threadPool_.get());
+    gaussRadau.store(bodies);
+    // 反復の回数によって1ステップの加速度の計算回数が変わるので、gaussRadauが数えた分を足す
+    const unsigned long long evaluations = gaussRadau.getForceEvaluationCount();
+    const unsigned long long added = evaluations - std::min(gaussRadauEvaluations_, evaluations);
+    forceEvaluations_ += added;
+    bodyForceEvaluations_ += added * bodies.size();
+    gaussRadauEvaluations_ = evaluations;
+    accelerationsValid_ = false;    // bodiesの加速度は計算していない
+}
+
+void Universe::updateWisdomHolman(float dt) {
+    const size_t n = bodies.size();
+    if (!wisdomHolmanReady_) {
+        // bodiesの現在の状態から始める(相互作用の計算1回)
+        wisdomHolman.start(bodies, threadPool_.get());
+        ++forceEvaluations_;
+        bodyForceEvaluations_ += n;
+        wisdomHolmanReady_ = true;
+    }
+    wisdomHolman.step(dt, threadPool_.get());
+    ++forceEvaluations_;
+    bodyForceEvaluations_ += n;
+    wisdomHolman.store(bodies);
+    accelerationsValid_ = false;    // bodiesの加速度は計算していない
+}
+
 void Universe::update(float dt) {
     simulationTime_ += dt; // 時間を更新
-    if (simulationTime_ > 0){
-        calculateForces();  // 力を計算
-        updatePosition(dt);  // 位置と速度を更新
+    if (simulationTime_.value() > 0){
+        if (keepsOwnState()) {
+            // 加速度は積分方法が自分の状態で計算するので、bodiesでは計算しない
+            updatePosition(dt);
+            updateCenterOfMass();
+        } else {
+            calculateForces();  // 力を計算
+            updatePosition(dt);  // 位置と速度を更新
+        }
 
-        for (Sphere& sphere : spheres) {
-            sphere.updateRotation(1.0f); // 回転角度を1度増加
+        for (size_t i = 0; i < sphereCount(); ++i) {
+            sphere(i).updateRotation(1.0f); // 回転角度を1度増加
         }
     }
 }
 
-float Universe::getSimulationTime(){
-    return simulationTime_;
+void Universe::setThreadCount(unsigned threadCount) {
+    if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+    if (threadCount <= 1) {
+        threadPool_.reset();
+    } else {
+        threadPool_.reset(new ThreadPool(threadCount));
+    }
+}
+
+unsigned Universe::getThreadCount() const {
+    return threadPool_ ? threadPool_->size() : 1;
+}
+
+double Universe::getAdaptiveStep() const {
+    if (integrationMethod == IntegrationMethod::IAS15) return gaussRadau.getStep();
+    return adaptiveStep_;
+}
+
+bool Universe::usesForceMethod() const {
+    // Hermite法は躍度も要るので、IAS15とWisdom–Holman法は自分の状態(double)で計算するので、それぞれ直接計算を持っている
+    return integrationMethod != IntegrationMethod::Hermite && integrationMethod != IntegrationMethod::IAS15
+        && integrationMethod != IntegrationMethod::WisdomHolman;
+}
+
+float Universe::getMinAdaptiveTolerance() const {
+    return (precision == Precision::Double) ? DOPRI_MIN_TOLERANCE_PRECISE : DOPRI_MIN_TOLERANCE;
+}
+
+unsigned long long Universe::getForceEvaluationCount() const {
+    return forceEvaluations_;
+}
+
+unsigned long long Universe::getBodyForceEvaluationCount() const {
+    return bodyForceEvaluations_;
+}
+
+bool Universe::keepsOwnState() const {
+    return integrationMethod == IntegrationMethod::DOPRI5 || integrationMethod == IntegrationMethod::Hermite
+        || integrationMethod == IntegrationMethod::IAS15 || integrationMethod == IntegrationMethod::WisdomHolman
+        || precision == Precision::Double || usesLocalFrames();
+}
+
+void Universe::parallelFor(size_t n, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    if (threadPool_) {
+        threadPool_->parallelFor(0, n, grain, body);
+    } else {
+        body(0, n);
+    }
+}
+
+double Universe::getSimulationTime() const {
+    return simulationTime_.value();
+}
+
+const Hierarchy& Universe::getHierarchy() const {
+    return hierarchy_;
+}
+
+Diagnostics Universe::getDiagnostics() const {
+    if (preciseReady_ && precise_.size() == bodies.size()) return diagnosticsOf(precise_);
+    return diagnosticsOf(bodies);
 }
 
 std::chrono::system_clock::time_point Universe::getSimulationTime_tp(){
-    return startTime_+std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<float>(simulationTime_));
+    return startTime_+std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double>(simulationTime_.value()));
 }
\ No newline at end of file
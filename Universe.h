@@ -2,31 +2,191 @@
 #define UNIVERSE_H
 
 #include <chrono>
+#include <functional>
+#include <memory>
 // #include "Constants.h"
 #include "Sphere.h"
+#include "BodyStore.h"
+#include "Summation.h"
+#include "BarnesHut.h"
+#include "Gravity.h"
+#include "ThreadPool.h"
+#include "WisdomHolman.h"
+#include "GaussRadau.h"
+#include "Hierarchy.h"
+#include "TrajectoryStore.h"
 
+// 系全体の保存量。積分方法や刻み幅の精度を比べるのに使う(相対誤差を見るので、質量の代わりにμ = G*mを重みにしたG倍の値を持つ)
+// 単位はシミュレーション単位。どの量もdoubleで足す
+struct Diagnostics {
+    double kinetic;             // Σ μ_i v_i^2 / 2
+    double potential;           // -Σ_{i<j} μ_i μ_j / r_ij
+    double energy;              // kinetic + potential
+    double momentum[3];         // Σ μ_i v_i
+    double angularMomentum[3];  // Σ μ_i r_i × v_i (原点のまわり)
+};
 
-
-// Universeクラス：すべてのSphereオブジェクトを管理し、相互作用を計算、Sphereオブジェクトの状態も更新
+// Universeクラス：すべての天体を管理し、相互作用を計算、天体の状態も更新
+// 天体の物理量はbodies(配列ごとにまとめたもの)に、名前や色などはbodyInfoに分けて持つ。
+// 描画や画面表示からはsphere(i)で得られるSphere(ハンドル)を通して扱う。
 class Universe {
+    friend class Snapshot;  // 保存と読み込みのために内部の状態を直接読み書きする
 public:
     // プロパティ
-    std::vector<Sphere> spheres;  // Sphereオブジェクトのリスト
+    BodyStore bodies;               // 位置・速度・加速度・G*m。力の計算と積分はこれだけを触る
+    std::vector<BodyInfo> bodyInfo; // 名前・色・半径など(bodiesと同じ番号)
+    TrajectoryStore trajectories;   // 全天体の軌跡。1天体あたりの点の数(初期値TRAJECTORYLENGTH)や間引き方はここで調整する
     float centerOfMass[3];  // 重心座標（x, y, z）
     IntegrationMethod integrationMethod;    // 数値積分の方法(Constants.hで定義されたIntegrationMethodという列挙体を入れる。)
+    Precision precision;        // 状態を持つ精度(Constants.hで定義)。Doubleのときbodiesは倍精度の状態を毎ステップ写した表示用のもの
+    bool compensatedSummation;  // 位置と速度に足していくときに補正付きの和(summation::add)を使うか。初期値はtrue
+    bool localFrames;           // 衛星の状態を主星からの相対で持って進めるか。初期値はtrue。Euler〜PEFRLのPrecision::Singleで、衛星があるときだけ使う
+    ForceMethod forceMethod;    // 重力の計算方法(Constants.hで定義)。Hermite法、IAS15、Wisdom–Holman法は使わず、いつもdoubleの直接計算(O(N^2))で進める(usesForceMethod())
+    BarnesHut barnesHut;        // forceMethodがBarnesHutのときに使う。開き角や葉の大きさはここで調整する
+    gravity::Isa directIsa;     // forceMethodがDirectまたはTiledのときに使う命令セット。初期値は実行中のCPUで使える一番速いもの(Hermite法などは上と同じく使わない)
+    float hermiteEta;           // Hermite法の刻みを決める精度パラメータ(Aarsethの η)。小さくするほど刻みが細かくなる
+    GaussRadau gaussRadau;      // integrationMethodがIAS15のときに使う。精度パラメータ(epsilon)はここで調整する
+    WisdomHolman wisdomHolman;  // integrationMethodがWisdomHolmanのときに使う。座標系(democratic heliocentric / Jacobi)はここで選ぶ
+    float adaptiveTolerance;    // DOPRI5で1ステップに許す誤差(そのステップで軌道が曲がる量に対する比)。小さくするほど刻みが細かくなる。getMinAdaptiveTolerance()より小さくはできない
     // コンストラクタ
-    Universe(IntegrationMethod method, std::chrono::system_clock::time_point startTime);
+    Universe(IntegrationMethod method, std::chrono::system_clock::time_point startTime, float waitingPeriod = INITIAL_WAITING_PERIOD);   // waitingPeriod[DT]:開始までの待ち時間。ヘッドレスでは0にする
     // その他メソッド
-    void addSphere(const Sphere& sphere);
-    void calculateForces();
+    Sphere addSphere(     // 天体を追加する。単位は位置km、速度km/s、質量kg、半径km、色0~255
+        std::string name,
+        float posX, float posY, float posZ,
+        float velX, float velY, float velZ,
+        float m, float rad,
+        float r, float g, float b,
+        bool lightEmission,
+        size_t primary = Hierarchy::NONE    // 主星の番号。指定すると位置と速度は主星からの相対になる(主星は先に追加しておくこと)
+    );
+    size_t sphereCount() const;
+    Sphere sphere(size_t index);
+    void calculateForces();     // 現在の位置での加速度と重心を計算する。加速度が計算済みなら計算し直さない
     void updatePosition(float dt);
     void update(float dt);
-    float getSimulationTime();
+    void setThreadCount(unsigned threadCount);  // 計算に使うスレッド数。0ならハードウェアのスレッド数、1なら並列化しない
+    unsigned getThreadCount() const;
+    double getAdaptiveStep() const;     // DOPRI5(IAS15のときはIAS15)の次の刻み幅[s]
+    bool usesForceMethod() const;       // 今のintegrationMethodが、forceMethod(とbarnesHut, directIsa)で加速度を計算するか
+    float getMinAdaptiveTolerance() const;  // 今のprecisionでDOPRI5が使える許容誤差の下限(Singleで3e-6、Doubleで1e-12)。adaptiveToleranceがこれより小さければこの値で進む
+    unsigned long long getForceEvaluationCount() const;     // これまでに加速度を計算した回数(Hermite法では、一部の天体だけを計算したブロックも1回と数える)
+    unsigned long long getBodyForceEvaluationCount() const; // 天体1つの加速度の計算を1回と数えた合計
+    double getSimulationTime() const;   // 補正付きの和で積み上げているので、何年進めても刻みの分だけ正確に進む
     std::chrono::system_clock::time_point getSimulationTime_tp();
+    const Hierarchy& getHierarchy() const;  // 天体の主星の関係
+    // 今の状態の保存量。Precision::Doubleのときは倍精度の状態から、それ以外はbodies(float)から計算する
+    // (floatの位置の丸めのため、エネルギーの相対誤差は1e-7程度より小さくは見えない)。位置エネルギーは全ペアを足すのでO(N^2)
+    Diagnostics getDiagnostics() const;
 
 private:
-    float simulationTime_; // シミュレーションタイム
+    // 積分の途中段階(ステージ)で使う作業領域。bodiesと同じ並びの配列を使う
+    BodyStore stage_;     // 途中段階の状態とその点での加速度
+    BodyStore sum_;       // RK4の傾きの重み付き和(位置の傾きをx,y,z、速度の傾きをvx,vy,vzに入れる)
+    BodyStore error_;     // bodiesの位置と速度(x..vz)の補正付きの和の誤差
+    bool errorValid_;     // error_がbodiesの今の状態のものか。ほかの方法で進めたときはfalseにして0から始める
+
+    // Precision::Doubleのときの状態と作業領域(役割はbodies, stage_, sum_, error_と同じ)
+    PreciseBodyStore precise_, preciseStage_, preciseSum_, preciseError_;
+    bool preciseReady_;                 // precise_がbodiesから作られているか
+    bool preciseAccelerationsValid_;    // precise_の加速度が現在の位置のものか
+    void updatePrecise(float dt);       // precise_を1ステップ進めてbodiesに写す
+
+    // localFramesのときの状態。衛星の位置・速度・加速度は主星からの相対で持つ(主星のない天体はbodiesと同じ)
+    // bodiesには毎ステップ全体の座標に直して写す(軌跡と重心に使うので)
+    Hierarchy hierarchy_;
+    BodyStore local_;
+    BodyStore localError_;              // local_の位置と速度の補正付きの和の誤差
+    BodyStore frameGlobal_;             // 力の計算のために全体の座標に直した位置と、その加速度
+    bool localReady_;                   // local_がbodiesと同じ状態を表しているか。addSphereはこのときだけlocal_にも追加する
+    bool localAccelerationsValid_;      // local_の加速度が現在の位置のものか
+    bool usesLocalFrames() const;       // 今の設定でlocal_を進めるか
+    void updateLocal(float dt);         // local_を1ステップ進めてbodiesに写す
+    void localAccelerations(BodyStore& state);  // 主星からの相対の位置stateで、主星からの相対の加速度を計算する
+
+    // 積分の途中の状態stateの位置で加速度を計算する(localFramesならstateは主星からの相対)
+    void stateAccelerations(BodyStore& state);
+    void stateAccelerations(PreciseBodyStore& state);
+
+    // Euler〜PEFRLで1ステップ進める。stateの加速度は現在の位置のものが入っていること
+    // 戻り値は、終わったときにstateの加速度が新しい位置のものになっているか(シンプレクティック積分法ならtrue)
+    template <typename Real>
+    bool stepFixed(BasicBodyStore<Real>& state, BasicBodyStore<Real>& stage, BasicBodyStore<Real>& sum, BasicBodyStore<Real>& error, float dt);
+
+    // bodiesの加速度が現在の位置のものになっているか
+    // シンプレクティック積分法はステップの最後に新しい位置での加速度を計算するので、次のステップではそれをそのまま使う
+    // bodiesの位置を外から書き換えたときはfalseに戻す必要がある
+    bool accelerationsValid_;
+
+    // シンプレクティック積分法(蛙飛び法を組み合わせたもの)で1ステップ進める
+    template <typename Real>
+    void updateSymplectic(BasicBodyStore<Real>& state, BasicBodyStore<Real>& error, float dt);
+
+    // DOPRI5の状態。bodiesとは別に自分の刻みで進め、bodiesには表示する時刻の値を補間して入れる。precisionがDoubleならprecise側を使う
+    BodyStore dopriStage_[7];   // 各段の位置と傾き(位置の傾き = vx, vy, vz、速度の傾き = ax, ay, az)。[0]が現在のステップの始点で、μも持つ
+    BodyStore dopriDense_[5];   // 直前のステップの補間用の係数(x, y, z, vx, vy, vzだけ使う)
+    PreciseBodyStore preciseDopriStage_[7];
+    PreciseBodyStore preciseDopriDense_[5];
+    std::vector<double> dopriError_;    // 天体ごとの誤差の見積もり(許容誤差との比)
+    std::vector<double> dopriNoise_;    // 天体ごとの、位置の丸めから来る加速度の誤差の見積もり。これより小さい誤差は求めない
+    bool adaptiveReady_;        // 今のprecisionのdopriStage_[0]がbodiesから作られているか。falseなら次のupdateでbodiesから始め直す
+    Precision adaptivePrecision_;   // adaptiveReady_のときの状態の精度
+    double adaptiveTime_;       // 表示する時刻(始め直してからの経過時間[s])。Hermite法でも使う
+    double stepBegin_, stepEnd_;    // 直前のステップの区間
+    double adaptiveStep_;       // 次に試す刻み幅[s]
+    // 表示する時刻をdtだけ進め、足りない分だけステップを進めてbodiesに補間する
+    template <typename Real>
+    void updateAdaptive(float dt, BasicBodyStore<Real>* stage, BasicBodyStore<Real>* dense);
+    // 誤差が許容範囲に収まるまで刻みを縮めながら1ステップ進める。
+    // どの天体もほとんど動かない刻み(位置の数ulp)まで縮めても収まらなければ、その刻みで進める。誤差が有限でなければstd::runtime_error
+    template <typename Real>
+    void stepDopri(BasicBodyStore<Real>* stage, BasicBodyStore<Real>* dense);
+
+    // Hermite法の状態。各天体は自分の時刻hermiteTime_まで進んでいて、bodiesには表示する時刻まで予測子で進めた値を入れる
+    // 時刻と刻みはHERMITE_TICK秒を単位とする整数で持つ(刻みが2の累乗なので、丸め誤差なしに揃えられる)
+    // 状態はdoubleで持つ(修正子は加速度の差から高階の微分を求めるので、floatでは丸め誤差が刻みを決めてしまう。precisionによらない)
+    PreciseBodyStore hermite_;  // 各天体の時刻での位置・速度・加速度とμ
+    PreciseBodyStore predicted_;    // 今のブロックの時刻に予測子で揃えた全天体の位置・速度(x..vz)と、計算し直した天体の加速度(ax..az)
+    std::vector<double> jerkX_, jerkY_, jerkZ_;             // 各天体の時刻での躍度
+    std::vector<double> newJerkX_, newJerkY_, newJerkZ_;    // 今のブロックで計算し直した躍度
+    std::vector<unsigned long long> hermiteTime_;   // 各天体の時刻
+    std::vector<unsigned long long> hermiteStep_;   // 各天体の刻み
+    std::vector<size_t> activeBodies_;  // 今のブロックで力を計算し直す天体
+    bool hermiteReady_;         // hermite_がbodiesから作られているか
+    void updateHermite(float dt);   // 表示する時刻をdtだけ進め、その時刻までのブロックを進めてbodiesに予測する
+    void stepHermiteBlock(unsigned long long blockTime);    // 時刻がblockTimeになる天体だけを進める
+
+    // IAS15の状態はgaussRadauが持つ
+    bool gaussRadauReady_;      // gaussRadauがbodiesから作られているか
+    unsigned long long gaussRadauEvaluations_;  // gaussRadauの加速度の計算回数のうち、forceEvaluations_に足した分
+    void updateGaussRadau(float dt);
+
+    // Wisdom–Holman法は状態をdoubleで自分で持ち、bodiesには毎ステップ書き戻すだけにする
+    bool wisdomHolmanReady_;    // wisdomHolmanがbodiesから作られているか
+    void updateWisdomHolman(float dt);
+
+    bool keepsOwnState() const;     // bodiesとは別に自分の状態を持って進める積分方法か(DOPRI5, Hermite, IAS15, Wisdom–Holman, Precision::Double, localFrames)。bodiesの加速度は使わない
+
+    void updateCenterOfMass();
+    void recordTrajectories();
+    unsigned long long forceEvaluations_;
+    unsigned long long bodyForceEvaluations_;
+
+    std::vector<float> tiledPartial_;   // forceMethodがTiledのときの、スレッドごとの部分和
+    std::vector<double> tiledPartialPrecise_;
+    BodyStore barnesHutView_;           // Precision::DoubleでforceMethodがBarnesHutのときに使う、位置と加速度のfloatの写し
+
+    std::unique_ptr<ThreadPool> threadPool_;   // 2スレッド以上のときだけ作る
+    // [0, n) をスレッドで分担して body(始め, 終わり) を呼ぶ。スレッドプールがなければそのまま呼ぶ
+    void parallelFor(size_t n, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+    // 位置(x, y, z)、μがmuのbodies.size()個の天体の加速度を一度に計算してax, ay, azに書き込む(forceMethodに従う)
+    void computeAccelerations(const float* x, const float* y, const float* z, const float* mu, float* ax, float* ay, float* az);
+    // 倍精度版。Barnes–Hut法は単精度しかないので、floatに直して計算する(近似の誤差の方がずっと大きい)
+    void computeAccelerations(const double* x, const double* y, const double* z, const double* mu, double* ax, double* ay, double* az);
+
+    summation::Compensated<double> simulationTime_; // シミュレーションタイム
     std::chrono::system_clock::time_point startTime_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,290 @@
+// Wisdom–Holman法による積分
+
+#include <algorithm>    // std::sort
+#include <cmath>        // std::sqrt
+#include <functional>   // std::function
+
+#include "WisdomHolman.h"
+#include "BodyStore.h"
+#include "Kepler.h"
+#include "ThreadPool.h"
+
+namespace {
+    const size_t FORCE_GRAIN = 64;      // 相互作用の計算で1つの塊にする天体の数
+    const size_t KEPLER_GRAIN = 256;    // Kepler運動を解くときに1つの塊にする天体の数
+    const int MAX_KEPLER_SPLITS = 8;    // Kepler方程式が収束しなかったとき、刻みを半分にして解き直す回数の上限
+
+    void parallel(ThreadPool* pool, size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body) {
+        if (begin >= end) return;
+        if (pool) {
+            pool->parallelFor(begin, end, grain, body);
+        } else {
+            body(begin, end);
+        }
+    }
+
+    // 収束しなければ刻みを半分にして2回解く
+    void keplerDrift(double mu, double dt, double& x, double& y, double& z, double& vx, double& vy, double& vz, int depth = 0) {
+        if (kepler::drift(mu, dt, x, y, z, vx, vy, vz) || depth >= MAX_KEPLER_SPLITS) return;
+        keplerDrift(mu, dt / 2, x, y, z, vx, vy, vz, depth + 1);
+        keplerDrift(mu, dt / 2, x, y, z, vx, vy, vz, depth + 1);
+    }
+}
+
+WisdomHolman::WisdomHolman(Coordinates coordinatesInput)
+:   coordinates(coordinatesInput),
+    current_(coordinatesInput)
+{
+}
+
+size_t WisdomHolman::size() const {
+    return order_.size();
+}
+
+void WisdomHolman::start(const BodyStore& bodies, ThreadPool* pool) {
+    const size_t n = bodies.size();
+    order_.resize(n);
+    for (size_t i = 0; i < n; ++i) order_[i] = i;
+    if (n == 0) return;
+
+    // G*mが一番大きい天体を先頭にし、残りを中心天体からの距離の順に並べる(Jacobi座標は内側から順に作るため)
+    size_t central = 0;
+    for (size_t i = 1; i < n; ++i) {
+        if (bodies.mu[i] > bodies.mu[central]) central = i;
+    }
+    std::swap(order_[0], order_[central]);
+    std::vector<double> distance(n);
+    for (size_t i = 0; i < n; ++i) {
+        double dx = static_cast<double>(bodies.x[i]) - bodies.x[central];
+        double dy = static_cast<double>(bodies.y[i]) - bodies.y[central];
+        double dz = static_cast<double>(bodies.z[i]) - bodies.z[central];
+        distance[i] = dx*dx + dy*dy + dz*dz;
+    }
+    std::sort(order_.begin() + 1, order_.end(), [&](size_t a, size_t b) {
+        return distance[a] < distance[b] || (distance[a] == distance[b] && a < b);
+    });
+
+    setMasses(bodies);
+    for (std::vector<double>* v : {&x_, &y_, &z_, &vx_, &vy_, &vz_, &ax_, &ay_, &az_}) v->assign(n, 0.0);
+    const float* const source[6] = {bodies.x, bodies.y, bodies.z, bodies.vx, bodies.vy, bodies.vz};
+    for (int q = 0; q < 6; ++q) {
+        for (size_t i = 0; i < n; ++i) inertial_[q][i] = source[q][order_[i]];
+    }
+    fromInertial(inertial_);
+    interactionAccelerations(pool);
+}
+
+void WisdomHolman::setMasses(const BodyStore& bodies) {
+    const size_t n = order_.size();
+    mu_.resize(n);
+    eta_.resize(n);
+    massive_.clear();
+    double eta = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        mu_[i] = bodies.mu[order_[i]];
+        eta += mu_[i];
+        eta_[i] = eta;
+        if (i > 0 && mu_[i] > 0.0) massive_.push_back(i);
+    }
+    for (int q = 0; q < 6; ++q) inertial_[q].resize(n);
+    for (int q = 0; q < 3; ++q) inertialAcceleration_[q].resize(n);
+}
+
+void WisdomHolman::step(double dt, ThreadPool* pool) {
+    if (order_.empty()) return;
+    if (current_ != coordinates) {
+        // 座標系が変えられたので、慣性系を通して変換し直す
+        toInertial(inertial_);
+        fromInertial(inertial_);
+        interactionAccelerations(pool);
+    }
+    const bool democratic = (coordinates == Coordinates::DemocraticHeliocentric);
+    kick(dt / 2);
+    if (democratic) jump(dt / 2);
+    drift(dt, pool);
+    if (democratic) jump(dt / 2);
+    interactionAccelerations(pool);
+    kick(dt / 2);
+}
+
+void WisdomHolman::store(BodyStore& bodies) {
+    const size_t n = order_.size();
+    toInertial(inertial_);
+    float* const target[6] = {bodies.x, bodies.y, bodies.z, bodies.vx, bodies.vy, bodies.vz};
+    for (int q = 0; q < 6; ++q) {
+        for (size_t i = 0; i < n; ++i) target[q][order_[i]] = static_cast<float>(inertial_[q][i]);
+    }
+}
+
+// 慣性系の位置r、速度vから
+//   DemocraticHeliocentric: Q_0 = 重心、Q_i = r_i - r_0 、V_0 = 重心の速度、V_i = v_i - V_0
+//   Jacobi: r'_i = r_i - R_{i-1} (R_iは0〜i番目の天体の重心)、r'_0 = 全体の重心。速度も同じ
+void WisdomHolman::fromInertial(const std::vector<double>* in) {
+    const size_t n = order_.size();
+    const std::vector<double>& rx = in[0]; const std::vector<double>& ry = in[1]; const std::vector<double>& rz = in[2];
+    const std::vector<double>& ux = in[3]; const std::vector<double>& uy = in[4]; const std::vector<double>& uz = in[5];
+    if (coordinates == Coordinates::DemocraticHeliocentric) {
+        const double total = eta_[n - 1];
+        double cx = 0.0, cy = 0.0, cz = 0.0, cvx = 0.0, cvy = 0.0, cvz = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            cx += mu_[i] * rx[i]; cy += mu_[i] * ry[i]; cz += mu_[i] * rz[i];
+            cvx += mu_[i] * ux[i]; cvy += mu_[i] * uy[i]; cvz += mu_[i] * uz[i];
+        }
+        x_[0] = cx / total; y_[0] = cy / total; z_[0] = cz / total;
+        vx_[0] = cvx / total; vy_[0] = cvy / total; vz_[0] = cvz / total;
+        for (size_t i = 1; i < n; ++i) {
+            x_[i] = rx[i] - rx[0]; y_[i] = ry[i] - ry[0]; z_[i] = rz[i] - rz[0];
+            vx_[i] = ux[i] - vx_[0]; vy_[i] = uy[i] - vy_[0]; vz_[i] = uz[i] - vz_[0];
+        }
+    } else {
+        double cx = rx[0], cy = ry[0], cz = rz[0], cvx = ux[0], cvy = uy[0], cvz = uz[0];
+        for (size_t i = 1; i < n; ++i) {
+            x_[i] = rx[i] - cx; y_[i] = ry[i] - cy; z_[i] = rz[i] - cz;
+            vx_[i] = ux[i] - cvx; vy_[i] = uy[i] - cvy; vz_[i] = uz[i] - cvz;
+            const double ratio = mu_[i] / eta_[i];
+            cx += ratio * x_[i]; cy += ratio * y_[i]; cz += ratio * z_[i];
+            cvx += ratio * vx_[i]; cvy += ratio * vy_[i]; cvz += ratio * vz_[i];
+        }
+        x_[0] = cx; y_[0] = cy; z_[0] = cz;
+        vx_[0] = cvx; vy_[0] = cvy; vz_[0] = cvz;
+    }
+    current_ = coordinates;
+}
+
+// fromInertialの逆
+//   DemocraticHeliocentric: r_0 = Q_0 - Σ m_i Q_i / M 、v_0 = V_0 - Σ m_i V_i / m_0 (重心の速度が変わらないように)
+//   Jacobi: R_{i-1} = R_i - (m_i / η_i) r'_i 、r_i = R_{i-1} + r'_i を外側から順に
+void WisdomHolman::toInertial(std::vector<double>* out) const {
+    const size_t n = order_.size();
+    std::vector<double>& rx = out[0]; std::vector<double>& ry = out[1]; std::vector<double>& rz = out[2];
+    std::vector<double>& ux = out[3]; std::vector<double>& uy = out[4]; std::vector<double>& uz = out[5];
+    if (current_ == Coordinates::DemocraticHeliocentric) {
+        double sx = 0.0, sy = 0.0, sz = 0.0, svx = 0.0, svy = 0.0, svz = 0.0;
+        for (size_t i = 1; i < n; ++i) {
+            sx += mu_[i] * x_[i]; sy += mu_[i] * y_[i]; sz += mu_[i] * z_[i];
+            svx += mu_[i] * vx_[i]; svy += mu_[i] * vy_[i]; svz += mu_[i] * vz_[i];
+        }
+        const double total = eta_[n - 1];
+        rx[0] = x_[0] - sx / total; ry[0] = y_[0] - sy / total; rz[0] = z_[0] - sz / total;
+        ux[0] = vx_[0] - svx / mu_[0]; uy[0] = vy_[0] - svy / mu_[0]; uz[0] = vz_[0] - svz / mu_[0];
+        for (size_t i = 1; i < n; ++i) {
+            rx[i] = x_[i] + rx[0]; ry[i] = y_[i] + ry[0]; rz[i] = z_[i] + rz[0];
+            ux[i] = vx_[i] + vx_[0]; uy[i] = vy_[i] + vy_[0]; uz[i] = vz_[i] + vz_[0];
+        }
+    } else {
+        double cx = x_[0], cy = y_[0], cz = z_[0], cvx = vx_[0], cvy = vy_[0], cvz = vz_[0];
+        for (size_t i = n - 1; i >= 1; --i) {
+            const double ratio = mu_[i] / eta_[i];
+            cx -= ratio * x_[i]; cy -= ratio * y_[i]; cz -= ratio * z_[i];
+            cvx -= ratio * vx_[i]; cvy -= ratio * vy_[i]; cvz -= ratio * vz_[i];
+            rx[i] = cx + x_[i]; ry[i] = cy + y_[i]; rz[i] = cz + z_[i];
+            ux[i] = cvx + vx_[i]; uy[i] = cvy + vy_[i]; uz[i] = cvz + vz_[i];
+        }
+        rx[0] = cx; ry[0] = cy; rz[0] = cz;
+        ux[0] = cvx; uy[0] = cvy; uz[0] = cvz;
+    }
+}
+
+// 相互作用(Kepler運動に含まれない引力)による加速度
+//   DemocraticHeliocentric: 中心天体以外の天体どうしの引力だけ。Q_iの差がそのまま天体間の位置の差になる
+//   Jacobi: 慣性系での全天体の加速度をJacobi座標に変換し(位置と同じ変換)、Kepler運動の分 -η_i r'_i / |r'_i|^3 を引く
+void WisdomHolman::interactionAccelerations(ThreadPool* pool) {
+    const size_t n = order_.size();
+    const size_t sources = massive_.size();
+    if (current_ == Coordinates::DemocraticHeliocentric) {
+        ax_[0] = ay_[0] = az_[0] = 0.0;
+        parallel(pool, 1, n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+                for (size_t k = 0; k < sources; ++k) {
+                    const size_t j = massive_[k];
+                    if (j == i) continue;
+                    double dx = x_[j] - x_[i];
+                    double dy = y_[j] - y_[i];
+                    double dz = z_[j] - z_[i];
+                    double r2 = dx*dx + dy*dy + dz*dz;
+                    if (!(r2 > 0.0)) continue;  // 同じ位置にある天体は足さない
+                    double s = mu_[j] / (r2 * std::sqrt(r2));
+                    sumX += s * dx; sumY += s * dy; sumZ += s * dz;
+                }
+                ax_[i] = sumX; ay_[i] = sumY; az_[i] = sumZ;
+            }
+        });
+        return;
+    }
+
+    toInertial(inertial_);
+    const std::vector<double>& rx = inertial_[0];
+    const std::vector<double>& ry = inertial_[1];
+    const std::vector<double>& rz = inertial_[2];
+    std::vector<double>& accX = inertialAcceleration_[0];
+    std::vector<double>& accY = inertialAcceleration_[1];
+    std::vector<double>& accZ = inertialAcceleration_[2];
+    parallel(pool, 0, n, FORCE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+            // 中心天体(0番)と、質量のある天体から
+            for (size_t k = 0; k <= sources; ++k) {
+                const size_t j = (k == 0) ? 0 : massive_[k - 1];
+                if (j == i) continue;
+                double dx = rx[j] - rx[i];
+                double dy = ry[j] - ry[i];
+                double dz = rz[j] - rz[i];
+                double r2 = dx*dx + dy*dy + dz*dz;
+                if (!(r2 > 0.0)) continue;  // 同じ位置にある天体は足さない
+                double s = mu_[j] / (r2 * std::sqrt(r2));
+                sumX += s * dx; sumY += s * dy; sumZ += s * dz;
+            }
+            accX[i] = sumX; accY[i] = sumY; accZ[i] = sumZ;
+        }
+    });
+    // a'_i = a_i - Σ_{k<i} m_k a_k / η_{i-1}
+    double sumX = mu_[0] * accX[0], sumY = mu_[0] * accY[0], sumZ = mu_[0] * accZ[0];
+    ax_[0] = ay_[0] = az_[0] = 0.0;
+    for (size_t i = 1; i < n; ++i) {
+        double r2 = x_[i]*x_[i] + y_[i]*y_[i] + z_[i]*z_[i];
+        double s = eta_[i] / (r2 * std::sqrt(r2));
+        ax_[i] = accX[i] - sumX / eta_[i - 1] + s * x_[i];
+        ay_[i] = accY[i] - sumY / eta_[i - 1] + s * y_[i];
+        az_[i] = accZ[i] - sumZ / eta_[i - 1] + s * z_[i];
+        sumX += mu_[i] * accX[i]; sumY += mu_[i] * accY[i]; sumZ += mu_[i] * accZ[i];
+    }
+}
+
+void WisdomHolman::kick(double dt) {
+    const size_t n = order_.size();
+    for (size_t i = 1; i < n; ++i) {
+        vx_[i] += ax_[i] * dt;
+        vy_[i] += ay_[i] * dt;
+        vz_[i] += az_[i] * dt;
+    }
+}
+
+// 中心天体の運動量 -Σ m_i V_i による項 |Σ m_i V_i|^2 / (2 m_0) で、全天体の位置が同じだけずれる
+void WisdomHolman::jump(double dt) {
+    const size_t n = order_.size();
+    double px = 0.0, py = 0.0, pz = 0.0;
+    for (size_t k = 0; k < massive_.size(); ++k) {
+        const size_t i = massive_[k];
+        px += mu_[i] * vx_[i]; py += mu_[i] * vy_[i]; pz += mu_[i] * vz_[i];
+    }
+    const double scale = dt / mu_[0];
+    px *= scale; py *= scale; pz *= scale;
+    for (size_t i = 1; i < n; ++i) {
+        x_[i] += px; y_[i] += py; z_[i] += pz;
+    }
+}
+
+// 重心は等速直線運動、それ以外の天体はKepler運動
+//   DemocraticHeliocentric: 中心天体のG*mのまわり。Jacobi: η_i(内側の天体すべてと自分のG*mの和)のまわり
+void WisdomHolman::drift(double dt, ThreadPool* pool) {
+    const size_t n = order_.size();
+    x_[0] += vx_[0] * dt; y_[0] += vy_[0] * dt; z_[0] += vz_[0] * dt;
+    const bool democratic = (current_ == Coordinates::DemocraticHeliocentric);
+    parallel(pool, 1, n, KEPLER_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const double mu = democratic ? mu_[0] : eta_[i];
+            keplerDrift(mu, dt, x_[i], y_[i], z_[i], vx_[i], vy_[i], vz_[i]);
+        }
+    });
+}
@@ -0,0 +1,61 @@
+#ifndef WISDOMHOLMAN_H
+#define WISDOMHOLMAN_H
+
+#include <cstddef>  // size_t
+#include <vector>   // std::vector
+
+#include "BodyStore.h"
+
+class ThreadPool;
+
+// Wisdom–Holman法(混合変数シンプレクティック積分法, WHFast型)。2次
+// ハミルトニアンを「中心天体のまわりのKepler運動」と「それ以外の天体どうしの引力(相互作用)」に分け、
+// Kepler運動はkepler::driftで解析的に解き、相互作用だけを速度の変化(Kick)として足す。
+// 相互作用は中心天体の引力に比べて小さい(惑星と中心天体の質量比程度)ので、誤差もその比だけ小さくなり、
+// 一番短い公転周期の数%の刻みでもエネルギーの誤差が一定の幅に収まる。
+//
+// 中心天体はG*mが一番大きい天体とする。状態はすべてdoubleで、選んだ座標系の値として自分で持つ
+// (bodiesのfloatに毎ステップ戻すと、丸め誤差でエネルギーが少しずつずれるため)。
+// 惑星のまわりを回る衛星(月など)は中心天体のまわりのKepler運動から大きく外れるので、刻みを衛星の周期に合わせる必要がある。
+class WisdomHolman {
+public:
+    // 正準座標の選び方
+    enum class Coordinates {
+        DemocraticHeliocentric, // 位置は中心天体からの相対位置、速度は重心に対する速度。天体の順番によらない。中心天体から一度に離れる天体があっても扱える
+        Jacobi                  // 内側の天体から順に、それまでの天体の重心に対する位置と速度。階層的な系で誤差が小さい(天体は中心天体からの距離の順に並べ直す)
+    };
+    Coordinates coordinates;    // 途中で変えてもよい(次のstepで変換し直す)
+
+    WisdomHolman(Coordinates coordinatesInput = Coordinates::DemocraticHeliocentric);
+
+    // bodiesの位置・速度・G*mから始める(最初の相互作用の加速度もここで計算する)
+    void start(const BodyStore& bodies, ThreadPool* pool = nullptr);
+    // dt[s]だけ進める。Kick(dt/2) [Jump(dt/2)] Drift(dt) [Jump(dt/2)] Kick(dt/2)。相互作用の計算は1回
+    // (最後のKickの加速度は次のステップの最初のKickにそのまま使う)
+    void step(double dt, ThreadPool* pool = nullptr);
+    // 現在の位置と速度を慣性系(始めたときの座標の原点)に戻してbodiesに書き込む。加速度は書き込まない
+    void store(BodyStore& bodies);
+    size_t size() const;
+    friend class Snapshot;  // 保存と読み込みのために中身を直接読み書きする
+
+private:
+    std::vector<size_t> order_;     // 内部での天体の並び。order_[0]が中心天体で、残りは中心天体からの距離の順
+    std::vector<double> mu_;        // 並べ直した天体のG*m
+    std::vector<double> eta_;       // Jacobi座標で使う、先頭からi番目までのG*mの和
+    std::vector<size_t> massive_;   // G*mが0でない天体(相互作用の計算で相手になるもの。中心天体は含まない)
+    std::vector<double> x_, y_, z_, vx_, vy_, vz_;      // 選んだ座標系での位置と速度。[0]は重心
+    std::vector<double> ax_, ay_, az_;                  // 選んだ座標系での相互作用の加速度
+    std::vector<double> inertial_[6];                   // 慣性系の位置・速度(変換の作業領域)
+    std::vector<double> inertialAcceleration_[3];      // 慣性系の加速度(Jacobi座標の作業領域)
+    Coordinates current_;           // x_〜vz_がどの座標系の値か
+
+    void setMasses(const BodyStore& bodies);            // order_の順にmu_, eta_, massive_を作り、作業領域を天体数に合わせる
+    void toInertial(std::vector<double>* out) const;    // x_〜vz_ を慣性系の位置・速度に変換してout[0..5]に書き込む
+    void fromInertial(const std::vector<double>* in);   // 慣性系の位置・速度から coordinates の座標系に変換する
+    void interactionAccelerations(ThreadPool* pool);    // 今の位置での相互作用の加速度をax_, ay_, az_に計算する
+    void kick(double dt);
+    void jump(double dt);           // 中心天体の運動量による位置のずれ(DemocraticHeliocentricのみ)
+    void drift(double dt, ThreadPool* pool);
+};
+
+#endif
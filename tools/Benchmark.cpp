@@ -0,0 +1,442 @@
+// 性能の回帰を見つけるためのベンチマーク
+// 力の計算(命令セットと計算方法ごと)、各積分方法の1ステップ、軌跡の記録、カメラの更新の速さを天体数ごとに測る。
+// カメラはOpenGLの行列を読むので、ウィンドウを表示しないコンテキストを作って測る(RenderCheckと同じ。OffscreenContext.h)。
+//   Linux   : -lEGL -lGL -lGLU。ディスプレイのない計算機でもMesaで動く
+//   Windows : -lopengl32 -lglu32 -lgdi32、メモリ量の取得に-lpsapi
+// Camera.cppも一緒にビルドする。コンテキストが作れなければカメラは測らずに続ける。
+//
+// 使い方:
+//   Benchmark [--sizes LIST] [--integrator-sizes LIST] [--cases LIST] [--min-time S] [--repetitions R]
+//             [--max-interactions X] [--max-bytes B] [--threads T] [--json PATH] [--baseline PATH] [--threshold F]
+//     --sizes     : 力の計算と軌跡の記録を測る天体数(カンマ区切り)。省略時は 3,100,1000,10000,100000,1000000
+//     --integrator-sizes : 積分方法を測る天体数。省略時は 3,1000
+//     --cases     : 測るもの(forces, integrators, trajectories, camera のカンマ区切り)。省略時は全部
+//     --min-time  : 1つの項目に使う計算時間の目安[s]。省略時は0.5
+//     --repetitions : 1つの項目を何回に分けて測るか。表示するのはその中央値。省略時は5
+//     --max-interactions : 全ペアを計算する方法(direct, tiled)を測る上限(1回の計算のペアの数)。省略時は1e10
+//     --max-bytes : 軌跡の記録を測る上限(軌跡に使うメモリ[byte])。省略時は1GiB
+//     --max-points : カメラを測る上限(1回の更新で投影する点の数 = 天体数 × (軌跡の点の数 + 1))。省略時は1e7
+//     --threads   : tiled, barneshut と積分方法に使うスレッド数。省略時は1(directのカーネルは常に1スレッド)
+//     --json      : 結果を書き出す(--baselineで読める形式。1行に1項目)
+//     --baseline  : 前に--jsonで書いた結果と比べる。1操作あたりの時間が--threshold(省略時は0.1 = 10%)より遅くなった項目があれば終了コード1
+//
+// 表示する量:
+//   ns/op   : 1操作あたりの時間。操作は力の計算(direct, tiled)なら天体のペア(i, j)(i≠jの順序付き。tiledは半分しか計算しないので速く見える)、
+//             barneshutなら天体1つ、積分方法ならupdate(DT)1回、軌跡なら天体1つの記録、
+//             カメラなら画面に投影する点1つ(天体の今の位置と軌跡の点。Camera::update()は点ごとにgluProjectとgluUnProjectを2回呼ぶ)
+//   ops/s   : 1秒あたりの操作の数(積分方法ならsteps/s)
+//   memory  : その項目の準備と計測で増えたプロセスの常駐メモリ[byte](解放されずに残っていた領域を使い回すと小さく出る)
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>  // GetProcessMemoryInfo
+#else
+#include <unistd.h> // sysconf
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../Constants.h"
+#include "../BarnesHut.h"
+#include "../Camera.h"
+#include "../Frame.h"
+#include "../Gravity.h"
+#include "../Scenario.h"
+#include "../ThreadPool.h"
+#include "../TrajectoryStore.h"
+#include "../Universe.h"
+#include "OffscreenContext.h"
+
+#include <GL/gl.h>
+#include <GL/glu.h>
+
+struct Result {
+    std::string name;
+    size_t bodies;
+    std::string unit;       // 1操作が何か
+    double nsPerOp;
+    double opsPerSecond;
+    long long memoryBytes;
+    unsigned long long iterations;  // 計測で呼んだ回数(全部の回の合計)
+};
+
+struct Options {
+    double minTime = 0.5;
+    int repetitions = 5;
+    double maxInteractions = 1e10;
+    double maxBytes = 1024.0 * 1024.0 * 1024.0;
+    double maxPoints = 1e7;
+    unsigned threads = 1;
+};
+
+// プロセスの今の常駐メモリ[byte]。取れなければ0
+long long residentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return static_cast<long long>(counters.WorkingSetSize);
+    return 0;
+#else
+    std::ifstream statm("/proc/self/statm");
+    long long pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+    return resident * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// opを繰り返し呼んで、1回あたりの時間[s]の中央値を返す。最初の1回は計測しない(キャッシュや木の構築を温める)
+double measure(const Options& options, const std::function<void()>& op, unsigned long long& iterations) {
+    op();
+    // 1回の時間を見て、1回分の計測がminTime/repetitionsくらいになるように呼ぶ回数を決める
+    auto start = std::chrono::steady_clock::now();
+    op();
+    const double once = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double budget = options.minTime / options.repetitions;
+    const unsigned long long calls = once > 0.0 ? std::max<unsigned long long>(1, static_cast<unsigned long long>(budget / once)) : 1000;
+
+    std::vector<double> samples;
+    iterations = 0;
+    for (int r = 0; r < options.repetitions; ++r) {
+        start = std::chrono::steady_clock::now();
+        for (unsigned long long c = 0; c < calls; ++c) op();
+        samples.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / calls);
+        iterations += calls;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+void addResult(std::vector<Result>& results, const std::string& name, size_t bodies, const std::string& unit,
+               double secondsPerCall, double opsPerCall, long long memoryBytes, unsigned long long iterations) {
+    Result result;
+    result.name = name;
+    result.bodies = bodies;
+    result.unit = unit;
+    result.nsPerOp = secondsPerCall * 1e9 / opsPerCall;
+    result.opsPerSecond = secondsPerCall > 0.0 ? opsPerCall / secondsPerCall : 0.0;
+    result.memoryBytes = memoryBytes;
+    result.iterations = iterations;
+    results.push_back(result);
+    std::printf("%-28s %9zu %14.4f ns/%-12s %14.4g ops/s %14lld bytes\n",
+                name.c_str(), bodies, result.nsPerOp, unit.c_str(), result.opsPerSecond, memoryBytes);
+    std::fflush(stdout);
+}
+
+// 太陽・地球・月と、残りを小惑星帯にしたn個の天体(n < 3 なら太陽・地球・月)
+void populate(Universe& universe, size_t n) {
+    scenario::addSunEarthMoon(universe);
+    if (n > universe.sphereCount()) scenario::addAsteroidBelt(universe, n - universe.sphereCount());
+}
+
+void benchmarkForces(const Options& options, size_t n, ThreadPool* pool, std::vector<Result>& results) {
+    const long long memoryBefore = residentBytes();
+    Universe universe(IntegrationMethod::Euler, std::chrono::system_clock::now(), 0.0f);
+    populate(universe, n);
+    n = universe.sphereCount();
+    BodyStore& b = universe.bodies;
+    const double pairs = static_cast<double>(n) * (n - 1);
+    unsigned long long iterations = 0;
+
+    if (pairs <= options.maxInteractions) {
+        const gravity::Isa isas[] = {gravity::Isa::Scalar, gravity::Isa::AVX2, gravity::Isa::AVX512};
+        for (gravity::Isa isa : isas) {
+            if (!gravity::isSupported(isa)) continue;
+            double seconds = measure(options, [&] {
+                gravity::directAccelerations(b.x, b.y, b.z, b.mu, n, 0, n, b.ax, b.ay, b.az, isa);
+            }, iterations);
+            addResult(results, std::string("forces/direct/") + gravity::isaName(isa), n, "interaction", seconds, pairs,
+                      residentBytes() - memoryBefore, iterations);
+        }
+        std::vector<float> partial;
+        const gravity::Isa isa = gravity::detectIsa();
+        double seconds = measure(options, [&] {
+            gravity::tiledAccelerations(b.x, b.y, b.z, b.mu, n, b.ax, b.ay, b.az, isa, pool, partial);
+        }, iterations);
+        addResult(results, std::string("forces/tiled/") + gravity::isaName(isa), n, "interaction", seconds, pairs,
+                  residentBytes() - memoryBefore, iterations);
+    }
+
+    BarnesHut barnesHut;
+    double seconds = measure(options, [&] {
+        barnesHut.accelerations(b.x, b.y, b.z, b.mu, n, b.ax, b.ay, b.az, pool);
+    }, iterations);
+    addResult(results, "forces/barneshut", n, "body", seconds, static_cast<double>(n), residentBytes() - memoryBefore, iterations);
+}
+
+void benchmarkIntegrators(const Options& options, size_t n, std::vector<Result>& results) {
+    const struct {
+        const char* name;
+        IntegrationMethod method;
+    } methods[] = {
+        {"euler", IntegrationMethod::Euler}, {"heun", IntegrationMethod::Heun}, {"rk4", IntegrationMethod::RK4},
+        {"leapfrog", IntegrationMethod::Leapfrog}, {"yoshida4", IntegrationMethod::Yoshida4}, {"yoshida6", IntegrationMethod::Yoshida6},
+        {"pefrl", IntegrationMethod::PEFRL}, {"dopri5", IntegrationMethod::DOPRI5}, {"hermite", IntegrationMethod::Hermite},
+        {"ias15", IntegrationMethod::IAS15}, {"wisdomholman", IntegrationMethod::WisdomHolman}
+    };
+    for (const auto& entry : methods) {
+        const long long memoryBefore = residentBytes();
+        Universe universe(entry.method, std::chrono::system_clock::now(), 0.0f);
+        universe.setThreadCount(options.threads);
+        populate(universe, n);
+        unsigned long long iterations = 0;
+        double seconds = measure(options, [&] { universe.update(scaling::DT); }, iterations);
+        addResult(results, std::string("step/") + entry.name, universe.sphereCount(), "step", seconds, 1.0,
+                  residentBytes() - memoryBefore, iterations);
+    }
+}
+
+void benchmarkTrajectories(const Options& options, size_t n, std::vector<Result>& results) {
+    const double bytes = static_cast<double>(n) * (TRAJECTORYLENGTH + 1) * 3 * sizeof(float);
+    if (bytes > options.maxBytes) return;
+    const long long memoryBefore = residentBytes();
+    Universe universe(IntegrationMethod::Euler, std::chrono::system_clock::now(), 0.0f);
+    populate(universe, n);
+    n = universe.sphereCount();
+    const BodyStore& b = universe.bodies;
+    TrajectoryStore trajectories(TRAJECTORYLENGTH);
+    trajectories.resize(n);
+    unsigned long long iterations = 0;
+    double seconds = measure(options, [&] {
+        for (size_t i = 0; i < n; ++i) trajectories.record(i, b.x[i], b.y[i], b.z[i]);
+    }, iterations);
+    addResult(results, "trajectories/record", n, "record", seconds, static_cast<double>(n), residentBytes() - memoryBefore, iterations);
+}
+
+// 描画スレッドと同じように、計算スレッドが写したFrameからカメラの位置を決める。
+// 行列とビューポートはRealScale_1のウィンドウと同じように設定しておく(Camera::update()はそれを読んで点を投影する)
+void benchmarkCamera(const Options& options, size_t n, std::vector<Result>& results) {
+    const double points = static_cast<double>(n) * (TRAJECTORYLENGTH + 1);
+    if (points > options.maxPoints) return;
+    const long long memoryBefore = residentBytes();
+    Universe universe(IntegrationMethod::Euler, std::chrono::system_clock::now(), 0.0f);
+    populate(universe, n);
+    n = universe.sphereCount();
+
+    // 軌跡を容量いっぱいまで記録する(描画中のいつもの状態)。点は天体の今の位置から少しずつずらす
+    const BodyStore& b = universe.bodies;
+    const size_t capacity = universe.trajectories.capacity();
+    for (size_t k = 0; k < capacity; ++k) {
+        const float offset = static_cast<float>(k) / capacity;
+        for (size_t i = 0; i < n; ++i) universe.trajectories.record(i, b.x[i] + offset, b.y[i] - offset, b.z[i]);
+    }
+    Frame frame;
+    frame.capture(universe);
+    double projected = static_cast<double>(n);
+    for (size_t i = 0; i < n; ++i) projected += frame.bodies[i].trajectoryCount;
+
+    const int width = 1280, height = 720;
+    glViewport(50, 0, width - 100, height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(cameraSetting::fovy, static_cast<double>(width) / height, cameraSetting::zNear, cameraSetting::zFar);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    gluLookAt(0.0, -300.0, 100.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0);
+
+    Camera camera(universe, {});
+    unsigned long long iterations = 0;
+    double seconds = measure(options, [&] { camera.update(frame, 0.5); }, iterations);
+    addResult(results, "camera/update", n, "point", seconds, projected, residentBytes() - memoryBefore, iterations);
+}
+
+bool parseSizes(const std::string& text, std::vector<size_t>& sizes) {
+    sizes.clear();
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        const double value = std::atof(item.c_str());     // 1e6 のようにも書ける
+        if (value < 1.0) return false;
+        sizes.push_back(static_cast<size_t>(value));
+    }
+    return !sizes.empty();
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+bool writeJson(const std::string& path, const std::vector<Result>& results, const Options& options) {
+    std::ofstream file(path);
+    if (!file) return false;
+    file.precision(9);
+    file << "{\n";
+    file << "  \"version\": 1,\n";
+    file << "  \"isa\": \"" << gravity::isaName(gravity::detectIsa()) << "\",\n";
+    file << "  \"threads\": " << options.threads << ",\n";
+    file << "  \"min_time\": " << options.minTime << ",\n";
+    file << "  \"results\": [\n";
+    for (size_t k = 0; k < results.size(); ++k) {
+        const Result& r = results[k];
+        file << "    {\"name\": \"" << jsonEscape(r.name) << "\", \"bodies\": " << r.bodies << ", \"unit\": \"" << r.unit << "\""
+             << ", \"ns_per_op\": " << r.nsPerOp << ", \"ops_per_second\": " << r.opsPerSecond
+             << ", \"memory_bytes\": " << r.memoryBytes << ", \"iterations\": " << r.iterations << "}"
+             << (k + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n";
+    file << "}\n";
+    return static_cast<bool>(file);
+}
+
+// 行の中の "key": の後の値(文字列なら引用符の中)。なければ空
+std::string jsonField(const std::string& line, const std::string& key) {
+    const std::string pattern = "\"" + key + "\":";
+    size_t position = line.find(pattern);
+    if (position == std::string::npos) return "";
+    position = line.find_first_not_of(' ', position + pattern.size());
+    if (position == std::string::npos) return "";
+    if (line[position] == '"') {
+        const size_t end = line.find('"', position + 1);
+        return end == std::string::npos ? "" : line.substr(position + 1, end - position - 1);
+    }
+    const size_t end = line.find_first_of(",}", position);
+    return line.substr(position, end == std::string::npos ? std::string::npos : end - position);
+}
+
+// --jsonで書いたファイルを読む(1行に1項目の形式だけ)。キーは 名前@天体数
+bool readBaseline(const std::string& path, std::map<std::string, double>& baseline) {
+    std::ifstream file(path);
+    if (!file) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        const std::string name = jsonField(line, "name");
+        const std::string bodies = jsonField(line, "bodies");
+        const std::string nsPerOp = jsonField(line, "ns_per_op");
+        if (name.empty() || bodies.empty() || nsPerOp.empty()) continue;
+        baseline[name + "@" + bodies] = std::atof(nsPerOp.c_str());
+    }
+    return true;
+}
+
+// 基準と比べて表示する。遅くなった項目の数を返す
+int compare(const std::vector<Result>& results, const std::map<std::string, double>& baseline, double threshold) {
+    int regressions = 0;
+    std::printf("\n%-28s %9s %14s %14s %9s\n", "comparison", "bodies", "ns/op", "baseline", "change");
+    for (const Result& r : results) {
+        auto it = baseline.find(r.name + "@" + std::to_string(r.bodies));
+        if (it == baseline.end() || it->second <= 0.0) {
+            std::printf("%-28s %9zu %14.4f %14s %9s\n", r.name.c_str(), r.bodies, r.nsPerOp, "-", "new");
+            continue;
+        }
+        const double change = r.nsPerOp / it->second - 1.0;
+        const bool regressed = change > threshold;
+        if (regressed) ++regressions;
+        std::printf("%-28s %9zu %14.4f %14.4f %+8.1f%%%s\n", r.name.c_str(), r.bodies, r.nsPerOp, it->second, change * 100.0,
+                    regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "usage: " << program
+              << " [--sizes LIST] [--integrator-sizes LIST] [--cases forces,integrators,trajectories,camera] [--min-time S] [--repetitions R]"
+              << " [--max-interactions X] [--max-bytes B] [--max-points P] [--threads T] [--json PATH] [--baseline PATH] [--threshold F]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    std::vector<size_t> sizes = {3, 100, 1000, 10000, 100000, 1000000};
+    std::vector<size_t> integratorSizes = {3, 1000};
+    bool runForces = true, runIntegrators = true, runTrajectories = true, runCamera = true;
+    std::string jsonPath, baselinePath;
+    double threshold = 0.1;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sizes" && hasValue) {
+            if (!parseSizes(argv[++i], sizes)) {
+                std::cerr << "invalid sizes: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--integrator-sizes" && hasValue) {
+            if (!parseSizes(argv[++i], integratorSizes)) {
+                std::cerr << "invalid sizes: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--cases" && hasValue) {
+            const std::string cases = argv[++i];
+            runForces = cases.find("forces") != std::string::npos;
+            runIntegrators = cases.find("integrators") != std::string::npos;
+            runTrajectories = cases.find("trajectories") != std::string::npos;
+            runCamera = cases.find("camera") != std::string::npos;
+        } else if (arg == "--min-time" && hasValue) {
+            options.minTime = std::atof(argv[++i]);
+        } else if (arg == "--repetitions" && hasValue) {
+            options.repetitions = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--max-interactions" && hasValue) {
+            options.maxInteractions = std::atof(argv[++i]);
+        } else if (arg == "--max-bytes" && hasValue) {
+            options.maxBytes = std::atof(argv[++i]);
+        } else if (arg == "--max-points" && hasValue) {
+            options.maxPoints = std::atof(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (arg == "--baseline" && hasValue) {
+            baselinePath = argv[++i];
+        } else if (arg == "--threshold" && hasValue) {
+            threshold = std::atof(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // 基準は計測の前に読む(読めないことに最後に気付くと計測が無駄になる)
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty() && !readBaseline(baselinePath, baseline)) {
+        std::cerr << "cannot read baseline: " << baselinePath << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<ThreadPool> pool;
+    if (options.threads != 1) pool.reset(new ThreadPool(options.threads));
+    options.threads = pool ? pool->size() : 1;
+    std::cout << "isa: " << gravity::isaName(gravity::detectIsa()) << ", threads: " << options.threads << std::endl;
+
+    std::vector<Result> results;
+    if (runForces) {
+        for (size_t n : sizes) benchmarkForces(options, n, pool.get(), results);
+    }
+    if (runIntegrators) {
+        for (size_t n : integratorSizes) benchmarkIntegrators(options, n, results);
+    }
+    if (runTrajectories) {
+        for (size_t n : sizes) benchmarkTrajectories(options, n, results);
+    }
+    if (runCamera) {
+        if (offscreen::createContext()) {
+            for (size_t n : sizes) benchmarkCamera(options, n, results);
+        } else {
+            std::cerr << "cannot create an OpenGL context; camera is not measured" << std::endl;
+        }
+        offscreen::destroyContext();
+    }
+
+    if (!jsonPath.empty() && !writeJson(jsonPath, results, options)) {
+        std::cerr << "cannot write " << jsonPath << std::endl;
+        return 1;
+    }
+    if (!baselinePath.empty()) {
+        const int regressions = compare(results, baseline, threshold);
+        std::cout << regressions << " regression(s) over " << threshold * 100.0 << "%" << std::endl;
+        if (regressions > 0) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,342 @@
+// 描画なしでUniverseを回すバッチ実行用のドライバ
+// windows.h / OpenGLに依存しないので、Linuxの計算機でもビルドできる。
+//
+// 使い方:
+//   Headless [--steps N | --years Y | --seconds S] [--dt DT] [--method euler|heun|rk4|leapfrog|yoshida4|yoshida6|pefrl|dopri5|hermite|ias15|wisdomholman] [--report K]
+//            [--tolerance TOL] [--epsilon EPS] [--coordinates democratic|jacobi] [--precision single|double] [--no-compensation] [--no-local-frames]
+//            [--asteroids N] [--force direct|tiled|barneshut] [--theta T] [--leaf L] [--quadrupole] [--rebuild K] [--threads T]
+//            [--isa scalar|avx2|avx512] [--load PATH] [--save PATH] [--checkpoint PATH] [--checkpoint-interval S]
+//            [--record PATH] [--record-stride K] [--keyframe-interval S] [--seek S]
+//     --steps   : 進めるステップ数
+//     --years   : 進めるシミュレーション時間[年] (365日で換算)
+//     --seconds : 進めるシミュレーション時間[s]
+//     --dt      : 時間ステップ[s]。省略時はscaling::DT
+//     --method  : 数値積分の方法。省略時はrk4
+//     --report  : Kステップごとに経過を表示(0なら表示しない)
+//     --tolerance : dopri5の許容誤差(相対)。省略時はUniverseの初期値。精度ごとの下限(Universe::getMinAdaptiveTolerance())より小さければ警告して下限を使う
+//     --epsilon : ias15の精度パラメータ。省略時はGaussRadauの初期値
+//     --coordinates : wisdomholmanの座標系。省略時はdemocratic(democratic heliocentric)
+//     --precision : euler〜pefrlとdopri5で状態を持つ精度。省略時はsingle
+//     --no-compensation : 位置と速度の更新に補正付きの和を使わない(比較用)
+//     --no-local-frames : 月の状態を地球からの相対で持たず、全体の座標で進める(比較用)
+//     --asteroids : 太陽・地球・月に加えてN個の小惑星を置く
+//     --force   : 重力の計算方法。省略時はdirect。hermite, ias15, wisdomholmanはいつもdoubleの直接計算なので、指定すると警告して無視する
+//     --theta, --leaf, --quadrupole, --rebuild : Barnes–Hut法の開き角、葉の大きさ、四重極の有無、木を作り直す間隔
+//     --load    : 初期条件の代わりにスナップショットから再開する。積分や力の計算の設定もファイルのものを使う(--threads, --isaを除く)
+//     --save    : 終わったときの状態をスナップショットに書く
+//     --checkpoint : 計算しながら、--checkpoint-interval秒(シミュレーション時間、省略時は30日)ごとにスナップショットを書く
+//     --record  : 全天体の位置と速度の時系列を書き出す(--record-strideステップごと、省略時は毎ステップ)
+//     --keyframe-interval : 巻き戻し用の履歴をとり、S秒(シミュレーション時間)ごとにキーフレームを置く
+//     --seek    : 終わった後に、履歴を使ってシミュレーション時刻Sの状態に戻して表示する(--keyframe-intervalが必要)
+//     --threads : 計算に使うスレッド数。省略時(0)はハードウェアのスレッド数
+//     --isa     : 直接計算に使う命令セット。省略時はCPUで使える一番速いもの(hermite, ias15, wisdomholmanでは使わない)
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "../Constants.h"
+#include "../Universe.h"
+#include "../Scenario.h"
+#include "../Recorder.h"
+#include "../Replay.h"
+#include "../Snapshot.h"
+
+namespace {
+
+bool parseMethod(const std::string& name, IntegrationMethod& method) {
+    if (name == "euler")      { method = IntegrationMethod::Euler;      return true; }
+    if (name == "heun")       { method = IntegrationMethod::Heun;       return true; }
+    if (name == "rk4")        { method = IntegrationMethod::RK4;        return true; }
+    if (name == "leapfrog")   { method = IntegrationMethod::Leapfrog;   return true; }
+    if (name == "yoshida4")   { method = IntegrationMethod::Yoshida4;   return true; }
+    if (name == "yoshida6")   { method = IntegrationMethod::Yoshida6;   return true; }
+    if (name == "pefrl") { method = IntegrationMethod::PEFRL; return true; }
+    if (name == "dopri5")     { method = IntegrationMethod::DOPRI5;     return true; }
+    if (name == "hermite")    { method = IntegrationMethod::Hermite;    return true; }
+    if (name == "ias15")      { method = IntegrationMethod::IAS15;      return true; }
+    if (name == "wisdomholman") { method = IntegrationMethod::WisdomHolman; return true; }
+    return false;
+}
+
+bool parseForce(const std::string& name, ForceMethod& force) {
+    if (name == "direct")    { force = ForceMethod::Direct;    return true; }
+    if (name == "tiled")     { force = ForceMethod::Tiled;     return true; }
+    if (name == "barneshut") { force = ForceMethod::BarnesHut; return true; }
+    return false;
+}
+
+bool parseCoordinates(const std::string& name, WisdomHolman::Coordinates& coordinates) {
+    if (name == "democratic") { coordinates = WisdomHolman::Coordinates::DemocraticHeliocentric; return true; }
+    if (name == "jacobi")     { coordinates = WisdomHolman::Coordinates::Jacobi;                 return true; }
+    return false;
+}
+
+bool parsePrecision(const std::string& name, Precision& precision) {
+    if (name == "single") { precision = Precision::Single; return true; }
+    if (name == "double") { precision = Precision::Double; return true; }
+    return false;
+}
+
+bool parseIsa(const std::string& name, gravity::Isa& isa) {
+    if (name == "scalar") { isa = gravity::Isa::Scalar; return true; }
+    if (name == "avx2")   { isa = gravity::Isa::AVX2;   return true; }
+    if (name == "avx512") { isa = gravity::Isa::AVX512; return true; }
+    return false;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "usage: " << program
+              << " [--steps N | --years Y | --seconds S] [--dt DT] [--method euler|heun|rk4|leapfrog|yoshida4|yoshida6|pefrl|dopri5|hermite|ias15|wisdomholman] [--report K] [--tolerance TOL] [--epsilon EPS] [--coordinates democratic|jacobi]"
+              << " [--precision single|double] [--no-compensation] [--no-local-frames]"
+              << " [--asteroids N] [--force direct|tiled|barneshut] [--theta T] [--leaf L] [--quadrupole] [--rebuild K] [--threads T]"
+              << " [--isa scalar|avx2|avx512] [--load PATH] [--save PATH] [--checkpoint PATH] [--checkpoint-interval S]"
+              << " [--record PATH] [--record-stride K] [--keyframe-interval S] [--seek S]" << std::endl;
+}
+
+void printState(Universe& universe) {
+    const size_t shown = 10;    // 天体が多いときは先頭だけ表示する
+    for (size_t i = 0; i < universe.sphereCount() && i < shown; ++i) {
+        Sphere sphere = universe.sphere(i);
+        std::cout << "  " << sphere.name()
+                  << " position(" << sphere.x() / scaling::distance << ", " << sphere.y() / scaling::distance << ", " << sphere.z() / scaling::distance << ")[km]"
+                  << " velocity(" << sphere.vx() / scaling::velocity << ", " << sphere.vy() / scaling::velocity << ", " << sphere.vz() / scaling::velocity << ")[km/s]"
+                  << std::endl;
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    const double secondsPerYear = 365.0 * 24.0 * 60.0 * 60.0;
+
+    unsigned long long steps = 0;   // 0のままなら1年分
+    double span = 0.0;              // シミュレーション時間[s]で指定された場合
+    float dt = scaling::DT;
+    unsigned long long report = 0;
+    IntegrationMethod method = IntegrationMethod::RK4;
+    ForceMethod force = ForceMethod::Direct;
+    size_t asteroids = 0;
+    BarnesHut treeSettings;
+    unsigned threads = 0;
+    gravity::Isa isa = gravity::detectIsa();
+    float tolerance = 0.0f;
+    double epsilon = 0.0;
+    WisdomHolman::Coordinates coordinates = WisdomHolman::Coordinates::DemocraticHeliocentric;
+    Precision precision = Precision::Single;
+    bool compensation = true;
+    bool localFrames = true;
+    std::string loadPath, savePath, checkpointPath;
+    double checkpointInterval = 30.0 * 24.0 * 60.0 * 60.0;
+    std::string recordPath;
+    size_t recordStride = 1;
+    double keyframeInterval = 0.0;
+    double seekTime = 0.0;
+    bool seek = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--steps" && hasValue) {
+            steps = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--years" && hasValue) {
+            span = std::atof(argv[++i]) * secondsPerYear;
+        } else if (arg == "--seconds" && hasValue) {
+            span = std::atof(argv[++i]);
+        } else if (arg == "--tolerance" && hasValue) {
+            tolerance = static_cast<float>(std::atof(argv[++i]));
+        } else if (arg == "--epsilon" && hasValue) {
+            epsilon = std::atof(argv[++i]);
+        } else if (arg == "--coordinates" && hasValue) {
+            if (!parseCoordinates(argv[++i], coordinates)) {
+                std::cerr << "unknown coordinates: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--precision" && hasValue) {
+            if (!parsePrecision(argv[++i], precision)) {
+                std::cerr << "unknown precision: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--no-compensation") {
+            compensation = false;
+        } else if (arg == "--no-local-frames") {
+            localFrames = false;
+        } else if (arg == "--load" && hasValue) {
+            loadPath = argv[++i];
+        } else if (arg == "--save" && hasValue) {
+            savePath = argv[++i];
+        } else if (arg == "--checkpoint" && hasValue) {
+            checkpointPath = argv[++i];
+        } else if (arg == "--checkpoint-interval" && hasValue) {
+            checkpointInterval = std::atof(argv[++i]);
+        } else if (arg == "--record" && hasValue) {
+            recordPath = argv[++i];
+        } else if (arg == "--record-stride" && hasValue) {
+            recordStride = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--keyframe-interval" && hasValue) {
+            keyframeInterval = std::atof(argv[++i]);
+        } else if (arg == "--seek" && hasValue) {
+            seekTime = std::atof(argv[++i]);
+            seek = true;
+        } else if (arg == "--dt" && hasValue) {
+            dt = static_cast<float>(std::atof(argv[++i]));
+        } else if (arg == "--method" && hasValue) {
+            if (!parseMethod(argv[++i], method)) {
+                std::cerr << "unknown method: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--report" && hasValue) {
+            report = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--asteroids" && hasValue) {
+            asteroids = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--force" && hasValue) {
+            if (!parseForce(argv[++i], force)) {
+                std::cerr << "unknown force method: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--theta" && hasValue) {
+            treeSettings.theta = static_cast<float>(std::atof(argv[++i]));
+        } else if (arg == "--leaf" && hasValue) {
+            treeSettings.leafSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--quadrupole") {
+            treeSettings.quadrupole = true;
+        } else if (arg == "--rebuild" && hasValue) {
+            treeSettings.rebuildInterval = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--isa" && hasValue) {
+            if (!parseIsa(argv[++i], isa) || !gravity::isSupported(isa)) {
+                std::cerr << "unsupported instruction set: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (dt <= 0.0f) {
+        std::cerr << "dt must be positive" << std::endl;
+        return 1;
+    }
+    // ステップ数はシミュレーション時刻からではなく、ここで整数として数える(時刻を刻みで割ると端数で1ステップずれることがあるため)。
+    if (steps == 0) {
+        if (span <= 0.0) span = secondsPerYear;
+        steps = static_cast<unsigned long long>(span / dt + 0.5);
+    }
+
+    // 待ち時間なしで開始する
+    Universe universe(method, std::chrono::system_clock::now(), 0.0f);
+    universe.forceMethod = force;
+    universe.barnesHut = treeSettings;
+    universe.setThreadCount(threads);
+    universe.directIsa = isa;
+    if (tolerance > 0.0f) universe.adaptiveTolerance = tolerance;
+    if (epsilon > 0.0) universe.gaussRadau.epsilon = epsilon;
+    universe.wisdomHolman.coordinates = coordinates;
+    universe.precision = precision;
+    universe.compensatedSummation = compensation;
+    universe.localFrames = localFrames;
+    if (loadPath.empty()) {
+        scenario::addSunEarthMoon(universe);
+        scenario::addAsteroidBelt(universe, asteroids);
+    } else {
+        auto loadStart = std::chrono::steady_clock::now();
+        try {
+            Snapshot::load(universe, loadPath);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        std::cout << "loaded " << loadPath << " in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count() << "[s]"
+                  << ", simulation time: " << universe.getSimulationTime() << "[s]" << std::endl;
+    }
+    if (universe.integrationMethod == IntegrationMethod::DOPRI5 && universe.adaptiveTolerance < universe.getMinAdaptiveTolerance()) {
+        std::cerr << "warning: tolerance " << universe.adaptiveTolerance << " is below the limit for this precision; using "
+                  << universe.getMinAdaptiveTolerance() << std::endl;
+    }
+    if (!universe.usesForceMethod() && universe.forceMethod != ForceMethod::Direct) {
+        std::cerr << "warning: hermite, ias15 and wisdomholman always use direct double-precision summation; --force is ignored" << std::endl;
+    }
+    std::unique_ptr<Checkpointer> checkpointer;
+    if (!checkpointPath.empty()) checkpointer.reset(new Checkpointer(checkpointPath, checkpointInterval));
+    std::unique_ptr<Recorder> recorder;
+    if (!recordPath.empty()) {
+        try {
+            recorder.reset(new Recorder(recordPath, recordStride));
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        recorder->record(universe);     // 初期状態
+    }
+    std::unique_ptr<Replay> replay;
+    if (keyframeInterval > 0.0) replay.reset(new Replay(keyframeInterval));
+
+    std::cout << "bodies: " << universe.sphereCount() << ", threads: " << universe.getThreadCount()
+              << ", isa: " << gravity::isaName(universe.directIsa)
+              << ", steps: " << steps << ", dt: " << dt << "[s]"
+              << ", simulated: " << steps * static_cast<double>(dt) / secondsPerYear << "[year]" << std::endl;
+    std::cout << "initial state" << std::endl;
+    printState(universe);
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long long step = 1; step <= steps; ++step) {
+        universe.update(dt);
+        if (checkpointer) checkpointer->update(universe);
+        if (recorder) recorder->update(universe);
+        if (replay) replay->update(universe, dt);
+        if (report != 0 && step % report == 0) {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "step " << step << " / " << steps << " (" << step * static_cast<double>(dt) / secondsPerYear << "[year])"
+                      << ", " << step / elapsed << " steps/s" << std::endl;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (checkpointer) {
+        checkpointer->flush();
+        std::cout << "checkpoints: " << checkpointer->getWrittenCount() << std::endl;
+        if (!checkpointer->getLastError().empty()) std::cerr << checkpointer->getLastError() << std::endl;
+    }
+    if (recorder) {
+        recorder->close();
+        std::cout << "recorded frames: " << recorder->getFrameCount()
+                  << ", " << recorder->getRawBytes() << " -> " << recorder->getCompressedBytes() << " bytes";
+        if (recorder->getCompressedBytes() > 0) std::cout << " (ratio " << static_cast<double>(recorder->getRawBytes()) / recorder->getCompressedBytes() << ")";
+        std::cout << std::endl;
+        if (!recorder->getLastError().empty()) std::cerr << recorder->getLastError() << std::endl;
+    }
+    if (!savePath.empty()) {
+        try {
+            Snapshot::save(universe, savePath);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "final state" << std::endl;
+    printState(universe);
+    if (seek) {
+        if (!replay) {
+            std::cerr << "--seek needs --keyframe-interval" << std::endl;
+            return 1;
+        }
+        auto seekStart = std::chrono::steady_clock::now();
+        replay->seek(universe, seekTime);
+        std::cout << "seeked to " << universe.getSimulationTime() << "[s] in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - seekStart).count() << "[s]"
+                  << " (keyframes: " << replay->getKeyframeCount() << ", replayed steps: " << replay->getReplayedStepCount() << ")" << std::endl;
+        printState(universe);
+    }
+    std::cout << "wall time: " << elapsed << "[s], " << (elapsed > 0.0 ? steps / elapsed : 0.0) << " steps/s" << std::endl;
+    std::cout << "force evaluations: " << universe.getForceEvaluationCount()
+              << " (bodies: " << universe.getBodyForceEvaluationCount() << ")" << std::endl;
+    if (method == IntegrationMethod::DOPRI5 || method == IntegrationMethod::IAS15) {
+        std::cout << "adaptive step: " << universe.getAdaptiveStep() << "[s]" << std::endl;
+    }
+    return 0;
+}
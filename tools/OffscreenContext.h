@@ -0,0 +1,101 @@
+#ifndef OFFSCREENCONTEXT_H
+#define OFFSCREENCONTEXT_H
+
+// ウィンドウを表示せずにOpenGLのコンテキストを作る(RenderCheckとBenchmarkで使う。1つの実行ファイルに1つだけ)
+// 描くのはフレームバッファなので、画面は要らない。ソフトウェアのラスタライザ(Mesaのllvmpipe)でも動く。
+//   Linux   : EGLでウィンドウのないコンテキストを作る(-lEGL -lGL)。LIBGL_ALWAYS_SOFTWARE=1にするとllvmpipeを使う
+//   Windows : 見えないウィンドウでコンテキストを作る(-lopengl32 -lgdi32)。MesaのOpenGL32.dllを実行ファイルの隣に置くとllvmpipeを使う
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>  // EGL_PLATFORM_SURFACELESS_MESA
+#endif
+
+#include <cstdint>  // intptr_t
+
+namespace offscreen {
+#ifdef _WIN32
+    inline HWND window = NULL;
+    inline HDC deviceContext = NULL;
+    inline HGLRC renderingContext = NULL;
+
+    // gl::load()に渡す
+    inline void* getProcAddress(const char* name) {
+        void* address = reinterpret_cast<void*>(wglGetProcAddress(name));
+        const intptr_t value = reinterpret_cast<intptr_t>(address);
+        if (value == 1 || value == 2 || value == 3 || value == -1) return nullptr;
+        return address;
+    }
+
+    // 見えないウィンドウにコンテキストを作り、今のコンテキストにする
+    inline bool createContext() {
+        window = CreateWindowEx(0, "STATIC", "offscreen", WS_OVERLAPPEDWINDOW, 0, 0, 16, 16, NULL, NULL, GetModuleHandle(NULL), NULL);
+        if (!window) return false;
+        deviceContext = GetDC(window);
+        PIXELFORMATDESCRIPTOR pfd = {};
+        pfd.nSize = sizeof(pfd);
+        pfd.nVersion = 1;
+        pfd.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL;
+        pfd.iPixelType = PFD_TYPE_RGBA;
+        pfd.cColorBits = 32;
+        if (!SetPixelFormat(deviceContext, ChoosePixelFormat(deviceContext, &pfd), &pfd)) return false;
+        renderingContext = wglCreateContext(deviceContext);
+        return renderingContext && wglMakeCurrent(deviceContext, renderingContext);
+    }
+
+    // createContext()が失敗したときも呼んでよい
+    inline void destroyContext() {
+        wglMakeCurrent(NULL, NULL);
+        if (renderingContext) wglDeleteContext(renderingContext);
+        if (deviceContext) ReleaseDC(window, deviceContext);
+        if (window) DestroyWindow(window);
+        renderingContext = NULL;
+        deviceContext = NULL;
+        window = NULL;
+    }
+#else
+    inline EGLDisplay display = EGL_NO_DISPLAY;
+    inline EGLContext context = EGL_NO_CONTEXT;
+
+    // gl::load()に渡す
+    inline void* getProcAddress(const char* name) {
+        return reinterpret_cast<void*>(eglGetProcAddress(name));
+    }
+
+    // 画面のないコンテキスト(サーフェスなし)を作る。固定機能の行列と光源を使うので互換プロファイルにする
+    inline bool createContext() {
+        // ディスプレイ(Xなど)のない計算機でも作れるように、Mesaのサーフェスのないプラットフォームがあればそれを使う
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) return false;
+        if (!eglBindAPI(EGL_OPENGL_API)) return false;
+        const EGLint configAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+        EGLConfig config = EGL_NO_CONFIG_KHR;  // サーフェスを作らないので、合う設定がなければ設定なしで作る(EGL_KHR_no_config_context)
+        EGLint configs = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) || configs == 0) config = EGL_NO_CONFIG_KHR;
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        return context != EGL_NO_CONTEXT && eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+    }
+
+    // createContext()が失敗したときも呼んでよい
+    inline void destroyContext() {
+        if (display == EGL_NO_DISPLAY) return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        eglTerminate(display);
+        context = EGL_NO_CONTEXT;
+        display = EGL_NO_DISPLAY;
+    }
+#endif
+}
+
+#endif
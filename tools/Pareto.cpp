@@ -0,0 +1,472 @@
+// 積分方法と刻み幅ごとの「精度と計算時間」を測り、Paretoフロント(これより速くて正確な設定がないもの)を出す
+// 精度の許容範囲を決めれば、それを満たす一番安い設定を選べる。
+//
+// 問題(Scenario.hの典型的な問題):
+//   kepler       : 2体問題。解析解(kepler::drift)と比べる
+//   figure8      : 8の字の3体周期解
+//   sunearthmoon : 太陽・地球・月(WinMainと同じ)
+//   plummer      : Plummer球の星団
+// kepler以外は、doubleの状態のDOPRI5を候補のどれよりも小さい許容誤差で解いたものを基準にする。
+// (候補と同じ方法・同じ精度パラメータを基準にすると、その候補は必ず誤差0でフロントに入ってしまうため)
+//
+// 使い方:
+//   Pareto [--problems LIST] [--methods LIST] [--steps-per-period LIST] [--precision single|double|both]
+//          [--eccentricity E] [--plummer N] [--csv PATH] [--energy-budget X] [--position-budget Y]
+//     --problems : 省略時は全部
+//     --methods  : 省略時は全部(euler, heun, rk4, leapfrog, yoshida4, yoshida6, pefrl, dopri5, hermite, ias15, wisdomholman)
+//     --steps-per-period : update(dt)の刻み(特徴的な時間あたりの回数)。2の累乗にそろえる。省略時は 16,32,...,2048
+//                          DOPRI5, Hermite法, IAS15は自分で刻みを決めるので、代わりにそれぞれの精度パラメータを変える
+//     --precision : Euler〜PEFRLとDOPRI5の状態の精度。bothなら両方を測る。省略時はsingle
+//     --eccentricity : keplerの離心率。省略時は0.5
+//     --plummer  : plummerの星の数。省略時は64
+//     --csv      : 全部の結果を書き出す(Paretoフロントに入るものはpareto列が1)
+//     --energy-budget, --position-budget : 許すエネルギーの相対誤差と位置の相対誤差。指定すると、問題ごとにそれを満たす一番速い設定を表示する
+//
+// 測る量:
+//   cpu    : update()に使ったCPU時間[s](保存量の計算は含まない)
+//   energy : エネルギーの相対誤差 |E - E0| / |E0| の、途中(64回)と最後での最大値
+//   position : 最後の時刻での、天体の位置のずれ |Δr| を長さの目安で割ったもの。主星のある天体は主星からの相対位置を比べ、
+//              主星までの距離で割る。ほかは重心からの位置を比べ、系の大きさ(重心からの距離の二乗平均の平方根)で割る。
+//              天体ごとのずれの最大値(plummerだけは、近接遭遇した星がカオス的にずれるので中央値)
+//              向きの角度で比べると、8の字解の真ん中の天体のように重心にいる天体では角度が決まらないため、長さで比べる
+// どちらもfloatの位置から計算するので、1e-7程度より小さくは見えない。
+//
+// 最後の時刻がどの刻みでもぴったり同じになるように、進める時間(span)をfloatに丸め、刻みはそれを2の累乗で割ったものにする。
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../Constants.h"
+#include "../Kepler.h"
+#include "../Scenario.h"
+#include "../Universe.h"
+
+struct Problem {
+    std::string name;
+    double periods;     // 特徴的な時間の何倍進めるか(2の累乗)
+    bool median;        // 位相の誤差を天体の中央値にする
+};
+
+struct Config {
+    std::string name;
+    IntegrationMethod method;
+    Precision precision;
+    double parameter;   // DOPRI5の許容誤差、Hermite法のη、IAS15のε(それ以外は使わない)
+    bool adaptive;
+};
+
+struct Point {
+    std::string problem;
+    std::string config;
+    unsigned long long steps;   // update()の回数
+    double dt;
+    double cpu;
+    double energyError;
+    double positionError;
+    unsigned long long forceEvaluations;
+    bool pareto;
+};
+
+// 位置と速度(x..vz)と主星の番号
+struct State {
+    std::vector<double> values[6];
+    std::vector<double> mu;
+    std::vector<size_t> primary;
+};
+
+State stateOf(const Universe& universe) {
+    State state;
+    const BodyStore& b = universe.bodies;
+    const float* arrays[6] = {b.x, b.y, b.z, b.vx, b.vy, b.vz};
+    for (int q = 0; q < 6; ++q) state.values[q].assign(arrays[q], arrays[q] + b.size());
+    state.mu.assign(b.mu, b.mu + b.size());
+    for (size_t i = 0; i < b.size(); ++i) state.primary.push_back(universe.getHierarchy().primary(i));
+    return state;
+}
+
+// 天体ごとの位置のずれ(長さの目安に対する比)
+double positionError(const State& state, const State& reference, bool median) {
+    const size_t n = state.mu.size();
+    // 重心と系の大きさ
+    double center[2][3] = {};
+    double total = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        total += state.mu[i];
+        for (int q = 0; q < 3; ++q) {
+            center[0][q] += state.mu[i] * state.values[q][i];
+            center[1][q] += reference.mu[i] * reference.values[q][i];
+        }
+    }
+    double size = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        for (int q = 0; q < 3; ++q) {
+            const double d = reference.values[q][i] - center[1][q] / total;
+            size += d * d;
+        }
+    }
+    size = std::sqrt(size / static_cast<double>(n));
+    std::vector<double> errors;
+    for (size_t i = 0; i < n; ++i) {
+        double u[3], w[3];
+        const size_t p = state.primary[i];
+        for (int q = 0; q < 3; ++q) {
+            u[q] = state.values[q][i] - (p == Hierarchy::NONE ? center[0][q] / total : state.values[q][p]);
+            w[q] = reference.values[q][i] - (p == Hierarchy::NONE ? center[1][q] / total : reference.values[q][p]);
+        }
+        const double scale = (p == Hierarchy::NONE) ? size : std::sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+        const double difference = std::sqrt((u[0] - w[0]) * (u[0] - w[0]) + (u[1] - w[1]) * (u[1] - w[1]) + (u[2] - w[2]) * (u[2] - w[2]));
+        errors.push_back(difference / scale);
+    }
+    if (errors.empty()) return 0.0;
+    if (median) {
+        std::nth_element(errors.begin(), errors.begin() + errors.size() / 2, errors.end());
+        return errors[errors.size() / 2];
+    }
+    return *std::max_element(errors.begin(), errors.end());
+}
+
+// 問題の初期条件を置いて、特徴的な時間[s]を返す
+double setUp(Universe& universe, const std::string& problem, double eccentricity, size_t plummerCount) {
+    if (problem == "kepler") return scenario::addKeplerPair(universe, eccentricity);
+    if (problem == "figure8") return scenario::addFigureEight(universe);
+    if (problem == "plummer") return scenario::addPlummer(universe, plummerCount);
+    scenario::addSunEarthMoon(universe);
+    return 365.25 * 24.0 * 60.0 * 60.0;     // 地球の公転周期
+}
+
+// keplerの解析解: 最初の状態から相対運動をspanだけ進め、重心に戻す
+State keplerSolution(const State& initial, double span) {
+    State state = initial;
+    const double mu = initial.mu[0] + initial.mu[1];
+    const double f1 = initial.mu[1] / mu, f2 = initial.mu[0] / mu;
+    double relative[6], center[6];
+    for (int q = 0; q < 6; ++q) {
+        relative[q] = initial.values[q][1] - initial.values[q][0];
+        center[q] = f2 * initial.values[q][0] + f1 * initial.values[q][1];
+    }
+    // 時間はシミュレーション単位(dtはそのまま秒として渡しているので同じ)
+    kepler::drift(mu, span, relative[0], relative[1], relative[2], relative[3], relative[4], relative[5]);
+    for (int q = 0; q < 3; ++q) center[q] += center[q + 3] * span;
+    for (int q = 0; q < 6; ++q) {
+        state.values[q][0] = center[q] - f1 * relative[q];
+        state.values[q][1] = center[q] + f2 * relative[q];
+    }
+    return state;
+}
+
+void applyConfig(Universe& universe, const Config& config) {
+    universe.precision = config.precision;
+    if (config.method == IntegrationMethod::DOPRI5) universe.adaptiveTolerance = static_cast<float>(config.parameter);
+    if (config.method == IntegrationMethod::Hermite) universe.hermiteEta = static_cast<float>(config.parameter);
+    if (config.method == IntegrationMethod::IAS15) universe.gaussRadau.epsilon = config.parameter;
+}
+
+// spanを steps 回に分けて進め、誤差とCPU時間を測る
+Point run(const std::string& problem, const Config& config, double eccentricity, size_t plummerCount,
+          float span, unsigned long long steps, const State* reference, bool median) {
+    Universe universe(config.method, std::chrono::system_clock::now(), 0.0f);
+    universe.setThreadCount(1);
+    setUp(universe, problem, eccentricity, plummerCount);
+    applyConfig(universe, config);
+    const State initial = stateOf(universe);
+    const double energy0 = universe.getDiagnostics().energy;
+
+    const float dt = span / static_cast<float>(steps);     // 2の累乗で割るので丸めはない
+    const unsigned long long samples = std::min<unsigned long long>(64, steps);
+    Point point;
+    point.problem = problem;
+    point.config = config.name;
+    point.steps = steps;
+    point.dt = dt;
+    point.cpu = 0.0;
+    point.energyError = 0.0;
+    point.pareto = false;
+    unsigned long long done = 0;
+    for (unsigned long long k = 1; k <= samples; ++k) {
+        const unsigned long long until = steps * k / samples;
+        const std::clock_t start = std::clock();
+        for (; done < until; ++done) universe.update(dt);
+        point.cpu += static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+        const double energy = universe.getDiagnostics().energy;
+        point.energyError = std::max(point.energyError, std::fabs((energy - energy0) / energy0));
+    }
+    point.forceEvaluations = universe.getForceEvaluationCount();
+    const State final = stateOf(universe);
+    if (reference) {
+        point.positionError = positionError(final, *reference, median);
+    } else {
+        point.positionError = positionError(final, keplerSolution(initial, universe.getSimulationTime()), median);
+    }
+    if (!std::isfinite(point.energyError) || !std::isfinite(point.positionError)) {
+        point.energyError = point.positionError = INFINITY;    // 発散した
+    }
+    return point;
+}
+
+// 問題ごとに、ほかのどの点にも cpu, energy, position のすべてで負けていない点に印を付ける
+void markPareto(std::vector<Point>& points) {
+    for (Point& p : points) {
+        p.pareto = std::isfinite(p.energyError) && std::isfinite(p.positionError);
+        for (const Point& q : points) {
+            if (!p.pareto) break;
+            if (&p == &q || q.problem != p.problem) continue;
+            const bool noWorse = q.cpu <= p.cpu && q.energyError <= p.energyError && q.positionError <= p.positionError;
+            const bool better = q.cpu < p.cpu || q.energyError < p.energyError || q.positionError < p.positionError;
+            if (noWorse && better) p.pareto = false;
+        }
+    }
+}
+
+bool parseList(const std::string& text, std::vector<std::string>& items) {
+    items.clear();
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return !items.empty();
+}
+
+bool parseMethod(const std::string& name, IntegrationMethod& method, bool& adaptive) {
+    const struct {
+        const char* name;
+        IntegrationMethod method;
+        bool adaptive;
+    } methods[] = {
+        {"euler", IntegrationMethod::Euler, false}, {"heun", IntegrationMethod::Heun, false}, {"rk4", IntegrationMethod::RK4, false},
+        {"leapfrog", IntegrationMethod::Leapfrog, false}, {"yoshida4", IntegrationMethod::Yoshida4, false},
+        {"yoshida6", IntegrationMethod::Yoshida6, false}, {"pefrl", IntegrationMethod::PEFRL, false},
+        {"dopri5", IntegrationMethod::DOPRI5, true}, {"hermite", IntegrationMethod::Hermite, true},
+        {"ias15", IntegrationMethod::IAS15, true}, {"wisdomholman", IntegrationMethod::WisdomHolman, false}
+    };
+    for (const auto& entry : methods) {
+        if (name == entry.name) {
+            method = entry.method;
+            adaptive = entry.adaptive;
+            return true;
+        }
+    }
+    return false;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "usage: " << program
+              << " [--problems kepler,figure8,sunearthmoon,plummer] [--methods LIST] [--steps-per-period LIST] [--precision single|double|both]"
+              << " [--eccentricity E] [--plummer N] [--csv PATH] [--energy-budget X] [--position-budget Y]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> problems = {"kepler", "figure8", "sunearthmoon", "plummer"};
+    std::vector<std::string> methods = {"euler", "heun", "rk4", "leapfrog", "yoshida4", "yoshida6", "pefrl",
+                                        "dopri5", "hermite", "ias15", "wisdomholman"};
+    std::vector<unsigned long long> stepsPerPeriod = {16, 32, 64, 128, 256, 512, 1024, 2048};
+    bool single = true, precise = false;
+    double eccentricity = 0.5;
+    size_t plummerCount = 64;
+    std::string csvPath;
+    double energyBudget = -1.0, positionBudget = -1.0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        std::vector<std::string> items;
+        if (arg == "--problems" && hasValue && parseList(argv[++i], items)) {
+            problems = items;
+        } else if (arg == "--methods" && hasValue && parseList(argv[++i], items)) {
+            methods = items;
+        } else if (arg == "--steps-per-period" && hasValue && parseList(argv[++i], items)) {
+            stepsPerPeriod.clear();
+            for (const std::string& item : items) {
+                const unsigned long long value = std::strtoull(item.c_str(), nullptr, 10);
+                if (value == 0 || (value & (value - 1)) != 0) {
+                    std::cerr << "steps per period must be a power of two: " << item << std::endl;
+                    return 1;
+                }
+                stepsPerPeriod.push_back(value);
+            }
+        } else if (arg == "--precision" && hasValue) {
+            const std::string value = argv[++i];
+            single = value == "single" || value == "both";
+            precise = value == "double" || value == "both";
+            if (!single && !precise) {
+                std::cerr << "unknown precision: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--eccentricity" && hasValue) {
+            eccentricity = std::atof(argv[++i]);
+        } else if (arg == "--plummer" && hasValue) {
+            plummerCount = static_cast<size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--csv" && hasValue) {
+            csvPath = argv[++i];
+        } else if (arg == "--energy-budget" && hasValue) {
+            energyBudget = std::atof(argv[++i]);
+        } else if (arg == "--position-budget" && hasValue) {
+            positionBudget = std::atof(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // 設定の一覧。刻みを自分で決める方法は精度パラメータを変える
+    std::vector<Config> configs;
+    for (const std::string& name : methods) {
+        Config config;
+        if (!parseMethod(name, config.method, config.adaptive)) {
+            std::cerr << "unknown method: " << name << std::endl;
+            return 1;
+        }
+        config.precision = Precision::Single;
+        config.parameter = 0.0;
+        if (config.method == IntegrationMethod::DOPRI5) {
+            // floatの状態では3e-6より小さい許容誤差は使えない(Universe::getMinAdaptiveTolerance())
+            if (single) {
+                for (double tolerance : {1e-3, 1e-5, 3e-6}) {
+                    config.parameter = tolerance;
+                    char text[32];
+                    std::snprintf(text, sizeof(text), "/tol=%.0e", tolerance);
+                    config.name = name + text;
+                    configs.push_back(config);
+                }
+            }
+            if (precise) {
+                config.precision = Precision::Double;
+                for (double tolerance : {1e-5, 1e-7, 1e-9}) {
+                    config.parameter = tolerance;
+                    char text[32];
+                    std::snprintf(text, sizeof(text), "/tol=%.0e/double", tolerance);
+                    config.name = name + text;
+                    configs.push_back(config);
+                }
+            }
+        } else if (config.method == IntegrationMethod::Hermite) {
+            for (double eta : {0.04, 0.02, 0.01, 0.005}) {
+                config.parameter = eta;
+                config.name = name + "/eta=" + std::to_string(eta).substr(0, 5);
+                configs.push_back(config);
+            }
+        } else if (config.method == IntegrationMethod::IAS15) {
+            for (double epsilon : {1e-5, 1e-7, 1e-9}) {
+                config.parameter = epsilon;
+                char text[32];
+                std::snprintf(text, sizeof(text), "/eps=%.0e", epsilon);
+                config.name = name + text;
+                configs.push_back(config);
+            }
+        } else if (config.method == IntegrationMethod::WisdomHolman) {
+            config.name = name;
+            configs.push_back(config);
+        } else {
+            if (single) {
+                config.name = name;
+                configs.push_back(config);
+            }
+            if (precise) {
+                config.precision = Precision::Double;
+                config.name = name + "/double";
+                configs.push_back(config);
+            }
+        }
+    }
+
+    std::vector<Point> points;
+    for (const std::string& problem : problems) {
+        if (problem != "kepler" && problem != "figure8" && problem != "sunearthmoon" && problem != "plummer") {
+            std::cerr << "unknown problem: " << problem << std::endl;
+            return 1;
+        }
+        const bool median = problem == "plummer";
+        const double periods = problem == "kepler" ? 8.0 : problem == "figure8" ? 2.0 : 1.0;
+        Universe probe(IntegrationMethod::Euler, std::chrono::system_clock::now(), 0.0f);
+        const float span = static_cast<float>(periods * setUp(probe, problem, eccentricity, plummerCount));
+        const unsigned long long middle = stepsPerPeriod[stepsPerPeriod.size() / 2];
+
+        // 基準: doubleの状態のDOPRI5を、Precision::Doubleで使える一番小さい許容誤差で(kepler以外)
+        State reference;
+        if (problem != "kepler") {
+            Universe universe(IntegrationMethod::DOPRI5, std::chrono::system_clock::now(), 0.0f);
+            setUp(universe, problem, eccentricity, plummerCount);
+            universe.precision = Precision::Double;
+            universe.adaptiveTolerance = universe.getMinAdaptiveTolerance();
+            const unsigned long long steps = static_cast<unsigned long long>(periods) * 4096;
+            const float dt = span / static_cast<float>(steps);
+            for (unsigned long long k = 0; k < steps; ++k) universe.update(dt);
+            reference = stateOf(universe);
+        }
+
+        std::printf("%s (span %.6g s)\n", problem.c_str(), span);
+        std::printf("  %-22s %10s %12s %12s %12s %12s\n", "config", "steps", "cpu[s]", "energy", "position", "forces");
+        for (const Config& config : configs) {
+            std::vector<unsigned long long> grid = stepsPerPeriod;
+            if (config.adaptive) grid.assign(1, middle);     // 刻みは精度パラメータで決まるので、表示の間隔だけ
+            for (unsigned long long perPeriod : grid) {
+                const unsigned long long steps = static_cast<unsigned long long>(periods) * perPeriod;
+                Point point = run(problem, config, eccentricity, plummerCount, span, steps,
+                                  problem == "kepler" ? nullptr : &reference, median);
+                std::printf("  %-22s %10llu %12.4g %12.4g %12.4g %12llu\n", config.name.c_str(), point.steps, point.cpu,
+                            point.energyError, point.positionError, point.forceEvaluations);
+                std::fflush(stdout);
+                points.push_back(point);
+            }
+        }
+    }
+
+    markPareto(points);
+    std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) {
+        return a.problem != b.problem ? a.problem < b.problem : a.cpu < b.cpu;
+    });
+    std::string current;
+    for (const Point& p : points) {
+        if (!p.pareto) continue;
+        if (p.problem != current) {
+            current = p.problem;
+            std::printf("\nPareto front: %s\n", current.c_str());
+            std::printf("  %-22s %10s %12s %12s %12s\n", "config", "steps", "cpu[s]", "energy", "position");
+        }
+        std::printf("  %-22s %10llu %12.4g %12.4g %12.4g\n", p.config.c_str(), p.steps, p.cpu, p.energyError, p.positionError);
+    }
+
+    if (energyBudget >= 0.0 || positionBudget >= 0.0) {
+        std::printf("\ncheapest within budget (energy %s, position %s)\n",
+                    energyBudget >= 0.0 ? std::to_string(energyBudget).c_str() : "-", positionBudget >= 0.0 ? std::to_string(positionBudget).c_str() : "-");
+        for (const std::string& problem : problems) {
+            const Point* best = nullptr;
+            for (const Point& p : points) {
+                if (p.problem != problem) continue;
+                if (energyBudget >= 0.0 && !(p.energyError <= energyBudget)) continue;
+                if (positionBudget >= 0.0 && !(p.positionError <= positionBudget)) continue;
+                if (!best || p.cpu < best->cpu) best = &p;
+            }
+            if (best) {
+                std::printf("  %-14s %-22s steps %llu, cpu %.4g s, energy %.4g, position %.4g\n", problem.c_str(), best->config.c_str(),
+                            best->steps, best->cpu, best->energyError, best->positionError);
+            } else {
+                std::printf("  %-14s none\n", problem.c_str());
+            }
+        }
+    }
+
+    if (!csvPath.empty()) {
+        std::ofstream csv(csvPath);
+        if (!csv) {
+            std::cerr << "cannot write " << csvPath << std::endl;
+            return 1;
+        }
+        csv.precision(9);
+        csv << "problem,config,steps,dt,cpu,energy_error,position_error,force_evaluations,pareto\n";
+        for (const Point& p : points) {
+            csv << p.problem << "," << p.config << "," << p.steps << "," << p.dt << "," << p.cpu << ","
+                << p.energyError << "," << p.positionError << "," << p.forceEvaluations << "," << (p.pareto ? 1 : 0) << "\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,357 @@
+// 球と軌跡の描画をウィンドウなしで確かめる(オフスクリーン描画)
+// 格子状に並べた天体を、SphereRenderer(インスタンス描画)とFrame::drawBody()(gluSphereで1つずつ)の両方でフレームバッファに描き、
+// 画素を読み戻して比べる。描くのにかかった時間と、SphereRendererが描かなかった・点で描いた・形の細かさごとに描いた天体の数も表示する。
+// 見る位置は2つ:
+//   overview : 格子全体を斜め上から見る(天体が多ければほとんどが点になる)
+//   close    : 格子の端から低く見る(手前の球は大きく細かい形で、奥は点で、横の球は視錐台の外)
+// 軌跡(trails)は、天体ごとに格子の点の周りを回る軌跡を作り、1フレームごとに全天体に1点ずつ記録してFrameに写し、
+// TrailRenderer(1回の描画命令)で描く時間と、GPUに書き込んだ点の数を測る。最後にFrame::drawTrajectory()(1本ずつ)と画像を比べる。
+// 時間は、命令を出し終わるまで(submit: ドライバを呼ぶ回数で決まる)と描き終わるまで(total)を分けて測る。
+// ソフトウェアのラスタライザでは頂点と画素の計算が重いので、totalの差はGPUで描くときより小さく出る。
+// ソフトウェアのラスタライザ(Mesaのllvmpipe)でも動くので、GPUのない計算機でも確かめられる。
+//   Linux   : EGLでウィンドウのないコンテキストを作る(-lEGL -lGL -lGLU)。LIBGL_ALWAYS_SOFTWARE=1にするとllvmpipeを使う
+//   Windows : 見えないウィンドウでコンテキストを作る(-lopengl32 -lglu32 -lgdi32)。MesaのOpenGL32.dllを実行ファイルの隣に置くとllvmpipeを使う
+//
+// 使い方:
+//   RenderCheck [--count N] [--size PIXELS] [--frames F] [--legacy-max N] [--trail POINTS] [--ppm PREFIX]
+//     --count  : 天体の数。省略時は10000
+//     --size   : 描く画像の幅と高さ[pixel]。省略時は512
+//     --frames : 時間を測るときに描く回数(その平均を表示する)。省略時は5
+//     --legacy-max : 天体がこれより多ければFrame::drawBody()では描かない(比べない)。省略時は20000
+//     --trail  : 1天体あたりの軌跡の点の数(TrajectoryStoreの容量)。省略時は200
+//     --ppm    : SphereRendererとTrailRendererで描いた画像を PREFIX-overview.ppm, PREFIX-close.ppm, PREFIX-trails.ppm に書き出す
+//
+// 比べるもの:
+//   視錐台で除かず、全部を同じ細かさの形で描いたSphereRenderer(no culling)とFrame::drawBody()
+//     coverage : どちらか一方だけに球が写っている画素の数の、球が写っている画素の数に対する比(球の分割数が違うので輪郭が少しずれる)
+//     color    : 両方に球が写っている画素の色の差の平均(0~1)。固定機能は頂点ごと、SphereRendererは画素ごとに光の当たり方を計算するので少し違う
+//   SphereRendererとSphereRenderer(no culling)
+//     coverage : no cullingにだけ球が写っている画素の比(視錐台の判定や細かさの選び方が見える球を落としていないか)。
+//                点で描いた球は1pixelより小さくても1pixelに写るので、逆に増える画素は数えない
+//     color    : 上と同じ
+//   TrailRenderer(古い点を暗くしない)とFrame::drawTrajectory()
+//     coverage, color : 1つ目と同じ(書き換わった所だけを書き込んだGPUの点が、Frameの点と同じになっているか)
+// どれかのcoverageが0.1、colorが0.1を超えれば終了コード1。
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../Camera.h"     // cameraSetting::fovy
+#include "../Constants.h"
+#include "../Frame.h"
+#include "../GLFunctions.h"
+#include "../SphereRenderer.h"
+#include "../TrailRenderer.h"
+#include "../Universe.h"
+#include "OffscreenContext.h"
+
+#include <GL/glu.h>
+
+namespace {
+    const double COVERAGE_LIMIT = 0.1;
+    const double COLOR_LIMIT = 0.1;
+    const float BACKGROUND = 0.0f;
+
+    // 天体をxy平面に格子状に並べる(単位はaddSphereと同じkm)。光を放つ球と、色の違う球を混ぜる
+    void addGrid(Universe& universe, size_t count, float& extent) {
+        const size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        const float spacing = 3.0f / scaling::distance;    // 描画の単位で3
+        const float radius = 1.0f / scaling::distance;
+        extent = side * 3.0f;
+        const float colors[4][3] = {{255, 200, 0}, {0, 100, 255}, {200, 200, 200}, {255, 80, 60}};
+        for (size_t i = 0; i < count; ++i) {
+            const float x = (static_cast<float>(i % side) - 0.5f * (side - 1)) * spacing;
+            const float y = (static_cast<float>(i / side) - 0.5f * (side - 1)) * spacing;
+            const float* color = colors[i % 4];
+            universe.addSphere("grid" + std::to_string(i), x, y, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, radius,
+                               color[0], color[1], color[2], i % 7 == 0);
+        }
+    }
+
+    // 天体ごとに、格子の点の周りを回る軌跡のk番目の点を記録する(円周の8割で容量がいっぱいになる)
+    void recordOrbit(Universe& universe, size_t index, size_t k) {
+        const double pi = 3.14159265358979;
+        const double angle = 2.0 * pi * static_cast<double>(k + index) / (1.25 * universe.trajectories.capacity());
+        const float radius = 1.2f;
+        universe.trajectories.record(index, universe.bodies.x[index] + radius * static_cast<float>(std::cos(angle)),
+                                     universe.bodies.y[index] + radius * static_cast<float>(std::sin(angle)), 0.0f);
+    }
+
+    // RealScale_1.cppのWM_SIZE, WM_PAINTと同じ行列と光源。eyeからtargetを見る
+    void setScene(int size, float extent, const double eye[3], const double target[3]) {
+        glViewport(0, 0, size, size);
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        gluPerspective(cameraSetting::fovy, 1.0, 0.01, 10.0 * extent);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        gluLookAt(eye[0], eye[1], eye[2], target[0], target[1], target[2], 0.0, 0.0, 1.0);
+
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_LIGHTING);
+        const GLfloat ambient[] = {0.2f, 0.2f, 0.2f, 1.0f};
+        const GLfloat diffuse[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        const GLfloat position[] = {0.0f, 0.0f, 0.5f * extent, 1.0f};  // 格子の上の点光源
+        glLightfv(GL_LIGHT0, GL_AMBIENT, ambient);
+        glLightfv(GL_LIGHT0, GL_DIFFUSE, diffuse);
+        glLightfv(GL_LIGHT0, GL_SPECULAR, diffuse);
+        glLightfv(GL_LIGHT0, GL_POSITION, position);
+        glEnable(GL_LIGHT0);
+        glClearColor(BACKGROUND, BACKGROUND, BACKGROUND, 1.0f);
+    }
+
+    struct Timing {
+        double submit;  // drawがOpenGLの命令を出し終わるまでの時間[s](ドライバを呼ぶ回数で決まる)
+        double total;   // 描き終わる(glFinish())までの時間[s]
+    };
+
+    // drawを描いた時間の平均と、最後に描いた画像
+    template <typename Draw>
+    Timing render(int size, int frames, Draw draw, std::vector<unsigned char>& pixels) {
+        // 1回目はドライバがシェーダーや状態を準備するので数えない
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        draw();
+        glFinish();
+        Timing timing = {0.0, 0.0};
+        for (int f = 0; f < frames; ++f) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glFinish();
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            draw();
+            const std::chrono::steady_clock::time_point submitted = std::chrono::steady_clock::now();
+            glFinish();
+            const std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+            timing.submit += std::chrono::duration<double>(submitted - start).count() / frames;
+            timing.total += std::chrono::duration<double>(finished - start).count() / frames;
+        }
+        pixels.resize(static_cast<size_t>(size) * size * 4);
+        glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        return timing;
+    }
+
+    bool writePPM(const std::string& path, int size, const std::vector<unsigned char>& pixels) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) return false;
+        out << "P6\n" << size << " " << size << "\n255\n";
+        for (int y = size - 1; y >= 0; --y) {     // glReadPixelsは下の行から
+            for (int x = 0; x < size; ++x) out.write(reinterpret_cast<const char*>(&pixels[(static_cast<size_t>(y) * size + x) * 4]), 3);
+        }
+        return static_cast<bool>(out);
+    }
+
+    // 背景以外の画素を球が写っているとみなして、testをreferenceと比べる。違いが大きすぎればfalse
+    // oneSidedならreferenceにだけ写っている画素だけを違いとして数える
+    bool compare(const char* name, const std::vector<unsigned char>& test, const std::vector<unsigned char>& reference, bool oneSided) {
+        size_t covered = 0, mismatched = 0, both = 0;
+        double colorDifference = 0.0;
+        for (size_t p = 0; p < test.size(); p += 4) {
+            const bool a = test[p] || test[p + 1] || test[p + 2];
+            const bool b = reference[p] || reference[p + 1] || reference[p + 2];
+            if (oneSided ? b : (a || b)) ++covered;
+            if (oneSided ? (b && !a) : (a != b)) ++mismatched;
+            if (a && b) {
+                ++both;
+                for (int c = 0; c < 3; ++c) colorDifference += std::abs(test[p + c] - reference[p + c]) / 255.0;
+            }
+        }
+        const double coverage = covered ? static_cast<double>(mismatched) / covered : 1.0;
+        const double color = both ? colorDifference / (3.0 * both) : 1.0;
+        std::printf("  %-30s covered pixels %7zu, coverage difference %.4f, mean color difference %.4f\n", name, covered, coverage, color);
+        return covered > 0 && coverage <= COVERAGE_LIMIT && color <= COLOR_LIMIT;
+    }
+
+    void printUsage(const char* program) {
+        std::cerr << "usage: " << program << " [--count N] [--size PIXELS] [--frames F] [--legacy-max N] [--trail POINTS] [--ppm PREFIX]" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = 10000;
+    int size = 512;
+    int frames = 5;
+    size_t legacyMax = 20000;
+    size_t trail = 200;
+    std::string ppmPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--count" && hasValue) {
+            count = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (arg == "--size" && hasValue) {
+            size = std::atoi(argv[++i]);
+        } else if (arg == "--frames" && hasValue) {
+            frames = std::atoi(argv[++i]);
+        } else if (arg == "--legacy-max" && hasValue) {
+            legacyMax = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (arg == "--trail" && hasValue) {
+            trail = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (arg == "--ppm" && hasValue) {
+            ppmPath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (count == 0 || size <= 0 || frames <= 0 || trail == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (!offscreen::createContext()) {
+        std::cerr << "cannot create an OpenGL context" << std::endl;
+        offscreen::destroyContext();
+        return 1;
+    }
+    std::cout << "renderer: " << glGetString(GL_RENDERER) << " | " << glGetString(GL_VERSION) << std::endl;
+    if (!gl::load(offscreen::getProcAddress)) {
+        std::cerr << "OpenGL 3.3 functions are not available" << std::endl;
+        offscreen::destroyContext();
+        return 1;
+    }
+
+    int result = 0;
+    SphereRenderer renderer;
+    TrailRenderer trailRenderer;
+    GLuint framebuffer = 0, renderbuffers[2] = {0, 0};
+    try {
+        renderer.init();
+        trailRenderer.init();
+
+        // 色と深度のフレームバッファ
+        gl::genFramebuffers(1, &framebuffer);
+        gl::bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        gl::genRenderbuffers(2, renderbuffers);
+        gl::bindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        gl::renderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+        gl::framebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        gl::bindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        gl::renderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        gl::framebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        if (gl::checkFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) throw std::runtime_error("framebuffer is incomplete");
+
+        Universe universe(IntegrationMethod::RK4, std::chrono::system_clock::now(), 0.0f);
+        float extent = 0.0f;
+        addGrid(universe, count, extent);
+        Frame frame;
+        frame.capture(universe);
+        std::printf("bodies %zu, %dx%d\n", count, size, size);
+
+        struct View {
+            const char* name;
+            double eye[3];
+            double target[3];
+        };
+        const View views[] = {
+            {"overview", {0.0, -0.6 * extent, 0.9 * extent}, {0.0, 0.0, 0.0}},
+            {"close", {0.0, -0.5 * extent - 3.0, 2.0}, {0.0, 0.0, 0.0}},
+        };
+        for (const View& view : views) {
+            setScene(size, extent, view.eye, view.target);
+            std::printf("%s\n", view.name);
+
+            std::vector<unsigned char> instanced, plain, legacy;
+            renderer.culling = renderer.levelOfDetail = true;
+            const Timing instancedTiming = render(size, frames, [&] { renderer.draw(frame, 1.0); }, instanced);
+            const SphereRenderer::Statistics& statistics = renderer.getStatistics();
+            std::printf("  SphereRenderer               submit %9.3f ms, total %9.3f ms per frame"
+                        "  (culled %zu, points %zu, meshes %zu / %zu / %zu)\n",
+                        instancedTiming.submit * 1e3, instancedTiming.total * 1e3, statistics.culled, statistics.impostors,
+                        statistics.meshes[0], statistics.meshes[1], statistics.meshes[2]);
+            if (!ppmPath.empty() && !writePPM(ppmPath + "-" + view.name + ".ppm", size, instanced)) {
+                throw std::runtime_error("cannot write " + ppmPath + "-" + view.name + ".ppm");
+            }
+
+            renderer.culling = renderer.levelOfDetail = false;
+            const Timing plainTiming = render(size, frames, [&] { renderer.draw(frame, 1.0); }, plain);
+            std::printf("  SphereRenderer (no culling)  submit %9.3f ms, total %9.3f ms per frame\n", plainTiming.submit * 1e3, plainTiming.total * 1e3);
+            if (!compare("culled vs no culling", instanced, plain, true)) {
+                std::cerr << "culling or level of detail drops visible spheres (" << view.name << ")" << std::endl;
+                result = 1;
+            }
+
+            if (count > legacyMax) continue;
+            const Timing legacyTiming = render(size, frames, [&] {
+                for (size_t i = 0; i < frame.bodies.size(); ++i) frame.drawBody(i, 1.0);
+            }, legacy);
+            std::printf("  Frame::drawBody              submit %9.3f ms, total %9.3f ms per frame\n", legacyTiming.submit * 1e3, legacyTiming.total * 1e3);
+            if (!compare("no culling vs Frame::drawBody", plain, legacy, false)) {
+                std::cerr << "SphereRenderer differs from Frame::drawBody (" << view.name << ")" << std::endl;
+                result = 1;
+            }
+        }
+
+        // 軌跡。天体ごとに記録した点の数を変えて、いっぱいでない軌跡と継ぎ目をまたぐ軌跡を混ぜる
+        universe.trajectories.setCapacity(trail);
+        std::vector<size_t> recorded(count);
+        for (size_t i = 0; i < count; ++i) {
+            recorded[i] = 1 + (i * 37) % (2 * trail);
+            for (size_t k = 0; k < recorded[i]; ++k) recordOrbit(universe, i, k);
+        }
+        frame.capture(universe);
+        setScene(size, extent, views[0].eye, views[0].target);
+        std::printf("trails (%zu points per body, %s buffer)\n", trail, trailRenderer.isPersistent() ? "persistently mapped" : "glBufferSubData");
+
+        // 1フレームごとに全天体が1ステップ進んだことにして、Frameに写してから描く。最初のフレームはバッファを作るので数えない
+        double captureTime = 0.0, submitTime = 0.0, totalTime = 0.0;
+        size_t uploaded = 0, strips = 0;
+        for (int f = 0; f <= frames; ++f) {
+            for (size_t i = 0; i < count; ++i) recordOrbit(universe, i, recorded[i]++);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glFinish();
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            frame.capture(universe);
+            const std::chrono::steady_clock::time_point captured = std::chrono::steady_clock::now();
+            trailRenderer.draw(frame);
+            const std::chrono::steady_clock::time_point submitted = std::chrono::steady_clock::now();
+            glFinish();
+            const std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+            if (f == 0) continue;
+            captureTime += std::chrono::duration<double>(captured - start).count() / frames;
+            submitTime += std::chrono::duration<double>(submitted - captured).count() / frames;
+            totalTime += std::chrono::duration<double>(finished - captured).count() / frames;
+            uploaded += trailRenderer.getStatistics().uploadedPoints;
+            strips = trailRenderer.getStatistics().strips;
+        }
+        std::printf("  Frame::capture               %9.3f ms per frame\n", captureTime * 1e3);
+        std::printf("  TrailRenderer                submit %9.3f ms, total %9.3f ms per frame  (strips %zu, uploaded points %zu of %zu)\n",
+                    submitTime * 1e3, totalTime * 1e3, strips, uploaded / frames, count * (trail + 1));
+
+        std::vector<unsigned char> trails, faded, legacyTrails;
+        if (!ppmPath.empty()) {
+            render(size, 1, [&] { trailRenderer.draw(frame); }, faded);
+            if (!writePPM(ppmPath + "-trails.ppm", size, faded)) throw std::runtime_error("cannot write " + ppmPath + "-trails.ppm");
+        }
+        if (count <= legacyMax) {
+            const float fade = trailRenderer.fade;
+            trailRenderer.fade = 0.0f;
+            render(size, 1, [&] { trailRenderer.draw(frame); }, trails);
+            trailRenderer.fade = fade;
+            const Timing legacyTiming = render(size, frames, [&] {
+                for (size_t i = 0; i < frame.bodies.size(); ++i) frame.drawTrajectory(i);
+            }, legacyTrails);
+            std::printf("  Frame::drawTrajectory        submit %9.3f ms, total %9.3f ms per frame\n", legacyTiming.submit * 1e3, legacyTiming.total * 1e3);
+            if (!compare("TrailRenderer vs drawTrajectory", trails, legacyTrails, false)) {
+                std::cerr << "TrailRenderer differs from Frame::drawTrajectory" << std::endl;
+                result = 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        result = 1;
+    }
+
+    renderer.destroy();
+    trailRenderer.destroy();
+    if (framebuffer) gl::deleteFramebuffers(1, &framebuffer);
+    if (renderbuffers[0]) gl::deleteRenderbuffers(2, renderbuffers);
+    offscreen::destroyContext();
+    return result;
+}